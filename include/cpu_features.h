@@ -0,0 +1,31 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+
+/*
+    runtime CPU feature checks for the hand written SIMD paths
+
+    the build stays at the compiler's default instruction set, kernels that use more are compiled
+    per function with CPU_TARGET_AVX2 / CPU_TARGET_AVX2_FMA and only called after a check here
+*/
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86 1
+#endif
+
+#if defined(CPU_X86) && !defined(_MSC_VER)
+#define CPU_TARGET_AVX __attribute__((target("avx")))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#define CPU_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#else
+#define CPU_TARGET_AVX
+#define CPU_TARGET_AVX2
+#define CPU_TARGET_AVX2_FMA
+#endif
+
+// all include the OS check that ymm registers are saved, false on anything that isn't x86
+bool cpuHasAvx();
+bool cpuHasAvx2();
+bool cpuHasFma();
+
+#endif
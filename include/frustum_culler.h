@@ -0,0 +1,76 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+
+
+/*
+    view frustum culling of many objects by their bounding volumes
+
+        FrustumCuller culler;
+        culler.resize(objectCount);
+        culler.setBox(id, boxMin, boxMax);                 // when an object moves, in world space
+        ...
+        culler.cull(projection * view, visible);           // every frame, then draw only visible
+
+    1. the planes come out of the view-projection matrix (Gribb/Hartmann), normalized, pointing in.
+       an object is culled when its volume is entirely behind one of them
+    2. every object has a sphere and a box around the same center, kept as structure of arrays
+       (center x, y, z, radius, half extent x, y, z). setBox gives the sphere through the corners,
+       setSphere the box around the sphere. spheres are the cheaper test, boxes the tighter one:
+        sphere  dot(n, center) + w < -radius
+        box     dot(n, center) + w < -dot(abs(n), extent)
+    3. AVX2/FMA tests 8 objects a step, SSE 4, the scalar loop one. the survivors of a step come out
+       of a lane mask: AVX2 left-packs their indices with one permute from a 256 entry table, the
+       other paths write every lane and only advance over the visible ones, no branches either way
+    4. with parallel on, the objects are cut into chunks of 16k for the thread pool. every chunk
+       compacts into its own part of the output, then they are moved together, so the visible list
+       is in increasing order whatever the thread count
+*/
+
+// the six clip planes (xyz normal, w distance, normalized) of a view-projection matrix, in
+// whatever space the matrix takes its input from
+void extractFrustumPlanes(const glm::mat4 &viewProjection, glm::vec4 planes[6]);
+
+enum FrustumVolume
+{
+    FrustumSphere,
+    FrustumBox
+};
+
+struct FrustumCullOptions
+{
+    FrustumVolume volume = FrustumSphere;
+    bool parallel = true;
+    int simdWidth = 8;   // 8 AVX2/FMA, 4 SSE, 1 scalar, lowered to what the CPU has
+};
+
+class FrustumCuller
+{
+public:
+    // new objects are a point at the origin
+    void resize(size_t count);
+    size_t size() const { return count; }
+
+    void setSphere(size_t i, const glm::vec3 &center, float radius);
+    void setBox(size_t i, const glm::vec3 &boxMin, const glm::vec3 &boxMax);
+
+    // fills visible with the indices of the objects inside or crossing the frustum, in increasing
+    // order, and returns how many there are
+    size_t cull(const glm::mat4 &viewProjection, std::vector<unsigned int> &visible,
+                const FrustumCullOptions &options = FrustumCullOptions()) const;
+
+    // the widest simdWidth this CPU runs
+    static int maxSimdWidth();
+
+private:
+    size_t count = 0;
+    // padded to a multiple of 8, the lanes past count are masked off
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> extentX, extentY, extentZ;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "vertex_layout.h"
+#include "range_allocator.h"
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+struct MeshData;
+class StreamRing;
+
+
+/*
+    many meshes in one vertex and one index buffer, drawn with glMultiDrawElementsIndirect
+
+        GeometryPool pool(VertexLayout::standard(), 1 << 20, 4 << 20);
+        MeshHandle crate = pool.add(loadMesh("crate.obj"));
+        ...
+        MultiDrawBatch batch(pool);
+        batch.add(materialId, crate, transform);          // per object, every frame
+        batch.submit(ring, [&](unsigned int materialId) { ... bind textures ... });
+        batch.clear();
+        pool.defragment(256 << 10);                       // once a frame, moves at most 256 KB
+
+    1. every mesh of the pool shares its layout, so one VAO covers all of them. a mesh is a range of
+       the index buffer plus a base vertex, its indices stay local to the mesh
+    2. the ranges come from a RangeAllocator per buffer (vertices and indices), so meshes can be
+       removed and added while streaming without new buffer objects. defragment moves the highest
+       meshes down into holes with glCopyBufferSubData, a few at a time, the copies run on the GPU
+       in order with the draws so nothing has to wait. that's why meshes are handles: where a mesh
+       lives can change between frames
+    3. draws are sorted by bucket (whatever state has to change between them: program, textures)
+       and each bucket becomes one DrawElementsIndirectCommand array and one multi draw call
+    4. the per draw transforms go into a shader storage buffer, the vertex shader (MULTI_DRAW define)
+       picks its own with gl_DrawID, which counts the draws of one multi draw call from 0
+    5. commands and transforms are written into a StreamRing, nothing is copied through the driver
+*/
+
+// the layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+typedef unsigned int MeshHandle;
+
+// where one mesh lives in the pool right now
+struct PoolMesh
+{
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    int baseVertex = 0;
+    unsigned int vertexCount = 0;
+};
+
+struct GeometryPoolStats
+{
+    RangeAllocatorStats vertices;   // in vertices
+    RangeAllocatorStats indices;    // in indices
+    size_t meshes = 0;
+    size_t bytesMoved = 0;          // by defragment, since the pool was made
+};
+
+class GeometryPool
+{
+public:
+    unsigned int VAO, VBO, EBO;
+
+    // the buffers are allocated up front, add throws std::runtime_error when a mesh doesn't fit
+    GeometryPool(const VertexLayout &layout, uint32_t maxVertices, uint32_t maxIndices);
+    ~GeometryPool();
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    // packs mesh into the pool's layout
+    MeshHandle add(const MeshData &mesh);
+    // vertices already in the pool's layout, indices count from 0 for this mesh
+    MeshHandle add(const void *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount);
+    // the ranges are free right away, draws already issued still read the old data
+    void remove(MeshHandle mesh);
+
+    const PoolMesh& mesh(MeshHandle mesh) const { return entries[mesh].mesh; }
+
+    // moves meshes into lower holes until about byteBudget bytes were copied, returns the bytes moved
+    size_t defragment(size_t byteBudget);
+
+    const VertexLayout& layout() const { return vertexLayout; }
+    GeometryPoolStats stats() const;
+
+    // "#define MULTI_DRAW" for the Shader constructor
+    static std::string shaderDefines();
+
+private:
+    struct Entry
+    {
+        PoolMesh mesh;
+        RangeAllocation vertices, indices;
+        bool live;
+    };
+
+    // moves the highest allocations of one arena down, vertices or indices
+    size_t compact(bool vertexArena, size_t byteBudget);
+
+    VertexLayout vertexLayout;
+    RangeAllocator vertexRanges, indexRanges;
+    std::vector<Entry> entries;
+    std::vector<MeshHandle> freeHandles;
+    size_t meshCount = 0;
+    size_t totalMoved = 0;
+};
+
+class MultiDrawBatch
+{
+public:
+    // binding point of the per draw transforms in the shader
+    static const int transformBinding = 0;
+
+    explicit MultiDrawBatch(GeometryPool &pool);
+
+    void add(unsigned int bucket, MeshHandle mesh, const glm::mat4 &transform);
+    void clear();
+    size_t size() const { return draws.size(); }
+
+    // one glMultiDrawElementsIndirect per bucket, in increasing bucket order. bindBucket sets up the
+    // state of a bucket (the program has to be built with GeometryPool::shaderDefines()), the
+    // commands and transforms go into the current frame of ring. returns the number of draw calls
+    int submit(StreamRing &ring, const std::function<void(unsigned int bucket)> &bindBucket);
+
+private:
+    struct Draw
+    {
+        unsigned int bucket;
+        MeshHandle mesh;
+        glm::mat4 transform;
+    };
+
+    GeometryPool &pool;
+    std::vector<Draw> draws;
+    std::vector<unsigned int> order;   // draws sorted by bucket, kept to reuse its memory
+    size_t storageAlignment;
+};
+
+#endif
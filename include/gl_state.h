@@ -0,0 +1,109 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+
+/*
+    shadow copy of the GL binding and fixed function state we touch every frame,
+    a call that wouldn't change anything is dropped before it reaches the driver
+
+    everything that binds or enables something has to go through here, otherwise the shadow
+    gets out of sync with the real context. after raw GL calls (or a new context) call invalidate()
+*/
+
+enum StateCall
+{
+    STATE_PROGRAM,
+    STATE_VERTEX_ARRAY,
+    STATE_BUFFER,
+    STATE_ACTIVE_TEXTURE,
+    STATE_TEXTURE,
+    STATE_SAMPLER,
+    STATE_CAPABILITY,
+    STATE_BLEND_FUNC,
+    STATE_DEPTH_FUNC,
+    STATE_DEPTH_MASK,
+    STATE_CALL_COUNT
+};
+
+// how many calls of each kind went to the driver and how many were redundant
+struct StateCallStats
+{
+    long issued[STATE_CALL_COUNT] = {};
+    long skipped[STATE_CALL_COUNT] = {};
+
+    long totalIssued() const;
+    long totalSkipped() const;
+    static const char* name(int call);
+};
+
+class GLStateCache
+{
+public:
+    static const int maxTextureUnits = 32;
+
+    GLStateCache();
+
+    // forget everything, the next call of every kind goes through
+    void invalidate();
+
+    void useProgram(unsigned int program);
+    void bindVertexArray(unsigned int vertexArray);
+    // GL_ELEMENT_ARRAY_BUFFER is part of the bound VAO and is tracked per VAO switch
+    void bindBuffer(GLenum target, unsigned int buffer);
+    // indexed bindings aren't shadowed and always go through, the generic binding they move is
+    void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+    void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+    void activeTexture(int unit);
+    void bindTexture(int unit, GLenum target, unsigned int texture);
+    void bindSampler(int unit, unsigned int sampler);
+
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void blendFunc(GLenum source, GLenum destination);
+    void depthFunc(GLenum function);
+    void depthMask(bool write);
+
+    // objects being deleted have to be forgotten, GL may hand the same name out again
+    void forgetProgram(unsigned int program);
+    void forgetVertexArray(unsigned int vertexArray);
+    void forgetBuffer(unsigned int buffer);
+    void forgetTexture(unsigned int texture);
+
+    const StateCallStats& stats() const { return callStats; }
+    void resetStats() { callStats = StateCallStats(); }
+
+private:
+    enum BufferSlot { ARRAY_BUFFER_SLOT, ELEMENT_BUFFER_SLOT, UNIFORM_BUFFER_SLOT, PIXEL_UNPACK_SLOT,
+                      DRAW_INDIRECT_SLOT, COPY_READ_SLOT, COPY_WRITE_SLOT, SHADER_STORAGE_SLOT, BUFFER_SLOT_COUNT };
+    enum CapabilitySlot { BLEND_SLOT, DEPTH_TEST_SLOT, CULL_FACE_SLOT, SCISSOR_TEST_SLOT, CAPABILITY_SLOT_COUNT };
+    enum TextureTargetSlot { TEXTURE_2D_SLOT, TEXTURE_2D_ARRAY_SLOT, TEXTURE_CUBE_SLOT, TEXTURE_BUFFER_SLOT, TEXTURE_TARGET_COUNT };
+
+    static int bufferSlot(GLenum target);
+    static int capabilitySlot(GLenum capability);
+    static int textureTargetSlot(GLenum target);
+    bool setCapability(GLenum capability, bool enabled);
+    void count(StateCall call, bool issued);
+
+    // unknown means "whatever the driver has", the first call always goes through
+    static const unsigned int unknown = 0xFFFFFFFFu;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int buffers[BUFFER_SLOT_COUNT];
+    int activeUnit;
+    unsigned int textures[maxTextureUnits][TEXTURE_TARGET_COUNT];
+    unsigned int samplers[maxTextureUnits];
+    int capabilities[CAPABILITY_SLOT_COUNT];   // -1 unknown, 0 off, 1 on
+    GLenum blendSource, blendDestination;
+    GLenum depthFunction;
+    int depthWrite;
+
+    StateCallStats callStats;
+};
+
+// the cache for the current context, there is only ever one context per process here
+GLStateCache& glState();
+
+#endif
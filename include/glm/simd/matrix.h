@@ -1025,4 +1025,214 @@ GLM_FUNC_QUALIFIER void glm_mat4_outerProduct(__m128 const & c, __m128 const & r
 	out[3] = _mm_mul_ps(c, _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)));
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+// AVX and FMA variants
+//
+// These don't depend on GLM_ARCH: each function carries its own target attribute, so a build
+// for plain SSE2 still contains them. Calling one on a CPU without the instructions is illegal,
+// the caller checks cpuid first and keeps the SSE2 functions above as the fallback.
+
+#if GLM_COMPILER & (GLM_COMPILER_GCC | GLM_COMPILER_CLANG)
+#	define GLM_SIMD_TARGET_AVX __attribute__((target("avx")))
+#	define GLM_SIMD_TARGET_AVX_FMA __attribute__((target("avx,fma")))
+#else
+#	define GLM_SIMD_TARGET_AVX
+#	define GLM_SIMD_TARGET_AVX_FMA
+#endif
+
+#include <immintrin.h>
+
+GLM_SIMD_TARGET_AVX_FMA GLM_FUNC_QUALIFIER glm_vec4 glm_mat4_mul_vec4_fma(glm_vec4 const m[4], glm_vec4 v)
+{
+	__m128 v0 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 v1 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 v2 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 v3 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+
+	__m128 a0 = _mm_mul_ps(m[0], v0);
+	__m128 a1 = _mm_fmadd_ps(m[1], v1, a0);
+	__m128 a2 = _mm_fmadd_ps(m[2], v2, a1);
+	__m128 a3 = _mm_fmadd_ps(m[3], v3, a2);
+
+	return a3;
+}
+
+// Two vectors per ymm: v holds vector 0 in the low 128 bits and vector 1 in the high ones.
+GLM_SIMD_TARGET_AVX_FMA GLM_FUNC_QUALIFIER __m256 glm_mat4_mul_vec4_x2_fma(glm_vec4 const m[4], __m256 v)
+{
+	__m256 c0 = _mm256_broadcast_ps(&m[0]);
+	__m256 c1 = _mm256_broadcast_ps(&m[1]);
+	__m256 c2 = _mm256_broadcast_ps(&m[2]);
+	__m256 c3 = _mm256_broadcast_ps(&m[3]);
+
+	__m256 a0 = _mm256_mul_ps(c0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+	__m256 a1 = _mm256_fmadd_ps(c1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), a0);
+	__m256 a2 = _mm256_fmadd_ps(c2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), a1);
+	__m256 a3 = _mm256_fmadd_ps(c3, _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3)), a2);
+
+	return a3;
+}
+
+// Two columns of the result per ymm. The columns of in1 are repeated in both 128 bit lanes, the
+// elements of two columns of in2 are splat inside their lane, so one multiply-add chain makes
+// out[0] and out[1] and a second one out[2] and out[3]. Same operations in the same order as
+// glm_mat4_mul, so the result is identical. Memory is only touched with unaligned loads and
+// stores, so the arrays may come from a plain glm::mat4.
+GLM_SIMD_TARGET_AVX GLM_FUNC_QUALIFIER void glm_mat4_mul_avx(glm_vec4 const in1[4], glm_vec4 const in2[4], glm_vec4 out[4])
+{
+	__m256 a01 = _mm256_loadu_ps(reinterpret_cast<float const*>(&in1[0]));
+	__m256 a23 = _mm256_loadu_ps(reinterpret_cast<float const*>(&in1[2]));
+	__m256 c0 = _mm256_permute2f128_ps(a01, a01, 0x00);
+	__m256 c1 = _mm256_permute2f128_ps(a01, a01, 0x11);
+	__m256 c2 = _mm256_permute2f128_ps(a23, a23, 0x00);
+	__m256 c3 = _mm256_permute2f128_ps(a23, a23, 0x11);
+
+	for(int i = 0; i < 2; ++i)
+	{
+		__m256 b = _mm256_loadu_ps(reinterpret_cast<float const*>(&in2[i * 2]));
+
+		__m256 m0 = _mm256_mul_ps(c0, _mm256_permute_ps(b, _MM_SHUFFLE(0, 0, 0, 0)));
+		__m256 m1 = _mm256_mul_ps(c1, _mm256_permute_ps(b, _MM_SHUFFLE(1, 1, 1, 1)));
+		__m256 m2 = _mm256_mul_ps(c2, _mm256_permute_ps(b, _MM_SHUFFLE(2, 2, 2, 2)));
+		__m256 m3 = _mm256_mul_ps(c3, _mm256_permute_ps(b, _MM_SHUFFLE(3, 3, 3, 3)));
+
+		__m256 a0 = _mm256_add_ps(m0, m1);
+		__m256 a1 = _mm256_add_ps(m2, m3);
+		__m256 a2 = _mm256_add_ps(a0, a1);
+
+		_mm256_storeu_ps(reinterpret_cast<float*>(&out[i * 2]), a2);
+	}
+}
+
+// glm_mat4_mul_avx with fused multiply-adds, one rounding per element step instead of two.
+GLM_SIMD_TARGET_AVX_FMA GLM_FUNC_QUALIFIER void glm_mat4_mul_fma(glm_vec4 const in1[4], glm_vec4 const in2[4], glm_vec4 out[4])
+{
+	__m256 a01 = _mm256_loadu_ps(reinterpret_cast<float const*>(&in1[0]));
+	__m256 a23 = _mm256_loadu_ps(reinterpret_cast<float const*>(&in1[2]));
+	__m256 c0 = _mm256_permute2f128_ps(a01, a01, 0x00);
+	__m256 c1 = _mm256_permute2f128_ps(a01, a01, 0x11);
+	__m256 c2 = _mm256_permute2f128_ps(a23, a23, 0x00);
+	__m256 c3 = _mm256_permute2f128_ps(a23, a23, 0x11);
+
+	for(int i = 0; i < 2; ++i)
+	{
+		__m256 b = _mm256_loadu_ps(reinterpret_cast<float const*>(&in2[i * 2]));
+
+		__m256 a0 = _mm256_mul_ps(c0, _mm256_permute_ps(b, _MM_SHUFFLE(0, 0, 0, 0)));
+		__m256 a1 = _mm256_fmadd_ps(c1, _mm256_permute_ps(b, _MM_SHUFFLE(1, 1, 1, 1)), a0);
+		__m256 a2 = _mm256_fmadd_ps(c2, _mm256_permute_ps(b, _MM_SHUFFLE(2, 2, 2, 2)), a1);
+		__m256 a3 = _mm256_fmadd_ps(c3, _mm256_permute_ps(b, _MM_SHUFFLE(3, 3, 3, 3)), a2);
+
+		_mm256_storeu_ps(reinterpret_cast<float*>(&out[i * 2]), a3);
+	}
+}
+
+// r[i] holds element i of 8 rows, afterwards r[j] holds elements 0 - 7 of row j.
+GLM_SIMD_TARGET_AVX GLM_FUNC_QUALIFIER void glm_transpose8_avx(__m256 r[8])
+{
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Inverse of 8 matrices at once, in[4 * i + c] is column c of matrix i (unaligned is fine). The matrices are
+// transposed so that every ymm holds one element of all 8, then the cofactor expansion runs
+// lane-wise exactly as it would for a single matrix: 12 2x2 determinants of the two column
+// pairs, the determinant from them and the adjugate scaled by its reciprocal. A singular
+// matrix gives infinities or NaNs like glm_mat4_inverse.
+GLM_SIMD_TARGET_AVX_FMA GLM_FUNC_QUALIFIER void glm_mat4_inverse_x8_fma(glm_vec4 const in[32], glm_vec4 out[32])
+{
+	__m256 lo[8], hi[8];
+	for(int i = 0; i < 8; ++i)
+	{
+		lo[i] = _mm256_loadu_ps(reinterpret_cast<float const*>(&in[i * 4]));
+		hi[i] = _mm256_loadu_ps(reinterpret_cast<float const*>(&in[i * 4 + 2]));
+	}
+	glm_transpose8_avx(lo);
+	glm_transpose8_avx(hi);
+
+	// aCR is row R of column C
+	__m256 a00 = lo[0], a01 = lo[1], a02 = lo[2], a03 = lo[3];
+	__m256 a10 = lo[4], a11 = lo[5], a12 = lo[6], a13 = lo[7];
+	__m256 a20 = hi[0], a21 = hi[1], a22 = hi[2], a23 = hi[3];
+	__m256 a30 = hi[4], a31 = hi[5], a32 = hi[6], a33 = hi[7];
+
+	__m256 s0 = _mm256_fmsub_ps(a00, a11, _mm256_mul_ps(a10, a01));
+	__m256 s1 = _mm256_fmsub_ps(a00, a12, _mm256_mul_ps(a10, a02));
+	__m256 s2 = _mm256_fmsub_ps(a00, a13, _mm256_mul_ps(a10, a03));
+	__m256 s3 = _mm256_fmsub_ps(a01, a12, _mm256_mul_ps(a11, a02));
+	__m256 s4 = _mm256_fmsub_ps(a01, a13, _mm256_mul_ps(a11, a03));
+	__m256 s5 = _mm256_fmsub_ps(a02, a13, _mm256_mul_ps(a12, a03));
+
+	__m256 c5 = _mm256_fmsub_ps(a22, a33, _mm256_mul_ps(a32, a23));
+	__m256 c4 = _mm256_fmsub_ps(a21, a33, _mm256_mul_ps(a31, a23));
+	__m256 c3 = _mm256_fmsub_ps(a21, a32, _mm256_mul_ps(a31, a22));
+	__m256 c2 = _mm256_fmsub_ps(a20, a33, _mm256_mul_ps(a30, a23));
+	__m256 c1 = _mm256_fmsub_ps(a20, a32, _mm256_mul_ps(a30, a22));
+	__m256 c0 = _mm256_fmsub_ps(a20, a31, _mm256_mul_ps(a30, a21));
+
+	// s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0
+	__m256 det = _mm256_mul_ps(s0, c5);
+	det = _mm256_fnmadd_ps(s1, c4, det);
+	det = _mm256_fmadd_ps(s2, c3, det);
+	det = _mm256_fmadd_ps(s3, c2, det);
+	det = _mm256_fnmadd_ps(s4, c1, det);
+	det = _mm256_fmadd_ps(s5, c0, det);
+	__m256 r = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+	__m256 n = _mm256_sub_ps(_mm256_setzero_ps(), r);
+
+	// x * p - y * q + z * t, times the reciprocal (n for the negated terms)
+#	define GLM_COFACTOR(x, p, y, q, z, t, scale) _mm256_mul_ps(_mm256_fmadd_ps(z, t, _mm256_fmsub_ps(x, p, _mm256_mul_ps(y, q))), scale)
+
+	lo[0] = GLM_COFACTOR(a11, c5, a12, c4, a13, c3, r);
+	lo[1] = GLM_COFACTOR(a01, c5, a02, c4, a03, c3, n);
+	lo[2] = GLM_COFACTOR(a31, s5, a32, s4, a33, s3, r);
+	lo[3] = GLM_COFACTOR(a21, s5, a22, s4, a23, s3, n);
+	lo[4] = GLM_COFACTOR(a10, c5, a12, c2, a13, c1, n);
+	lo[5] = GLM_COFACTOR(a00, c5, a02, c2, a03, c1, r);
+	lo[6] = GLM_COFACTOR(a30, s5, a32, s2, a33, s1, n);
+	lo[7] = GLM_COFACTOR(a20, s5, a22, s2, a23, s1, r);
+	hi[0] = GLM_COFACTOR(a10, c4, a11, c2, a13, c0, r);
+	hi[1] = GLM_COFACTOR(a00, c4, a01, c2, a03, c0, n);
+	hi[2] = GLM_COFACTOR(a30, s4, a31, s2, a33, s0, r);
+	hi[3] = GLM_COFACTOR(a20, s4, a21, s2, a23, s0, n);
+	hi[4] = GLM_COFACTOR(a10, c3, a11, c1, a12, c0, n);
+	hi[5] = GLM_COFACTOR(a00, c3, a01, c1, a02, c0, r);
+	hi[6] = GLM_COFACTOR(a30, s3, a31, s1, a32, s0, n);
+	hi[7] = GLM_COFACTOR(a20, s3, a21, s1, a22, s0, r);
+
+#	undef GLM_COFACTOR
+
+	glm_transpose8_avx(lo);
+	glm_transpose8_avx(hi);
+	for(int i = 0; i < 8; ++i)
+	{
+		_mm256_storeu_ps(reinterpret_cast<float*>(&out[i * 4]), lo[i]);
+		_mm256_storeu_ps(reinterpret_cast<float*>(&out[i * 4 + 2]), hi[i]);
+	}
+}
+
 #endif//GLM_ARCH & GLM_ARCH_SSE2_BIT
@@ -0,0 +1,34 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+#include <string>
+
+
+// an OpenGL context without any window, made with EGL on the surfaceless Mesa platform
+// so it runs on build servers without a GPU or X server (llvmpipe)
+// everything renders into an offscreen framebuffer of the given size
+class HeadlessContext
+{
+public:
+    unsigned int framebuffer;
+    int width, height;
+
+    // creates the context, makes it current, loads glad and binds the framebuffer
+    // throws std::runtime_error when EGL or the context can't be set up
+    HeadlessContext(int width, int height);
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // "renderer | version" of the context, for benchmark reports
+    std::string description() const;
+
+private:
+    void *display;
+    void *context;
+    unsigned int colorBuffer, depthBuffer;
+};
+
+#endif
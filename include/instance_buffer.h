@@ -0,0 +1,92 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+class StreamRing;
+
+
+/*
+    per-instance data for drawing many copies of one mesh with a single glDrawElementsInstanced
+
+        InstanceBuffer instances;
+        instances.attach(VAO);                          // once, next to loadBuffer
+        Shader shader(vs, fs, InstanceBuffer::shaderDefines(false));
+        ...
+        instances.upload(transforms.data(), transforms.size());   // every frame
+        instances.draw(VAO, indexCount);
+
+    1. every instance has a mat4 at attribute locations 4 - 7, tinted buffers add a vec4 color at 8
+       (multiplies the texture color) and a vec2 uv offset at 9. glVertexAttribDivisor(location, 1)
+       makes them advance once per instance instead of once per vertex
+    2. the streams live in their own buffers, so the mesh's VBO stays GL_STATIC_DRAW
+    3. upload orphans the old storage (glBufferData with null) before writing, the driver hands out
+       fresh memory while the previous frame's draw may still be reading the old one. the StreamRing
+       overload writes into a persistently mapped ring instead, no driver copy at all, and draw
+       points the attributes at wherever the last upload went
+    4. the shaders pick the instanced path with the INSTANCED / INSTANCE_TINT defines, the transform
+       uniform is still applied on top, as the camera
+*/
+
+struct InstanceTint
+{
+    glm::vec4 color = glm::vec4(1.0f);
+    glm::vec2 uvOffset = glm::vec2(0.0f);
+};
+
+class InstanceBuffer
+{
+public:
+    static const int transformLocation = 4;   // takes 4 - 7, one per column
+    static const int colorLocation = 8;
+    static const int uvOffsetLocation = 9;
+
+    unsigned int transformBuffer;
+    unsigned int tintBuffer;   // 0 unless tinted
+
+    explicit InstanceBuffer(bool tinted = false);
+    ~InstanceBuffer();
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    // sets the instance attribute pointers on vertexArray, can be called for several vertex arrays
+    void attach(unsigned int vertexArray);
+
+    // streams count instances for the next draws, tints must be given for a tinted buffer
+    // (throws std::invalid_argument otherwise)
+    void upload(const glm::mat4 *transforms, size_t count, const InstanceTint *tints = nullptr);
+    // the same into the current frame of ring, draw before the ring's endFrame
+    void upload(StreamRing &ring, const glm::mat4 *transforms, size_t count, const InstanceTint *tints = nullptr);
+
+    // every uploaded instance of the indexed mesh in vertexArray, with the current program. firstIndex
+    // picks a range of the index buffer, a LOD level for example
+    void draw(unsigned int vertexArray, GLsizei indexCount, size_t firstIndex = 0) const;
+
+    size_t count() const { return instanceCount; }
+    bool tinted() const { return tintBuffer != 0; }
+
+    // "#define INSTANCED" (and INSTANCE_TINT) for the Shader constructor
+    static std::string shaderDefines(bool tinted);
+
+private:
+    // rebinds the instance attributes of the bound vertex array to the last upload
+    void bindStreams() const;
+
+    size_t instanceCount = 0;
+    size_t capacity = 0;   // instances the buffers were last allocated for
+
+    // where the last upload went, our own buffers at 0 or a region of a ring
+    unsigned int transformSource = 0, tintSource = 0;
+    size_t transformOffset = 0, tintOffset = 0;
+};
+
+// count copies of a unit sized mesh on a square grid over clip space [-1, 1], each spinning
+// around z with time at its own phase. the instances are split over the thread pool
+void layoutInstanceGrid(std::vector<glm::mat4> &transforms, size_t count, float time);
+
+#endif
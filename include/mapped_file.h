@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+
+/*
+    read only memory mapping of a whole file
+
+    the pages come straight from the page cache, so parsers can point into data() instead of
+    reading the file into a buffer first. the mapping goes away with the object, anything that
+    points into it has to be done by then
+*/
+
+class MappedFile
+{
+public:
+    // throws std::runtime_error when the file can't be opened or mapped
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+    // tells the kernel the whole file is about to be read front to back
+    void adviseSequential() const;
+
+private:
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
+
+#endif
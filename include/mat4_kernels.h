@@ -0,0 +1,54 @@
+#ifndef MAT4_KERNELS_H
+#define MAT4_KERNELS_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+
+/*
+    batched mat4 math on the widest SIMD path the CPU has, picked at runtime
+
+        const Mat4Kernels &kernels = mat4Kernels();          // cpuid on the first call, a table of functions after
+        kernels.multiply(parents, locals, worlds, count);
+        kernels.inverse(worlds, inverses, count);
+
+    1. the levels, every one needs the CPU of the one before:
+        scalar   glm's own operators (type_mat4x4.inl and func_matrix.inl), what glm::mat4 does today
+        sse2     glm/simd/matrix.h as glm ships it: glm_mat4_mul, glm_mat4_mul_vec4, glm_mat4_inverse
+        avx      glm_mat4_mul_avx, two columns of the result per ymm
+        avx_fma  glm_mat4_mul_fma, glm_mat4_mul_vec4_x2_fma (two vectors per ymm) and
+                 glm_mat4_inverse_x8_fma (8 matrices a step, one per lane)
+    2. glm picks its SIMD path from GLM_ARCH at compile time, which for a default x86-64 build is
+       SSE2. the AVX/FMA functions in glm/simd/matrix.h carry their own target attribute instead,
+       so the same binary holds all levels and cpu_features.h decides which one runs
+    3. arrays need no alignment, the kernels load and store unaligned. out may be the same array as
+       an input
+*/
+
+enum Mat4KernelLevel
+{
+    Mat4Scalar,
+    Mat4Sse2,
+    Mat4Avx,
+    Mat4AvxFma,
+    Mat4KernelLevelCount
+};
+
+struct Mat4Kernels
+{
+    const char *name;
+    // out[i] = a[i] * b[i]
+    void (*multiply)(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, size_t count);
+    // out[i] = m * in[i]
+    void (*transform)(const glm::mat4 &m, const glm::vec4 *in, glm::vec4 *out, size_t count);
+    // out[i] = glm::inverse(in[i])
+    void (*inverse)(const glm::mat4 *in, glm::mat4 *out, size_t count);
+};
+
+// the highest level this CPU runs
+const Mat4Kernels& mat4Kernels();
+// a given level, nullptr when the CPU or the build doesn't have it
+const Mat4Kernels* mat4Kernels(Mat4KernelLevel level);
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include "mapped_file.h"
+#include "vertex_layout.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct MeshData;
+
+
+/*
+    .bmesh, a binary mesh container that is mapped and uploaded as it is
+
+        mesh_convert model.glb model.bmesh --lods 4 --meshlets      // the converter target, at build time
+        ...
+        MeshFile file("model.bmesh");                               // mmap and a header check, no parsing
+        loadBuffer(file.vertexData(), file.vertexBytes(), file.indexData(), file.indexBytes(), ..., file.layout());
+
+    1. a fixed size header: the vertex layout (attributes as VertexLayout describes them), counts,
+       bounds, and a table of sections (offset, stored size, decoded size). every section starts
+       on a 64 byte boundary of the file, so the pointers into the mapping are aligned for SIMD
+    2. sections: vertices (interleaved, ready for GL_ARRAY_BUFFER), indices (every LOD level one
+       after the other), the LOD table, and the meshlet tables of meshlet.h
+    3. compressed files store the vertices in VertexLayout::compact, so the quantized attributes go
+       to the GPU without being touched, and the indices as zigzag encoded deltas to the index
+       before, in blocks of 256 that are 1, 2 or 4 bytes wide (a width byte per block leads the
+       section). decoding widens 8 deltas at a time, undoes the zigzag and adds them up with an
+       in register prefix sum on AVX2
+    4. everything is little endian and written by writeMeshFile, a version mismatch, a section
+       outside the file or an index or meshlet past what it refers to throws
+*/
+
+struct MeshFileSection
+{
+    uint64_t offset;
+    uint64_t size;          // bytes in the file
+    uint64_t decodedSize;   // bytes once decoded, the same as size unless compressed
+};
+
+struct MeshFileAttribute
+{
+    uint8_t semantic;
+    uint8_t format;
+    uint16_t offset;
+    uint16_t size;
+    uint16_t padding;
+};
+
+enum MeshFileSectionId
+{
+    MeshFileVertices,
+    MeshFileIndices,
+    MeshFileLods,
+    MeshFileMeshlets,
+    MeshFileMeshletBounds,
+    MeshFileMeshletVertices,
+    MeshFileMeshletTriangles,
+    MeshFileSectionCount
+};
+
+struct MeshFileHeader
+{
+    static const uint32_t magicValue = 0x48534D42;   // "BMSH"
+    static const uint32_t currentVersion = 1;
+    static const uint32_t compressedFlag = 1;
+    static const int maxAttributes = 8;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t vertexCount;
+    uint32_t indexCount;     // level 0
+    uint32_t vertexStride;
+    uint32_t attributeCount;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    float radius;            // of the sphere around the bounds' center
+    MeshFileAttribute attributes[maxAttributes];
+    MeshFileSection sections[MeshFileSectionCount];
+};
+
+struct MeshFileOptions
+{
+    bool compress = false;
+    bool optimize = true;      // optimizeMesh before anything else
+    int lodLevels = 1;         // 1 is the mesh alone
+    bool meshlets = false;     // of level 0
+};
+
+// throws std::runtime_error when the file can't be written
+void writeMeshFile(const std::string &path, MeshData mesh, const MeshFileOptions &options = MeshFileOptions());
+
+class MeshFile
+{
+public:
+    // maps the file and checks the header and section table, throws std::runtime_error
+    explicit MeshFile(const std::string &path);
+
+    const MeshFileHeader& header() const { return *head; }
+    bool compressed() const { return (head->flags & MeshFileHeader::compressedFlag) != 0; }
+    VertexLayout layout() const;
+
+    // straight from the mapping, valid as long as the MeshFile
+    const void* vertexData() const { return section(MeshFileVertices); }
+    size_t vertexBytes() const { return (size_t)head->sections[MeshFileVertices].size; }
+    // nullptr for a compressed file, decodeIndices writes them out then
+    const unsigned int* indexData() const;
+    size_t indexBytes() const { return (size_t)head->sections[MeshFileIndices].decodedSize; }
+    // every level of the index section, indexBytes() / 4 of them. throws std::runtime_error when
+    // the compressed indices decode to one past the vertices
+    void decodeIndices(unsigned int *out, bool allowSimd = true) const;
+    std::vector<unsigned int> indices() const;
+
+    // the level table, a single level covering the indices when the file has no LODs
+    std::vector<LodLevel> lods() const;
+    // empty when the file has none
+    MeshletData meshlets() const;
+
+    // whether decodeIndices can take the AVX2 path on this CPU
+    static bool simdAvailable();
+
+private:
+    const unsigned char* section(MeshFileSectionId id) const { return file.data() + head->sections[id].offset; }
+
+    MappedFile file;
+    const MeshFileHeader *head;
+};
+
+// the file as a MeshData, compact vertices are expanded back to floats (loadMesh calls this for .bmesh)
+MeshData loadMeshFile(const std::string &path);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class ThreadPool;
+
+
+/*
+    mesh import for Wavefront OBJ and binary glTF 2.0 (.glb)
+
+    both formats are memory mapped, nothing is read into an intermediate buffer
+
+    OBJ
+    1. the file is cut into newline aligned chunks, one pass over every chunk counts its v/vt/vn lines
+       so each chunk knows where its attributes land in the shared arrays (and how to resolve
+       negative indices)
+    2. chunks are parsed in parallel, attributes go straight into the shared arrays and faces are
+       kept per chunk as resolved (v, vt, vn) corners
+    3. each chunk welds its corners into vertices and fans polygons into triangles, corners shared
+       across a chunk border end up as two vertices
+    4. the per chunk vertices and indices are copied into the final arrays in parallel
+
+    glTF
+    the JSON chunk is parsed into a small tree, accessors are read in place from the mapped BIN
+    chunk through their buffer view stride, every primitive of the default scene is transformed by
+    its node and appended. only the GLB embedded buffer is supported, no external .bin or data uris
+
+    the result is interleaved the way loadBuffer expects it
+*/
+
+struct MeshData
+{
+    // position xyz, color rgb, texture coords uv, the layout loadBuffer sets up
+    static const int floatsPerVertex = 8;
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;   // triangle list
+    std::vector<float> normals;          // xyz per vertex when the file has normals, otherwise empty
+
+    size_t vertexCount() const { return vertices.size() / floatsPerVertex; }
+    size_t triangleCount() const { return indices.size() / 3; }
+    size_t vertexBytes() const { return vertices.size() * sizeof(float); }
+    size_t indexBytes() const { return indices.size() * sizeof(unsigned int); }
+};
+
+// picks the format by extension (.obj, .glb or .bmesh from mesh_file.h), throws std::runtime_error on
+// anything it can't read
+MeshData loadMesh(const std::string &path, ThreadPool &pool);
+MeshData loadMesh(const std::string &path);
+
+MeshData loadObj(const std::string &path, ThreadPool &pool);
+MeshData loadGlb(const std::string &path, ThreadPool &pool);
+
+#endif
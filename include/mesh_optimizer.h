@@ -0,0 +1,69 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+
+struct MeshData;
+
+
+/*
+    mesh optimization before upload
+
+    1. vertex cache: triangles are reordered so vertices that were just transformed get reused
+       - Forsyth: greedy, scores vertices by their position in a simulated LRU cache and by how many
+         triangles still need them, picks the best scoring triangle next
+       - Tipsify (Sander et al. 2007): fans around a vertex, then moves to the neighbour that is most
+         likely still in a FIFO cache. linear time, and since it targets the same FIFO the statistics
+         simulate it usually comes out ahead of Forsyth there (which tunes for a 32 entry LRU)
+    2. overdraw: the cache optimized order is cut into clusters (where the cache restarts, and
+       smaller where that costs less than threshold in ACMR), clusters facing away from the
+       mesh center are drawn first so they occlude the rest
+    3. vertex fetch: vertices are renumbered in the order the index buffer first touches them, so
+       the vertex buffer is read front to back (unused vertices are dropped)
+
+    the statistics run the index buffer through a software FIFO cache like the post transform
+    cache of most GPUs:
+        ACMR  cache misses per triangle, 3 worst, 0.5 is the limit for a big regular grid
+        ATVR  cache misses per vertex, 1 is every vertex transformed exactly once
+*/
+
+struct VertexCacheStats
+{
+    size_t triangles = 0;
+    size_t vertices = 0;     // vertices the index buffer references
+    size_t misses = 0;
+    double acmr = 0.0;
+    double atvr = 0.0;
+};
+
+struct VertexFetchStats
+{
+    size_t bytesFetched = 0;   // whole cache lines
+    double overfetch = 0.0;    // bytes fetched / bytes of the vertices referenced, 1 is perfect
+};
+
+enum class VertexCacheMethod
+{
+    Forsyth,
+    Tipsify
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount, int cacheSize = 16);
+// 64 byte lines in a 16 KB FIFO, vertexStride is the size of one vertex in the buffer
+VertexFetchStats analyzeVertexFetch(const std::vector<unsigned int> &indices, size_t vertexCount, size_t vertexStride);
+
+void optimizeVertexCacheForsyth(std::vector<unsigned int> &indices, size_t vertexCount);
+void optimizeVertexCacheTipsify(std::vector<unsigned int> &indices, size_t vertexCount, int cacheSize = 16);
+
+// indices should already be cache optimized, returns the number of clusters that were sorted
+size_t optimizeOverdraw(std::vector<unsigned int> &indices, const MeshData &mesh, float threshold = 1.05f,
+                        int cacheSize = 16);
+
+// renumbers mesh vertices (and normals) in first use order, returns the vertex count afterwards
+size_t optimizeVertexFetch(MeshData &mesh);
+
+// all three in order
+void optimizeMesh(MeshData &mesh, VertexCacheMethod method = VertexCacheMethod::Tipsify);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+#include <cstddef>
+
+struct MeshData;
+
+
+/*
+    level of detail: quadric error simplification, a LOD chain per mesh and picking a level per object
+
+        MeshLodChain lods = buildLodChain(mesh);             // at import, all levels share the vertices
+        ... upload mesh.vertices once and lods.indices as the index buffer ...
+        float pixelsPerUnit = lodPixelsPerUnit(fovY, viewportHeight) * objectScale / distance;
+        object.lod = selectLod(lods, pixelsPerUnit, object.lod);
+        glDrawElements(..., lods.levels[object.lod].indexCount, ..., firstIndex * 4);
+
+    1. simplification collapses edges, one vertex moves onto the other (half edge collapse), so a
+       simplified mesh is only a new index buffer over the original vertices
+    2. every position has a quadric (Garland/Heckbert), the sum of the squared distances to the planes
+       of its triangles weighted by area. moving a onto b costs a's quadric evaluated at b, the
+       collapse merges a's quadric into b's
+    3. vertices are classified once: manifold (moves anywhere), border (only along its open edge),
+       seam (two vertices at one position with different attributes, e.g. a UV seam: they move
+       together along the seam so the two sides stay welded) and locked (anything more complex,
+       never moves). borders and seams also get a quadric of the plane through the edge at right
+       angles to the triangle, so their outline is kept
+    4. a pass sorts all candidate collapses by cost and takes the cheapest, skipping any whose
+       neighbourhood already changed in this pass or that would flip a triangle, until the target
+       index count or error is reached. passes repeat until nothing more goes
+    5. a LOD chain simplifies every level from the one before, reduction times its triangles, and
+       stops when the error limit blocks progress. errors add up along the chain, so the error of a
+       level is an upper bound of its distance to the original, in the mesh's units
+    6. at runtime the error of a level times pixelsPerUnit is how far it is off on screen. an object
+       takes the coarsest level under the pixel threshold, but only goes coarser once that level is
+       also under threshold * (1 - hysteresis), so objects near a boundary don't pop back and forth
+*/
+
+// the index buffer of a simplified mesh over the same vertices. targetError is relative to the mesh's
+// size (the longest side of its bounding box), resultError gets the error reached in the same unit
+std::vector<unsigned int> simplifyMesh(const MeshData &mesh, const std::vector<unsigned int> &indices,
+                                       size_t targetIndexCount, float targetError = 1.0f,
+                                       float *resultError = nullptr);
+
+struct LodLevel
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;   // in the mesh's units, 0 for the full mesh
+};
+
+struct MeshLodChain
+{
+    std::vector<unsigned int> indices;   // every level, level 0 first
+    std::vector<LodLevel> levels;
+};
+
+struct LodChainOptions
+{
+    int maxLevels = 6;           // including the full mesh
+    float reduction = 0.5f;      // triangles of a level against the one before
+    float maxError = 0.05f;      // relative to the mesh's size, per level
+    size_t minTriangles = 64;    // no level smaller than this
+};
+
+// level 0 is mesh.indices as it is, the simplified levels are optimized for the vertex cache
+MeshLodChain buildLodChain(const MeshData &mesh, const LodChainOptions &options = LodChainOptions());
+
+struct LodSelectOptions
+{
+    float pixelThreshold = 1.0f;
+    float hysteresis = 0.25f;
+};
+
+// pixels on screen per unit of size at distance 1 of a perspective projection
+float lodPixelsPerUnit(float fovY, int viewportHeight);
+
+// current is the level the object drew last frame, -1 when there is none
+int selectLod(const MeshLodChain &chain, float pixelsPerUnit, int current,
+              const LodSelectOptions &options = LodSelectOptions());
+
+#endif
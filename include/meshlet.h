@@ -0,0 +1,117 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include "frustum_culler.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+
+struct MeshData;
+
+
+/*
+    meshlets: an indexed mesh cut into small clusters that can be culled on their own
+
+        MeshletData clusters = buildMeshlets(mesh);        // at load time, or stored with the mesh
+        MeshletCuller culler(clusters.bounds);
+        culler.cull(projection * view * model, cameraInModelSpace, visible);
+        ... one DrawElementsIndirectCommand per visible meshlet over clusters.indexBuffer() ...
+
+    1. building: the triangles are cut into chunks of 64k (in index buffer order, which after
+       optimizeMesh is already spatially coherent) that are clustered in parallel, so the result
+       doesn't depend on the thread count. inside a chunk a meshlet grows greedily from a seed
+       triangle: the next one is a triangle touching the meshlet that adds the fewest new vertices,
+       ties go to the one closest to the meshlet's center. the last unused triangle of a vertex counts
+       as adding none, so no single triangles are stranded. it closes at 64 vertices / 124 triangles
+       or when nothing touching it fits, and the next meshlet is seeded on its border
+    2. bounds per meshlet:
+        sphere  center of the AABB, radius to the farthest vertex
+        AABB    of the vertex positions
+        cone    axis is the mean of the triangle normals, cutoff the sine of the widest angle between
+                the axis and a normal. the apex is moved back along the axis so that from anywhere
+                inside the cone behind it every triangle is seen from the back. meshlets whose normals
+                spread over more than a half sphere get a cutoff of 2 and never cull
+    3. culling (object space, the planes come from the model-view-projection matrix with
+       extractFrustumPlanes of frustum_culler.h):
+        frustum    sphere against the 6 planes
+        backface   dot(normalize(apex - camera), axis) >= cutoff
+       the CPU path keeps the bounds as structure of arrays and tests 8 meshlets per AVX2/FMA step,
+       the compute shader (src/shaders/meshlet_cull.comp) does the same per invocation and appends
+       draw commands with an atomic counter
+*/
+
+struct Meshlet
+{
+    unsigned int vertexOffset;     // into MeshletData::vertices
+    unsigned int triangleOffset;   // into MeshletData::triangles, counted in triangles
+    unsigned int vertexCount;
+    unsigned int triangleCount;
+};
+
+// laid out like the std430 struct of the culling shader, so the array uploads as it is
+struct MeshletBounds
+{
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneApex;
+    float coneCutoff;     // sin of the cone angle, 2 when the meshlet can't be backface culled
+    glm::vec3 coneAxis;
+    float padding0;
+    glm::vec3 boxMin;
+    float padding1;
+    glm::vec3 boxMax;
+    float padding2;
+};
+
+struct MeshletData
+{
+    static const size_t maxVertices = 64;
+    static const size_t maxTriangles = 124;
+
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;   // one per meshlet
+    std::vector<unsigned int> vertices;  // mesh vertex of every meshlet vertex
+    std::vector<unsigned char> triangles; // 3 meshlet local vertices per triangle
+
+    // the triangles as plain mesh indices in meshlet order, meshlet m is the index range
+    // [triangleOffset * 3, (triangleOffset + triangleCount) * 3)
+    std::vector<unsigned int> indexBuffer() const;
+    size_t triangleCount() const { return triangles.size() / 3; }
+};
+
+// maxVertices and maxTriangles can go lower than the defaults, not higher (local indices are bytes)
+MeshletData buildMeshlets(const MeshData &mesh, size_t maxVertices = MeshletData::maxVertices,
+                          size_t maxTriangles = MeshletData::maxTriangles);
+MeshletBounds computeMeshletBounds(const MeshData &mesh, const MeshletData &data, const Meshlet &meshlet);
+
+struct MeshletCullStats
+{
+    size_t tested = 0;
+    size_t frustumCulled = 0;
+    size_t backfaceCulled = 0;
+};
+
+class MeshletCuller
+{
+public:
+    explicit MeshletCuller(const std::vector<MeshletBounds> &bounds);
+
+    // appends the indices of the meshlets that survive to visible (cleared first), in increasing
+    // order. modelViewProjection and cameraPosition are in the meshlets' object space
+    MeshletCullStats cull(const glm::mat4 &modelViewProjection, const glm::vec3 &cameraPosition,
+                          std::vector<unsigned int> &visible, bool allowSimd = true) const;
+
+    size_t size() const { return count; }
+    // whether cull can take the AVX2/FMA path on this CPU
+    static bool simdAvailable();
+
+private:
+    // structure of arrays, padded to a multiple of 8 with meshlets that always fail the frustum test
+    size_t count;
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> apexX, apexY, apexZ, axisX, axisY, axisZ, cutoff;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+
+/*
+    per-stage frame profiler
+
+    every stage gets a CPU timer and a pair of GL_TIMESTAMP queries. queries go into a small
+    ring of frames and are only read once GL_QUERY_RESULT_AVAILABLE says so, so reading GPU
+    times never waits on the pipeline (a frame whose results are still not there when its slot
+    comes around again is dropped and counted instead)
+
+        profiler.beginFrame();
+        { ProfileScope scope(&profiler, "draw"); ... }
+        profiler.endFrame();
+
+    timestamps are used instead of GL_TIME_ELAPSED because elapsed queries can't nest
+*/
+
+// rolling numbers for one stage, in milliseconds per frame
+struct StageStats
+{
+    std::string name;
+    double cpuAverage, cpuMax;
+    double gpuAverage, gpuMax;   // 0 when GPU timing is off or no result arrived yet
+    int samples;
+};
+
+class FrameProfiler
+{
+public:
+    // historyFrames is the window of the rolling averages
+    explicit FrameProfiler(bool gpuTiming = true, int historyFrames = 120);
+    ~FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // the frame itself is reported as a stage called "frame"
+    void beginFrame();
+    void endFrame();
+
+    // stages nest, name has to outlive the profiler (string literals)
+    void beginStage(const char *name);
+    void endStage();
+
+    // keep every CPU and GPU sample for writeChromeTrace, off by default because it grows with each frame
+    void setTraceCapture(bool enabled) { traceCapture = enabled; }
+    // trace event JSON, open it in Perfetto or chrome://tracing
+    bool writeChromeTrace(const std::string &path);
+
+    std::vector<StageStats> stageStats() const;
+    // the rolling per-stage table
+    void printSummary(std::ostream &out) const;
+
+    long framesProfiled() const { return frameIndex; }
+    long gpuFramesDropped() const { return droppedGpuFrames; }
+
+private:
+    // ring of frames with queries in flight, three covers what drivers normally buffer
+    static const int gpuFrameLatency = 3;
+
+    struct Stage
+    {
+        const char *name;
+        std::vector<double> cpuHistory, gpuHistory;   // ring buffers of per-frame totals
+        int cpuCount = 0, gpuCount = 0;
+        double cpuThisFrame = 0.0;
+    };
+
+    struct OpenStage
+    {
+        int stage;
+        std::chrono::steady_clock::time_point cpuStart;
+        unsigned int beginQuery;
+    };
+
+    struct GpuStageQuery
+    {
+        int stage;
+        unsigned int beginQuery, endQuery;
+    };
+
+    struct GpuFrame
+    {
+        std::vector<unsigned int> queries;   // pool, grows to the number of stages a frame uses
+        size_t used = 0;
+        std::vector<GpuStageQuery> stages;
+        bool pending = false;
+    };
+
+    struct TraceEvent
+    {
+        int stage;
+        bool gpu;
+        double start, duration;   // microseconds since the profiler was created
+    };
+
+    int stageIndex(const char *name);
+    unsigned int nextQuery(GpuFrame &frame);
+    // returns false when the results are not available yet
+    bool collectGpuFrame(GpuFrame &frame, bool force);
+    void pushSample(std::vector<double> &history, int &count, double value);
+    double microsecondsSinceStart(std::chrono::steady_clock::time_point time) const;
+
+    bool gpuTiming;
+    bool traceCapture = false;
+    int historyFrames;
+    long frameIndex = 0;
+    long droppedGpuFrames = 0;
+
+    std::vector<Stage> stages;
+    std::vector<OpenStage> openStages;
+    GpuFrame gpuFrames[gpuFrameLatency];
+    std::vector<TraceEvent> traceEvents;
+
+    // lines GPU timestamps up with the CPU clock for the trace
+    std::chrono::steady_clock::time_point cpuEpoch;
+    int64_t gpuEpoch = 0;
+};
+
+// times everything until the end of the enclosing block, a null profiler makes it a no-op
+class ProfileScope
+{
+public:
+    ProfileScope(FrameProfiler *profiler, const char *name)
+        : profiler(profiler)
+    {
+        if (profiler)
+            profiler->beginStage(name);
+    }
+
+    ~ProfileScope()
+    {
+        if (profiler)
+            profiler->endStage();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler *profiler;
+};
+
+#endif
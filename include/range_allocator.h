@@ -0,0 +1,95 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+/*
+    offset allocator for ranges inside a big GPU buffer (TLSF, two level segregated fit)
+
+    the allocator never touches the buffer, it only hands out offsets in whatever unit the caller
+    counts in (vertices, indices, bytes), so one buffer object can hold thousands of meshes
+
+    1. free ranges are kept in 240 bins: sizes below 8 have a bin each, above that every power of
+       two is split into 8 bins (3 bits of mantissa, like a tiny float). the worst waste of a bin is
+       12.5%
+    2. a bitmask says which groups of 8 bins have anything and a byte per group which of its bins do,
+       finding the first big enough free range is two count-trailing-zeros
+    3. a request is rounded up to the next bin boundary so any range in that bin fits, the rest is
+       split off and goes back into its bin. before that the first few ranges of the bin the request
+       itself falls in are tried, so a freed range can be taken again by a request of the same size
+    4. every range knows its neighbours by address, free merges with free neighbours right away
+
+    allocate and free are O(1), stats() walks the ranges and is meant for reports
+*/
+
+struct RangeAllocation
+{
+    static const uint32_t invalid = 0xFFFFFFFFu;
+
+    uint32_t offset = invalid;
+    uint32_t node = invalid;   // for free(), the allocator's own bookkeeping
+
+    bool valid() const { return node != invalid; }
+};
+
+struct RangeAllocatorStats
+{
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t free = 0;
+    size_t largestFree = 0;
+    size_t allocations = 0;
+    size_t freeRanges = 0;
+    double utilisation = 0.0;    // used / capacity
+    double fragmentation = 0.0;  // 1 - largest free range / free space, 0 is one single hole
+};
+
+class RangeAllocator
+{
+public:
+    explicit RangeAllocator(uint32_t capacity);
+
+    // an invalid allocation when no free range is big enough, size 0 is rounded up to 1
+    RangeAllocation allocate(uint32_t size);
+    void free(RangeAllocation allocation);
+
+    uint32_t sizeOf(RangeAllocation allocation) const;
+    uint32_t capacity() const { return totalSize; }
+    RangeAllocatorStats stats() const;
+
+    // forgets every allocation
+    void reset();
+
+private:
+    static const int binCount = 240;
+    static const uint32_t none = 0xFFFFFFFFu;
+
+    struct Node
+    {
+        uint32_t offset, size;
+        uint32_t binPrev, binNext;                 // free list of the bin, only while free
+        uint32_t neighbourPrev, neighbourNext;     // by address
+        bool used;
+    };
+
+    static int binIndex(uint32_t size, bool roundUp);
+    int firstBinFrom(int bin) const;
+
+    uint32_t newNode();
+    void insertFree(uint32_t node);
+    void removeFree(uint32_t node);
+
+    uint32_t totalSize;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+    uint32_t binHeads[binCount];
+    uint32_t groupMask;            // bit g: group g has a non empty bin
+    uint8_t binMasks[binCount / 8];
+    size_t allocationCount;
+    size_t usedSize;
+};
+
+#endif
@@ -1,29 +1,101 @@
-
 #ifndef SHADER_H
 #define SHADER_H
 
 #include <glad/glad.h> // include glad to get all the required OpenGL headers
-  
+#include <glm/glm.hpp>
+#include "gl_state.h"
+
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <iostream>
-  
+
+
+// handle to an active uniform, resolve it once with Shader::uniform() and keep it
+// around so the render loop never asks the driver to look a name up
+struct UniformHandle
+{
+    int location = -1;
+
+    bool valid() const { return location >= 0; }
+};
+
+// one active uniform found by reflection after linking
+struct UniformInfo
+{
+    std::string name;
+    int location;
+    GLenum type;
+    int size;   // array length, 1 for non-arrays
+};
 
 class Shader
 {
 public:
     // the program ID
     unsigned int ID;
-  
-    // constructor reads and builds the shader
-    Shader(const char* vertexPath, const char* fragmentPath);
-    // use/activate the shader
+
+    // constructor reads and builds the shader, defines are inserted after the #version line
+    // the linked program is cached on disk and reused on the next launch when nothing changed
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string &defines = "");
+    // a compute program from one file, cached and reflected the same way
+    static Shader compute(const char* computePath, const std::string &defines = "");
+    // use/activate the shader, skipped when it is already in use
     void use();
+
+    // find a uniform in the reflected table (no GL call), names it doesn't hold such as "lights[2]"
+    // go to glGetUniformLocation. invalid handle if it is not active
+    UniformHandle uniform(const std::string &name) const;
+    // every active uniform of the linked program
+    const std::vector<UniformInfo>& uniforms() const { return uniformTable; }
+
     // utility uniform functions
-    void setBool(const std::string &name, bool value) const;  
-    void setInt(const std::string &name, int value) const;   
+    void setBool(const std::string &name, bool value) const;
+    void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
+    void setVec3(const std::string &name, const glm::vec3 &value) const;
+    void setVec4(const std::string &name, const glm::vec4 &value) const;
+    void setMat4(const std::string &name, const glm::mat4 &value) const;
+
+    // handle based uniform functions, these are a single glUniform* call
+    void setBool(UniformHandle handle, bool value) const;
+    void setInt(UniformHandle handle, int value) const;
+    void setFloat(UniformHandle handle, float value) const;
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const;
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const;
+    void setMat4(UniformHandle handle, const glm::mat4 &value) const;
+
+    // directory for cached program binaries ("shader_cache" by default), empty turns caching off
+    static std::string binaryCacheDirectory;
+
+private:
+    Shader() : ID(0) {}
+
+    bool compileProgram(const std::string &vertexCode, const std::string &fragmentCode);
+    bool compileComputeProgram(const std::string &computeCode);
+
+    // program binary cache
+    static std::string binaryCachePath(const char* vertexPath, const char* fragmentPath, const std::string &defines);
+    static uint64_t binaryCacheKey(const std::string &vertexCode, const std::string &fragmentCode, const std::string &defines);
+    bool loadProgramBinary(const std::string &path, uint64_t key);
+    void saveProgramBinary(const std::string &path, uint64_t key);
+
+    // enumerate GL_ACTIVE_UNIFORMS once after glLinkProgram
+    void reflectUniforms();
+    void insertUniformName(const std::string &name, int index);
+
+    std::vector<UniformInfo> uniformTable;
+
+    // open addressing hash table over uniformTable, an empty slot has index -1
+    struct UniformSlot
+    {
+        uint32_t hash = 0;
+        int index = -1;
+        std::string key;
+    };
+    std::vector<UniformSlot> uniformSlots;
 };
-  
-#endif
\ No newline at end of file
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef SKELETAL_ANIMATION_H
+#define SKELETAL_ANIMATION_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+
+#include <vector>
+#include <cstddef>
+
+
+/*
+    skeletal animation of many characters that share a skeleton, up to the joint transforms the
+    vertex shader skins with
+
+        Skeleton skeleton;
+        unsigned int hip = skeleton.addJoint(Skeleton::noParent, hipPosition);
+        unsigned int knee = skeleton.addJoint(hip, kneeOffset);
+        ...
+        AnimationClip walk(skeleton.jointCount(), 32, 30.0f);
+        walk.setKey(frame, knee, offset, rotation);          // every joint at every frame
+        ...
+        AnimationSystem crowd(skeleton);
+        size_t guard = crowd.addCharacter();
+        crowd.blend(guard, walk, t, run, t, speed);          // every frame, for every character
+        crowd.update();
+        skin.upload(crowd.dualQuaternions().data(), crowd.dualQuaternions().size());   // SkinBuffer
+
+    1. joints are added parents first, so one pass in joint order has every parent done before its
+       children. the bind pose is given per joint relative to its parent, the skeleton keeps the
+       inverse of where that puts every joint as a dual quaternion
+    2. a clip has a key for every joint at every frame, resampled at a fixed rate, so finding the two
+       keys around a time is one multiply. a frame is stored as structure of arrays (rotation x, y, z,
+       w, position x, y, z, each padded to a multiple of 8 joints) and clips loop, the last frame
+       blends back into the first. there is no scale, dual quaternions only carry rotation and
+       translation
+    3. sampling interpolates the two frames 8 joints at a time with AVX2/FMA: positions linearly,
+       rotations on the shorter arc by nlerp (normalized lerp) or slerp (acos and sin as
+       polynomials, exact to about 1e-7). blending two clips is the same kernel run on the two
+       sampled poses
+    4. the local poses become model space dual quaternions in one pass down the joints (parent *
+       local). on AVX2 a dual quaternion is one register there, the real part in one 128 bit lane
+       and the dual part in the other, so a joint is two lane wise quaternion multiplies. then
+       skin = model * inverse bind, 8 joints a step again. the dual quaternions (32 bytes a joint)
+       or the mat4s made from them (64 bytes) are written per character back to back
+    5. characters are split over the thread pool, each one only touches its own slice
+*/
+
+class Skeleton
+{
+public:
+    static const unsigned int noParent = ~0u;
+
+    // parent has to exist already, the bind position and rotation are relative to it. returns the
+    // joint index, throws std::invalid_argument for a parent that isn't there
+    unsigned int addJoint(unsigned int parent, const glm::vec3 &bindPosition,
+                          const glm::quat &bindRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+
+    size_t jointCount() const { return parents.size(); }
+    unsigned int parent(unsigned int joint) const { return parents[joint]; }
+    // from model space to the joint's bind space
+    const glm::dualquat& inverseBind(unsigned int joint) const { return inverseBinds[joint]; }
+    // joint count rounded up to 8, the stride of the structure of arrays poses
+    size_t paddedJointCount() const { return (parents.size() + 7) / 8 * 8; }
+
+private:
+    friend class AnimationSystem;
+
+    std::vector<unsigned int> parents;
+    std::vector<glm::vec3> bindPositions;
+    std::vector<glm::quat> bindRotations;
+    std::vector<glm::dualquat> bindModels, inverseBinds;
+    // the bind pose in the layout of a clip frame, and inverseBinds as 8 component arrays
+    std::vector<float> bindPose, inverseBindComponents;
+};
+
+class AnimationClip
+{
+public:
+    // every key starts as the identity, the clip lasts frameCount / framesPerSecond and loops
+    AnimationClip(size_t jointCount, size_t frameCount, float framesPerSecond);
+
+    void setKey(size_t frame, size_t joint, const glm::vec3 &position, const glm::quat &rotation);
+    glm::vec3 position(size_t frame, size_t joint) const;
+    glm::quat rotation(size_t frame, size_t joint) const;
+
+    size_t jointCount() const { return joints; }
+    size_t frameCount() const { return frames; }
+    float framesPerSecond() const { return rate; }
+    float duration() const { return frames / rate; }
+    // the 7 padded component arrays of one frame
+    const float* frame(size_t index) const { return &keys[index * 7 * stride]; }
+
+private:
+    size_t joints, frames, stride;
+    float rate;
+    std::vector<float> keys;
+};
+
+enum AnimationInterpolation
+{
+    AnimationNlerp,
+    AnimationSlerp
+};
+
+enum SkinningOutput
+{
+    SkinDualQuaternions,
+    SkinMatrices
+};
+
+struct AnimationUpdateOptions
+{
+    AnimationInterpolation interpolation = AnimationNlerp;
+    SkinningOutput output = SkinDualQuaternions;
+    bool parallel = true;
+    bool allowSimd = true;
+};
+
+class AnimationSystem
+{
+public:
+    // the skeleton has to outlive the system, so do the clips given to play and blend
+    explicit AnimationSystem(const Skeleton &skeleton);
+
+    // a new character stands in the bind pose until it plays something
+    size_t addCharacter();
+    size_t characterCount() const { return characters.size(); }
+    size_t jointCount() const { return skeleton.jointCount(); }
+
+    // time is in seconds and wraps around the clip. a clip for another joint count throws
+    // std::invalid_argument
+    void play(size_t character, const AnimationClip &clip, float time);
+    // weight 0 is all from, 1 all to
+    void blend(size_t character, const AnimationClip &from, float fromTime, const AnimationClip &to, float toTime,
+               float weight);
+
+    // samples, blends and skins every character
+    void update(const AnimationUpdateOptions &options = AnimationUpdateOptions());
+
+    // jointCount() per character back to back, from the last update that asked for that output
+    const std::vector<glm::dualquat>& dualQuaternions() const { return skinDualQuaternions; }
+    const std::vector<glm::mat4>& matrices() const { return skinMatrices; }
+
+    // whether update can take the AVX2/FMA path on this CPU
+    static bool simdAvailable();
+
+private:
+    struct Character
+    {
+        const AnimationClip *clips[2] = {nullptr, nullptr};
+        float times[2] = {0.0f, 0.0f};
+        float weight = 0.0f;
+    };
+
+    void animate(size_t begin, size_t end, const AnimationUpdateOptions &options, bool simd);
+
+    const Skeleton &skeleton;
+    std::vector<Character> characters;
+    std::vector<glm::dualquat> skinDualQuaternions;
+    std::vector<glm::mat4> skinMatrices;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef SKIN_BUFFER_H
+#define SKIN_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+
+#include <string>
+#include <cstddef>
+
+class StreamRing;
+
+
+/*
+    joint transforms for skinning in the vertex shader, a shader storage buffer the shader indexes
+    by the vertex's joints
+
+        unsigned int weights = SkinBuffer::attachWeights(VAO, skinVertices.data(), vertexCount);   // once
+        SkinBuffer skin;
+        Shader shader(vs, fs, SkinBuffer::shaderDefines(false));
+        ...
+        skin.upload(crowd.dualQuaternions().data(), crowd.dualQuaternions().size());   // every frame
+        skin.bind();
+        shader.setInt("jointsPerInstance", crowd.jointCount());
+        instances.draw(VAO, indexCount);                       // a character per instance
+
+    1. every vertex has up to 4 joints as bytes at attribute location 10 and their weights as unorm8
+       at 11, 8 bytes a vertex in a buffer of their own next to the mesh's. joints are per
+       skeleton, so 256 at most
+    2. instance i of a draw reads the joints from i * jointsPerInstance on, so a whole crowd that
+       shares a mesh is one instanced draw with one upload
+    3. dual quaternions (SKINNED) are 32 bytes a joint and blended in the shader by dual quaternion
+       linear blending: weighted sum on the shorter arc of the first joint, normalized, no volume
+       loss at twisted joints. SKIN_MATRICES takes mat4s instead, 64 bytes, plain linear blending
+    4. upload orphans the storage first like InstanceBuffer does, the StreamRing overload writes into
+       the ring and bind points the binding at that range
+*/
+
+struct SkinVertex
+{
+    unsigned char joints[4] = {0, 0, 0, 0};
+    unsigned char weights[4] = {255, 0, 0, 0};   // unorm8, should add up to 255
+};
+
+class SkinBuffer
+{
+public:
+    static const int jointsLocation = 10;
+    static const int weightsLocation = 11;
+    static const int binding = 1;   // shader storage binding, GeometryPool's draw transforms take 0
+
+    unsigned int jointBuffer;
+
+    SkinBuffer();
+    ~SkinBuffer();
+    SkinBuffer(const SkinBuffer&) = delete;
+    SkinBuffer& operator=(const SkinBuffer&) = delete;
+
+    // puts the per vertex joints and weights into a new buffer and points vertexArray's skinning
+    // attributes at it. returns the buffer, the caller deletes it with the mesh
+    static unsigned int attachWeights(unsigned int vertexArray, const SkinVertex *vertices, size_t count);
+
+    void upload(const glm::dualquat *joints, size_t count);
+    void upload(const glm::mat4 *joints, size_t count);
+    // into the current frame of ring, bind and draw before the ring's endFrame
+    void upload(StreamRing &ring, const glm::dualquat *joints, size_t count);
+    void upload(StreamRing &ring, const glm::mat4 *joints, size_t count);
+
+    // the last upload to the binding, before the draws that skin with it
+    void bind() const;
+
+    size_t bytes() const { return uploadBytes; }
+
+    // "#define SKINNED" (and SKIN_MATRICES) for the Shader constructor, goes with INSTANCED too
+    static std::string shaderDefines(bool matrices);
+
+private:
+    void uploadBytesToBuffer(const void *data, size_t size);
+    void uploadBytesToRing(StreamRing &ring, const void *data, size_t size);
+
+    size_t uploadBytes = 0;
+    size_t capacity = 0;   // bytes jointBuffer was last allocated with
+    size_t storageAlignment = 256;
+
+    // where the last upload went, our own buffer at 0 or a region of a ring
+    unsigned int source = 0;
+    size_t offset = 0;
+};
+
+#endif
@@ -270,6 +270,13 @@ RECENT REVISION HISTORY:
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// On x86 the JPEG decoder also has AVX2 versions of the IDCT, the color
+// conversion and the 2x2 chroma upsampling, and the PNG decoder has SSE2/AVX2
+// row unfilters. The AVX2 ones are compiled with function level target
+// attributes, so no -mavx2 is needed, and picked once through cpuid when the
+// CPU and OS support AVX2. Define STBI_NO_AVX2 to leave them out. All paths
+// decode to the same pixels, stbi_set_simd_limit() forces a slower one.
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
@@ -524,6 +531,26 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// opt-in multithreaded JPEG decoding. stb_image has no threads of its own, so you hand it a
+// "parallel for": it must call task(task_context, begin, end) over disjoint ranges that cover
+// [0, count) exactly once and return when all of them are done. huffman decoding stays serial,
+// the IDCT and the upsampling/color conversion are split over block rows and pixel rows.
+// the output is bit-identical to the serial decoder. pass NULL to go back to serial decoding
+typedef void stbi_parallel_task(void *task_context, int begin, int end);
+typedef void stbi_parallel_for(void *user, stbi_parallel_task *task, void *task_context, int count);
+STBIDEF void stbi_set_jpeg_parallel_for(stbi_parallel_for *parallel_for, void *user);
+
+// SIMD kernel paths for JPEG decoding and PNG unfiltering, the best one the CPU supports is used.
+// the limit is there for benchmarks and tests, stbi_simd_path() reports the path the next decode takes
+enum
+{
+   STBI_SIMD_NONE  = 0,
+   STBI_SIMD_BASIC = 1, // SSE2 or NEON
+   STBI_SIMD_AVX2  = 2
+};
+STBIDEF int  stbi_simd_path(void);
+STBIDEF void stbi_set_simd_limit(int path);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -534,6 +561,11 @@ STBIDEF int   stbi_zlib_decode_buffer(char *obuffer, int olen, const char *ibuff
 STBIDEF char *stbi_zlib_decode_noheader_malloc(const char *buffer, int len, int *outlen);
 STBIDEF int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const char *ibuffer, int ilen);
 
+// the inflate loop refills a 64-bit bit buffer a word at a time, looks up two literals at once
+// and copies matches 8 bytes at a time while it is far from both buffer ends. on by default,
+// pass 0 to decode everything with the careful byte-at-a-time loop (for benchmarks)
+STBIDEF void  stbi_set_zlib_fast_path(int flag_true_if_fast);
+
 
 #ifdef __cplusplus
 }
@@ -651,6 +683,12 @@ typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
 #endif
 
+#ifdef _MSC_VER
+typedef unsigned __int64 stbi__uint64;
+#else
+typedef uint64_t stbi__uint64;
+#endif
+
 // should produce compiler error if size is wrong
 typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 
@@ -750,7 +788,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -761,7 +799,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -774,6 +812,37 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 on top of SSE2, only the JPEG and PNG kernels use it and they are selected at run time
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && \
+    ((defined(_MSC_VER) && _MSC_VER >= 1800) || defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define STBI__AVX2_TARGET
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info,0);
+   if (info[0] < 7) return 0;
+   // the OS has to save the ymm registers too (OSXSAVE + AVX, then XCR0 bits 1 and 2)
+   __cpuid(info,1);
+   if ((info[2] & 0x18000000) != 0x18000000) return 0;
+   if ((_xgetbv(0) & 6) != 6) return 0;
+   __cpuidex(info,7,0);
+   return ((info[1] >> 5) & 1) != 0;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+static int stbi__avx2_available(void)
+{
+   // checks the OS support as well
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -1134,6 +1203,60 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                          : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+static stbi_parallel_for *stbi__jpeg_parallel_for = NULL;
+static void *stbi__jpeg_parallel_user = NULL;
+
+STBIDEF void stbi_set_jpeg_parallel_for(stbi_parallel_for *parallel_for, void *user)
+{
+   stbi__jpeg_parallel_for = parallel_for;
+   stbi__jpeg_parallel_user = user;
+}
+
+static int stbi__simd_limit = STBI_SIMD_AVX2;
+
+STBIDEF void stbi_set_simd_limit(int path)
+{
+   stbi__simd_limit = path;
+}
+
+// the kernel path this CPU supports, a cpuid or two
+static int stbi__simd_detect(void)
+{
+   int path = STBI_SIMD_NONE;
+#if defined(STBI_SSE2) && (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG))
+   if (stbi__sse2_available())
+      path = STBI_SIMD_BASIC;
+#endif
+#ifdef STBI_NEON
+   path = STBI_SIMD_BASIC;
+#endif
+#ifdef STBI_AVX2
+   if (path == STBI_SIMD_BASIC && stbi__avx2_available())
+      path = STBI_SIMD_AVX2;
+#endif
+   return path;
+}
+
+// the parallel JPEG decode asks from pool threads, so there is no shared lazily written cache:
+// each thread keeps its own where the compiler has thread locals, otherwise it is detected again
+static int stbi__simd_best(void)
+{
+#ifdef STBI_THREAD_LOCAL
+   static STBI_THREAD_LOCAL int best = -1;
+   if (best < 0)
+      best = stbi__simd_detect();
+   return best;
+#else
+   return stbi__simd_detect();
+#endif
+}
+
+STBIDEF int stbi_simd_path(void)
+{
+   int best = stbi__simd_best();
+   return best < stbi__simd_limit ? best : stbi__simd_limit;
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1972,10 +2095,12 @@ typedef struct
       stbi_uc *data;
       void *raw_data, *raw_coeff;
       stbi_uc *linebuf;
-      short   *coeff;   // progressive only
+      short   *coeff;   // progressive, or baseline with deferred_idct
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
    } img_comp[4];
 
+   int            deferred_idct; // baseline: keep dequantized coefficients, IDCT them in parallel at the end
+
    stbi__uint32   code_buffer; // jpeg entropy-coded buffer
    int            code_bits;   // number of valid bits
    unsigned char  marker;      // marker seen while filling entropy buffer
@@ -2704,6 +2829,171 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// the sse2 IDCT with the 32-bit half of each pass done 8 columns at a time,
+// so it is bit-identical to the generic C version as well
+STBI__AVX2_TARGET
+static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), \
+                                               _mm_unpackhi_epi16((x),(y)), 1); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+         out0 = _mm256_castsi256_si128(packed); \
+         out1 = _mm256_extracti128_si256(packed, 1); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         __m256i x0 = _mm256_add_epi32(t0e, t3e); \
+         __m256i x3 = _mm256_sub_epi32(t0e, t3e); \
+         __m256i x1 = _mm256_add_epi32(t1e, t2e); \
+         __m256i x2 = _mm256_sub_epi32(t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         __m256i x4 = _mm256_add_epi32(y0o, y4o); \
+         __m256i x5 = _mm256_add_epi32(y1o, y5o); \
+         __m256i x6 = _mm256_add_epi32(y2o, y5o); \
+         __m256i x7 = _mm256_add_epi32(y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose pass 1
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      // transpose pass 2
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      // transpose pass 3
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose pass 1
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      // transpose pass 2
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      // transpose pass 3
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2960,24 +3250,31 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
          // component has, independent of interleaved MCU blocking and such
          int w = (z->img_comp[n].x+7) >> 3;
          int h = (z->img_comp[n].y+7) >> 3;
+         int ended = 0;
          for (j=0; j < h; ++j) {
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
-               if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               short *block = z->deferred_idct ? z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w) : data;
+               if (ended)
+                  memset(block, 0, 64*sizeof(block[0]));
+               else if (!stbi__jpeg_decode_block(z, block, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+               if (!z->deferred_idct)
+                  z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
-               if (--z->todo <= 0) {
+               if (!ended && --z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
                   // if it's NOT a restart, then just bail, so we get corrupt data
-                  // rather than no data
-                  if (!STBI__RESTART(z->marker)) return 1;
-                  stbi__jpeg_reset(z);
+                  // rather than no data. the blocks left are flat, in serial and deferred
+                  // mode alike, instead of whatever the buffers held
+                  if (!STBI__RESTART(z->marker)) ended = 1;
+                  else stbi__jpeg_reset(z);
                }
             }
          }
          return 1;
       } else { // interleaved
          int i,j,k,x,y;
+         int ended = 0;
          STBI_SIMD_ALIGN(short, data[64]);
          for (j=0; j < z->img_mcu_y; ++j) {
             for (i=0; i < z->img_mcu_x; ++i) {
@@ -2991,17 +3288,21 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int x2 = (i*z->img_comp[n].h + x)*8;
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
-                        if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        short *block = z->deferred_idct ? z->img_comp[n].coeff + 64 * (x2/8 + (y2/8) * z->img_comp[n].coeff_w) : data;
+                        if (ended)
+                           memset(block, 0, 64*sizeof(block[0]));
+                        else if (!stbi__jpeg_decode_block(z, block, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                        if (!z->deferred_idct)
+                           z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
                      }
                   }
                }
                // after all interleaved components, that's an interleaved MCU,
                // so now count down the restart interval
-               if (--z->todo <= 0) {
+               if (!ended && --z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                  if (!STBI__RESTART(z->marker)) return 1;
-                  stbi__jpeg_reset(z);
+                  if (!STBI__RESTART(z->marker)) ended = 1;
+                  else stbi__jpeg_reset(z);
                }
             }
          }
@@ -3077,25 +3378,41 @@ static void stbi__jpeg_dequantize(short *data, stbi__uint16 *dequant)
       data[i] *= dequant[i];
 }
 
-static void stbi__jpeg_finish(stbi__jpeg *z)
-{
-   if (z->progressive) {
-      // dequantize and idct the data
-      int i,j,n;
-      for (n=0; n < z->s->img_n; ++n) {
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+// dequantize (progressive only, baseline blocks are stored dequantized) and idct block rows
+// [begin,end), rows of all components are numbered one after the other
+static void stbi__jpeg_finish_rows(void *context, int begin, int end)
+{
+   stbi__jpeg *z = (stbi__jpeg *) context;
+   int i,j,n,row = 0;
+   for (n=0; n < z->s->img_n; ++n) {
+      int w = (z->img_comp[n].x+7) >> 3;
+      int h = (z->img_comp[n].y+7) >> 3;
+      for (j=0; j < h; ++j, ++row) {
+         if (row < begin || row >= end) continue;
+         for (i=0; i < w; ++i) {
+            short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+            if (z->progressive)
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-            }
+            z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
          }
       }
    }
 }
 
+static void stbi__jpeg_finish(stbi__jpeg *z)
+{
+   if (z->progressive || z->deferred_idct) {
+      // dequantize and idct the data
+      int n, rows = 0;
+      for (n=0; n < z->s->img_n; ++n)
+         rows += (z->img_comp[n].y+7) >> 3;
+      if (stbi__jpeg_parallel_for)
+         stbi__jpeg_parallel_for(stbi__jpeg_parallel_user, stbi__jpeg_finish_rows, z, rows);
+      else
+         stbi__jpeg_finish_rows(z, 0, rows);
+   }
+}
+
 static int stbi__process_marker(stbi__jpeg *z, int m)
 {
    int L;
@@ -3339,7 +3656,7 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
-      if (z->progressive) {
+      if (z->progressive || z->deferred_idct) {
          // w2, h2 are multiples of 8 (see above)
          z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
          z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
@@ -3437,11 +3754,17 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
          if (NL != j->s->img_y) return stbi__err("bad DNL height", "Corrupt JPEG");
          m = stbi__get_marker(j);
       } else {
-         if (!stbi__process_marker(j, m)) return 1;
+         if (!stbi__process_marker(j, m)) {
+            // damaged or truncated file: keep what was decoded, like the serial path which has
+            // already run the idct of every baseline block by now
+            if (j->deferred_idct && !j->progressive)
+               stbi__jpeg_finish(j);
+            return 1;
+         }
          m = stbi__get_marker(j);
       }
    }
-   if (j->progressive)
+   if (j->progressive || j->deferred_idct)
       stbi__jpeg_finish(j);
    return 1;
 }
@@ -3643,6 +3966,75 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+// same filter as stbi__resample_row_hv_2_simd, 16 pixels at a time
+STBI__AVX2_TARGET
+static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass, 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i diff  = _mm256_sub_epi16(farw, nearw);
+      __m256i nears = _mm256_slli_epi16(nearw, 2);
+      __m256i curr  = _mm256_add_epi16(nears, diff); // current row
+
+      // "prev"/"next" are the current row shifted by one pixel across the two lanes, with the
+      // pixel before this block (t1) and the first one of the next block shifted in
+      __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+      __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+      __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+      __m256i next = _mm256_insert_epi16(nxt0, 3*in_near[i+16] + in_far[i+16], 15);
+
+      // horizontal filter, polyphase implementation since it's convenient:
+      // even pixels = 3*cur + prev = cur*4 + (prev - cur)
+      // odd  pixels = 3*cur + next = cur*4 + (next - cur)
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curs = _mm256_slli_epi16(curr, 2);
+      __m256i prvd = _mm256_sub_epi16(prev, curr);
+      __m256i nxtd = _mm256_sub_epi16(next, curr);
+      __m256i curb = _mm256_add_epi16(curs, bias);
+      __m256i even = _mm256_add_epi16(prvd, curb);
+      __m256i odd  = _mm256_add_epi16(nxtd, curb);
+
+      // interleave even and odd pixels, then undo scaling. the lanes hold pixels 0-7 and 8-15,
+      // so the per-lane pack already comes out in memory order
+      __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+      __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+      __m256i de0  = _mm256_srli_epi16(int0, 4);
+      __m256i de1  = _mm256_srli_epi16(int1, 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(de0, de1));
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3817,25 +4209,109 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// the sse2 color transform on 16 pixels at a time, also covers step == 3 since
+// that is what 3-channel loads use. the leftover pixels go through the sse2 version
+STBI__AVX2_TARGET
+static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 3 || step == 4) {
+      __m128i signflip  = _mm_set1_epi8(-0x80);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+      // drops every 4th byte, rgbx rgbx... -> rgb rgb...
+      __m256i drop_x = _mm256_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1,
+                                        0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+
+      // the step 3 stores write 4 bytes past the 16 pixels, keep a pixel pair of slack
+      for (; step == 4 ? i+15 < count : i+17 < count; i += 16) {
+         // load
+         __m128i y_bytes = _mm_loadu_si128((__m128i *) (y+i));
+         __m128i cr_biased = _mm_xor_si128(_mm_loadu_si128((__m128i *) (pcr+i)), signflip); // -128
+         __m128i cb_biased = _mm_xor_si128(_mm_loadu_si128((__m128i *) (pcb+i)), signflip); // -128
+
+         // unpack to short (and left-shift cr, cb by 8)
+         __m256i yw  = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+         __m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cr_biased), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cb_biased), 8);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte, set up for transpose
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+
+         // transpose to interleave channels, o0 holds pixels 0-3 | 8-11, o1 pixels 4-7 | 12-15
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+         // store
+         if (step == 4) {
+            _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+         } else {
+            __m256i p0 = _mm256_shuffle_epi8(o0, drop_x);
+            __m256i p1 = _mm256_shuffle_epi8(o1, drop_x);
+            _mm_storeu_si128((__m128i *) (out + 0), _mm256_castsi256_si128(p0));
+            _mm_storeu_si128((__m128i *) (out + 12), _mm256_castsi256_si128(p1));
+            _mm_storeu_si128((__m128i *) (out + 24), _mm256_extracti128_si256(p0, 1));
+            _mm_storeu_si128((__m128i *) (out + 36), _mm256_extracti128_si256(p1, 1));
+            out += 48;
+         }
+      }
+   }
+
+   stbi__YCbCr_to_RGB_simd(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
+   int path = stbi_simd_path();
+   STBI_NOTUSED(path);
+
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
-#ifdef STBI_SSE2
-   if (stbi__sse2_available()) {
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+   if (path >= STBI_SIMD_BASIC) {
       j->idct_block_kernel = stbi__idct_simd;
       j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
       j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
    }
 #endif
 
-#ifdef STBI_NEON
-   j->idct_block_kernel = stbi__idct_simd;
-   j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
-   j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+#ifdef STBI_AVX2
+   if (path >= STBI_SIMD_AVX2) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
 #endif
 }
 
@@ -3862,6 +4338,162 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc *output;
+   int n, decode_n, is_rgb;
+   int failed;
+} stbi__jpeg_convert;
+
+// resample and color-convert output rows [begin,end). each call has its own line buffers and
+// replays the vertical resample state up to begin, so the rows can be converted in any order
+static void stbi__jpeg_convert_rows(void *context, int begin, int end)
+{
+   stbi__jpeg_convert *c = (stbi__jpeg_convert *) context;
+   stbi__jpeg *z = c->z;
+   int n = c->n, decode_n = c->decode_n, is_rgb = c->is_rgb;
+   int k;
+   unsigned int i,j;
+   stbi_uc *linebuf, *lastrow;
+   stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
+   stbi__resample res_comp[4];
+
+   // allocate line buffer big enough for upsampling off the edges
+   // with upsample factor of 4. the converters below write one byte past the row when n == 3,
+   // so the last row of the range goes through lastrow instead of stomping on the next range
+   linebuf = (stbi_uc *) stbi__malloc_mad2(decode_n, z->s->img_x + 3, n * z->s->img_x + 1);
+   if (!linebuf) { c->failed = 1; return; }
+   lastrow = linebuf + decode_n * (z->s->img_x + 3);
+
+   for (k=0; k < decode_n; ++k) {
+      stbi__resample *r = &res_comp[k];
+
+      r->hs      = z->img_h_max / z->img_comp[k].h;
+      r->vs      = z->img_v_max / z->img_comp[k].v;
+      r->ystep   = r->vs >> 1;
+      r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
+      r->ypos    = 0;
+      r->line0   = r->line1 = z->img_comp[k].data;
+
+      if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
+      else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
+      else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+      else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
+      else                               r->resample = stbi__resample_row_generic;
+
+      // skip to the first row of this range
+      for (j=0; j < (unsigned int) begin; ++j) {
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+   }
+
+   for (j=begin; j < (unsigned int) end; ++j) {
+      stbi_uc *out = c->output + n * z->s->img_x * j;
+      if (j == (unsigned int) end-1 && j+1 < z->s->img_y)
+         out = lastrow;
+      for (k=0; k < decode_n; ++k) {
+         stbi__resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(linebuf + k * (z->s->img_x + 3),
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+      if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (is_rgb) {
+               for (i=0; i < z->s->img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else if (z->s->img_n == 4) {
+            if (z->app14_color_transform == 0) { // CMYK
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                  out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                  out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                  out[3] = 255;
+                  out += n;
+               }
+            } else if (z->app14_color_transform == 2) { // YCCK
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(255 - out[0], m);
+                  out[1] = stbi__blinn_8x8(255 - out[1], m);
+                  out[2] = stbi__blinn_8x8(255 - out[2], m);
+                  out += n;
+               }
+            } else { // YCbCr + alpha?  Ignore the fourth channel for now
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               out[3] = 255; // not used if n==3
+               out += n;
+            }
+      } else {
+         if (is_rgb) {
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i)
+                  *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+            else {
+               for (i=0; i < z->s->img_x; ++i, out += 2) {
+                  out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                  out[1] = 255;
+               }
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+               stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+               stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+               out[0] = stbi__compute_y(r, g, b);
+               out[1] = 255;
+               out += n;
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+               out[1] = 255;
+               out += n;
+            }
+         } else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+               for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+         }
+      }
+   }
+   if ((unsigned int) end < z->s->img_y)
+      memcpy(c->output + n * z->s->img_x * (end-1), lastrow, n * z->s->img_x);
+   STBI_FREE(linebuf);
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n, is_rgb;
@@ -3870,6 +4502,9 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // validate req_comp
    if (req_comp < 0 || req_comp > 4) return stbi__errpuc("bad req_comp", "Internal error");
 
+   // defer the idct so it can run in parallel once all blocks are decoded
+   z->deferred_idct = stbi__jpeg_parallel_for != NULL;
+
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
@@ -3889,139 +4524,27 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
    // resample and color-convert
    {
-      int k;
-      unsigned int i,j;
-      stbi_uc *output;
-      stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
-
-      stbi__resample res_comp[4];
-
-      for (k=0; k < decode_n; ++k) {
-         stbi__resample *r = &res_comp[k];
-
-         // allocate line buffer big enough for upsampling off the edges
-         // with upsample factor of 4
-         z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
-         if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
-         r->ystep   = r->vs >> 1;
-         r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
-         r->ypos    = 0;
-         r->line0   = r->line1 = z->img_comp[k].data;
-
-         if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
-         else                               r->resample = stbi__resample_row_generic;
-      }
+      stbi__jpeg_convert convert;
+
+      convert.output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+      if (!convert.output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+      convert.z        = z;
+      convert.n        = n;
+      convert.decode_n = decode_n;
+      convert.is_rgb   = is_rgb;
+      convert.failed   = 0;
+
+      if (stbi__jpeg_parallel_for)
+         stbi__jpeg_parallel_for(stbi__jpeg_parallel_user, stbi__jpeg_convert_rows, &convert, z->s->img_y);
+      else
+         stbi__jpeg_convert_rows(&convert, 0, z->s->img_y);
 
-      // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
-            }
-         }
-      }
       stbi__cleanup_jpeg(z);
+      if (convert.failed) { STBI_FREE(convert.output); return stbi__errpuc("outofmem", "Out of memory"); }
       *out_x = z->s->img_x;
       *out_y = z->s->img_y;
       if (comp) *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
-      return output;
+      return convert.output;
    }
 }
 
@@ -4092,6 +4615,14 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
+// literal/length table of the fast inflate loop, one lookup gives up to two literals:
+//    bits  0-8   first symbol
+//    bits  9-16  second symbol, always a literal
+//    bits 17-21  bits used by both codes
+//    bits 22-23  symbols in the entry, 0 when the code is longer than STBI__ZFAST2_BITS
+#define STBI__ZFAST2_BITS  11
+#define STBI__ZFAST2_MASK  ((1 << STBI__ZFAST2_BITS) - 1)
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -4121,14 +4652,17 @@ stbi_inline static int stbi__bit_reverse(int v, int bits)
    return stbi__bitreverse16(v) >> (16-bits);
 }
 
-static int stbi__zbuild_huffman(stbi__zhuffman *z, const stbi_uc *sizelist, int num)
+// fast2 is the optional two-literal table of the fast inflate loop, see STBI__ZFAST2_BITS
+static int stbi__zbuild_huffman(stbi__zhuffman *z, const stbi_uc *sizelist, int num, stbi__uint32 *fast2)
 {
    int i,k=0;
    int code, next_code[16], sizes[17];
+   stbi__uint16 single[1 << STBI__ZFAST2_BITS];
 
    // DEFLATE spec for generating codes
    memset(sizes, 0, sizeof(sizes));
    memset(z->fast, 0, sizeof(z->fast));
+   if (fast2) memset(single, 0, sizeof(single));
    for (i=0; i < num; ++i)
       ++sizes[sizelist[i]];
    sizes[0] = 0;
@@ -4162,9 +4696,29 @@ static int stbi__zbuild_huffman(stbi__zhuffman *z, const stbi_uc *sizelist, int
                j += (1 << s);
             }
          }
+         if (fast2 && s <= STBI__ZFAST2_BITS) {
+            int j = stbi__bit_reverse(next_code[s],s);
+            while (j < (1 << STBI__ZFAST2_BITS)) {
+               single[j] = fastv;
+               j += (1 << s);
+            }
+         }
          ++next_code[s];
       }
    }
+   if (fast2) {
+      // pair up a literal with the literal after it when both codes fit in the table bits
+      for (i=0; i < (1 << STBI__ZFAST2_BITS); ++i) {
+         int v1 = single[i], s1 = v1 >> 9, v2, s2;
+         if (!v1) { fast2[i] = 0; continue; }
+         fast2[i] = (stbi__uint32) ((v1 & 511) | (s1 << 17) | (1 << 22));
+         if ((v1 & 511) >= 256 || s1 >= STBI__ZFAST2_BITS) continue;
+         v2 = single[i >> s1];
+         s2 = v2 >> 9;
+         if (v2 && (v2 & 511) < 256 && s1 + s2 <= STBI__ZFAST2_BITS)
+            fast2[i] = (stbi__uint32) ((v1 & 511) | ((v2 & 255) << 9) | ((s1 + s2) << 17) | (2 << 22));
+      }
+   }
    return 1;
 }
 
@@ -4179,7 +4733,7 @@ typedef struct
    stbi_uc *zbuffer, *zbuffer_end;
    int num_bits;
    int hit_zeof_once;
-   stbi__uint32 code_buffer;
+   stbi__uint64 code_buffer; // only the low num_bits are ever set
 
    char *zout;
    char *zout_start;
@@ -4187,8 +4741,17 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+   int fast_path;
+   stbi__uint32 z_fast2[1 << STBI__ZFAST2_BITS];
 } stbi__zbuf;
 
+static int stbi__zlib_fast_path = 1;
+
+STBIDEF void stbi_set_zlib_fast_path(int flag_true_if_fast)
+{
+   stbi__zlib_fast_path = flag_true_if_fast;
+}
+
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
 {
    return (z->zbuffer >= z->zbuffer_end);
@@ -4202,13 +4765,28 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
 static void stbi__fill_bits(stbi__zbuf *z)
 {
    do {
-      if (z->code_buffer >= (1U << z->num_bits)) {
+      if (z->code_buffer >= ((stbi__uint64) 1 << z->num_bits)) {
         z->zbuffer = z->zbuffer_end;  /* treat this as EOF so we fail. */
         return;
       }
-      z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
+      z->code_buffer |= (stbi__uint64) stbi__zget8(z) << z->num_bits;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 48);
+}
+
+// tops the bit buffer up to 56-63 bits with one 8 byte read, the caller makes sure
+// there are 8 bytes left. written with shifts so it is endian-neutral, compilers turn it into one load
+stbi_inline static void stbi__fill_bits_fast(stbi__zbuf *z)
+{
+   stbi_uc *p = z->zbuffer;
+   int n = (63 - z->num_bits) >> 3; // whole bytes that fit
+   stbi__uint64 bytes = (stbi__uint64) p[0]       | ((stbi__uint64) p[1] << 8)  |
+                       ((stbi__uint64) p[2] << 16) | ((stbi__uint64) p[3] << 24) |
+                       ((stbi__uint64) p[4] << 32) | ((stbi__uint64) p[5] << 40) |
+                       ((stbi__uint64) p[6] << 48) | ((stbi__uint64) p[7] << 56);
+   z->code_buffer |= (bytes & (((stbi__uint64) 1 << (n*8)) - 1)) << z->num_bits;
+   z->zbuffer += n;
+   z->num_bits += n*8;
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
@@ -4226,7 +4804,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
    int b,s,k;
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = stbi__bit_reverse(a->code_buffer, 16);
+   k = stbi__bit_reverse((int) (a->code_buffer & 0xffff), 16);
    for (s=STBI__ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
@@ -4306,11 +4884,85 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// one symbol (or two literals) of the fast inflate loop. the caller checked that 8 input bytes
+// and more than 258+8 output bytes are left, so nothing here needs to look at the buffer ends.
+// returns 1 to keep going, 2 at the end of the block, 0 on error
+stbi_inline static int stbi__parse_huffman_fast(stbi__zbuf *a, char **pzout)
+{
+   char *zout = *pzout;
+   stbi_uc *p;
+   stbi__uint32 e;
+   int z,len,dist;
+
+   // 56+ bits covers a length code, its extra bits, a distance code and its extra bits
+   stbi__fill_bits_fast(a);
+   e = a->z_fast2[a->code_buffer & STBI__ZFAST2_MASK];
+   if ((e >> 22) == 2) {
+      zout[0] = (char) (e & 255);
+      zout[1] = (char) ((e >> 9) & 255);
+      *pzout = zout + 2;
+      a->code_buffer >>= (e >> 17) & 31;
+      a->num_bits -= (e >> 17) & 31;
+      return 1;
+   }
+   if (e) {
+      z = e & 511;
+      a->code_buffer >>= (e >> 17) & 31;
+      a->num_bits -= (e >> 17) & 31;
+   } else {
+      z = stbi__zhuffman_decode_slowpath(a, &a->z_length);
+   }
+
+   if (z < 256) {
+      if (z < 0) return stbi__err("bad huffman code","Corrupt PNG");
+      *zout++ = (char) z;
+      *pzout = zout;
+      return 1;
+   }
+   if (z == 256) return 2;
+   if (z >= 286) return stbi__err("bad huffman code","Corrupt PNG");
+   z -= 257;
+   len = stbi__zlength_base[z];
+   if (stbi__zlength_extra[z]) len += stbi__zreceive(a, stbi__zlength_extra[z]);
+   z = stbi__zhuffman_decode(a, &a->z_distance);
+   if (z < 0 || z >= 30) return stbi__err("bad huffman code","Corrupt PNG");
+   dist = stbi__zdist_base[z];
+   if (stbi__zdist_extra[z]) dist += stbi__zreceive(a, stbi__zdist_extra[z]);
+   if (zout - a->zout_start < dist) return stbi__err("bad dist","Corrupt PNG");
+
+   p = (stbi_uc *) (zout - dist);
+   if (dist >= 8) {
+      // whole words, may write up to 7 bytes past the match which the margin allows for.
+      // source and destination never overlap within one word since they are 8+ apart
+      char *end = zout + len;
+      do {
+         memcpy(zout, p, 8);
+         zout += 8;
+         p += 8;
+      } while (zout < end);
+      zout = end;
+   } else if (dist == 1) { // run of one byte; common in images.
+      memset(zout, *p, len);
+      zout += len;
+   } else {
+      do *zout++ = *p++; while (--len);
+   }
+   *pzout = zout;
+   return 1;
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+      if (a->fast_path && a->zbuffer_end - a->zbuffer >= 8 && a->zout_end - zout > 258 + 8) {
+         int r = stbi__parse_huffman_fast(a, &zout);
+         if (r == 1) continue;
+         a->zout = zout;
+         return r == 2;
+      }
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4374,7 +5026,7 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
       int s = stbi__zreceive(a,3);
       codelength_sizes[length_dezigzag[i]] = (stbi_uc) s;
    }
-   if (!stbi__zbuild_huffman(&z_codelength, codelength_sizes, 19)) return 0;
+   if (!stbi__zbuild_huffman(&z_codelength, codelength_sizes, 19, NULL)) return 0;
 
    n = 0;
    while (n < ntot) {
@@ -4401,8 +5053,8 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
       }
    }
    if (n != ntot) return stbi__err("bad codelengths","Corrupt PNG");
-   if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
-   if (!stbi__zbuild_huffman(&a->z_distance, lencodes+hlit, hdist)) return 0;
+   if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit, a->fast_path ? a->z_fast2 : NULL)) return 0;
+   if (!stbi__zbuild_huffman(&a->z_distance, lencodes+hlit, hdist, NULL)) return 0;
    return 1;
 }
 
@@ -4414,12 +5066,19 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
       stbi__zreceive(a, a->num_bits & 7); // discard
    // drain the bit-packed data into header
    k = 0;
-   while (a->num_bits > 0) {
+   while (a->num_bits > 0 && k < 4) {
       header[k++] = (stbi_uc) (a->code_buffer & 255); // suppress MSVC run-time check
       a->code_buffer >>= 8;
       a->num_bits -= 8;
    }
    if (a->num_bits < 0) return stbi__err("zlib corrupt","Corrupt PNG");
+   // the 64-bit buffer can hold bytes past the header, hand them back to the input
+   if (a->num_bits > 0) {
+      if (a->hit_zeof_once) return stbi__err("zlib corrupt","Corrupt PNG");
+      a->zbuffer -= a->num_bits >> 3;
+      a->code_buffer = 0;
+      a->num_bits = 0;
+   }
    // now fill header the normal way
    while (k < 4)
       header[k++] = stbi__zget8(a);
@@ -4496,8 +5155,8 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
       } else {
          if (type == 1) {
             // use fixed code lengths
-            if (!stbi__zbuild_huffman(&a->z_length  , stbi__zdefault_length  , STBI__ZNSYMS)) return 0;
-            if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance,  32)) return 0;
+            if (!stbi__zbuild_huffman(&a->z_length  , stbi__zdefault_length  , STBI__ZNSYMS, a->fast_path ? a->z_fast2 : NULL)) return 0;
+            if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance,  32, NULL)) return 0;
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
@@ -4509,6 +5168,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
 
 static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse_header)
 {
+   a->fast_path  = stbi__zlib_fast_path;
    a->zout_start = obuf;
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
@@ -4667,6 +5327,143 @@ static int stbi__paeth(int a, int b, int c)
    return t1;
 }
 
+#ifdef STBI_SSE2
+// SIMD row unfilters. Up is plain vector adds; Sub, Avg and Paeth depend on the pixel to the
+// left, so those only exist for 3 and 4 byte pixels and go one pixel per step (Sub four)
+typedef int stbi__unfilter_row_func(int filter, stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter_bytes);
+
+stbi_inline static __m128i stbi__load_pixel(const stbi_uc *p)
+{
+   int v;
+   memcpy(&v, p, 4);
+   return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void stbi__store_pixel(stbi_uc *p, __m128i v)
+{
+   int x = _mm_cvtsi128_si32(v);
+   memcpy(p, &x, 4);
+}
+
+// returns 0 if there is no SIMD version for this filter and pixel size
+static int stbi__unfilter_row_sse2(int filter, stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter_bytes)
+{
+   int k = 0;
+   __m128i zero = _mm_setzero_si128();
+
+   if (filter == STBI__F_up) {
+      for (; k+16 <= nk; k += 16)
+         _mm_storeu_si128((__m128i *) (cur+k), _mm_add_epi8(_mm_loadu_si128((const __m128i *) (raw+k)),
+                                                            _mm_loadu_si128((const __m128i *) (prior+k))));
+      for (; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+      return 1;
+   }
+
+   if (filter_bytes != 3 && filter_bytes != 4)
+      return 0;
+
+   switch (filter) {
+   case STBI__F_sub: {
+      // prefix sum of 4 pixels in one register, then add the last pixel of the previous step.
+      // the 3 byte version stores 16 bytes but only moves on by 12, the next step overwrites the rest
+      int step = filter_bytes * 4;
+      __m128i last = zero;
+      for (; k+16 <= nk; k += step) {
+         __m128i x = _mm_loadu_si128((const __m128i *) (raw+k));
+         if (filter_bytes == 4) {
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi8(x, last);
+            last = _mm_shuffle_epi32(x, 0xff);
+         } else {
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+            x = _mm_add_epi8(x, last);
+            last = _mm_and_si128(_mm_srli_si128(x, 9), _mm_setr_epi32(0xffffff, 0, 0, 0));
+            last = _mm_or_si128(last, _mm_slli_si128(last, 3));
+            last = _mm_or_si128(last, _mm_slli_si128(last, 6));
+         }
+         _mm_storeu_si128((__m128i *) (cur+k), x);
+      }
+      if (k == 0) {
+         memcpy(cur, raw, filter_bytes);
+         k = filter_bytes;
+      }
+      for (; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + cur[k-filter_bytes]);
+      return 1;
+   }
+   case STBI__F_avg: {
+      // floor((a+b)/2) is the rounding-up pavgb minus the low bit of a^b
+      __m128i one = _mm_set1_epi8(1);
+      __m128i a = zero;
+      // 4 byte loads and stores, so the last 3 byte pixel is left to the scalar loop
+      for (; k+4 <= nk; k += filter_bytes) {
+         __m128i b = stbi__load_pixel(prior+k);
+         __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+         a = _mm_add_epi8(stbi__load_pixel(raw+k), avg);
+         stbi__store_pixel(cur+k, a);
+      }
+      for (; k < filter_bytes; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + (prior[k]>>1));
+      for (; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k-filter_bytes])>>1));
+      return 1;
+   }
+   case STBI__F_paeth: {
+      // the spec's predictor in 16-bit lanes: a if |b-c| is smallest, else b if |a-c| is, else c
+      __m128i a = zero, c = zero;
+      for (; k+4 <= nk; k += filter_bytes) {
+         __m128i b = _mm_unpacklo_epi8(stbi__load_pixel(prior+k), zero);
+         __m128i pb = _mm_sub_epi16(a, c);
+         __m128i pa = _mm_sub_epi16(b, c);
+         __m128i pc = _mm_add_epi16(pa, pb);
+         __m128i smallest, nearest, pred;
+         pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+         pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+         pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+         smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+         {
+            __m128i use_a = _mm_cmpeq_epi16(smallest, pa);
+            __m128i use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(smallest, pb));
+            __m128i use_c = _mm_andnot_si128(_mm_or_si128(use_a, use_b), _mm_set1_epi16(-1));
+            nearest = _mm_or_si128(_mm_or_si128(_mm_and_si128(use_a, a), _mm_and_si128(use_b, b)),
+                                   _mm_and_si128(use_c, c));
+         }
+         pred = _mm_add_epi8(stbi__load_pixel(raw+k), _mm_packus_epi16(nearest, nearest));
+         stbi__store_pixel(cur+k, pred);
+         a = _mm_unpacklo_epi8(pred, zero);
+         c = b;
+      }
+      for (; k < filter_bytes; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + prior[k]); // prior[k] == stbi__paeth(0,prior[k],0)
+      for (; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k-filter_bytes], prior[k], prior[k-filter_bytes]));
+      return 1;
+   }
+   }
+   return 0;
+}
+#endif
+
+#ifdef STBI_AVX2
+// only Up gets wider, the other filters are bound by the dependency on the pixel to the left
+STBI__AVX2_TARGET
+static int stbi__unfilter_row_avx2(int filter, stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter_bytes)
+{
+   int k = 0;
+   if (filter != STBI__F_up)
+      return stbi__unfilter_row_sse2(filter, cur, prior, raw, nk, filter_bytes);
+   for (; k+32 <= nk; k += 32)
+      _mm256_storeu_si256((__m256i *) (cur+k), _mm256_add_epi8(_mm256_loadu_si256((const __m256i *) (raw+k)),
+                                                               _mm256_loadu_si256((const __m256i *) (prior+k))));
+   for (; k < nk; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+   return 1;
+}
+#endif
+
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // adds an extra all-255 alpha channel
@@ -4707,6 +5504,15 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+#ifdef STBI_SSE2
+   stbi__unfilter_row_func *unfilter_row = NULL;
+   if (stbi_simd_path() >= STBI_SIMD_BASIC)
+      unfilter_row = stbi__unfilter_row_sse2;
+#ifdef STBI_AVX2
+   if (stbi_simd_path() >= STBI_SIMD_AVX2)
+      unfilter_row = stbi__unfilter_row_avx2;
+#endif
+#endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
    a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4751,6 +5557,11 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       // if first row, use special filter that doesn't sample previous row
       if (j == 0) filter = first_row_filter[filter];
 
+#ifdef STBI_SSE2
+      if (unfilter_row && unfilter_row(filter, cur, prior, raw, nk, filter_bytes))
+         filter = -1; // done
+#endif
+
       // perform actual filtering
       switch (filter) {
       case STBI__F_none:
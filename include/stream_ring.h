@@ -0,0 +1,81 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+
+/*
+    ring buffer for data that is written once a frame and read by that frame's draws
+
+        StreamRing ring(4 << 20);
+        ring.beginFrame();
+        StreamAllocation block = ring.allocate(count * sizeof(glm::mat4));
+        memcpy(block.data, transforms, block.size);     // straight into the buffer, no glBufferData
+        ... draw with ring.buffer at block.offset ...
+        ring.endFrame();
+
+    1. one buffer made with glBufferStorage and mapped once with GL_MAP_PERSISTENT_BIT |
+       GL_MAP_COHERENT_BIT, the pointer stays valid while the GPU reads the buffer
+    2. it is cut into frameCount regions (3: the CPU writes one while the GPU may still be on the
+       other two), allocations in a frame are bumped out of the current region
+    3. endFrame puts a fence after the frame's commands, beginFrame waits on the fence of the region
+       it is about to reuse. with three regions that wait is almost always already signaled
+
+    needs GL 4.4 (glBufferStorage), supported() says whether the context has it
+*/
+
+struct StreamAllocation
+{
+    void *data;      // write here
+    size_t offset;   // bytes from the start of StreamRing::buffer, for attribute pointers and glBindBufferRange
+    size_t size;
+};
+
+struct StreamRingStats
+{
+    long frames = 0;
+    long stalls = 0;         // beginFrame calls whose fence wasn't signaled yet
+    double stallMs = 0.0;    // time spent waiting in those
+    size_t peakFrameBytes = 0;
+};
+
+class StreamRing
+{
+public:
+    unsigned int buffer;
+
+    // frameBytes is what a single frame may allocate, throws std::runtime_error without GL 4.4
+    explicit StreamRing(size_t frameBytes, int frameCount = 3);
+    ~StreamRing();
+    StreamRing(const StreamRing&) = delete;
+    StreamRing& operator=(const StreamRing&) = delete;
+
+    // moves to the next region, waiting until the GPU is done with what was written there last time
+    void beginFrame();
+    // alignment has to be a power of two, throws std::runtime_error when the region is full
+    StreamAllocation allocate(size_t bytes, size_t alignment = 16);
+    // for a uniform block, aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    StreamAllocation allocateUniform(size_t bytes);
+    // fences everything the frame's draws read
+    void endFrame();
+
+    size_t frameBytes() const { return regionSize; }
+    size_t frameUsed() const { return head; }
+    const StreamRingStats& stats() const { return ringStats; }
+
+    static bool supported();
+
+private:
+    unsigned char *mapped;
+    size_t regionSize;
+    int regionCount;
+    int region = -1;
+    size_t head = 0;
+    size_t uniformAlignment;
+    GLsync fences[8];   // one per region
+    StreamRingStats ringStats;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+    asynchronous texture loading
+
+    1. load() hands back a handle right away and queues the file for a worker thread
+    2. workers read the file and decode it with stbi_load_from_memory
+    3. update() runs on the GL thread once a frame and streams decoded rows through a pixel
+       buffer object into the real texture, never more than uploadBudget bytes per frame
+    4. texture() returns a shared 1x1 placeholder until every row has arrived, then the real texture
+*/
+
+typedef int TextureHandle;
+
+struct TextureLoadOptions
+{
+    bool flipVertically = false;
+    GLenum wrap = GL_REPEAT;
+    GLenum minFilter = GL_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    bool mipmaps = true;
+};
+
+class TextureLoader
+{
+public:
+    // workerThreads 0 picks one per core, uploadBudget is in bytes per update()
+    explicit TextureLoader(int workerThreads = 0, size_t uploadBudget = 4 * 1024 * 1024);
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    TextureHandle load(const std::string &path, const TextureLoadOptions &options = TextureLoadOptions());
+
+    // the texture to bind for this handle, the placeholder while it is still loading
+    unsigned int texture(TextureHandle handle) const;
+    bool ready(TextureHandle handle) const;
+
+    // drop the GL texture and any decoded pixels, the handle stays valid and shows the placeholder
+    void unload(TextureHandle handle);
+    // queue an unloaded handle for decoding again
+    void reload(TextureHandle handle);
+    bool unloaded(TextureHandle handle) const;
+
+    // estimated video memory of the texture including mipmaps, 0 until its size is known
+    size_t gpuBytes(TextureHandle handle) const;
+    // hash of the file bytes, 0 until a worker has read the file
+    uint64_t contentHash(TextureHandle handle) const;
+
+    // upload decoded data within the budget, call once a frame on the GL thread
+    void update();
+    // block until everything queued is decoded and uploaded (ignores the budget)
+    void finish();
+
+    // textures that are not ready yet
+    int pendingCount() const;
+    size_t bytesUploadedLastUpdate() const { return lastUploadBytes; }
+
+    void setUploadBudget(size_t bytes) { uploadBudget = bytes; }
+
+    // split the IDCT and color conversion of each JPEG over threadPool(), off by default since the
+    // workers already decode different files side by side. this is process wide (stb_image global)
+    static void setParallelJpegDecode(bool enabled);
+
+private:
+    enum TextureStatus { DECODING, UPLOADING, READY, FAILED, UNLOADED };
+
+    struct Texture
+    {
+        std::string path;
+        TextureLoadOptions options;
+        TextureStatus status = DECODING;
+        unsigned int id = 0;   // real texture, created once the size is known
+
+        // decoded pixels, freed once the last row is uploaded
+        unsigned char *pixels = nullptr;
+        int width = 0, height = 0, channels = 0;
+        int rowsUploaded = 0;
+
+        uint64_t contentHash = 0;
+        // bumped by unload(), decodes queued before that are thrown away when they come back
+        int generation = 0;
+    };
+
+    struct DecodeJob
+    {
+        TextureHandle handle;
+        int generation;
+        std::string path;
+        bool flipVertically;
+    };
+
+    struct DecodeResult
+    {
+        TextureHandle handle;
+        int generation;
+        unsigned char *pixels;
+        int width, height, channels;
+        uint64_t contentHash;
+    };
+
+    void workerLoop();
+    void collectDecoded();
+    // copies as many whole rows as fit into budget bytes, returns the bytes copied
+    size_t uploadRows(Texture &texture, unsigned char *staging, size_t budget);
+
+    std::vector<Texture> textures;
+    unsigned int placeholder;
+    unsigned int pixelBuffer;
+    size_t uploadBudget;
+    size_t lastUploadBytes = 0;
+
+    // decode queue for the workers
+    std::vector<std::thread> workers;
+    std::deque<DecodeJob> jobs;
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    bool stopping = false;
+
+    // decoded images waiting for the GL thread
+    std::vector<DecodeResult> decoded;
+    std::mutex decodedMutex;
+    std::condition_variable decodedReady;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include "texture_loader.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+    texture cache on top of TextureLoader
+
+    acquire() is keyed by the canonical path (plus load options), so asking twice for the same
+    file shares one texture. once a worker has read a file its content hash is known too, and a
+    second path to identical bytes is folded into the texture that is already there
+
+    TextureRef is a reference counted handle. textures nobody references stay cached until the
+    estimated video memory goes over the budget, then the least recently used ones are unloaded
+*/
+
+class TextureManager;
+
+class TextureRef
+{
+public:
+    TextureRef() : manager(nullptr), entry(-1) {}
+    TextureRef(const TextureRef &other);
+    TextureRef& operator=(const TextureRef &other);
+    ~TextureRef();
+
+    // texture to bind (placeholder while loading), also marks it as recently used
+    unsigned int id() const;
+    bool ready() const;
+    bool valid() const { return manager != nullptr; }
+
+private:
+    friend class TextureManager;
+    TextureRef(TextureManager *manager, int entry);
+
+    TextureManager *manager;
+    int entry;
+};
+
+struct TextureCacheStats
+{
+    int textures;            // entries in the cache, resident or not
+    int resident;            // entries holding video memory
+    size_t residentBytes;
+    size_t budgetBytes;
+    long hits, misses;       // acquire() found an existing entry or not
+    long contentDuplicates;  // different paths that turned out to be the same file
+    long evictions;
+};
+
+class TextureManager
+{
+public:
+    // vramBudget in bytes, the rest is passed to the loader
+    explicit TextureManager(size_t vramBudget = 256u * 1024 * 1024, int workerThreads = 0,
+                            size_t uploadBudget = 4 * 1024 * 1024);
+
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    TextureRef acquire(const std::string &path, const TextureLoadOptions &options = TextureLoadOptions());
+
+    // uploads, folds content duplicates and evicts down to the budget, once a frame on the GL thread
+    void update();
+    // block until everything acquired is uploaded
+    void finish();
+
+    void setBudget(size_t bytes) { budget = bytes; }
+    TextureCacheStats stats() const;
+
+    TextureLoader& loader() { return textureLoader; }
+
+private:
+    friend class TextureRef;
+
+    struct Entry
+    {
+        std::string key;
+        std::string options;
+        TextureHandle handle;
+        int refCount = 0;
+        uint64_t lastUsed = 0;
+        // set when the file turned out to be a copy of another entry, which is used instead
+        int aliasOf = -1;
+        bool hashChecked = false;
+    };
+
+    static std::string optionsKey(const TextureLoadOptions &options);
+    int resolve(int entry) const;
+    void addRef(int entry);
+    void release(int entry);
+    unsigned int bind(int entry);
+    void foldDuplicates();
+    void evictToBudget();
+
+    TextureLoader textureLoader;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, int> entryByKey;
+    std::unordered_map<std::string, int> entryByContent;
+
+    size_t budget;
+    uint64_t useClock = 0;
+    long hits = 0, misses = 0, contentDuplicates = 0, evictions = 0;
+};
+
+#endif
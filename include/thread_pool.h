@@ -0,0 +1,63 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+
+/*
+    small worker pool for data parallel loops
+
+        pool.parallelFor(count, [&](int begin, int end) { for (int i = begin; i < end; i++) ... });
+
+    the range is cut into chunks of at least minChunk items. the calling thread works on its own
+    chunks too, so parallelFor can be called from several threads at once and from inside another
+    parallelFor without deadlocking
+*/
+
+class ThreadPool
+{
+public:
+    // threads 0 picks one per core, the caller counts as one of them
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void parallelFor(int count, const std::function<void(int begin, int end)> &body, int minChunk = 1);
+
+    // threads that work on a parallelFor, including the caller
+    int threadCount() const { return (int)workers.size() + 1; }
+
+private:
+    struct Batch
+    {
+        const std::function<void(int, int)> *body;
+        int count, chunkSize, chunkCount;
+        std::atomic<int> nextChunk;
+        std::atomic<int> chunksDone;
+        int workersInside;   // guarded by mutex, the batch lives on the caller's stack until this is 0
+    };
+
+    // claims and runs chunks of batch until none are left, returns true if it ran any
+    static bool runChunks(Batch &batch);
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<Batch*> batches;
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable batchDone;
+    bool stopping = false;
+};
+
+// process wide pool, created on first use
+ThreadPool& threadPool();
+
+#endif
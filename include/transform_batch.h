@@ -0,0 +1,69 @@
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+#include <cstddef>
+
+
+/*
+    world matrices of many objects at once, from a position, rotation and scale each
+
+        TransformBatch objects;
+        size_t id = objects.add(position, rotation, scale);
+        ...
+        objects.setPosition(id, newPosition);               // whenever something moves
+        objects.computeMatrices(worldMatrices.data());      // once a frame, straight into the instance upload
+
+    1. the parts are kept as structure of arrays, a float array per component (position x, y, z,
+       rotation x, y, z, w, scale x, y, z), so 8 objects load into one ymm register per component
+    2. the matrix is translate * rotate * scale, what glm::translate, glm::mat4_cast and glm::scale
+       build one after the other, written out directly: the rotation columns from the quaternion
+       times the scale, the position as the last column. no 4x4 multiplies at all
+    3. the AVX2/FMA kernel makes the 16 elements of 8 matrices in 16 registers, element major, and
+       transposes them in two 8x8 blocks into 8 column major mat4s. the scalar loop does the same
+       operations in the same order, they agree to a rounding or two
+    4. rotations are expected to be unit quaternions, like glm::mat4_cast does
+    5. computeMatrices without a range splits the objects over the thread pool in blocks of 8
+*/
+
+class TransformBatch
+{
+public:
+    // returns the index of the new object
+    size_t add(const glm::vec3 &position, const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+               const glm::vec3 &scale = glm::vec3(1.0f));
+    // new objects sit at the origin unrotated with scale 1
+    void resize(size_t count);
+    void clear() { resize(0); }
+    size_t size() const { return positionX.size(); }
+
+    void set(size_t i, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+    void setPosition(size_t i, const glm::vec3 &position);
+    void setRotation(size_t i, const glm::quat &rotation);
+    void setScale(size_t i, const glm::vec3 &scale);
+
+    glm::vec3 position(size_t i) const { return glm::vec3(positionX[i], positionY[i], positionZ[i]); }
+    glm::quat rotation(size_t i) const { return glm::quat(rotationW[i], rotationX[i], rotationY[i], rotationZ[i]); }
+    glm::vec3 scale(size_t i) const { return glm::vec3(scaleX[i], scaleY[i], scaleZ[i]); }
+
+    // out[i] for every i in [begin, end), on the calling thread
+    void computeMatrices(glm::mat4 *out, size_t begin, size_t end, bool allowSimd = true) const;
+    // out[i] for all size() objects, split over the thread pool when there are enough of them
+    void computeMatrices(glm::mat4 *out, bool allowSimd = true) const;
+
+    // whether computeMatrices can take the AVX2/FMA path on this CPU
+    static bool simdAvailable();
+
+private:
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+};
+
+// translate(position) * mat4_cast(rotation) * scale(scale) for a single object, the batch's scalar path
+glm::mat4 composeTransform(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include "transform_batch.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+#include <cstddef>
+
+
+/*
+    parent/child transforms as flat arrays instead of a tree of node pointers
+
+        TransformHierarchy scene;
+        unsigned int car = scene.add(TransformHierarchy::noParent, position);
+        unsigned int wheel = scene.add(car, wheelOffset);
+        ...
+        scene.setRotation(wheel, spin);        // only marks the node
+        scene.update();                        // once a frame, before anything reads world()
+        draw(scene.world(wheel));
+
+    1. nodes are kept sorted by depth: all roots, then all their children, then the grandchildren.
+       siblings sit next to each other in the order of their parents, so a level is one linear
+       sweep and every parent is done before its children are looked at. adding nodes re-sorts
+       on the next update, node ids stay the same (slotOf maps them to their place)
+    2. local parts (position, rotation, scale) live in a TransformBatch in the same order. a setter
+       sets the node's dirty flag and queues it. update composes the local matrices of the queued
+       nodes (with the batch's AVX2 kernel when most of them changed), then goes down level by
+       level: a node changed when it was queued or its parent changed, and only then
+       world = parent world * local is recomputed, with the Mat4Kernels multiply
+    3. the nodes of a level are split over the thread pool, the levels themselves run in order
+    4. worldChanged tells which nodes got a new world matrix in the last update, e.g. to only
+       refresh the bounds of those in a FrustumCuller
+*/
+
+class TransformHierarchy
+{
+public:
+    static const unsigned int noParent = ~0u;
+
+    // parent has to exist already, returns the id of the new node
+    unsigned int add(unsigned int parent, const glm::vec3 &position = glm::vec3(0.0f),
+                     const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                     const glm::vec3 &scale = glm::vec3(1.0f));
+    size_t size() const { return parents.size(); }
+    // levels of depth as of the last update, 1 when there are only roots
+    size_t levelCount() const { return levelStarts.empty() ? 0 : levelStarts.size() - 1; }
+
+    void setLocal(unsigned int node, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+    void setPosition(unsigned int node, const glm::vec3 &position);
+    void setRotation(unsigned int node, const glm::quat &rotation);
+    void setScale(unsigned int node, const glm::vec3 &scale);
+
+    unsigned int parent(unsigned int node) const;
+    // as of the last update
+    const glm::mat4& world(unsigned int node) const { return worlds[slotOf[node]]; }
+    bool worldChanged(unsigned int node) const { return changed[slotOf[node]] != 0; }
+
+    // recomputes the world matrices of every node that moved since the last update, and of everything below it
+    void update(bool parallel = true);
+
+private:
+    // puts the nodes in depth order again after adds (breadth first from the roots), everything is
+    // dirty afterwards
+    void sortByDepth();
+    void markDirty(size_t slot);
+
+    // by slot, in depth order once sorted
+    std::vector<unsigned int> parents;    // slot of the parent, noParent for roots
+    std::vector<unsigned int> nodeAt;     // id of the node in a slot
+    TransformBatch locals;
+    std::vector<glm::mat4> localMatrices, worlds;
+    std::vector<unsigned char> dirty;     // local parts changed since the last update
+    std::vector<unsigned char> changed;   // world recomputed in the last update
+    std::vector<unsigned int> dirtySlots;
+
+    std::vector<unsigned int> slotOf;     // by node id
+    std::vector<size_t> levelStarts;      // first slot of every level, and size() at the end
+    bool sorted = true;
+};
+
+#endif
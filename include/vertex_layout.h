@@ -0,0 +1,95 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstddef>
+
+struct MeshData;
+
+
+/*
+    vertex layout descriptor
+
+    a layout lists which attributes a vertex buffer holds and in what format, apply() turns that into
+    the glVertexAttribPointer calls and packVertices() turns a MeshData into the matching bytes
+
+        VertexLayout layout = VertexLayout::compact(!mesh.normals.empty());
+        std::vector<unsigned char> bytes = packVertices(mesh, layout);
+        loadBuffer(bytes.data(), bytes.size(), ..., layout);
+
+    formats
+        Float32     what MeshData holds, 4 bytes a component
+        Half16      IEEE half floats (glm::packHalf2x16), positions get a w of 1 so they stay 4 byte aligned
+        Unorm8      0..1 in a byte (glm::packUnorm4x8), colors get an alpha of 1
+        OctSnorm16  unit vectors folded onto an octahedron and stored as two snorm16 (glm::packSnorm2x16),
+                    the shader gets a vec2 and has to unfold it:
+
+                        vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+                        if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+                        n = normalize(n);
+
+    the compact layout is 16 bytes a vertex (20 with normals) against 32 (44) for the float one. packing
+    runs on AVX2 eight vertices at a time when the CPU has it and gives the same bytes as the glm calls
+    (nan or infinite normals aside)
+*/
+
+// the attribute location is the semantic, that's what the shaders declare
+enum class VertexSemantic
+{
+    Position = 0,
+    Color = 1,
+    TexCoord = 2,
+    Normal = 3
+};
+
+enum class VertexFormat
+{
+    Float32,
+    Half16,
+    Unorm8,
+    OctSnorm16
+};
+
+struct VertexAttribute
+{
+    VertexSemantic semantic;
+    VertexFormat format;
+    unsigned int offset;   // bytes from the start of the vertex
+    unsigned int size;     // bytes, always a multiple of 4
+};
+
+class VertexLayout
+{
+public:
+    // attributes are laid out in the order they are added, throws std::invalid_argument for a
+    // format the semantic can't be stored in (Unorm8 positions, octahedral colors, ...)
+    VertexLayout& add(VertexSemantic semantic, VertexFormat format);
+
+    unsigned int stride() const { return vertexStride; }
+    const std::vector<VertexAttribute>& attributes() const { return attributeList; }
+    const VertexAttribute* find(VertexSemantic semantic) const;
+
+    // attribute pointers for the bound vertex array and GL_ARRAY_BUFFER, starting at byte offset base
+    void apply(size_t base = 0) const;
+
+    // float position, color and uv, the 32 byte vertex loadBuffer always used
+    static VertexLayout standard();
+    // half positions and uvs, unorm8 colors and (if asked for) octahedral normals
+    static VertexLayout compact(bool withNormals);
+
+private:
+    std::vector<VertexAttribute> attributeList;
+    unsigned int vertexStride = 0;
+};
+
+// whether packVertices can take the AVX2 path on this CPU
+bool vertexPackingSimdAvailable();
+
+// packs mesh into layout, out has to hold vertexCount() * stride() bytes. a layout asking for normals
+// of a mesh without any gets (0, 0, 1). the vertices are split over the thread pool
+void packVertices(const MeshData &mesh, const VertexLayout &layout, unsigned char *out, bool allowSimd = true);
+std::vector<unsigned char> packVertices(const MeshData &mesh, const VertexLayout &layout);
+
+#endif
@@ -0,0 +1,2597 @@
+#include "main.h"
+#include "headless_context.h"
+#include "mesh_loader.h"
+#include "thread_pool.h"
+#include "vertex_layout.h"
+#include "instance_buffer.h"
+#include "stream_ring.h"
+#include "geometry_pool.h"
+#include "range_allocator.h"
+#include "meshlet.h"
+#include "frustum_culler.h"
+#include "mesh_simplifier.h"
+#include "transform_batch.h"
+#include "transform_hierarchy.h"
+#include "mat4_kernels.h"
+#include "skeletal_animation.h"
+#include "skin_buffer.h"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <cstdio>
+#include <random>
+
+
+/*
+    benchmarks for the render loop pieces, every mode prints one JSON object to stdout
+    they all run on a headless EGL context, so no window or GPU is needed (Mesa llvmpipe works)
+
+    --bench [frames]            render the demo scene offscreen without vsync, frame time statistics
+                                  --profile adds per-stage CPU/GPU times, --trace <file> writes a Chrome trace
+                                  --parallel-jpeg decodes the textures with the multithreaded JPEG path
+                                  --mesh <file> draws an .obj or .glb instead of the quad
+                                  --compact-vertices packs the vertices with VertexLayout::compact
+                                  --instances <n> draws n instanced copies of it
+                                  --lod builds a LOD chain at import and draws the level the screen size needs
+    --bench-uniforms [frames]   driver calls and time per frame for the uniform setup
+    --bench-jpeg [iterations]   stb_image JPEG decode throughput for every SIMD path the CPU has
+                                  --image <file> decodes another file instead of textures/container.jpg
+    --bench-png [iterations]    PNG decode throughput of the fast inflate and SIMD unfilters against the old path
+                                  --image <file> decodes another file instead of textures/awesomeface.png
+    --bench-mesh [iterations]   OBJ and GLB import throughput in triangles per second, one thread against all
+                                  --mesh <file> imports that file instead of a generated 1M triangle grid
+    --bench-vertex-formats [frames]  float vs compact vertex layout: bytes, packing time (scalar and AVX2),
+                                  quantization error and draw time of a 1M triangle grid (or --mesh <file>)
+    --bench-mesh-optimize       ACMR/ATVR and fetch overfetch before and after each mesh optimizer step, on
+                                  the grid as generated and shuffled (or --mesh <file>)
+    --bench-instances [frames]  1 to 1M quads as one draw call each and as a single instanced draw (plain
+                                  and with per instance color/uv), frame time and instances per second
+    --bench-stream [frames]     per frame instance data through glBufferData orphaning against a persistently
+                                  mapped ring (3 regions, and 1 to show the fence stalls), frames are not
+                                  finished one by one so the CPU and GPU overlap like they would with vsync off
+    --bench-multi-draw [frames] 100 to 10k objects of 16 meshes in 4 texture buckets, a VAO bind, uniform and
+                                  draw call per object against one glMultiDrawElementsIndirect per bucket
+    --bench-pool [frames]       range allocator ops per second, then 2000 resident meshes with 5% swapped out
+                                  every frame: a buffer per mesh against the geometry pool, with and without
+                                  defragmentation, fragmentation and utilisation at the end
+    --bench-meshlets [frames]   meshlet build time and sizes for a 1M triangle sphere (or --mesh <file>), cluster
+                                  culling on the CPU (scalar and AVX2) and in a compute shader, and the frame time
+                                  of drawing everything against the CPU and GPU culled indirect draws
+    --bench-lod [frames]        LOD chain of a 65k triangle sphere (or --mesh <file>): build time, triangles and
+                                  error per level, a field of 256 copies drawn at full detail against per object
+                                  LODs, and how often objects switch level with and without hysteresis
+    --bench-mesh-format [iterations]  file to GPU buffers for OBJ, GLB and .bmesh (plain and compressed) of a 1M
+                                  triangle grid (or --mesh <file>), and the compressed index decode speed
+    --bench-transforms [iterations]  world matrices of 1k to 1M objects from position, quaternion and scale: a
+                                  glm translate/rotate/scale loop against the SoA batch (scalar, AVX2, all threads)
+    --bench-mat4 [iterations]   batched mat4 multiply, mat4 * vec4 and inverse for every kernel level the CPU
+                                  runs (glm scalar, glm SSE2, AVX, AVX/FMA) and which one is picked at runtime
+    --bench-frustum [iterations]  frustum culling of 1M and 4M spheres and boxes: a per object glm loop against
+                                  the SoA culler (scalar, SSE, AVX2, AVX2 on all threads), objects tested per ms
+    --bench-hierarchy [frames]  350k node transform hierarchy: a pointer tree updated top down every frame against
+                                  the flat depth sorted one with dirty flags, with 100%, 1% and none of the nodes moving
+    --bench-animation [frames]  100 to 10k characters of 64 joints blending two clips: a glm slerp/mat4 loop against
+                                  the SoA sampler (scalar, AVX2 nlerp and slerp, matrices, all threads), then 1000 of
+                                  them skinned in one instanced draw with dual quaternions and with matrices
+*/
+
+
+// counts how often the render loop reaches into the driver, glad keeps its entry points
+// in plain function pointers so we just swap in counting wrappers while a benchmark runs
+namespace
+{
+    struct DriverCallCounter
+    {
+        long useProgram = 0;
+        long getUniformLocation = 0;
+        long uniform = 0;
+
+        long total() const { return useProgram + getUniformLocation + uniform; }
+    };
+
+    DriverCallCounter counter;
+    PFNGLUSEPROGRAMPROC realUseProgram;
+    PFNGLGETUNIFORMLOCATIONPROC realGetUniformLocation;
+    PFNGLUNIFORM1IPROC realUniform1i;
+    PFNGLUNIFORMMATRIX4FVPROC realUniformMatrix4fv;
+
+    void APIENTRY countedUseProgram(GLuint program)
+    {
+        counter.useProgram++;
+        realUseProgram(program);
+    }
+
+    GLint APIENTRY countedGetUniformLocation(GLuint program, const GLchar *name)
+    {
+        counter.getUniformLocation++;
+        return realGetUniformLocation(program, name);
+    }
+
+    void APIENTRY countedUniform1i(GLint location, GLint v0)
+    {
+        counter.uniform++;
+        realUniform1i(location, v0);
+    }
+
+    void APIENTRY countedUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+    {
+        counter.uniform++;
+        realUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    void installCallCounters()
+    {
+        realUseProgram = glad_glUseProgram;
+        realGetUniformLocation = glad_glGetUniformLocation;
+        realUniform1i = glad_glUniform1i;
+        realUniformMatrix4fv = glad_glUniformMatrix4fv;
+
+        glad_glUseProgram = countedUseProgram;
+        glad_glGetUniformLocation = countedGetUniformLocation;
+        glad_glUniform1i = countedUniform1i;
+        glad_glUniformMatrix4fv = countedUniformMatrix4fv;
+    }
+
+    void removeCallCounters()
+    {
+        glad_glUseProgram = realUseProgram;
+        glad_glGetUniformLocation = realGetUniformLocation;
+        glad_glUniform1i = realUniform1i;
+        glad_glUniformMatrix4fv = realUniformMatrix4fv;
+    }
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    glm::mat4 frameTransform(int frame)
+    {
+        glm::mat4 trans = glm::mat4(1.0f);
+        trans = glm::translate(trans, glm::vec3(0.5f, -0.5f, 0.0f));
+        trans = glm::rotate(trans, frame * 0.016f, glm::vec3(0.0f, 0.0f, 1.0f));
+        return trans;
+    }
+
+    // the uniform setup of the render loop as it was before reflection: three name lookups a frame
+    int benchUniforms(int frames)
+    {
+        HeadlessContext context(64, 64);
+        Shader theShader("src/shaders/shader.vs","src/shaders/shader.fs");
+
+        installCallCounters();
+
+        // before
+        counter = DriverCallCounter();
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            glm::mat4 trans = frameTransform(frame);
+            glUseProgram(theShader.ID);
+            unsigned int transformLoc = glGetUniformLocation(theShader.ID, "transform");
+            glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
+            glUniform1i(glGetUniformLocation(theShader.ID, "texture1"), 0);
+            glUniform1i(glGetUniformLocation(theShader.ID, "texture2"), 1);
+        }
+        glFinish();
+        double beforeMs = millisecondsSince(start);
+        DriverCallCounter before = counter;
+
+        // after: handles resolved once, samplers set once outside the loop
+        counter = DriverCallCounter();
+        start = std::chrono::steady_clock::now();
+        UniformHandle transformLoc = theShader.uniform("transform");
+        theShader.use();
+        theShader.setInt("texture1", 0);
+        theShader.setInt("texture2", 1);
+        for (int frame = 0; frame < frames; frame++)
+        {
+            glm::mat4 trans = frameTransform(frame);
+            theShader.use();
+            theShader.setMat4(transformLoc, trans);
+        }
+        glFinish();
+        double afterMs = millisecondsSince(start);
+        DriverCallCounter after = counter;
+
+        removeCallCounters();
+
+        auto report = [frames](const char *label, const DriverCallCounter &c, double ms, bool last)
+        {
+            std::cout << "  \"" << label << "\": {"
+                      << "\"driver_calls_per_frame\": " << (double)c.total() / frames
+                      << ", \"uniform_lookups_per_frame\": " << (double)c.getUniformLocation / frames
+                      << ", \"uniform_uploads_per_frame\": " << (double)c.uniform / frames
+                      << ", \"us_per_frame\": " << ms * 1000.0 / frames
+                      << "}" << (last ? "\n" : ",\n");
+        };
+        std::cout << "{\n  \"bench\": \"uniforms\",\n  \"frames\": " << frames << ",\n";
+        report("before", before, beforeMs, false);
+        report("after", after, afterMs, true);
+        std::cout << "}\n";
+        return 0;
+    }
+
+    std::vector<unsigned char> readFile(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("cannot open " + path);
+        return std::vector<unsigned char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    struct DecodeTiming
+    {
+        double msPerDecode;
+        double mbPerSecond;   // decoded pixel bytes
+        bool identical;
+    };
+
+    // decodes bytes iterations times with stb_image, the first decode is warmup and is compared
+    // against reference (or becomes the reference if that is still empty)
+    DecodeTiming timeDecodes(const std::vector<unsigned char> &bytes, int channels, int iterations,
+                             std::vector<unsigned char> &reference)
+    {
+        int width = 0, height = 0, fileChannels = 0;
+        bool identical = true;
+        double totalMs = 0.0;
+        for (int i = 0; i <= iterations; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            unsigned char *pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(),
+                                                          &width, &height, &fileChannels, channels);
+            double ms = millisecondsSince(start);
+            if (!pixels)
+                throw std::runtime_error(std::string("cannot decode: ") + stbi_failure_reason());
+
+            size_t size = (size_t)width * height * (channels ? channels : fileChannels);
+            if (i == 0)
+            {
+                if (reference.empty())
+                    reference.assign(pixels, pixels + size);
+                identical = reference.size() == size && std::memcmp(reference.data(), pixels, size) == 0;
+            }
+            else
+                totalMs += ms;
+            stbi_image_free(pixels);
+        }
+
+        double msPerDecode = totalMs / iterations;
+        double decodedMB = (double)width * height * (channels ? channels : fileChannels) / (1024.0 * 1024.0);
+        return {msPerDecode, decodedMB * 1000.0 / msPerDecode, identical};
+    }
+
+    void printTiming(const std::string &label, const DecodeTiming &timing, const char *referenceName, bool first)
+    {
+        std::cout << (first ? "\n" : ",\n") << "    \"" << label << "\": {"
+                  << "\"ms_per_decode\": " << timing.msPerDecode
+                  << ", \"mb_per_s\": " << timing.mbPerSecond
+                  << ", \"identical_to_" << referenceName << "\": " << (timing.identical ? "true" : "false") << "}";
+    }
+
+    static const char *simdPathNames[] = {"scalar", "simd128", "avx2"};  // simd128 is SSE2 or NEON
+
+    // decodes the same file over and over on each kernel path up to the best one, as 3 and 4 channels.
+    // every path has to give the same pixels as the scalar one. the file cut short has to decode the
+    // same with the parallel decoder as with the serial one. parallel is the mode to leave set
+    int benchJpeg(int iterations, const std::string &path, bool parallel)
+    {
+        std::vector<unsigned char> bytes = readFile(path);
+        int bestPath = stbi_simd_path();
+
+        std::cout << "{\n  \"bench\": \"jpeg\",\n  \"file\": \"" << path << "\",\n"
+                  << "  \"file_bytes\": " << bytes.size() << ",\n"
+                  << "  \"iterations\": " << iterations << ",\n  \"paths\": {";
+
+        for (int channels = 3; channels <= 4; channels++)
+        {
+            std::vector<unsigned char> reference;
+            for (int simd = STBI_SIMD_NONE; simd <= bestPath; simd++)
+            {
+                stbi_set_simd_limit(simd);
+                DecodeTiming timing = timeDecodes(bytes, channels, iterations, reference);
+                printTiming(std::string(simdPathNames[simd]) + (channels == 3 ? "_rgb" : "_rgba"), timing,
+                            "scalar", channels == 3 && simd == STBI_SIMD_NONE);
+            }
+        }
+        stbi_set_simd_limit(STBI_SIMD_AVX2);
+
+        // cut in the middle of the scan, there is no EOI marker and the last blocks decode from zeros
+        std::vector<unsigned char> truncated(bytes.begin(), bytes.begin() + bytes.size() * 2 / 3);
+        std::vector<unsigned char> serialPixels;
+        TextureLoader::setParallelJpegDecode(false);
+        timeDecodes(truncated, 3, 1, serialPixels);
+        TextureLoader::setParallelJpegDecode(true);
+        bool truncatedIdentical = timeDecodes(truncated, 3, 1, serialPixels).identical;
+        TextureLoader::setParallelJpegDecode(parallel);
+
+        std::cout << "\n  },\n  \"truncated_parallel_identical_to_serial\": " << (truncatedIdentical ? "true" : "false")
+                  << ",\n  \"best_path\": \"" << simdPathNames[bestPath] << "\"\n}\n";
+        return 0;
+    }
+
+    // "baseline" is the decoder as it was: byte at a time inflate and scalar unfilters. the other
+    // rows use the fast inflate loop with each unfilter path
+    int benchPng(int iterations, const std::string &path)
+    {
+        std::vector<unsigned char> bytes = readFile(path);
+        int bestPath = stbi_simd_path();
+
+        std::cout << "{\n  \"bench\": \"png\",\n  \"file\": \"" << path << "\",\n"
+                  << "  \"file_bytes\": " << bytes.size() << ",\n"
+                  << "  \"iterations\": " << iterations << ",\n  \"paths\": {";
+
+        std::vector<unsigned char> reference;
+        stbi_set_zlib_fast_path(0);
+        stbi_set_simd_limit(STBI_SIMD_NONE);
+        DecodeTiming baseline = timeDecodes(bytes, 0, iterations, reference);
+        printTiming("baseline", baseline, "baseline", true);
+
+        stbi_set_zlib_fast_path(1);
+        for (int simd = STBI_SIMD_NONE; simd <= bestPath; simd++)
+        {
+            stbi_set_simd_limit(simd);
+            DecodeTiming timing = timeDecodes(bytes, 0, iterations, reference);
+            printTiming(std::string("fast_inflate_") + simdPathNames[simd], timing, "baseline", false);
+            if (simd == bestPath)
+                std::cout << ",\n    \"speedup\": " << baseline.msPerDecode / timing.msPerDecode;
+        }
+        stbi_set_simd_limit(STBI_SIMD_AVX2);
+
+        std::cout << "\n  },\n  \"best_path\": \"" << simdPathNames[bestPath] << "\"\n}\n";
+        return 0;
+    }
+
+    // a width x height grid of quads over a sine wave, 1024 x 512 is about a million triangles
+    MeshData gridMesh(int width, int height)
+    {
+        MeshData mesh;
+        for (int y = 0; y <= height; y++)
+        {
+            for (int x = 0; x <= width; x++)
+            {
+                float u = (float)x / width, v = (float)y / height;
+                float slope = std::cos(u * 20.0f);   // d/du of 0.05 sin(20 u)
+                glm::vec3 normal = glm::normalize(glm::vec3(-slope, 0.0f, 1.0f));
+                mesh.vertices.insert(mesh.vertices.end(), {u - 0.5f, v - 0.5f, 0.05f * std::sin(u * 20.0f),
+                                                           u, v, 1.0f - u, u, v});
+                mesh.normals.insert(mesh.normals.end(), {normal.x, normal.y, normal.z});
+            }
+        }
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                unsigned int corner = y * (width + 1) + x;
+                mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + width + 2,
+                                                         corner, corner + width + 2, corner + width + 1});
+            }
+        }
+        return mesh;
+    }
+
+    // the grid written as OBJ quads and as a GLB with one indexed primitive
+    void writeGridMeshes(int width, int height, const std::string &objPath, const std::string &glbPath)
+    {
+        MeshData grid = gridMesh(width, height);
+        std::vector<float> positions, texcoords;
+        for (size_t i = 0; i < grid.vertexCount(); i++)
+        {
+            const float *vertex = &grid.vertices[i * MeshData::floatsPerVertex];
+            positions.insert(positions.end(), vertex, vertex + 3);
+            texcoords.insert(texcoords.end(), vertex + 6, vertex + 8);
+        }
+        const std::vector<unsigned int> &indices = grid.indices;
+        size_t vertexCount = positions.size() / 3;
+
+        std::ofstream obj(objPath, std::ios::binary);
+        obj << "# " << width << " x " << height << " grid\n";
+        char line[96];
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            obj.write(line, std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n",
+                                          positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]));
+        }
+        for (size_t i = 0; i < vertexCount; i++)
+            obj.write(line, std::snprintf(line, sizeof(line), "vt %.6f %.6f\n", texcoords[i * 2], texcoords[i * 2 + 1]));
+        obj << "vn 0 0 1\n";
+        for (size_t quad = 0; quad < indices.size() / 6; quad++)
+        {
+            const unsigned int *q = &indices[quad * 6];
+            unsigned int a = q[0] + 1, b = q[1] + 1, c = q[2] + 1, d = q[5] + 1;
+            obj.write(line, std::snprintf(line, sizeof(line), "f %u/%u/1 %u/%u/1 %u/%u/1 %u/%u/1\n",
+                                          a, a, b, b, c, c, d, d));
+        }
+        if (!obj)
+            throw std::runtime_error("cannot write " + objPath);
+
+        // GLB: positions, uvs and indices back to back in the BIN chunk
+        size_t positionBytes = positions.size() * sizeof(float);
+        size_t texcoordBytes = texcoords.size() * sizeof(float);
+        size_t indexBytes = indices.size() * sizeof(unsigned int);
+        size_t binBytes = positionBytes + texcoordBytes + indexBytes;
+        std::string json =
+            "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+            "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"TEXCOORD_0\":1},\"indices\":2}]}],"
+            "\"buffers\":[{\"byteLength\":" + std::to_string(binBytes) + "}],"
+            "\"bufferViews\":["
+            "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(positionBytes) + "},"
+            "{\"buffer\":0,\"byteOffset\":" + std::to_string(positionBytes) + ",\"byteLength\":" + std::to_string(texcoordBytes) + "},"
+            "{\"buffer\":0,\"byteOffset\":" + std::to_string(positionBytes + texcoordBytes) + ",\"byteLength\":" + std::to_string(indexBytes) + "}],"
+            "\"accessors\":["
+            "{\"bufferView\":0,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) + ",\"type\":\"VEC3\"},"
+            "{\"bufferView\":1,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) + ",\"type\":\"VEC2\"},"
+            "{\"bufferView\":2,\"componentType\":5125,\"count\":" + std::to_string(indices.size()) + ",\"type\":\"SCALAR\"}]}";
+        json.resize((json.size() + 3) & ~(size_t)3, ' ');
+
+        auto u32 = [](std::ofstream &out, uint32_t value) { out.write((const char*)&value, 4); };
+        std::ofstream glb(glbPath, std::ios::binary);
+        u32(glb, 0x46546c67);   // "glTF"
+        u32(glb, 2);
+        u32(glb, (uint32_t)(12 + 8 + json.size() + 8 + binBytes));
+        u32(glb, (uint32_t)json.size());
+        u32(glb, 0x4e4f534a);   // "JSON"
+        glb.write(json.data(), json.size());
+        u32(glb, (uint32_t)binBytes);
+        u32(glb, 0x004e4942);   // "BIN"
+        glb.write((const char*)positions.data(), positionBytes);
+        glb.write((const char*)texcoords.data(), texcoordBytes);
+        glb.write((const char*)indices.data(), indexBytes);
+        if (!glb)
+            throw std::runtime_error("cannot write " + glbPath);
+    }
+
+    // imports one file iterations times on a single thread and on the whole pool, after a warmup
+    // import that pulls the file into the page cache. reports the median of each
+    void benchMeshFile(const std::string &path, int iterations, bool first)
+    {
+        ThreadPool singleThread(1);
+        MeshData reference = loadMesh(path, singleThread);
+
+        auto timeImports = [&](ThreadPool &pool, bool &identical)
+        {
+            std::vector<double> samples;
+            identical = true;
+            for (int i = 0; i < iterations; i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                MeshData mesh = loadMesh(path, pool);
+                samples.push_back(millisecondsSince(start));
+                identical = identical && mesh.vertices == reference.vertices && mesh.indices == reference.indices &&
+                            mesh.normals == reference.normals;
+            }
+            std::sort(samples.begin(), samples.end());
+            return samples[samples.size() / 2];
+        };
+
+        bool singleIdentical, pooledIdentical;
+        double singleMs = timeImports(singleThread, singleIdentical);
+        double pooledMs = timeImports(threadPool(), pooledIdentical);
+
+        double fileMB = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+        double triangles = (double)reference.triangleCount();
+        auto report = [&](const char *label, double ms, int threads, bool identical, bool last)
+        {
+            std::cout << "      \"" << label << "\": {\"threads\": " << threads << ", \"ms\": " << ms
+                      << ", \"triangles_per_s\": " << triangles * 1000.0 / ms
+                      << ", \"mb_per_s\": " << fileMB * 1000.0 / ms
+                      << ", \"identical\": " << (identical ? "true" : "false") << "}" << (last ? "\n" : ",\n");
+        };
+
+        std::cout << (first ? "\n" : ",\n") << "    \"" << path << "\": {\n"
+                  << "      \"file_bytes\": " << std::filesystem::file_size(path) << ",\n"
+                  << "      \"vertices\": " << reference.vertexCount() << ",\n"
+                  << "      \"triangles\": " << reference.triangleCount() << ",\n";
+        report("single_thread", singleMs, 1, singleIdentical, false);
+        report("thread_pool", pooledMs, threadPool().threadCount(), pooledIdentical, true);
+        std::cout << "    }";
+    }
+
+    int benchMesh(int iterations, const std::string &meshPath)
+    {
+        std::vector<std::string> paths;
+        if (meshPath.empty())
+        {
+            std::filesystem::path directory = std::filesystem::temp_directory_path();
+            std::string objPath = (directory / "begin_opengl_bench_grid.obj").string();
+            std::string glbPath = (directory / "begin_opengl_bench_grid.glb").string();
+            writeGridMeshes(1024, 512, objPath, glbPath);
+            paths = {objPath, glbPath};
+        }
+        else
+            paths = {meshPath};
+
+        std::cout << "{\n  \"bench\": \"mesh\",\n  \"iterations\": " << iterations << ",\n  \"files\": {";
+        for (size_t i = 0; i < paths.size(); i++)
+            benchMeshFile(paths[i], iterations, i == 0);
+        std::cout << "\n  }\n}\n";
+
+        if (meshPath.empty())
+        {
+            for (const std::string &path : paths)
+                std::filesystem::remove(path);
+        }
+        return 0;
+    }
+
+    struct FrameStats
+    {
+        double min, median, p99, max, mean;
+    };
+
+    FrameStats summarize(std::vector<double> samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&samples](double p)
+        {
+            size_t index = (size_t)(p * (samples.size() - 1) + 0.5);
+            return samples[index];
+        };
+
+        double sum = 0.0;
+        for (double sample : samples)
+            sum += sample;
+
+        return {samples.front(), percentile(0.5), percentile(0.99), samples.back(), sum / samples.size()};
+    }
+
+    void printCacheStats(const char *indent, const char *label, const MeshData &mesh, double ms, bool last)
+    {
+        VertexCacheStats cache = analyzeVertexCache(mesh.indices, mesh.vertexCount());
+        VertexFetchStats fetch = analyzeVertexFetch(mesh.indices, mesh.vertexCount(),
+                                                    MeshData::floatsPerVertex * sizeof(float));
+        std::cout << indent << "\"" << label << "\": {\"acmr\": " << cache.acmr << ", \"atvr\": " << cache.atvr
+                  << ", \"overfetch\": " << fetch.overfetch;
+        if (ms >= 0.0)
+            std::cout << ", \"ms\": " << ms;
+        std::cout << "}" << (last ? "\n" : ",\n");
+    }
+
+    // every optimization step on its own, with the FIFO 16 cache and 16 KB fetch cache numbers after it
+    void benchOptimizeInput(const char *name, const MeshData &source, bool first)
+    {
+        std::cout << (first ? "\n" : ",\n") << "    \"" << name << "\": {\n"
+                  << "      \"vertices\": " << source.vertexCount() << ", \"triangles\": " << source.triangleCount() << ",\n";
+        printCacheStats("      ", "before", source, -1.0, false);
+
+        const char *methodNames[] = {"forsyth", "tipsify"};
+        for (int method = 0; method < 2; method++)
+        {
+            MeshData mesh = source;
+            auto start = std::chrono::steady_clock::now();
+            if (method == 0)
+                optimizeVertexCacheForsyth(mesh.indices, mesh.vertexCount());
+            else
+                optimizeVertexCacheTipsify(mesh.indices, mesh.vertexCount());
+            double cacheMs = millisecondsSince(start);
+            MeshData afterCache = mesh;
+
+            start = std::chrono::steady_clock::now();
+            size_t clusters = optimizeOverdraw(mesh.indices, mesh);
+            double overdrawMs = millisecondsSince(start);
+            MeshData afterOverdraw = mesh;
+
+            start = std::chrono::steady_clock::now();
+            optimizeVertexFetch(mesh);
+            double fetchMs = millisecondsSince(start);
+
+            std::cout << "      \"" << methodNames[method] << "\": {\n";
+            printCacheStats("        ", "vertex_cache", afterCache, cacheMs, false);
+            printCacheStats("        ", "overdraw", afterOverdraw, overdrawMs, false);
+            printCacheStats("        ", "vertex_fetch", mesh, fetchMs, false);
+            std::cout << "        \"overdraw_clusters\": " << clusters << "\n      }" << (method == 0 ? ",\n" : "\n");
+        }
+        std::cout << "    }";
+    }
+
+    // the 1M triangle grid in its natural row order and with the triangles shuffled (what a
+    // careless exporter might hand over), or a mesh file
+    int benchMeshOptimize(const std::string &meshPath)
+    {
+        std::cout << "{\n  \"bench\": \"mesh_optimize\",\n  \"cache\": \"fifo 16\",\n  \"inputs\": {";
+        if (!meshPath.empty())
+            benchOptimizeInput(meshPath.c_str(), loadMesh(meshPath), true);
+        else
+        {
+            MeshData grid = gridMesh(1024, 512);
+            benchOptimizeInput("grid", grid, true);
+
+            std::mt19937 random(1);
+            std::vector<size_t> order(grid.triangleCount());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::shuffle(order.begin(), order.end(), random);
+            MeshData shuffled = grid;
+            for (size_t i = 0; i < order.size(); i++)
+                std::copy_n(&grid.indices[order[i] * 3], 3, &shuffled.indices[i * 3]);
+            benchOptimizeInput("grid_shuffled", shuffled, false);
+        }
+        std::cout << "\n  }\n}\n";
+        return 0;
+    }
+
+    // largest difference between what the shader will see and the float source, positions in model
+    // units, normals as an angle in degrees
+    void compactErrors(const MeshData &mesh, const VertexLayout &layout, const std::vector<unsigned char> &packed,
+                       double &positionError, double &normalErrorDegrees)
+    {
+        positionError = normalErrorDegrees = 0.0;
+        const VertexAttribute *position = layout.find(VertexSemantic::Position);
+        const VertexAttribute *normal = layout.find(VertexSemantic::Normal);
+        for (size_t v = 0; v < mesh.vertexCount(); v++)
+        {
+            const unsigned char *vertex = &packed[v * layout.stride()];
+            uint32_t words[2];
+            if (position && position->format == VertexFormat::Half16)
+            {
+                std::memcpy(words, vertex + position->offset, 8);
+                glm::vec2 xy = glm::unpackHalf2x16(words[0]), zw = glm::unpackHalf2x16(words[1]);
+                glm::vec3 source = glm::make_vec3(&mesh.vertices[v * MeshData::floatsPerVertex]);
+                glm::vec3 difference = glm::abs(glm::vec3(xy, zw.x) - source);
+                positionError = std::max(positionError, (double)std::max(difference.x, std::max(difference.y, difference.z)));
+            }
+            if (normal && normal->format == VertexFormat::OctSnorm16 && !mesh.normals.empty())
+            {
+                // the unfolding from the vertex_layout.h comment
+                std::memcpy(words, vertex + normal->offset, 4);
+                glm::vec2 oct = glm::unpackSnorm2x16(words[0]);
+                glm::vec3 n(oct, 1.0f - std::abs(oct.x) - std::abs(oct.y));
+                if (n.z < 0.0f)
+                    n = glm::vec3(std::copysign(1.0f - std::abs(n.y), n.x), std::copysign(1.0f - std::abs(n.x), n.y), n.z);
+                glm::vec3 source = glm::normalize(glm::make_vec3(&mesh.normals[v * 3]));
+                double cosine = glm::clamp(glm::dot(glm::normalize(n), source), -1.0f, 1.0f);
+                normalErrorDegrees = std::max(normalErrorDegrees, std::acos(cosine) * 180.0 / 3.14159265358979);
+            }
+        }
+    }
+
+    // the same mesh as plain floats and in the compact layout: bytes, packing time (glm calls vs AVX2)
+    // and time to draw it with the scene shader. llvmpipe fetches vertices on the CPU, so the draw
+    // numbers show the memory traffic more than a GPU would
+    int benchVertexFormats(int frames, const std::string &meshPath)
+    {
+        HeadlessContext context(800, 600);
+        MeshData mesh = meshPath.empty() ? gridMesh(1024, 512) : loadMesh(meshPath);
+        bool withNormals = !mesh.normals.empty();
+
+        Shader theShader("src/shaders/shader.vs","src/shaders/shader.fs");
+        theShader.use();
+        theShader.setMat4(theShader.uniform("transform"), glm::mat4(1.0f));
+
+        VertexLayout floatLayout = VertexLayout::standard();
+        if (withNormals)
+            floatLayout.add(VertexSemantic::Normal, VertexFormat::Float32);
+        struct Variant
+        {
+            const char *name;
+            VertexLayout layout;
+        };
+        Variant variants[] = {{"float32", floatLayout}, {"compact", VertexLayout::compact(withNormals)}};
+
+        std::cout << "{\n  \"bench\": \"vertex_formats\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"mesh\": \"" << (meshPath.empty() ? "grid 1024x512" : meshPath) << "\",\n"
+                  << "  \"vertices\": " << mesh.vertexCount() << ",\n"
+                  << "  \"triangles\": " << mesh.triangleCount() << ",\n"
+                  << "  \"simd_packing\": " << (vertexPackingSimdAvailable() ? "true" : "false") << ",\n"
+                  << "  \"frames\": " << frames << ",\n  \"layouts\": {";
+
+        double floatBytes = 0.0, floatDrawMs = 0.0;
+        for (int i = 0; i < 2; i++)
+        {
+            const VertexLayout &layout = variants[i].layout;
+            std::vector<unsigned char> scalar(mesh.vertexCount() * layout.stride()), simd(scalar.size());
+
+            auto timePacking = [&](std::vector<unsigned char> &out, bool allowSimd)
+            {
+                std::vector<double> samples;
+                for (int run = 0; run < 5; run++)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    packVertices(mesh, layout, out.data(), allowSimd);
+                    samples.push_back(millisecondsSince(start));
+                }
+                std::sort(samples.begin(), samples.end());
+                return samples[samples.size() / 2];
+            };
+            double scalarMs = timePacking(scalar, false);
+            double simdMs = timePacking(simd, true);
+
+            unsigned int VBO, VAO, EBO;
+            loadBuffer(simd.data(), simd.size(), mesh.indices.data(), mesh.indexBytes(), VBO, VAO, EBO, layout);
+            std::vector<double> frameTimes;
+            for (int frame = 0; frame < frames + 3; frame++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                glClear(GL_COLOR_BUFFER_BIT);
+                glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0);
+                glFinish();
+                if (frame >= 3)
+                    frameTimes.push_back(millisecondsSince(start));
+            }
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+            glState().forgetVertexArray(VAO);
+            glState().forgetBuffer(VBO);
+            glState().forgetBuffer(EBO);
+
+            FrameStats stats = summarize(frameTimes);
+            double bytes = (double)simd.size();
+            if (i == 0)
+            {
+                floatBytes = bytes;
+                floatDrawMs = stats.median;
+            }
+
+            std::cout << (i ? ",\n" : "\n") << "    \"" << variants[i].name << "\": {"
+                      << "\"bytes_per_vertex\": " << layout.stride()
+                      << ", \"vertex_mb\": " << bytes / (1024.0 * 1024.0)
+                      << ", \"pack_ms_scalar\": " << scalarMs
+                      << ", \"pack_ms_simd\": " << simdMs
+                      << ", \"simd_identical\": " << (scalar == simd ? "true" : "false")
+                      << ", \"draw_ms_median\": " << stats.median;
+            if (i == 1)
+            {
+                double positionError, normalError;
+                compactErrors(mesh, layout, simd, positionError, normalError);
+                std::cout << ", \"max_position_error\": " << positionError
+                          << ", \"max_normal_error_deg\": " << normalError
+                          << ", \"memory_ratio\": " << bytes / floatBytes
+                          << ", \"draw_speedup\": " << floatDrawMs / stats.median;
+            }
+            std::cout << "}";
+        }
+        std::cout << "\n  }\n}\n";
+        return 0;
+    }
+
+    // n spinning quads drawn three ways: a uniform upload and glDrawElements per quad (the way the
+    // scene draws its one quad, only run up to 10k), one glDrawElementsInstanced over a transform
+    // stream, and the same with the color/uv stream as well. every frame rebuilds and uploads all
+    // transforms, the update column is the CPU part of that
+    int benchInstances(int frames)
+    {
+        const int warmupFrames = 2;
+        const size_t perDrawLimit = 10000;
+        HeadlessContext context(800, 600);
+
+        MeshData quad = gridMesh(1, 1);
+        std::vector<unsigned char> packed = packVertices(quad, VertexLayout::standard());
+        unsigned int VBO, VAO, EBO;
+        loadBuffer(packed.data(), packed.size(), quad.indices.data(), quad.indexBytes(), VBO, VAO, EBO);
+        GLsizei indexCount = (GLsizei)quad.indices.size();
+
+        Shader plain("src/shaders/shader.vs","src/shaders/shader.fs");
+        Shader instanced("src/shaders/shader.vs","src/shaders/shader.fs", InstanceBuffer::shaderDefines(false));
+        Shader tinted("src/shaders/shader.vs","src/shaders/shader.fs", InstanceBuffer::shaderDefines(true));
+        UniformHandle plainTransform = plain.uniform("transform");
+        for (Shader *shader : {&instanced, &tinted})
+        {
+            shader->use();
+            shader->setMat4(shader->uniform("transform"), glm::mat4(1.0f));
+        }
+
+        // attribute divisors are vertex array state, the per draw path keeps its own VAO without them
+        unsigned int instancedVAO, tintedVAO;
+        glGenVertexArrays(1, &instancedVAO);
+        glGenVertexArrays(1, &tintedVAO);
+        for (unsigned int vertexArray : {instancedVAO, tintedVAO})
+        {
+            glState().bindVertexArray(vertexArray);
+            glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+            VertexLayout::standard().apply();
+            glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        }
+        InstanceBuffer transformsOnly(false), withTints(true);
+        transformsOnly.attach(instancedVAO);
+        withTints.attach(tintedVAO);
+
+        std::cout << "{\n  \"bench\": \"instances\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"frames\": " << frames << ",\n  \"counts\": {";
+
+        std::vector<glm::mat4> transforms;
+        std::vector<InstanceTint> tints;
+        bool first = true;
+        for (size_t count = 1; count <= 1000000; count *= 10)
+        {
+            tints.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                float t = (float)i / count;
+                tints[i].color = glm::vec4(1.0f - t, 0.5f, t, 1.0f);
+                tints[i].uvOffset = glm::vec2(t, 0.0f);
+            }
+
+            std::vector<double> updateTimes;
+            auto timeFrames = [&](const std::function<void()> &drawFrame)
+            {
+                std::vector<double> frameTimes;
+                for (int frame = 0; frame < warmupFrames + frames; frame++)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    layoutInstanceGrid(transforms, count, frame / 60.0f);
+                    updateTimes.push_back(millisecondsSince(start));
+                    drawFrame();
+                    glFinish();
+                    if (frame >= warmupFrames)
+                        frameTimes.push_back(millisecondsSince(start));
+                }
+                return summarize(frameTimes).median;
+            };
+
+            double perDrawMs = 0.0;
+            if (count <= perDrawLimit)
+            {
+                perDrawMs = timeFrames([&]()
+                {
+                    plain.use();
+                    glState().bindVertexArray(VAO);
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        plain.setMat4(plainTransform, transforms[i]);
+                        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+                    }
+                });
+            }
+            double instancedMs = timeFrames([&]()
+            {
+                instanced.use();
+                transformsOnly.upload(transforms.data(), count);
+                transformsOnly.draw(instancedVAO, indexCount);
+            });
+            double tintedMs = timeFrames([&]()
+            {
+                tinted.use();
+                withTints.upload(transforms.data(), count, tints.data());
+                withTints.draw(tintedVAO, indexCount);
+            });
+
+            std::cout << (first ? "\n" : ",\n") << "    \"" << count << "\": {";
+            if (count <= perDrawLimit)
+                std::cout << "\"per_draw_ms\": " << perDrawMs << ", ";
+            std::cout << "\"instanced_ms\": " << instancedMs
+                      << ", \"instanced_tinted_ms\": " << tintedMs
+                      << ", \"update_ms\": " << summarize(updateTimes).median
+                      << ", \"instances_per_s\": " << count / (instancedMs / 1000.0);
+            if (count <= perDrawLimit)
+                std::cout << ", \"speedup\": " << perDrawMs / instancedMs;
+            std::cout << "}";
+            first = false;
+        }
+        std::cout << "\n  }\n}\n";
+
+        glDeleteVertexArrays(1, &instancedVAO);
+        glDeleteVertexArrays(1, &tintedVAO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glState().forgetVertexArray(instancedVAO);
+        glState().forgetVertexArray(tintedVAO);
+        glState().forgetVertexArray(VAO);
+        glState().forgetBuffer(VBO);
+        glState().forgetBuffer(EBO);
+        return 0;
+    }
+
+    // the same instanced frames with the transforms streamed three ways, only the last frame is
+    // waited for. upload_ms is the CPU time of the upload call alone
+    int benchStream(int frames)
+    {
+        HeadlessContext context(800, 600);
+        if (!StreamRing::supported())
+            throw std::runtime_error("--bench-stream needs GL 4.4");
+
+        MeshData quad = gridMesh(1, 1);
+        std::vector<unsigned char> packed = packVertices(quad, VertexLayout::standard());
+        unsigned int VBO, VAO, EBO;
+        loadBuffer(packed.data(), packed.size(), quad.indices.data(), quad.indexBytes(), VBO, VAO, EBO);
+        GLsizei indexCount = (GLsizei)quad.indices.size();
+
+        Shader instanced("src/shaders/shader.vs","src/shaders/shader.fs", InstanceBuffer::shaderDefines(false));
+        instanced.use();
+        instanced.setMat4(instanced.uniform("transform"), glm::mat4(1.0f));
+        InstanceBuffer instances;
+        instances.attach(VAO);
+
+        std::cout << "{\n  \"bench\": \"stream\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"frames\": " << frames << ",\n  \"counts\": {";
+
+        std::vector<glm::mat4> transforms;
+        for (size_t count = 1000; count <= 100000; count *= 10)
+        {
+            std::cout << (count == 1000 ? "\n" : ",\n") << "    \"" << count << "\": {";
+            const char *names[] = {"orphan", "ring_3", "ring_1"};
+            for (int method = 0; method < 3; method++)
+            {
+                std::unique_ptr<StreamRing> ring;
+                if (method > 0)
+                    ring.reset(new StreamRing(count * sizeof(glm::mat4), method == 1 ? 3 : 1));
+
+                double uploadMs = 0.0;
+                glFinish();
+                auto start = std::chrono::steady_clock::now();
+                for (int frame = 0; frame < frames; frame++)
+                {
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    layoutInstanceGrid(transforms, count, frame / 60.0f);
+
+                    auto uploadStart = std::chrono::steady_clock::now();
+                    if (ring)
+                    {
+                        ring->beginFrame();
+                        instances.upload(*ring, transforms.data(), count);
+                    }
+                    else
+                    {
+                        instances.upload(transforms.data(), count);
+                    }
+                    uploadMs += millisecondsSince(uploadStart);
+
+                    instances.draw(VAO, indexCount);
+                    if (ring)
+                        ring->endFrame();
+                    // stands in for the buffer swap, gets the frame going without waiting for it
+                    glFlush();
+                }
+                glFinish();
+                double totalMs = millisecondsSince(start);
+
+                std::cout << (method ? ", " : "") << "\"" << names[method] << "\": {"
+                          << "\"ms_per_frame\": " << totalMs / frames
+                          << ", \"upload_ms\": " << uploadMs / frames;
+                if (ring)
+                    std::cout << ", \"stalls\": " << ring->stats().stalls << ", \"stall_ms\": " << ring->stats().stallMs;
+                std::cout << "}";
+            }
+            std::cout << "}";
+        }
+        std::cout << "\n  }\n}\n";
+
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glState().forgetVertexArray(VAO);
+        glState().forgetBuffer(VBO);
+        glState().forgetBuffer(EBO);
+        return 0;
+    }
+
+    // a small scene of many objects: 16 grid meshes of 2 to 128 triangles and 4 one texel textures
+    // standing in for materials. drawn the loadBuffer way (a VAO per mesh, objects sorted by texture,
+    // bind + uniform + draw each) and from a geometry pool with one multi draw call per texture.
+    // submit_ms is the CPU side of the frame, before glFinish. llvmpipe runs an indirect draw inside
+    // the call (it has to read the commands back), so there submit_ms includes the rasterization
+    int benchMultiDraw(int frames)
+    {
+        const int warmupFrames = 2;
+        const int meshCount = 16, bucketCount = 4;
+        HeadlessContext context(800, 600);
+        if (!StreamRing::supported())
+            throw std::runtime_error("--bench-multi-draw needs GL 4.4");
+
+        GeometryPool pool(VertexLayout::standard(), 1 << 16, 1 << 18);
+        std::vector<MeshData> meshes;
+        std::vector<MeshHandle> pooled;
+        std::vector<unsigned int> meshVAOs, meshBuffers;
+        for (int i = 0; i < meshCount; i++)
+        {
+            meshes.push_back(gridMesh(1 << (i % 4), 1 << (i / 4)));
+            pooled.push_back(pool.add(meshes.back()));
+
+            std::vector<unsigned char> packed = packVertices(meshes.back(), VertexLayout::standard());
+            unsigned int VBO, VAO, EBO;
+            loadBuffer(packed.data(), packed.size(), meshes.back().indices.data(), meshes.back().indexBytes(),
+                       VBO, VAO, EBO);
+            meshVAOs.push_back(VAO);
+            meshBuffers.insert(meshBuffers.end(), {VBO, EBO});
+        }
+
+        unsigned int textures[bucketCount];
+        glGenTextures(bucketCount, textures);
+        for (int i = 0; i < bucketCount; i++)
+        {
+            unsigned char texel[4] = {(unsigned char)(64 * i), 255, (unsigned char)(255 - 64 * i), 255};
+            glState().bindTexture(0, GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        }
+
+        Shader plain("src/shaders/shader.vs","src/shaders/shader.fs");
+        Shader multiDraw("src/shaders/shader.vs","src/shaders/shader.fs", GeometryPool::shaderDefines());
+        UniformHandle plainTransform = plain.uniform("transform");
+        multiDraw.use();
+        multiDraw.setMat4(multiDraw.uniform("transform"), glm::mat4(1.0f));
+
+        std::cout << "{\n  \"bench\": \"multi_draw\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"frames\": " << frames << ",\n  \"counts\": {";
+
+        std::vector<glm::mat4> transforms;
+        std::mt19937 random(7);
+        for (int count = 100; count <= 10000; count *= 10)
+        {
+            StreamRing ring(count * (sizeof(glm::mat4) + sizeof(DrawElementsIndirectCommand)) + 4096 * bucketCount);
+            MultiDrawBatch batch(pool);
+
+            // objects sorted by bucket, the per object path relies on that to skip texture binds
+            struct Object { int mesh, bucket; };
+            std::vector<Object> objects(count);
+            for (Object &object : objects)
+                object = {(int)(random() % meshCount), (int)(random() % bucketCount)};
+            std::stable_sort(objects.begin(), objects.end(), [](const Object &a, const Object &b)
+            {
+                return a.bucket < b.bucket;
+            });
+
+            double submitMs[2] = {}, frameMs[2] = {};
+            int drawCalls[2] = {count, 0};
+            for (int method = 0; method < 2; method++)
+            {
+                std::vector<double> frameTimes, submitTimes;
+                for (int frame = 0; frame < warmupFrames + frames; frame++)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    layoutInstanceGrid(transforms, count, frame / 60.0f);
+
+                    if (method == 0)
+                    {
+                        plain.use();
+                        for (int i = 0; i < count; i++)
+                        {
+                            glState().bindTexture(0, GL_TEXTURE_2D, textures[objects[i].bucket]);
+                            glState().bindVertexArray(meshVAOs[objects[i].mesh]);
+                            plain.setMat4(plainTransform, transforms[i]);
+                            glDrawElements(GL_TRIANGLES, (GLsizei)meshes[objects[i].mesh].indices.size(),
+                                           GL_UNSIGNED_INT, 0);
+                        }
+                    }
+                    else
+                    {
+                        ring.beginFrame();
+                        batch.clear();
+                        for (int i = 0; i < count; i++)
+                            batch.add(objects[i].bucket, pooled[objects[i].mesh], transforms[i]);
+                        multiDraw.use();
+                        drawCalls[1] = batch.submit(ring, [&](unsigned int bucket)
+                        {
+                            glState().bindTexture(0, GL_TEXTURE_2D, textures[bucket]);
+                        });
+                        ring.endFrame();
+                    }
+
+                    double submitted = millisecondsSince(start);
+                    glFinish();
+                    if (frame >= warmupFrames)
+                    {
+                        submitTimes.push_back(submitted);
+                        frameTimes.push_back(millisecondsSince(start));
+                    }
+                }
+                submitMs[method] = summarize(submitTimes).median;
+                frameMs[method] = summarize(frameTimes).median;
+            }
+
+            std::cout << (count == 100 ? "\n" : ",\n") << "    \"" << count << "\": {"
+                      << "\"per_object\": {\"draw_calls\": " << drawCalls[0]
+                      << ", \"submit_ms\": " << submitMs[0] << ", \"frame_ms\": " << frameMs[0] << "}"
+                      << ", \"multi_draw\": {\"draw_calls\": " << drawCalls[1]
+                      << ", \"submit_ms\": " << submitMs[1] << ", \"frame_ms\": " << frameMs[1] << "}"
+                      << ", \"submit_speedup\": " << submitMs[0] / submitMs[1]
+                      << ", \"frame_speedup\": " << frameMs[0] / frameMs[1] << "}";
+        }
+        std::cout << "\n  }\n}\n";
+
+        for (unsigned int VAO : meshVAOs)
+        {
+            glDeleteVertexArrays(1, &VAO);
+            glState().forgetVertexArray(VAO);
+        }
+        for (unsigned int buffer : meshBuffers)
+        {
+            glDeleteBuffers(1, &buffer);
+            glState().forgetBuffer(buffer);
+        }
+        glDeleteTextures(bucketCount, textures);
+        for (unsigned int texture : textures)
+            glState().forgetTexture(texture);
+        return 0;
+    }
+
+    // how fast the allocator itself is, random allocate and free on a 16M unit range
+    double rangeAllocatorNanoseconds(int operations)
+    {
+        RangeAllocator allocator(1u << 24);
+        std::vector<RangeAllocation> live;
+        std::mt19937 random(3);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < operations; i++)
+        {
+            if (live.empty() || random() % 2 == 0)
+            {
+                RangeAllocation allocation = allocator.allocate(1 + random() % 4096);
+                if (allocation.valid())
+                    live.push_back(allocation);
+            }
+            else
+            {
+                size_t index = random() % live.size();
+                allocator.free(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        return millisecondsSince(start) * 1e6 / operations;
+    }
+
+    // streaming churn: meshes of 4 to 2048 triangles come and go, each way keeps the same set resident.
+    // after the pool runs, every live mesh is read back and compared, defragmentation included
+    int benchPool(int frames)
+    {
+        const int meshVariants = 16, resident = 2000, swapsPerFrame = resident / 20;
+        HeadlessContext context(64, 64);
+
+        std::vector<MeshData> variants;
+        std::vector<std::vector<unsigned char>> packed;
+        for (int i = 0; i < meshVariants; i++)
+        {
+            variants.push_back(gridMesh(1 << (i % 4 * 2), 2 << (i / 4)));
+            packed.push_back(packVertices(variants.back(), VertexLayout::standard()));
+        }
+
+        const int operations = 2000000;
+        std::cout << "{\n  \"bench\": \"pool\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"allocator_ns_per_op\": " << rangeAllocatorNanoseconds(operations) << ",\n"
+                  << "  \"resident_meshes\": " << resident << ",\n"
+                  << "  \"swaps_per_frame\": " << swapsPerFrame << ",\n"
+                  << "  \"frames\": " << frames << ",\n  \"methods\": {";
+
+        const char *names[] = {"buffer_per_mesh", "pool", "pool_defrag"};
+        for (int method = 0; method < 3; method++)
+        {
+            std::mt19937 random(11);
+            std::unique_ptr<GeometryPool> pool;
+            if (method > 0)
+                pool.reset(new GeometryPool(VertexLayout::standard(), 1u << 20, 3u << 20));
+
+            // what each slot holds: its variant, and either its pool handle or its own buffers
+            struct Slot { int variant; MeshHandle handle; unsigned int VBO, VAO, EBO; };
+            std::vector<Slot> slots(resident);
+            auto load = [&](Slot &slot)
+            {
+                slot.variant = (int)(random() % meshVariants);
+                const MeshData &mesh = variants[slot.variant];
+                const std::vector<unsigned char> &bytes = packed[slot.variant];
+                if (pool)
+                    slot.handle = pool->add(bytes.data(), mesh.vertexCount(), mesh.indices.data(), mesh.indices.size());
+                else
+                    loadBuffer(bytes.data(), bytes.size(), mesh.indices.data(), mesh.indexBytes(), slot.VBO, slot.VAO, slot.EBO);
+            };
+            auto unload = [&](Slot &slot)
+            {
+                if (pool)
+                {
+                    pool->remove(slot.handle);
+                    return;
+                }
+                glDeleteVertexArrays(1, &slot.VAO);
+                glDeleteBuffers(1, &slot.VBO);
+                glDeleteBuffers(1, &slot.EBO);
+                glState().forgetVertexArray(slot.VAO);
+                glState().forgetBuffer(slot.VBO);
+                glState().forgetBuffer(slot.EBO);
+            };
+
+            for (Slot &slot : slots)
+                load(slot);
+            glFinish();
+
+            std::vector<double> frameTimes;
+            for (int frame = 0; frame < frames; frame++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                for (int swap = 0; swap < swapsPerFrame; swap++)
+                {
+                    Slot &slot = slots[random() % resident];
+                    unload(slot);
+                    load(slot);
+                }
+                if (method == 2)
+                    pool->defragment(256 << 10);
+                glFinish();
+                frameTimes.push_back(millisecondsSince(start));
+            }
+
+            std::cout << (method ? ",\n" : "\n") << "    \"" << names[method] << "\": {"
+                      << "\"frame_ms\": " << summarize(frameTimes).median;
+            if (pool)
+            {
+                auto arena = [](const char *label, const RangeAllocatorStats &ranges)
+                {
+                    std::cout << ", \"" << label << "\": {\"utilisation\": " << ranges.utilisation
+                              << ", \"fragmentation\": " << ranges.fragmentation
+                              << ", \"free_ranges\": " << ranges.freeRanges
+                              << ", \"largest_free\": " << ranges.largestFree << "}";
+                };
+                GeometryPoolStats stats = pool->stats();
+                arena("vertices", stats.vertices);
+                arena("indices", stats.indices);
+
+                // with the churn over, what defragmentation gets to when it runs until nothing moves
+                if (method == 2)
+                {
+                    for (int pass = 0; pass < 1000 && pool->defragment(256 << 10) > 0; pass++)
+                        ;
+                    stats = pool->stats();
+                    arena("vertices_settled", stats.vertices);
+                    arena("indices_settled", stats.indices);
+                }
+
+                // read everything back, a mesh moved by defragment has to come out the same
+                bool intact = true;
+                size_t stride = pool->layout().stride();
+                for (const Slot &slot : slots)
+                {
+                    const PoolMesh &mesh = pool->mesh(slot.handle);
+                    std::vector<unsigned char> vertices(mesh.vertexCount * stride);
+                    std::vector<unsigned int> indices(mesh.indexCount);
+                    glState().bindBuffer(GL_COPY_READ_BUFFER, pool->VBO);
+                    glGetBufferSubData(GL_COPY_READ_BUFFER, mesh.baseVertex * stride, vertices.size(), vertices.data());
+                    glState().bindBuffer(GL_COPY_READ_BUFFER, pool->EBO);
+                    glGetBufferSubData(GL_COPY_READ_BUFFER, mesh.firstIndex * sizeof(unsigned int),
+                                       indices.size() * sizeof(unsigned int), indices.data());
+                    intact = intact && vertices == packed[slot.variant] && indices == variants[slot.variant].indices;
+                }
+
+                std::cout << ", \"bytes_moved\": " << stats.bytesMoved
+                          << ", \"contents_intact\": " << (intact ? "true" : "false");
+            }
+            std::cout << "}";
+
+            for (Slot &slot : slots)
+                unload(slot);
+        }
+        std::cout << "\n  }\n}\n";
+        return 0;
+    }
+
+    // a uv sphere of radius 1, counter clockwise seen from outside
+    MeshData sphereMesh(int segments, int rings)
+    {
+        MeshData mesh;
+        for (int r = 0; r <= rings; r++)
+        {
+            for (int s = 0; s <= segments; s++)
+            {
+                float u = (float)s / segments, v = (float)r / rings;
+                // the last column repeats the first bit for bit, a seam the simplifier can weld
+                float theta = v * 3.14159265f, phi = (float)(s % segments) / segments * 6.28318531f;
+                glm::vec3 p(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                mesh.vertices.insert(mesh.vertices.end(), {p.x, p.y, p.z, u, v, 1.0f - u, u, v});
+                mesh.normals.insert(mesh.normals.end(), {p.x, p.y, p.z});
+            }
+        }
+        for (int r = 0; r < rings; r++)
+        {
+            for (int s = 0; s < segments; s++)
+            {
+                unsigned int corner = r * (segments + 1) + s;
+                mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + segments + 1,
+                                                         corner + 1, corner + segments + 2, corner + segments + 1});
+            }
+        }
+        return mesh;
+    }
+
+    // meshlets the cone test rejects from eye although one of their triangles faces it, has to be 0
+    size_t frontFacingConeCulled(const MeshData &mesh, const MeshletData &meshlets, const glm::vec3 &eye)
+    {
+        auto position = [&](unsigned int vertex)
+        {
+            const float *p = &mesh.vertices[vertex * MeshData::floatsPerVertex];
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+        size_t wrong = 0;
+        for (size_t m = 0; m < meshlets.meshlets.size(); m++)
+        {
+            const MeshletBounds &bounds = meshlets.bounds[m];
+            glm::vec3 view = bounds.coneApex - eye;
+            if (glm::dot(view, bounds.coneAxis) < bounds.coneCutoff * glm::length(view))
+                continue;
+            const Meshlet &meshlet = meshlets.meshlets[m];
+            for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+            {
+                const unsigned char *local = &meshlets.triangles[(meshlet.triangleOffset + t) * 3];
+                glm::vec3 a = position(meshlets.vertices[meshlet.vertexOffset + local[0]]);
+                glm::vec3 b = position(meshlets.vertices[meshlet.vertexOffset + local[1]]);
+                glm::vec3 c = position(meshlets.vertices[meshlet.vertexOffset + local[2]]);
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                glm::vec3 toEye = eye - a;
+                // edge on within rounding isn't facing the camera
+                if (glm::dot(normal, toEye) > 1e-5f * glm::length(normal) * glm::length(toEye))
+                {
+                    wrong++;
+                    break;
+                }
+            }
+        }
+        return wrong;
+    }
+
+    // build the meshlets of a 1M triangle sphere (or --mesh), cull them on the CPU (scalar and AVX2) and
+    // in the compute shader, then draw the mesh whole, the CPU survivors with one multi draw and the GPU
+    // survivors with glMultiDrawElementsIndirectCount. the camera sits close and looks past the center
+    // so both the frustum and the cone test have something to reject
+    int benchMeshlets(int frames, const std::string &meshPath)
+    {
+        const int warmupFrames = 2, cullRuns = 50;
+        HeadlessContext context(800, 600);
+        if (!GLAD_GL_VERSION_4_6)
+            throw std::runtime_error("--bench-meshlets needs GL 4.6");
+
+        MeshData mesh;
+        if (meshPath.empty())
+        {
+            mesh = sphereMesh(1024, 512);
+        }
+        else
+        {
+            mesh = loadMesh(meshPath);
+            optimizeMesh(mesh);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        MeshletData meshlets = buildMeshlets(mesh);
+        double buildMs = millisecondsSince(start);
+        MeshletCuller culler(meshlets.bounds);
+        std::vector<unsigned int> indices = meshlets.indexBuffer();
+
+        glm::vec3 eye(0.0f, 0.3f, 2.2f);
+        glm::mat4 transform = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 10.0f) *
+                              glm::lookAt(eye, glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        std::vector<unsigned int> visible[2];
+        MeshletCullStats cullStats;
+        double cullMs[2];
+        for (int simd = 0; simd < 2; simd++)
+        {
+            std::vector<double> samples;
+            for (int run = 0; run < cullRuns; run++)
+            {
+                start = std::chrono::steady_clock::now();
+                cullStats = culler.cull(transform, eye, visible[simd], simd == 1);
+                samples.push_back(millisecondsSince(start));
+            }
+            cullMs[simd] = summarize(samples).median;
+        }
+
+        // the cone test has to be conservative, on the bench mesh and on the sine wave grid whose
+        // meshlets are concave as well as convex, seen from above at a few places
+        MeshData wave = gridMesh(256, 128);
+        MeshletData waveMeshlets = buildMeshlets(wave);
+        size_t coneErrors = frontFacingConeCulled(mesh, meshlets, eye);
+        for (const glm::vec3 &waveEye : {glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.3f, -0.2f, 0.1f), glm::vec3(-0.6f, 0.4f, 0.05f)})
+            coneErrors += frontFacingConeCulled(wave, waveMeshlets, waveEye);
+
+        std::vector<unsigned char> packed = packVertices(mesh, VertexLayout::standard());
+        unsigned int VBO, VAO, EBO;
+        loadBuffer(packed.data(), packed.size(), indices.data(), indices.size() * sizeof(unsigned int), VBO, VAO, EBO);
+
+        // everything the compute shader reads and writes
+        std::vector<glm::uvec2> ranges;
+        for (const Meshlet &meshlet : meshlets.meshlets)
+            ranges.push_back(glm::uvec2(meshlet.triangleOffset * 3, meshlet.triangleCount * 3));
+        unsigned int cullBuffers[4];
+        glGenBuffers(4, cullBuffers);
+        size_t cullBytes[4] = {meshlets.bounds.size() * sizeof(MeshletBounds), ranges.size() * sizeof(glm::uvec2),
+                               meshlets.meshlets.size() * sizeof(DrawElementsIndirectCommand), sizeof(GLuint)};
+        const void *cullData[4] = {meshlets.bounds.data(), ranges.data(), nullptr, nullptr};
+        for (int i = 0; i < 4; i++)
+        {
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, cullBuffers[i]);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, cullBytes[i], cullData[i], i < 2 ? GL_STATIC_DRAW : GL_DYNAMIC_COPY);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, i, cullBuffers[i]);
+        }
+
+        Shader cull = Shader::compute("src/shaders/meshlet_cull.comp");
+        cull.use();
+        glm::vec4 planes[6];
+        extractFrustumPlanes(transform, planes);
+        glUniform4fv(cull.uniform("frustumPlanes").location, 6, &planes[0].x);
+        cull.setVec3(cull.uniform("cameraPosition"), eye);
+        glUniform1ui(cull.uniform("meshletCount").location, (GLuint)meshlets.meshlets.size());
+
+        auto gpuCull = [&]()
+        {
+            const GLuint zero = 0;
+            cull.use();
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, cullBuffers[3]);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+            glDispatchCompute((GLuint)(meshlets.meshlets.size() + 63) / 64, 1, 1);
+            glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        };
+        gpuCull();
+        GLuint gpuVisible = 0;
+        glState().bindBuffer(GL_COPY_READ_BUFFER, cullBuffers[3]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &gpuVisible);
+
+        Shader plain("src/shaders/shader.vs","src/shaders/shader.fs");
+        plain.use();
+        plain.setMat4(plain.uniform("transform"), transform);
+        StreamRing ring(meshlets.meshlets.size() * sizeof(DrawElementsIndirectCommand) + 256);
+        glState().enable(GL_CULL_FACE);
+
+        std::cout << "{\n  \"bench\": \"meshlets\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"mesh\": \"" << (meshPath.empty() ? "sphere 1024x512" : meshPath) << "\",\n"
+                  << "  \"triangles\": " << mesh.triangleCount() << ",\n"
+                  << "  \"build_ms\": " << buildMs << ",\n"
+                  << "  \"meshlets\": " << meshlets.meshlets.size() << ",\n"
+                  << "  \"vertices_per_meshlet\": " << (double)meshlets.vertices.size() / meshlets.meshlets.size() << ",\n"
+                  << "  \"triangles_per_meshlet\": " << (double)meshlets.triangleCount() / meshlets.meshlets.size() << ",\n"
+                  << "  \"vertex_references_per_vertex\": " << (double)meshlets.vertices.size() / mesh.vertexCount() << ",\n"
+                  << "  \"cull\": {\"frustum_culled\": " << cullStats.frustumCulled
+                  << ", \"backface_culled\": " << cullStats.backfaceCulled
+                  << ", \"visible_cpu\": " << visible[1].size() << ", \"visible_gpu\": " << gpuVisible
+                  << ", \"cpu_ms_scalar\": " << cullMs[0] << ", \"cpu_ms_simd\": " << cullMs[1]
+                  << ", \"simd\": " << (MeshletCuller::simdAvailable() ? "true" : "false")
+                  << ", \"simd_identical\": " << (visible[0] == visible[1] ? "true" : "false")
+                  << ", \"front_facing_cone_culled\": " << coneErrors << "},\n"
+                  << "  \"frames\": " << frames << ",\n  \"frame_ms\": {";
+
+        const char *names[] = {"no_cull", "cpu_cull", "gpu_cull"};
+        double baseline = 0.0;
+        std::vector<unsigned int> survivors;
+        for (int method = 0; method < 3; method++)
+        {
+            std::vector<double> frameTimes;
+            for (int frame = 0; frame < warmupFrames + frames; frame++)
+            {
+                start = std::chrono::steady_clock::now();
+                glClear(GL_COLOR_BUFFER_BIT);
+                if (method == 0)
+                {
+                    plain.use();
+                    glState().bindVertexArray(VAO);
+                    glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0);
+                }
+                else if (method == 1)
+                {
+                    culler.cull(transform, eye, survivors);
+                    ring.beginFrame();
+                    StreamAllocation commands = ring.allocate(survivors.size() * sizeof(DrawElementsIndirectCommand), 4);
+                    DrawElementsIndirectCommand *command = (DrawElementsIndirectCommand*)commands.data;
+                    for (unsigned int m : survivors)
+                        *command++ = {ranges[m].y, 1, ranges[m].x, 0, 0};
+
+                    plain.use();
+                    glState().bindVertexArray(VAO);
+                    glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.buffer);
+                    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)commands.offset,
+                                                (GLsizei)survivors.size(), 0);
+                    ring.endFrame();
+                }
+                else
+                {
+                    gpuCull();
+                    plain.use();
+                    glState().bindVertexArray(VAO);
+                    glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, cullBuffers[2]);
+                    // not one of the state cache's targets, it goes straight through
+                    glState().bindBuffer(GL_PARAMETER_BUFFER, cullBuffers[3]);
+                    glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0,
+                                                     (GLsizei)meshlets.meshlets.size(), 0);
+                }
+                glFinish();
+                if (frame >= warmupFrames)
+                    frameTimes.push_back(millisecondsSince(start));
+            }
+
+            FrameStats stats = summarize(frameTimes);
+            if (method == 0)
+                baseline = stats.median;
+            std::cout << (method ? ",\n" : "\n") << "    \"" << names[method] << "\": {\"median\": " << stats.median
+                      << ", \"p99\": " << stats.p99 << ", \"speedup\": " << baseline / stats.median << "}";
+        }
+        std::cout << "\n  }\n}\n";
+
+        glState().disable(GL_CULL_FACE);
+        glDeleteVertexArrays(1, &VAO);
+        glState().forgetVertexArray(VAO);
+        for (unsigned int buffer : {VBO, EBO, cullBuffers[0], cullBuffers[1], cullBuffers[2], cullBuffers[3]})
+        {
+            glDeleteBuffers(1, &buffer);
+            glState().forgetBuffer(buffer);
+        }
+        glDeleteProgram(cull.ID);
+        glState().forgetProgram(cull.ID);
+        return 0;
+    }
+
+    // where the camera of the LOD benchmark is at a frame: it dollies through the field and
+    // shakes a little, the way a player's camera does
+    glm::vec3 lodCamera(int frame)
+    {
+        float t = frame / 60.0f;
+        return glm::vec3(0.0f, 1.0f, 10.0f - 30.0f * (0.5f - 0.5f * std::cos(t * 0.5f)) + 0.05f * std::sin(t * 40.0f));
+    }
+
+    // 256 copies of one mesh on a 16 x 16 field, each picks its own level every frame from its distance
+    int benchLod(int frames, const std::string &meshPath)
+    {
+        const int warmupFrames = 2, side = 16, switchFrames = 600;
+        const float fovY = glm::radians(60.0f);
+        HeadlessContext context(800, 600);
+
+        MeshData mesh;
+        if (meshPath.empty())
+        {
+            mesh = sphereMesh(256, 128);
+        }
+        else
+        {
+            mesh = loadMesh(meshPath);
+            optimizeMesh(mesh);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        MeshLodChain lods = buildLodChain(mesh);
+        double buildMs = millisecondsSince(start);
+
+        std::vector<glm::vec3> objects;
+        for (int z = 0; z < side; z++)
+            for (int x = 0; x < side; x++)
+                objects.push_back(glm::vec3((x - side / 2) * 4.0f, 0.0f, -z * 6.0f));
+        float pixelsPerUnit = lodPixelsPerUnit(fovY, 600);
+
+        // level switches over a longer walk, selection only. a reversal is a switch back to the level
+        // the object left less than half a second ago, the popping hysteresis is there to stop
+        long switches[2] = {}, reversals[2] = {};
+        for (int h = 0; h < 2; h++)
+        {
+            LodSelectOptions options;
+            options.hysteresis = h ? 0.25f : 0.0f;
+            std::vector<int> current(objects.size(), -1), previous(objects.size(), -1), switchedAt(objects.size(), 0);
+            for (int frame = 0; frame < switchFrames; frame++)
+            {
+                glm::vec3 eye = lodCamera(frame);
+                for (size_t i = 0; i < objects.size(); i++)
+                {
+                    int level = selectLod(lods, pixelsPerUnit / glm::length(objects[i] - eye), current[i], options);
+                    if (current[i] >= 0 && level != current[i])
+                    {
+                        switches[h]++;
+                        reversals[h] += level == previous[i] && frame - switchedAt[i] < 30;
+                        previous[i] = current[i];
+                        switchedAt[i] = frame;
+                    }
+                    current[i] = level;
+                }
+            }
+        }
+
+        std::vector<unsigned char> packed = packVertices(mesh, VertexLayout::standard());
+        unsigned int VBO, VAO, EBO;
+        loadBuffer(packed.data(), packed.size(), lods.indices.data(), lods.indices.size() * sizeof(unsigned int),
+                   VBO, VAO, EBO);
+        Shader plain("src/shaders/shader.vs","src/shaders/shader.fs");
+        UniformHandle transformLocation = plain.uniform("transform");
+        glm::mat4 projection = glm::perspective(fovY, 800.0f / 600.0f, 0.1f, 200.0f);
+        glState().enable(GL_CULL_FACE);
+
+        std::cout << "{\n  \"bench\": \"lod\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"mesh\": \"" << (meshPath.empty() ? "sphere 256x128" : meshPath) << "\",\n"
+                  << "  \"build_ms\": " << buildMs << ",\n  \"levels\": [";
+        for (size_t i = 0; i < lods.levels.size(); i++)
+        {
+            std::cout << (i ? ", " : "") << "{\"triangles\": " << lods.levels[i].indexCount / 3
+                      << ", \"error\": " << lods.levels[i].error << "}";
+        }
+        std::cout << "],\n  \"objects\": " << objects.size() << ",\n"
+                  << "  \"switches_over_" << switchFrames << "_frames\": {\"no_hysteresis\": " << switches[0]
+                  << ", \"hysteresis\": " << switches[1] << "},\n"
+                  << "  \"reversals\": {\"no_hysteresis\": " << reversals[0] << ", \"hysteresis\": " << reversals[1] << "},\n"
+                  << "  \"frames\": " << frames << ",\n  \"methods\": {";
+
+        double baseline = 0.0;
+        for (int method = 0; method < 2; method++)
+        {
+            std::vector<double> frameTimes;
+            std::vector<int> current(objects.size(), -1);
+            double triangles = 0.0;
+            for (int frame = 0; frame < warmupFrames + frames; frame++)
+            {
+                start = std::chrono::steady_clock::now();
+                glClear(GL_COLOR_BUFFER_BIT);
+                glm::vec3 eye = lodCamera(frame * 10);
+                glm::mat4 viewProjection = projection * glm::lookAt(eye, eye + glm::vec3(0.0f, -0.1f, -1.0f),
+                                                                    glm::vec3(0.0f, 1.0f, 0.0f));
+                plain.use();
+                glState().bindVertexArray(VAO);
+                for (size_t i = 0; i < objects.size(); i++)
+                {
+                    int level = 0;
+                    if (method == 1)
+                        level = current[i] = selectLod(lods, pixelsPerUnit / glm::length(objects[i] - eye), current[i]);
+                    const LodLevel &lod = lods.levels[level];
+                    plain.setMat4(transformLocation, glm::translate(viewProjection, objects[i]));
+                    glDrawElements(GL_TRIANGLES, (GLsizei)lod.indexCount, GL_UNSIGNED_INT,
+                                   (const void*)(lod.firstIndex * sizeof(unsigned int)));
+                    if (frame >= warmupFrames)
+                        triangles += lod.indexCount / 3;
+                }
+                glFinish();
+                if (frame >= warmupFrames)
+                    frameTimes.push_back(millisecondsSince(start));
+            }
+
+            FrameStats stats = summarize(frameTimes);
+            if (method == 0)
+                baseline = stats.median;
+            std::cout << (method ? ",\n" : "\n") << "    \"" << (method ? "lod" : "full_detail") << "\": {"
+                      << "\"triangles_per_frame\": " << triangles / frames
+                      << ", \"frame_ms_median\": " << stats.median << ", \"speedup\": " << baseline / stats.median << "}";
+        }
+        std::cout << "\n  }\n}\n";
+
+        glState().disable(GL_CULL_FACE);
+        glDeleteVertexArrays(1, &VAO);
+        glState().forgetVertexArray(VAO);
+        for (unsigned int buffer : {VBO, EBO})
+        {
+            glDeleteBuffers(1, &buffer);
+            glState().forgetBuffer(buffer);
+        }
+        return 0;
+    }
+
+    // the time from a file to a mesh in GPU buffers: OBJ and GLB import plus packing against mapping a .bmesh
+    // (plain and compressed), and how fast the compressed indices decode with and without AVX2
+    int benchMeshFormat(int iterations, const std::string &meshPath)
+    {
+        HeadlessContext context(64, 64);
+        std::filesystem::path directory = std::filesystem::temp_directory_path();
+        std::string objPath = (directory / "begin_opengl_bench_format.obj").string();
+        std::string glbPath = (directory / "begin_opengl_bench_format.glb").string();
+        std::string rawPath = (directory / "begin_opengl_bench_format.bmesh").string();
+        std::string packedPath = (directory / "begin_opengl_bench_format_compressed.bmesh").string();
+
+        std::vector<std::string> sources;
+        if (meshPath.empty())
+        {
+            writeGridMeshes(1024, 512, objPath, glbPath);
+            sources = {objPath, glbPath};
+        }
+        else
+        {
+            sources = {meshPath};
+        }
+        MeshData source = loadMesh(sources[0]);
+        MeshFileOptions options;
+        writeMeshFile(rawPath, source, options);
+        options.compress = true;
+        writeMeshFile(packedPath, source, options);
+
+        // the median of iterations loads, each ends with the buffers filled and the GPU done with them
+        auto timeLoads = [&](const std::string &path)
+        {
+            std::vector<double> samples;
+            for (int i = 0; i < iterations; i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                unsigned int VBO, VAO, EBO;
+                if (isMeshFile(path))
+                {
+                    MeshFile file(path);
+                    std::vector<unsigned int> decoded;
+                    const unsigned int *indices = file.indexData();
+                    if (!indices)
+                    {
+                        decoded = file.indices();
+                        indices = decoded.data();
+                    }
+                    loadBuffer(file.vertexData(), file.vertexBytes(), indices, file.indexBytes(), VBO, VAO, EBO, file.layout());
+                }
+                else
+                {
+                    MeshData mesh = loadMesh(path);
+                    std::vector<unsigned char> packed = packVertices(mesh, VertexLayout::standard());
+                    loadBuffer(packed.data(), packed.size(), mesh.indices.data(), mesh.indexBytes(), VBO, VAO, EBO);
+                }
+                glFinish();
+                samples.push_back(millisecondsSince(start));
+
+                glDeleteVertexArrays(1, &VAO);
+                glState().forgetVertexArray(VAO);
+                for (unsigned int buffer : {VBO, EBO})
+                {
+                    glDeleteBuffers(1, &buffer);
+                    glState().forgetBuffer(buffer);
+                }
+            }
+            return summarize(samples).median;
+        };
+
+        std::vector<std::string> paths = sources;
+        paths.push_back(rawPath);
+        paths.push_back(packedPath);
+        std::cout << "{\n  \"bench\": \"mesh_format\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"triangles\": " << source.triangleCount() << ",\n"
+                  << "  \"iterations\": " << iterations << ",\n  \"to_gpu\": {";
+        double objMs = 0.0;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            double ms = timeLoads(paths[i]);
+            if (i == 0)
+                objMs = ms;
+            std::cout << (i ? ",\n" : "\n") << "    \"" << std::filesystem::path(paths[i]).filename().string() << "\": {"
+                      << "\"file_bytes\": " << std::filesystem::file_size(paths[i]) << ", \"ms\": " << ms
+                      << ", \"speedup\": " << objMs / ms << "}";
+        }
+
+        MeshFile packed(packedPath);
+        std::vector<unsigned int> reference = MeshFile(rawPath).indices(), decoded(reference.size());
+        double decodeMs[2];
+        bool identical = true;
+        for (int simd = 0; simd < 2; simd++)
+        {
+            std::vector<double> samples;
+            for (int i = 0; i < std::max(iterations, 10); i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                packed.decodeIndices(decoded.data(), simd == 1);
+                samples.push_back(millisecondsSince(start));
+                identical = identical && decoded == reference;
+            }
+            decodeMs[simd] = summarize(samples).median;
+        }
+        double indexGB = reference.size() * sizeof(unsigned int) / 1e9;
+        std::cout << "\n  },\n  \"index_decode\": {\"encoded_bytes\": " << packed.header().sections[MeshFileIndices].size
+                  << ", \"decoded_bytes\": " << packed.indexBytes()
+                  << ", \"gb_per_s_scalar\": " << indexGB * 1000.0 / decodeMs[0]
+                  << ", \"gb_per_s_simd\": " << indexGB * 1000.0 / decodeMs[1]
+                  << ", \"simd\": " << (MeshFile::simdAvailable() ? "true" : "false")
+                  << ", \"identical\": " << (identical ? "true" : "false") << "}\n}\n";
+
+        for (const std::string &path : {objPath, glbPath, rawPath, packedPath})
+            std::filesystem::remove(path);
+        return 0;
+    }
+
+    // position, rotation and scale to world matrices, the way the render loop builds trans against TransformBatch
+    int benchTransforms(int iterations)
+    {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        std::cout << "{\n  \"bench\": \"transforms\",\n"
+                  << "  \"threads\": " << threadPool().threadCount() << ",\n"
+                  << "  \"simd\": " << (TransformBatch::simdAvailable() ? "true" : "false") << ",\n"
+                  << "  \"iterations\": " << iterations << ",\n  \"objects\": [";
+
+        const size_t counts[] = {1000, 100000, 1000000};
+        for (size_t c = 0; c < 3; c++)
+        {
+            size_t count = counts[c];
+            std::vector<glm::vec3> positions(count), scales(count);
+            std::vector<glm::quat> rotations(count);
+            TransformBatch batch;
+            for (size_t i = 0; i < count; i++)
+            {
+                positions[i] = glm::vec3(unit(random), unit(random), unit(random)) * 100.0f;
+                rotations[i] = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+                scales[i] = glm::vec3(1.0f + 0.5f * unit(random), 1.0f + 0.5f * unit(random), 1.0f + 0.5f * unit(random));
+                batch.add(positions[i], rotations[i], scales[i]);
+            }
+
+            std::vector<glm::mat4> reference(count), matrices(count);
+            auto time = [&](const std::function<void()> &body)
+            {
+                std::vector<double> samples;
+                for (int i = 0; i < iterations; i++)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    body();
+                    samples.push_back(millisecondsSince(start));
+                }
+                return summarize(samples).median;
+            };
+            auto maxError = [&]()
+            {
+                float largest = 0.0f;
+                for (size_t i = 0; i < count; i++)
+                {
+                    for (int column = 0; column < 4; column++)
+                    {
+                        glm::vec4 d = glm::abs(matrices[i][column] - reference[i][column]);
+                        largest = std::max(largest, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+                    }
+                }
+                return largest;
+            };
+
+            double glmMs = time([&]()
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    glm::mat4 trans = glm::translate(glm::mat4(1.0f), positions[i]);
+                    trans = trans * glm::mat4_cast(rotations[i]);
+                    reference[i] = glm::scale(trans, scales[i]);
+                }
+            });
+
+            struct Path { const char *name; std::function<void()> body; };
+            Path paths[] = {
+                {"soa_scalar", [&]() { batch.computeMatrices(matrices.data(), 0, count, false); }},
+                {"soa_simd", [&]() { batch.computeMatrices(matrices.data(), 0, count, true); }},
+                {"soa_simd_threads", [&]() { batch.computeMatrices(matrices.data(), true); }},
+            };
+
+            std::cout << (c ? ",\n" : "\n") << "    {\"count\": " << count
+                      << ", \"glm\": {\"ms\": " << glmMs << ", \"matrices_per_ms\": " << count / glmMs << "}";
+            for (const Path &path : paths)
+            {
+                double ms = time(path.body);
+                std::cout << ", \"" << path.name << "\": {\"ms\": " << ms << ", \"matrices_per_ms\": " << count / ms
+                          << ", \"speedup\": " << glmMs / ms << ", \"max_error\": " << maxError() << "}";
+            }
+            std::cout << "}";
+        }
+        std::cout << "\n  ]\n}\n";
+        return 0;
+    }
+
+    // every Mat4Kernels level against glm's scalar operators on the same data
+    int benchMat4(int iterations)
+    {
+        // small enough to stay in cache, so the kernels are timed and not the memory bus
+        const size_t matrixCount = 8192, vectorCount = 32768;
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        // rigid transforms with some scale, and a projection now and then so the last row is used too
+        std::vector<glm::mat4> a(matrixCount), b(matrixCount);
+        for (std::vector<glm::mat4> *matrices : {&a, &b})
+        {
+            for (size_t i = 0; i < matrixCount; i++)
+            {
+                glm::quat rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+                glm::vec3 scale(1.0f + 0.5f * unit(random), 1.0f + 0.5f * unit(random), 1.0f + 0.5f * unit(random));
+                (*matrices)[i] = composeTransform(glm::vec3(unit(random), unit(random), unit(random)) * 10.0f, rotation, scale);
+                if (i % 16 == 0)
+                    (*matrices)[i] = glm::perspective(1.0f, 1.5f, 0.1f, 100.0f) * (*matrices)[i];
+            }
+        }
+        std::vector<glm::vec4> vectors(vectorCount);
+        for (glm::vec4 &v : vectors)
+            v = glm::vec4(unit(random), unit(random), unit(random), 1.0f) * 10.0f;
+
+        auto time = [&](const std::function<void()> &body)
+        {
+            std::vector<double> samples;
+            for (int i = 0; i < iterations; i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                body();
+                samples.push_back(millisecondsSince(start));
+            }
+            return summarize(samples).median;
+        };
+        // largest difference relative to the element's size, the inverse of a projection has large ones
+        auto maxError = [](const float *x, const float *y, size_t floats)
+        {
+            float largest = 0.0f;
+            for (size_t i = 0; i < floats; i++)
+                largest = std::max(largest, std::abs(x[i] - y[i]) / std::max(1.0f, std::abs(y[i])));
+            return largest;
+        };
+
+        const glm::mat4 &view = b[1];
+        std::vector<glm::mat4> referenceProducts(matrixCount), referenceInverses(matrixCount), matrices(matrixCount);
+        std::vector<glm::vec4> referenceVectors(vectorCount), transformed(vectorCount);
+        const Mat4Kernels &scalar = *mat4Kernels(Mat4Scalar);
+        scalar.multiply(a.data(), b.data(), referenceProducts.data(), matrixCount);
+        scalar.transform(view, vectors.data(), referenceVectors.data(), vectorCount);
+        scalar.inverse(a.data(), referenceInverses.data(), matrixCount);
+        double scalarMs[3] = {};
+
+        std::cout << "{\n  \"bench\": \"mat4\",\n"
+                  << "  \"selected\": \"" << mat4Kernels().name << "\",\n"
+                  << "  \"matrices\": " << matrixCount << ",\n"
+                  << "  \"vectors\": " << vectorCount << ",\n"
+                  << "  \"iterations\": " << iterations << ",\n  \"levels\": {";
+        bool first = true;
+        for (int level = 0; level < Mat4KernelLevelCount; level++)
+        {
+            const Mat4Kernels *kernels = mat4Kernels((Mat4KernelLevel)level);
+            if (!kernels)
+                continue;
+            double ms[3] = {
+                time([&]() { kernels->multiply(a.data(), b.data(), matrices.data(), matrixCount); }),
+                time([&]() { kernels->transform(view, vectors.data(), transformed.data(), vectorCount); }),
+                0.0,
+            };
+            float errors[3] = {
+                maxError(&matrices[0][0][0], &referenceProducts[0][0][0], matrixCount * 16),
+                maxError(&transformed[0][0], &referenceVectors[0][0], vectorCount * 4),
+                0.0f,
+            };
+            ms[2] = time([&]() { kernels->inverse(a.data(), matrices.data(), matrixCount); });
+            errors[2] = maxError(&matrices[0][0][0], &referenceInverses[0][0][0], matrixCount * 16);
+            if (level == Mat4Scalar)
+                std::copy(ms, ms + 3, scalarMs);
+
+            const char *names[3] = {"multiply", "transform", "inverse"};
+            const size_t counts[3] = {matrixCount, vectorCount, matrixCount};
+            std::cout << (first ? "\n" : ",\n") << "    \"" << kernels->name << "\": {";
+            for (int op = 0; op < 3; op++)
+            {
+                std::cout << (op ? ", " : "") << "\"" << names[op] << "\": {\"ms\": " << ms[op]
+                          << ", \"per_ms\": " << counts[op] / ms[op] << ", \"speedup\": " << scalarMs[op] / ms[op]
+                          << ", \"max_error\": " << errors[op] << "}";
+            }
+            std::cout << "}";
+            first = false;
+        }
+        std::cout << "\n  }\n}\n";
+        return 0;
+    }
+
+    // objects scattered through a 1000 unit cube, seen from one face of it
+    int benchFrustum(int iterations)
+    {
+        glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+                                 * glm::lookAt(glm::vec3(0.0f, 0.0f, 500.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        std::mt19937 random(5);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f), size(0.5f, 3.0f);
+
+        auto time = [&](const std::function<size_t()> &body, size_t &visibleCount)
+        {
+            std::vector<double> samples;
+            for (int i = 0; i < iterations; i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                visibleCount = body();
+                samples.push_back(millisecondsSince(start));
+            }
+            return summarize(samples).median;
+        };
+
+        std::cout << "{\n  \"bench\": \"frustum\",\n"
+                  << "  \"threads\": " << threadPool().threadCount() << ",\n"
+                  << "  \"max_simd_width\": " << FrustumCuller::maxSimdWidth() << ",\n"
+                  << "  \"iterations\": " << iterations << ",\n  \"objects\": [";
+
+        const size_t counts[] = {1000000, 4000000};
+        for (size_t c = 0; c < 2; c++)
+        {
+            size_t count = counts[c];
+            // the way a renderer without a culler would keep them, one struct per object
+            struct ObjectBounds { glm::vec3 center; float radius; };
+            std::vector<ObjectBounds> objects(count);
+            FrustumCuller culler;
+            culler.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                glm::vec3 center(position(random), position(random), position(random));
+                glm::vec3 extent(size(random), size(random), size(random));
+                culler.setBox(i, center - extent, center + extent);
+                objects[i] = {center, glm::length(extent)};
+            }
+
+            std::vector<unsigned int> visible, reference;
+            size_t glmVisible = 0;
+            double glmMs = time([&]()
+            {
+                glm::vec4 planes[6];
+                extractFrustumPlanes(viewProjection, planes);
+                reference.clear();
+                for (size_t i = 0; i < count; i++)
+                {
+                    bool inside = true;
+                    for (int p = 0; p < 6 && inside; p++)
+                        inside = glm::dot(glm::vec3(planes[p]), objects[i].center) + planes[p].w >= -objects[i].radius;
+                    if (inside)
+                        reference.push_back((unsigned int)i);
+                }
+                return reference.size();
+            }, glmVisible);
+
+            std::cout << (c ? ",\n" : "\n") << "    {\"count\": " << count
+                      << ", \"glm_spheres\": {\"ms\": " << glmMs << ", \"objects_per_ms\": " << count / glmMs
+                      << ", \"visible\": " << glmVisible << "}";
+
+            struct Path { const char *name; int simdWidth; bool parallel; };
+            const Path paths[] = {{"scalar", 1, false}, {"sse", 4, false}, {"avx2", 8, false}, {"avx2_threads", 8, true}};
+            for (FrustumVolume volume : {FrustumSphere, FrustumBox})
+            {
+                std::vector<unsigned int> scalarVisible;
+                for (const Path &path : paths)
+                {
+                    if (path.simdWidth > FrustumCuller::maxSimdWidth())
+                        continue;
+                    FrustumCullOptions options;
+                    options.volume = volume;
+                    options.simdWidth = path.simdWidth;
+                    options.parallel = path.parallel;
+                    size_t visibleCount = 0;
+                    double ms = time([&]() { return culler.cull(viewProjection, visible, options); }, visibleCount);
+                    if (path.simdWidth == 1)
+                        scalarVisible = visible;
+
+                    std::cout << ", \"" << (volume == FrustumSphere ? "spheres_" : "boxes_") << path.name << "\": {"
+                              << "\"ms\": " << ms << ", \"objects_per_ms\": " << count / ms
+                              << ", \"speedup\": " << glmMs / ms << ", \"visible\": " << visibleCount
+                              << ", \"same_as_scalar\": " << (visible == scalarVisible ? "true" : "false") << "}";
+                }
+            }
+            std::cout << "}";
+        }
+        std::cout << "\n  ]\n}\n";
+        return 0;
+    }
+
+    // 64 roots with 4 children per node down to depth 6, updated as a tree of nodes and as TransformHierarchy
+    int benchHierarchy(int frames)
+    {
+        struct TreeNode
+        {
+            glm::vec3 position, scale;
+            glm::quat rotation;
+            glm::mat4 world;
+            std::vector<std::unique_ptr<TreeNode>> children;
+        };
+
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        TransformHierarchy flat;
+        std::vector<std::unique_ptr<TreeNode>> roots;
+        std::vector<TreeNode*> treeNodes;   // by flat node id
+
+        std::function<void(std::vector<std::unique_ptr<TreeNode>>&, unsigned int, int)> grow =
+            [&](std::vector<std::unique_ptr<TreeNode>> &siblings, unsigned int parent, int depth)
+        {
+            TreeNode *node = new TreeNode();
+            siblings.emplace_back(node);
+            node->position = glm::vec3(unit(random), unit(random), unit(random)) * 4.0f;
+            node->rotation = glm::angleAxis(unit(random) * 3.14f, glm::normalize(glm::vec3(unit(random), unit(random), 1.0f)));
+            node->scale = glm::vec3(1.0f + 0.1f * unit(random));
+            unsigned int id = flat.add(parent, node->position, node->rotation, node->scale);
+            treeNodes.push_back(node);
+            if (depth < 6)
+            {
+                for (int child = 0; child < 4; child++)
+                    grow(node->children, id, depth + 1);
+            }
+        };
+        for (int root = 0; root < 64; root++)
+            grow(roots, TransformHierarchy::noParent, 0);
+        size_t count = treeNodes.size();
+        flat.update();
+
+        std::function<void(TreeNode&, const glm::mat4&)> updateTree = [&](TreeNode &node, const glm::mat4 &parentWorld)
+        {
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), node.position) * glm::mat4_cast(node.rotation);
+            node.world = parentWorld * glm::scale(local, node.scale);
+            for (std::unique_ptr<TreeNode> &child : node.children)
+                updateTree(*child, node.world);
+        };
+
+        // the nodes that move every frame, a new rotation each
+        auto moving = [&](double fraction)
+        {
+            std::vector<unsigned int> ids(count);
+            for (size_t i = 0; i < count; i++)
+                ids[i] = (unsigned int)i;
+            std::shuffle(ids.begin(), ids.end(), random);
+            ids.resize((size_t)(count * fraction));
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+        auto spin = [](unsigned int id, int frame)
+        {
+            return glm::angleAxis(frame * 0.01f + id * 0.1f, glm::vec3(0.0f, 0.0f, 1.0f));
+        };
+
+        auto timeFrames = [&](const std::function<void(int)> &frame)
+        {
+            std::vector<double> samples;
+            for (int i = 0; i < frames; i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                frame(i);
+                samples.push_back(millisecondsSince(start));
+            }
+            return summarize(samples).median;
+        };
+
+        std::cout << "{\n  \"bench\": \"hierarchy\",\n"
+                  << "  \"nodes\": " << count << ",\n"
+                  << "  \"levels\": " << flat.levelCount() << ",\n"
+                  << "  \"threads\": " << threadPool().threadCount() << ",\n"
+                  << "  \"mat4_kernels\": \"" << mat4Kernels().name << "\",\n"
+                  << "  \"frames\": " << frames << ",\n  \"ms_per_frame\": {";
+
+        struct Case { const char *name; double fraction; };
+        const Case cases[] = {{"all", 1.0}, {"one_percent", 0.01}, {"none", 0.0}};
+        float largestError = 0.0f;
+        for (size_t c = 0; c < 3; c++)
+        {
+            std::vector<unsigned int> ids = moving(cases[c].fraction);
+            double treeMs = timeFrames([&](int frame)
+            {
+                for (unsigned int id : ids)
+                    treeNodes[id]->rotation = spin(id, frame);
+                for (std::unique_ptr<TreeNode> &root : roots)
+                    updateTree(*root, glm::mat4(1.0f));
+            });
+            double flatMs[2];
+            for (int parallel = 0; parallel < 2; parallel++)
+            {
+                flatMs[parallel] = timeFrames([&](int frame)
+                {
+                    for (unsigned int id : ids)
+                        flat.setRotation(id, spin(id, frame));
+                    flat.update(parallel == 1);
+                });
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                for (int column = 0; column < 4; column++)
+                {
+                    glm::vec4 d = glm::abs(flat.world((unsigned int)i)[column] - treeNodes[i]->world[column]);
+                    largestError = std::max(largestError, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+                }
+            }
+
+            std::cout << (c ? ",\n" : "\n") << "    \"" << cases[c].name << "\": {\"moving\": " << ids.size()
+                      << ", \"pointer_tree\": " << treeMs << ", \"flat\": " << flatMs[0]
+                      << ", \"flat_threads\": " << flatMs[1] << ", \"speedup\": " << treeMs / std::min(flatMs[0], flatMs[1]) << "}";
+        }
+        std::cout << "\n  },\n  \"max_error\": " << largestError << "\n}\n";
+        return 0;
+    }
+
+    // 64 joint characters blending a walk and a run clip: a glm loop (slerp, mat4 per joint) against
+    // the SoA sampler and dual quaternion skinning, then a crowd of them skinned on the GPU
+    int benchAnimation(int frames)
+    {
+        const size_t jointCount = 64;
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        // a tree of short bones, every joint hangs off one of the four before it
+        Skeleton skeleton;
+        std::vector<glm::vec3> bindPositions;
+        std::vector<glm::quat> bindRotations;
+        for (size_t j = 0; j < jointCount; j++)
+        {
+            unsigned int parent = j == 0 ? Skeleton::noParent : (unsigned int)(j - 1 - random() % std::min<size_t>(j, 4));
+            glm::vec3 position = j == 0 ? glm::vec3(0.0f) : glm::vec3(0.02f * unit(random), 0.05f, 0.02f * unit(random));
+            glm::quat rotation = glm::angleAxis(0.3f * unit(random), glm::normalize(glm::vec3(unit(random), unit(random), 1.0f)));
+            skeleton.addJoint(parent, position, rotation);
+            bindPositions.push_back(position);
+            bindRotations.push_back(rotation);
+        }
+
+        // every joint swings around its own axis, up to 70 degrees either way
+        auto makeClip = [&](size_t clipFrames, float amplitude)
+        {
+            AnimationClip clip(jointCount, clipFrames, 30.0f);
+            for (size_t j = 0; j < jointCount; j++)
+            {
+                glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)));
+                float phase = 3.14f * unit(random);
+                for (size_t f = 0; f < clipFrames; f++)
+                {
+                    float angle = amplitude * std::sin(6.2832f * f / clipFrames + phase);
+                    clip.setKey(f, j, bindPositions[j], bindRotations[j] * glm::angleAxis(angle, axis));
+                }
+            }
+            return clip;
+        };
+        AnimationClip walk = makeClip(32, 0.6f), run = makeClip(20, 1.2f);
+
+        // what the glm loop reads: array of structures keys and mat4 inverse binds
+        struct Keys { std::vector<glm::quat> rotations; std::vector<glm::vec3> positions; };
+        auto keysOf = [&](const AnimationClip &clip)
+        {
+            Keys keys;
+            for (size_t f = 0; f < clip.frameCount(); f++)
+            {
+                for (size_t j = 0; j < jointCount; j++)
+                {
+                    keys.rotations.push_back(clip.rotation(f, j));
+                    keys.positions.push_back(clip.position(f, j));
+                }
+            }
+            return keys;
+        };
+        Keys walkKeys = keysOf(walk), runKeys = keysOf(run);
+        std::vector<glm::mat4> inverseBindMatrices(jointCount);
+        {
+            std::vector<glm::mat4> bindModels(jointCount);
+            for (size_t j = 0; j < jointCount; j++)
+            {
+                glm::mat4 local = glm::translate(glm::mat4(1.0f), bindPositions[j]) * glm::mat4_cast(bindRotations[j]);
+                unsigned int parent = skeleton.parent((unsigned int)j);
+                bindModels[j] = parent == Skeleton::noParent ? local : bindModels[parent] * local;
+                inverseBindMatrices[j] = glm::inverse(bindModels[j]);
+            }
+        }
+
+        // character i: blend weight i / count, its own place in the clips, all moving on with time
+        auto characterTime = [](size_t character, int frame) { return character * 0.37f + frame / 60.0f; };
+        auto characterWeight = [](size_t character, size_t count) { return (float)character / count; };
+
+        auto sampleGlm = [&](const Keys &keys, const AnimationClip &clip, float time, size_t j, glm::quat &rotation,
+                             glm::vec3 &position)
+        {
+            float at = std::fmod(time * clip.framesPerSecond(), (float)clip.frameCount());
+            size_t first = (size_t)at, second = (first + 1) % clip.frameCount();
+            float t = at - first;
+            rotation = glm::slerp(keys.rotations[first * jointCount + j], keys.rotations[second * jointCount + j], t);
+            position = glm::mix(keys.positions[first * jointCount + j], keys.positions[second * jointCount + j], t);
+        };
+        std::vector<glm::mat4> models(jointCount);
+        auto animateGlm = [&](size_t count, int frame, std::vector<glm::mat4> &skin)
+        {
+            skin.resize(count * jointCount);
+            for (size_t c = 0; c < count; c++)
+            {
+                float time = characterTime(c, frame), weight = characterWeight(c, count);
+                for (size_t j = 0; j < jointCount; j++)
+                {
+                    glm::quat walkRotation, runRotation;
+                    glm::vec3 walkPosition, runPosition;
+                    sampleGlm(walkKeys, walk, time, j, walkRotation, walkPosition);
+                    sampleGlm(runKeys, run, time, j, runRotation, runPosition);
+                    glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::mix(walkPosition, runPosition, weight))
+                                    * glm::mat4_cast(glm::slerp(walkRotation, runRotation, weight));
+                    unsigned int parent = skeleton.parent((unsigned int)j);
+                    models[j] = parent == Skeleton::noParent ? local : models[parent] * local;
+                    skin[c * jointCount + j] = models[j] * inverseBindMatrices[j];
+                }
+            }
+        };
+
+        auto timeFrames = [&](int count, const std::function<void(int)> &frame)
+        {
+            std::vector<double> samples;
+            for (int i = 0; i < count; i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                frame(i);
+                samples.push_back(millisecondsSince(start));
+            }
+            return summarize(samples).median;
+        };
+
+        std::cout << "{\n  \"bench\": \"animation\",\n"
+                  << "  \"joints\": " << jointCount << ",\n"
+                  << "  \"threads\": " << threadPool().threadCount() << ",\n"
+                  << "  \"simd\": " << (AnimationSystem::simdAvailable() ? "true" : "false") << ",\n"
+                  << "  \"frames\": " << frames << ",\n  \"characters\": [";
+
+        const size_t counts[] = {100, 1000, 10000};
+        for (size_t n = 0; n < 3; n++)
+        {
+            size_t count = counts[n];
+            AnimationSystem crowd(skeleton);
+            for (size_t c = 0; c < count; c++)
+                crowd.addCharacter();
+            auto setTimes = [&](int frame)
+            {
+                for (size_t c = 0; c < count; c++)
+                    crowd.blend(c, walk, characterTime(c, frame), run, characterTime(c, frame), characterWeight(c, count));
+            };
+
+            std::vector<glm::mat4> reference;
+            double glmMs = timeFrames(frames, [&](int frame) { animateGlm(count, frame, reference); });
+
+            struct Path { const char *name; AnimationUpdateOptions options; };
+            Path paths[5];
+            paths[0].name = "soa_scalar";
+            paths[0].options.allowSimd = false;
+            paths[0].options.parallel = false;
+            paths[1].name = "soa_simd";
+            paths[1].options.parallel = false;
+            paths[2].name = "soa_simd_slerp";
+            paths[2].options.parallel = false;
+            paths[2].options.interpolation = AnimationSlerp;
+            paths[3].name = "soa_simd_matrices";
+            paths[3].options.parallel = false;
+            paths[3].options.output = SkinMatrices;
+            paths[4].name = "soa_simd_threads";
+
+            std::cout << (n ? ",\n" : "\n") << "    {\"count\": " << count
+                      << ", \"glm_slerp_mat4\": {\"ms\": " << glmMs << "}";
+            for (const Path &path : paths)
+            {
+                double ms = timeFrames(frames, [&](int frame)
+                {
+                    setTimes(frame);
+                    crowd.update(path.options);
+                });
+                std::cout << ", \"" << path.name << "\": {\"ms\": " << ms << ", \"speedup\": " << glmMs / ms << "}";
+            }
+
+            // the last frame of the glm loop again, the slerp matrices against it
+            setTimes(frames - 1);
+            AnimationUpdateOptions exact;
+            exact.interpolation = AnimationSlerp;
+            exact.output = SkinMatrices;
+            crowd.update(exact);
+            float largestError = 0.0f;
+            for (size_t i = 0; i < reference.size(); i++)
+            {
+                for (int column = 0; column < 4; column++)
+                {
+                    glm::vec4 d = glm::abs(crowd.matrices()[i][column] - reference[i][column]);
+                    largestError = std::max(largestError, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+                }
+            }
+            std::cout << ", \"slerp_max_error\": " << largestError << "}";
+        }
+
+        // a strip of 4 x 64 quads along the chain of joints, each vertex on the two nearest joints
+        const size_t characters = 1000;
+        HeadlessContext context(800, 600);
+        MeshData strip = gridMesh(4, 64);
+        std::vector<unsigned char> packed = packVertices(strip, VertexLayout::standard());
+        unsigned int VBO, VAO, EBO;
+        loadBuffer(packed.data(), packed.size(), strip.indices.data(), strip.indexBytes(), VBO, VAO, EBO);
+        GLsizei indexCount = (GLsizei)strip.indices.size();
+        std::vector<SkinVertex> skinVertices(strip.vertexCount());
+        for (size_t v = 0; v < skinVertices.size(); v++)
+        {
+            float along = (strip.vertices[v * MeshData::floatsPerVertex + 1] + 0.5f) * (jointCount - 1);
+            unsigned int joint = std::min((unsigned int)along, (unsigned int)jointCount - 2);
+            unsigned char weight = (unsigned char)std::lround((along - joint) * 255.0f);
+            skinVertices[v].joints[0] = (unsigned char)joint;
+            skinVertices[v].joints[1] = (unsigned char)(joint + 1);
+            skinVertices[v].weights[0] = (unsigned char)(255 - weight);
+            skinVertices[v].weights[1] = weight;
+        }
+        unsigned int weightBuffer = SkinBuffer::attachWeights(VAO, skinVertices.data(), skinVertices.size());
+        InstanceBuffer instances;
+        instances.attach(VAO);
+        std::vector<glm::mat4> placements;
+        layoutInstanceGrid(placements, characters, 0.0f);
+        instances.upload(placements.data(), characters);
+        SkinBuffer skin;
+
+        AnimationSystem crowd(skeleton);
+        for (size_t c = 0; c < characters; c++)
+            crowd.addCharacter();
+
+        std::cout << "\n  ],\n  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"gpu_characters\": " << characters << ",\n  \"gpu_skinning\": {";
+        for (int matrices = 0; matrices < 2; matrices++)
+        {
+            Shader shader("src/shaders/shader.vs", "src/shaders/shader.fs",
+                          InstanceBuffer::shaderDefines(false) + "\n" + SkinBuffer::shaderDefines(matrices == 1));
+            shader.use();
+            shader.setMat4(shader.uniform("transform"), glm::mat4(1.0f));
+            shader.setInt(shader.uniform("jointsPerInstance"), (int)jointCount);
+            AnimationUpdateOptions options;
+            options.output = matrices ? SkinMatrices : SkinDualQuaternions;
+
+            std::vector<double> animateTimes, uploadTimes;
+            double frameMs = timeFrames(frames, [&](int frame)
+            {
+                auto start = std::chrono::steady_clock::now();
+                for (size_t c = 0; c < characters; c++)
+                    crowd.blend(c, walk, characterTime(c, frame), run, characterTime(c, frame), characterWeight(c, characters));
+                crowd.update(options);
+                animateTimes.push_back(millisecondsSince(start));
+
+                auto uploadStart = std::chrono::steady_clock::now();
+                if (matrices)
+                    skin.upload(crowd.matrices().data(), crowd.matrices().size());
+                else
+                    skin.upload(crowd.dualQuaternions().data(), crowd.dualQuaternions().size());
+                uploadTimes.push_back(millisecondsSince(uploadStart));
+
+                glClear(GL_COLOR_BUFFER_BIT);
+                skin.bind();
+                instances.draw(VAO, indexCount);
+                glFinish();
+            });
+            std::cout << (matrices ? ",\n" : "\n") << "    \"" << (matrices ? "matrices" : "dual_quaternions")
+                      << "\": {\"bytes_per_frame\": " << skin.bytes() << ", \"animate_ms\": " << summarize(animateTimes).median
+                      << ", \"upload_ms\": " << summarize(uploadTimes).median << ", \"frame_ms\": " << frameMs
+                      << ", \"gl_error\": " << glGetError() << "}";
+        }
+        std::cout << "\n  }\n}\n";
+
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &weightBuffer);
+        glState().forgetVertexArray(VAO);
+        glState().forgetBuffer(VBO);
+        glState().forgetBuffer(EBO);
+        glState().forgetBuffer(weightBuffer);
+        return 0;
+    }
+
+    // the demo scene at 800x600 with nothing pacing it, glFinish stands in for the buffer swap
+    // so each sample is the full CPU + GPU time of one frame
+    int benchFrames(int frames, bool profiling, const std::string &tracePath, const std::string &meshPath,
+                    bool compactVertices, int instanceCount, bool buildLods)
+    {
+        const int warmupFrames = 10;
+        HeadlessContext context(800, 600);
+        Scene scene(meshPath, compactVertices, instanceCount, buildLods);
+
+        // every measured frame should draw the real textures, not the placeholders
+        scene.textures.finish();
+
+        // the profiler costs a few queries per stage, so it is only there when asked for
+        FrameProfiler profiler(true, frames);
+        FrameProfiler *activeProfiler = profiling ? &profiler : nullptr;
+        profiler.setTraceCapture(!tracePath.empty());
+
+        std::vector<double> frameTimes;
+        frameTimes.reserve(frames);
+        StateCallStats setupStats = glState().stats();
+        glState().resetStats();
+        for (int frame = 0; frame < warmupFrames + frames; frame++)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            if (activeProfiler)
+                activeProfiler->beginFrame();
+
+            // fixed time step, every run draws exactly the same frames
+            scene.draw(frame / 60.0f, activeProfiler);
+            {
+                ProfileScope scope(activeProfiler, "finish");
+                glFinish();
+            }
+
+            if (activeProfiler)
+                activeProfiler->endFrame();
+
+            if (frame >= warmupFrames)
+                frameTimes.push_back(millisecondsSince(start));
+        }
+
+        FrameStats stats = summarize(frameTimes);
+        std::cout << "{\n  \"bench\": \"frames\",\n"
+                  << "  \"renderer\": \"" << context.description() << "\",\n"
+                  << "  \"width\": " << context.width << ",\n"
+                  << "  \"height\": " << context.height << ",\n"
+                  << "  \"frames\": " << frames << ",\n"
+                  << "  \"frame_ms\": {\"min\": " << stats.min
+                  << ", \"median\": " << stats.median
+                  << ", \"p99\": " << stats.p99
+                  << ", \"max\": " << stats.max
+                  << ", \"mean\": " << stats.mean << "}";
+
+        // what the state cache did per frame, warmup included
+        const StateCallStats &stateStats = glState().stats();
+        int drawnFrames = warmupFrames + frames;
+        std::cout << ",\n  \"state_calls_per_frame\": {\"issued\": " << (double)stateStats.totalIssued() / drawnFrames
+                  << ", \"skipped\": " << (double)stateStats.totalSkipped() / drawnFrames;
+        for (int call = 0; call < STATE_CALL_COUNT; call++)
+        {
+            if (stateStats.issued[call] + stateStats.skipped[call] > 0)
+                std::cout << ", \"" << StateCallStats::name(call) << "\": [" << (double)stateStats.issued[call] / drawnFrames
+                          << ", " << (double)stateStats.skipped[call] / drawnFrames << "]";
+        }
+        std::cout << "},\n  \"state_calls_setup\": {\"issued\": " << setupStats.totalIssued()
+                  << ", \"skipped\": " << setupStats.totalSkipped() << "}";
+
+        TextureCacheStats textureStats = scene.textures.stats();
+        std::cout << ",\n  \"texture_cache\": {\"textures\": " << textureStats.textures
+                  << ", \"resident_bytes\": " << textureStats.residentBytes
+                  << ", \"budget_bytes\": " << textureStats.budgetBytes
+                  << ", \"hits\": " << textureStats.hits << ", \"misses\": " << textureStats.misses
+                  << ", \"content_duplicates\": " << textureStats.contentDuplicates
+                  << ", \"evictions\": " << textureStats.evictions << "}";
+
+        if (activeProfiler)
+        {
+            if (!tracePath.empty())
+                profiler.writeChromeTrace(tracePath);
+
+            std::cout << ",\n  \"stages_ms\": {";
+            std::vector<StageStats> stages = profiler.stageStats();
+            for (size_t i = 0; i < stages.size(); i++)
+            {
+                std::cout << (i ? ",\n" : "\n") << "    \"" << stages[i].name << "\": {"
+                          << "\"cpu_avg\": " << stages[i].cpuAverage << ", \"cpu_max\": " << stages[i].cpuMax
+                          << ", \"gpu_avg\": " << stages[i].gpuAverage << ", \"gpu_max\": " << stages[i].gpuMax << "}";
+            }
+            std::cout << "\n  },\n  \"gpu_frames_dropped\": " << profiler.gpuFramesDropped();
+        }
+        std::cout << "\n}\n";
+        return 0;
+    }
+}
+
+int runBenchmark(int argc, char** argv)
+{
+    std::string mode = argv[1];
+    int frames = argc > 2 && std::isdigit((unsigned char)argv[2][0]) ? std::stoi(argv[2]) : 0;
+    std::string tracePath = flagValue(argc, argv, "--trace");
+    bool profiling = hasFlag(argc, argv, "--profile") || !tracePath.empty();
+    TextureLoader::setParallelJpegDecode(hasFlag(argc, argv, "--parallel-jpeg"));
+
+    try
+    {
+        if (mode == "--bench")
+            return benchFrames(frames > 0 ? frames : 1000, profiling, tracePath, flagValue(argc, argv, "--mesh"),
+                               hasFlag(argc, argv, "--compact-vertices"), countFlagValue(argc, argv, "--instances"),
+                               hasFlag(argc, argv, "--lod"));
+        if (mode == "--bench-uniforms")
+            return benchUniforms(frames > 0 ? frames : 10000);
+        if (mode == "--bench-jpeg")
+        {
+            std::string image = flagValue(argc, argv, "--image");
+            return benchJpeg(frames > 0 ? frames : 200, image.empty() ? "textures/container.jpg" : image,
+                             hasFlag(argc, argv, "--parallel-jpeg"));
+        }
+        if (mode == "--bench-png")
+        {
+            std::string image = flagValue(argc, argv, "--image");
+            return benchPng(frames > 0 ? frames : 200, image.empty() ? "textures/awesomeface.png" : image);
+        }
+        if (mode == "--bench-vertex-formats")
+            return benchVertexFormats(frames > 0 ? frames : 50, flagValue(argc, argv, "--mesh"));
+        if (mode == "--bench-mesh-optimize")
+            return benchMeshOptimize(flagValue(argc, argv, "--mesh"));
+        if (mode == "--bench-instances")
+            return benchInstances(frames > 0 ? frames : 10);
+        if (mode == "--bench-stream")
+            return benchStream(frames > 0 ? frames : 60);
+        if (mode == "--bench-multi-draw")
+            return benchMultiDraw(frames > 0 ? frames : 20);
+        if (mode == "--bench-pool")
+            return benchPool(frames > 0 ? frames : 100);
+        if (mode == "--bench-meshlets")
+            return benchMeshlets(frames > 0 ? frames : 20, flagValue(argc, argv, "--mesh"));
+        if (mode == "--bench-lod")
+            return benchLod(frames > 0 ? frames : 10, flagValue(argc, argv, "--mesh"));
+        if (mode == "--bench-mesh-format")
+            return benchMeshFormat(frames > 0 ? frames : 5, flagValue(argc, argv, "--mesh"));
+        if (mode == "--bench-transforms")
+            return benchTransforms(frames > 0 ? frames : 20);
+        if (mode == "--bench-mat4")
+            return benchMat4(frames > 0 ? frames : 200);
+        if (mode == "--bench-frustum")
+            return benchFrustum(frames > 0 ? frames : 10);
+        if (mode == "--bench-hierarchy")
+            return benchHierarchy(frames > 0 ? frames : 20);
+        if (mode == "--bench-animation")
+            return benchAnimation(frames > 0 ? frames : 20);
+        if (mode == "--bench-mesh")
+            return benchMesh(frames > 0 ? frames : 5, flagValue(argc, argv, "--mesh"));
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cerr << "Error : " << e.what() << "\n";
+        return 1;
+    }
+
+    std::cerr << "Unknown benchmark " << mode << "\n";
+    return 1;
+}
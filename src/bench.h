@@ -0,0 +1,7 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// entry point for every "--bench..." command line mode, returns the process exit code
+int runBenchmark(int argc, char** argv);
+
+#endif
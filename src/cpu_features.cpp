@@ -0,0 +1,63 @@
+#include "cpu_features.h"
+
+#if defined(CPU_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace
+{
+    struct CpuFeatures
+    {
+        bool avx = false;
+        bool avx2 = false;
+        bool fma = false;
+
+        CpuFeatures()
+        {
+#if defined(CPU_X86) && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            int leaves = info[0];
+            // the OS has to save the ymm registers too (OSXSAVE + AVX, then XCR0 bits 1 and 2)
+            __cpuid(info, 1);
+            if ((info[2] & 0x18000000) != 0x18000000 || (_xgetbv(0) & 6) != 6)
+                return;
+            avx = true;
+            if (leaves < 7)
+                return;
+            bool fmaBit = (info[2] >> 12) & 1;
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] >> 5) & 1;
+            fma = avx2 && fmaBit;
+#elif defined(CPU_X86)
+            __builtin_cpu_init();
+            avx = __builtin_cpu_supports("avx");
+            avx2 = avx && __builtin_cpu_supports("avx2");
+            fma = avx2 && __builtin_cpu_supports("fma");
+#endif
+        }
+    };
+
+    const CpuFeatures &features()
+    {
+        static CpuFeatures detected;
+        return detected;
+    }
+}
+
+
+bool cpuHasAvx()
+{
+    return features().avx;
+}
+
+bool cpuHasAvx2()
+{
+    return features().avx2;
+}
+
+bool cpuHasFma()
+{
+    return features().fma;
+}
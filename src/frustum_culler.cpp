@@ -0,0 +1,306 @@
+#include "frustum_culler.h"
+#include "thread_pool.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FRUSTUM_SSE 1
+#endif
+
+
+namespace
+{
+    const size_t chunkObjects = 16384;
+
+    struct Columns
+    {
+        const float *centerX, *centerY, *centerZ, *radius;
+        const float *extentX, *extentY, *extentZ;
+    };
+
+    // the kernels test [begin, end) and write the indices of the visible objects from out on,
+    // returning how many. begin is a multiple of 8, out has room for end - begin rounded up to 8
+    typedef size_t (*CullKernel)(const Columns &columns, size_t begin, size_t end, const glm::vec4 planes[6],
+                                 FrustumVolume volume, unsigned int *out);
+
+    size_t cullScalar(const Columns &c, size_t begin, size_t end, const glm::vec4 planes[6], FrustumVolume volume,
+                      unsigned int *out)
+    {
+        size_t found = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            bool outside = false;
+            for (int p = 0; p < 6; p++)
+            {
+                const glm::vec4 &plane = planes[p];
+                float d = plane.x * c.centerX[i] + (plane.y * c.centerY[i] + (plane.z * c.centerZ[i] + plane.w));
+                float reach = volume == FrustumSphere ? c.radius[i]
+                    : std::abs(plane.x) * c.extentX[i] + (std::abs(plane.y) * c.extentY[i] + std::abs(plane.z) * c.extentZ[i]);
+                outside = outside || d < -reach;
+            }
+            out[found] = (unsigned int)i;
+            found += !outside;
+        }
+        return found;
+    }
+
+#ifdef FRUSTUM_SSE
+    size_t cullSse(const Columns &c, size_t begin, size_t end, const glm::vec4 planes[6], FrustumVolume volume,
+                   unsigned int *out)
+    {
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        __m128 nx[6], ny[6], nz[6], nw[6];
+        for (int p = 0; p < 6; p++)
+        {
+            nx[p] = _mm_set1_ps(planes[p].x);
+            ny[p] = _mm_set1_ps(planes[p].y);
+            nz[p] = _mm_set1_ps(planes[p].z);
+            nw[p] = _mm_set1_ps(planes[p].w);
+        }
+
+        size_t found = 0;
+        for (size_t i = begin; i < end; i += 4)
+        {
+            __m128 cx = _mm_loadu_ps(c.centerX + i), cy = _mm_loadu_ps(c.centerY + i), cz = _mm_loadu_ps(c.centerZ + i);
+            __m128 outside = _mm_setzero_ps();
+            if (volume == FrustumSphere)
+            {
+                __m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(c.radius + i), signBit);
+                for (int p = 0; p < 6; p++)
+                {
+                    __m128 d = _mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_add_ps(_mm_mul_ps(ny[p], cy),
+                               _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p])));
+                    outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negativeRadius));
+                }
+            }
+            else
+            {
+                __m128 ex = _mm_loadu_ps(c.extentX + i), ey = _mm_loadu_ps(c.extentY + i), ez = _mm_loadu_ps(c.extentZ + i);
+                for (int p = 0; p < 6; p++)
+                {
+                    __m128 d = _mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_add_ps(_mm_mul_ps(ny[p], cy),
+                               _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p])));
+                    __m128 reach = _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signBit, nx[p]), ex),
+                                   _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signBit, ny[p]), ey),
+                                              _mm_mul_ps(_mm_andnot_ps(signBit, nz[p]), ez)));
+                    outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_xor_ps(reach, signBit)));
+                }
+            }
+
+            unsigned int keep = ~(unsigned int)_mm_movemask_ps(outside) & 0xFu;
+            if (end - i < 4)
+                keep &= (1u << (end - i)) - 1;
+            for (unsigned int lane = 0; lane < 4; lane++)
+            {
+                out[found] = (unsigned int)(i + lane);
+                found += (keep >> lane) & 1;
+            }
+        }
+        return found;
+    }
+#endif
+
+#ifdef CPU_X86
+    // for every 8 bit lane mask, the set lanes' numbers packed 4 bits each from the bottom, and how many
+    struct LeftPackTable
+    {
+        uint32_t lanes[256];
+        unsigned char count[256];
+
+        LeftPackTable()
+        {
+            for (unsigned int mask = 0; mask < 256; mask++)
+            {
+                lanes[mask] = 0;
+                count[mask] = 0;
+                for (unsigned int lane = 0; lane < 8; lane++)
+                {
+                    if (mask & (1u << lane))
+                        lanes[mask] |= lane << (4 * count[mask]++);
+                }
+            }
+        }
+    };
+
+    const LeftPackTable &leftPackTable()
+    {
+        static LeftPackTable table;
+        return table;
+    }
+
+    CPU_TARGET_AVX2_FMA
+    size_t cullAvx2(const Columns &c, size_t begin, size_t end, const glm::vec4 planes[6], FrustumVolume volume,
+                    unsigned int *out)
+    {
+        const LeftPackTable &table = leftPackTable();
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        const __m256i nibbleShifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28), seven = _mm256_set1_epi32(7);
+
+        __m256 nx[6], ny[6], nz[6], nw[6];
+        for (int p = 0; p < 6; p++)
+        {
+            nx[p] = _mm256_set1_ps(planes[p].x);
+            ny[p] = _mm256_set1_ps(planes[p].y);
+            nz[p] = _mm256_set1_ps(planes[p].z);
+            nw[p] = _mm256_set1_ps(planes[p].w);
+        }
+
+        size_t found = 0;
+        for (size_t i = begin; i < end; i += 8)
+        {
+            __m256 cx = _mm256_loadu_ps(c.centerX + i), cy = _mm256_loadu_ps(c.centerY + i), cz = _mm256_loadu_ps(c.centerZ + i);
+            __m256 outside = _mm256_setzero_ps();
+            if (volume == FrustumSphere)
+            {
+                __m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(c.radius + i), signBit);
+                for (int p = 0; p < 6; p++)
+                {
+                    __m256 d = _mm256_fmadd_ps(nx[p], cx, _mm256_fmadd_ps(ny[p], cy, _mm256_fmadd_ps(nz[p], cz, nw[p])));
+                    outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, negativeRadius, _CMP_LT_OQ));
+                }
+            }
+            else
+            {
+                __m256 ex = _mm256_loadu_ps(c.extentX + i), ey = _mm256_loadu_ps(c.extentY + i), ez = _mm256_loadu_ps(c.extentZ + i);
+                for (int p = 0; p < 6; p++)
+                {
+                    __m256 d = _mm256_fmadd_ps(nx[p], cx, _mm256_fmadd_ps(ny[p], cy, _mm256_fmadd_ps(nz[p], cz, nw[p])));
+                    __m256 reach = _mm256_fmadd_ps(_mm256_andnot_ps(signBit, nx[p]), ex,
+                                   _mm256_fmadd_ps(_mm256_andnot_ps(signBit, ny[p]), ey,
+                                                   _mm256_mul_ps(_mm256_andnot_ps(signBit, nz[p]), ez)));
+                    outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, _mm256_xor_ps(reach, signBit), _CMP_LT_OQ));
+                }
+            }
+
+            unsigned int keep = ~(unsigned int)_mm256_movemask_ps(outside) & 0xFFu;
+            if (end - i < 8)
+                keep &= (1u << (end - i)) - 1;
+            // the visible lanes' indices moved to the front, all 8 are stored and the rest overwritten next step
+            __m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)table.lanes[keep]), nibbleShifts), seven);
+            _mm256_storeu_si256((__m256i*)(out + found), _mm256_add_epi32(lanes, _mm256_set1_epi32((int)i)));
+            found += table.count[keep];
+        }
+        return found;
+    }
+#endif
+}
+
+void extractFrustumPlanes(const glm::mat4 &m, glm::vec4 planes[6])
+{
+    // Gribb/Hartmann, glm is column major so row i is m[0][i], m[1][i], ...
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    planes[0] = rows[3] + rows[0];   // left
+    planes[1] = rows[3] - rows[0];   // right
+    planes[2] = rows[3] + rows[1];   // bottom
+    planes[3] = rows[3] - rows[1];   // top
+    planes[4] = rows[3] + rows[2];   // near
+    planes[5] = rows[3] - rows[2];   // far
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+void FrustumCuller::resize(size_t newCount)
+{
+    size_t padded = (newCount + 7) & ~(size_t)7;
+    for (std::vector<float> *column : {&centerX, &centerY, &centerZ, &radius, &extentX, &extentY, &extentZ})
+    {
+        column->resize(padded, 0.0f);
+        // lanes that were past the end before may still hold an old object
+        if (newCount > count)
+            std::fill(column->begin() + count, column->begin() + newCount, 0.0f);
+    }
+    count = newCount;
+}
+
+void FrustumCuller::setSphere(size_t i, const glm::vec3 &center, float sphereRadius)
+{
+    centerX[i] = center.x;
+    centerY[i] = center.y;
+    centerZ[i] = center.z;
+    radius[i] = sphereRadius;
+    extentX[i] = extentY[i] = extentZ[i] = sphereRadius;
+}
+
+void FrustumCuller::setBox(size_t i, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+{
+    glm::vec3 center = (boxMin + boxMax) * 0.5f, extent = (boxMax - boxMin) * 0.5f;
+    centerX[i] = center.x;
+    centerY[i] = center.y;
+    centerZ[i] = center.z;
+    radius[i] = glm::length(extent);
+    extentX[i] = extent.x;
+    extentY[i] = extent.y;
+    extentZ[i] = extent.z;
+}
+
+int FrustumCuller::maxSimdWidth()
+{
+#ifdef CPU_X86
+    if (cpuHasAvx2() && cpuHasFma())
+        return 8;
+#endif
+#ifdef FRUSTUM_SSE
+    return 4;
+#else
+    return 1;
+#endif
+}
+
+size_t FrustumCuller::cull(const glm::mat4 &viewProjection, std::vector<unsigned int> &visible,
+                           const FrustumCullOptions &options) const
+{
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+
+    CullKernel kernel = cullScalar;
+    int width = std::min(options.simdWidth, maxSimdWidth());
+#ifdef CPU_X86
+    if (width >= 8)
+        kernel = cullAvx2;
+#endif
+#ifdef FRUSTUM_SSE
+    if (width >= 4 && width < 8)
+        kernel = cullSse;
+#endif
+
+    Columns columns = {centerX.data(), centerY.data(), centerZ.data(), radius.data(),
+                       extentX.data(), extentY.data(), extentZ.data()};
+    size_t chunks = (count + chunkObjects - 1) / chunkObjects;
+    std::vector<size_t> found(chunks);
+    visible.resize(centerX.size());
+
+    auto run = [&](int first, int last)
+    {
+        for (int chunk = first; chunk < last; chunk++)
+        {
+            size_t begin = chunk * chunkObjects, end = std::min(begin + chunkObjects, count);
+            found[chunk] = kernel(columns, begin, end, planes, options.volume, visible.data() + begin);
+        }
+    };
+    if (options.parallel && chunks > 1)
+        threadPool().parallelFor((int)chunks, run);
+    else
+        run(0, (int)chunks);
+
+    // every chunk compacted into the start of its own range, close the gaps
+    size_t total = 0;
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        if (total != chunk * chunkObjects)
+            std::memmove(visible.data() + total, visible.data() + chunk * chunkObjects, found[chunk] * sizeof(unsigned int));
+        total += found[chunk];
+    }
+    visible.resize(total);
+    return total;
+}
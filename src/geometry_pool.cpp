@@ -0,0 +1,249 @@
+#include "geometry_pool.h"
+#include "mesh_loader.h"
+#include "stream_ring.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <stdexcept>
+#include <string>
+
+
+GeometryPool::GeometryPool(const VertexLayout &layout, uint32_t maxVertices, uint32_t maxIndices)
+    : VAO(0), VBO(0), EBO(0), vertexLayout(layout), vertexRanges(maxVertices), indexRanges(maxIndices)
+{
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    // same steps as loadBuffer, only the data comes later
+    glState().bindVertexArray(VAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)maxVertices * vertexLayout.stride(), nullptr, GL_STATIC_DRAW);
+    vertexLayout.apply();
+
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)maxIndices * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+}
+
+GeometryPool::~GeometryPool()
+{
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glState().forgetVertexArray(VAO);
+    glState().forgetBuffer(VBO);
+    glState().forgetBuffer(EBO);
+}
+
+MeshHandle GeometryPool::add(const MeshData &mesh)
+{
+    std::vector<unsigned char> packed = packVertices(mesh, vertexLayout);
+    return add(packed.data(), mesh.vertexCount(), mesh.indices.data(), mesh.indices.size());
+}
+
+MeshHandle GeometryPool::add(const void *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount)
+{
+    RangeAllocation vertexRange = vertexRanges.allocate((uint32_t)vertexCount);
+    RangeAllocation indexRange = indexRanges.allocate((uint32_t)indexCount);
+    if (!vertexRange.valid() || !indexRange.valid())
+    {
+        vertexRanges.free(vertexRange);
+        indexRanges.free(indexRange);
+        throw std::runtime_error("GeometryPool full: " + std::to_string(vertexCount) + " vertices / " +
+                                 std::to_string(indexCount) + " indices don't fit");
+    }
+
+    Entry entry;
+    entry.mesh.firstIndex = indexRange.offset;
+    entry.mesh.indexCount = (unsigned int)indexCount;
+    entry.mesh.baseVertex = (int)vertexRange.offset;
+    entry.mesh.vertexCount = (unsigned int)vertexCount;
+    entry.vertices = vertexRange;
+    entry.indices = indexRange;
+    entry.live = true;
+
+    // the element buffer is VAO state, binding the VAO first keeps the pool's attached
+    size_t stride = vertexLayout.stride();
+    glState().bindVertexArray(VAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, vertexRange.offset * stride, vertexCount * stride, vertices);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexRange.offset * sizeof(unsigned int), indexCount * sizeof(unsigned int),
+                    indices);
+
+    MeshHandle handle;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        entries[handle] = entry;
+    }
+    else
+    {
+        handle = (MeshHandle)entries.size();
+        entries.push_back(entry);
+    }
+    meshCount++;
+    return handle;
+}
+
+void GeometryPool::remove(MeshHandle mesh)
+{
+    Entry &entry = entries[mesh];
+    if (!entry.live)
+        return;
+    vertexRanges.free(entry.vertices);
+    indexRanges.free(entry.indices);
+    entry.live = false;
+    freeHandles.push_back(mesh);
+    meshCount--;
+}
+
+size_t GeometryPool::compact(bool vertexArena, size_t byteBudget)
+{
+    RangeAllocator &ranges = vertexArena ? vertexRanges : indexRanges;
+    size_t unitSize = vertexArena ? vertexLayout.stride() : sizeof(unsigned int);
+    unsigned int buffer = vertexArena ? VBO : EBO;
+
+    // one hole (or none) left means everything already sits at the bottom
+    if (ranges.stats().freeRanges <= 1)
+        return 0;
+
+    // highest first, every one moved away joins the free space above it
+    std::vector<std::pair<uint32_t, MeshHandle>> byOffset;
+    for (MeshHandle handle = 0; handle < entries.size(); handle++)
+    {
+        if (entries[handle].live)
+            byOffset.push_back({(vertexArena ? entries[handle].vertices : entries[handle].indices).offset, handle});
+    }
+    std::sort(byOffset.begin(), byOffset.end(), std::greater<std::pair<uint32_t, MeshHandle>>());
+
+    // the same buffer on both copy bindings, glCopyBufferSubData allows that for ranges that don't overlap
+    glState().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+    size_t moved = 0;
+    for (const auto &candidate : byOffset)
+    {
+        if (moved >= byteBudget)
+            break;
+
+        Entry &entry = entries[candidate.second];
+        RangeAllocation &current = vertexArena ? entry.vertices : entry.indices;
+        uint32_t size = ranges.sizeOf(current);
+
+        // the old range is still taken, so the new one can't overlap it. once a mesh can't go lower
+        // the ones below it would only open holes under it, not grow the free space at the top
+        RangeAllocation target = ranges.allocate(size);
+        if (!target.valid() || target.offset > current.offset)
+        {
+            ranges.free(target);
+            continue;
+        }
+
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, current.offset * unitSize,
+                            target.offset * unitSize, size * unitSize);
+        ranges.free(current);
+        current = target;
+        if (vertexArena)
+            entry.mesh.baseVertex = (int)target.offset;
+        else
+            entry.mesh.firstIndex = target.offset;
+        moved += size * unitSize;
+    }
+    return moved;
+}
+
+size_t GeometryPool::defragment(size_t byteBudget)
+{
+    size_t moved = compact(true, byteBudget);
+    moved += compact(false, byteBudget > moved ? byteBudget - moved : 0);
+    totalMoved += moved;
+    return moved;
+}
+
+GeometryPoolStats GeometryPool::stats() const
+{
+    GeometryPoolStats stats;
+    stats.vertices = vertexRanges.stats();
+    stats.indices = indexRanges.stats();
+    stats.meshes = meshCount;
+    stats.bytesMoved = totalMoved;
+    return stats;
+}
+
+std::string GeometryPool::shaderDefines()
+{
+    return "#define MULTI_DRAW";
+}
+
+
+MultiDrawBatch::MultiDrawBatch(GeometryPool &pool)
+    : pool(pool)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    storageAlignment = (size_t)alignment;
+}
+
+void MultiDrawBatch::add(unsigned int bucket, MeshHandle mesh, const glm::mat4 &transform)
+{
+    draws.push_back({bucket, mesh, transform});
+}
+
+void MultiDrawBatch::clear()
+{
+    draws.clear();
+}
+
+int MultiDrawBatch::submit(StreamRing &ring, const std::function<void(unsigned int bucket)> &bindBucket)
+{
+    if (draws.empty())
+        return 0;
+
+    // stable, so draws keep the order they were added in within a bucket
+    order.resize(draws.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (unsigned int)i;
+    std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+    {
+        return draws[a].bucket < draws[b].bucket;
+    });
+
+    int calls = 0;
+    size_t first = 0;
+    while (first < order.size())
+    {
+        unsigned int bucket = draws[order[first]].bucket;
+        size_t last = first;
+        while (last < order.size() && draws[order[last]].bucket == bucket)
+            last++;
+        size_t drawCount = last - first;
+
+        // gl_DrawID restarts at 0 every call, so each bucket gets a transform range of its own
+        StreamAllocation commandBlock = ring.allocate(drawCount * sizeof(DrawElementsIndirectCommand), 4);
+        StreamAllocation transformBlock = ring.allocate(drawCount * sizeof(glm::mat4), storageAlignment);
+        DrawElementsIndirectCommand *commands = (DrawElementsIndirectCommand*)commandBlock.data;
+        glm::mat4 *transforms = (glm::mat4*)transformBlock.data;
+        for (size_t i = 0; i < drawCount; i++)
+        {
+            const Draw &draw = draws[order[first + i]];
+            const PoolMesh &mesh = pool.mesh(draw.mesh);
+            commands[i] = {mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex, 0};
+            transforms[i] = draw.transform;
+        }
+
+        // after the callback, whatever it binds the pool's vertex array is what gets drawn
+        bindBucket(bucket);
+        glState().bindVertexArray(pool.VAO);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.buffer);
+        glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, transformBinding, ring.buffer, transformBlock.offset,
+                                  transformBlock.size);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandBlock.offset, (GLsizei)drawCount, 0);
+        calls++;
+        first = last;
+    }
+    return calls;
+}
@@ -0,0 +1,317 @@
+#include "gl_state.h"
+
+
+long StateCallStats::totalIssued() const
+{
+    long total = 0;
+    for (long value : issued)
+        total += value;
+    return total;
+}
+
+long StateCallStats::totalSkipped() const
+{
+    long total = 0;
+    for (long value : skipped)
+        total += value;
+    return total;
+}
+
+const char* StateCallStats::name(int call)
+{
+    static const char* names[STATE_CALL_COUNT] = {
+        "program", "vertex_array", "buffer", "active_texture", "texture",
+        "sampler", "capability", "blend_func", "depth_func", "depth_mask"
+    };
+    return call >= 0 && call < STATE_CALL_COUNT ? names[call] : "unknown";
+}
+
+
+GLStateCache::GLStateCache()
+{
+    invalidate();
+}
+
+void GLStateCache::invalidate()
+{
+    program = unknown;
+    vertexArray = unknown;
+    for (unsigned int &buffer : buffers)
+        buffer = unknown;
+    activeUnit = -1;
+    for (auto &unit : textures)
+        for (unsigned int &texture : unit)
+            texture = unknown;
+    for (unsigned int &sampler : samplers)
+        sampler = unknown;
+    for (int &capability : capabilities)
+        capability = -1;
+    blendSource = blendDestination = unknown;
+    depthFunction = unknown;
+    depthWrite = -1;
+}
+
+void GLStateCache::count(StateCall call, bool issued)
+{
+    if (issued)
+        callStats.issued[call]++;
+    else
+        callStats.skipped[call]++;
+}
+
+void GLStateCache::useProgram(unsigned int newProgram)
+{
+    bool changed = program != newProgram;
+    count(STATE_PROGRAM, changed);
+    if (changed)
+    {
+        glUseProgram(newProgram);
+        program = newProgram;
+    }
+}
+
+void GLStateCache::bindVertexArray(unsigned int newVertexArray)
+{
+    bool changed = vertexArray != newVertexArray;
+    count(STATE_VERTEX_ARRAY, changed);
+    if (changed)
+    {
+        glBindVertexArray(newVertexArray);
+        vertexArray = newVertexArray;
+
+        // the element buffer comes with the VAO, we don't know what this one has
+        buffers[ELEMENT_BUFFER_SLOT] = unknown;
+    }
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer)
+{
+    int slot = bufferSlot(target);
+    if (slot < 0)
+    {
+        // not a target we shadow, always pass it on
+        count(STATE_BUFFER, true);
+        glBindBuffer(target, buffer);
+        return;
+    }
+
+    bool changed = buffers[slot] != buffer;
+    count(STATE_BUFFER, changed);
+    if (changed)
+    {
+        glBindBuffer(target, buffer);
+        buffers[slot] = buffer;
+    }
+}
+
+void GLStateCache::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+{
+    count(STATE_BUFFER, true);
+    glBindBufferBase(target, index, buffer);
+    int slot = bufferSlot(target);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+}
+
+void GLStateCache::bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset,
+                                   GLsizeiptr size)
+{
+    count(STATE_BUFFER, true);
+    glBindBufferRange(target, index, buffer, offset, size);
+    int slot = bufferSlot(target);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+}
+
+void GLStateCache::activeTexture(int unit)
+{
+    bool changed = activeUnit != unit;
+    count(STATE_ACTIVE_TEXTURE, changed);
+    if (changed)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+}
+
+void GLStateCache::bindTexture(int unit, GLenum target, unsigned int texture)
+{
+    int slot = textureTargetSlot(target);
+    if (slot < 0 || unit < 0 || unit >= maxTextureUnits)
+    {
+        activeTexture(unit);
+        count(STATE_TEXTURE, true);
+        glBindTexture(target, texture);
+        return;
+    }
+
+    // the unit only has to be switched when the binding actually changes
+    bool changed = textures[unit][slot] != texture;
+    count(STATE_TEXTURE, changed);
+    if (changed)
+    {
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        textures[unit][slot] = texture;
+    }
+}
+
+void GLStateCache::bindSampler(int unit, unsigned int sampler)
+{
+    if (unit < 0 || unit >= maxTextureUnits)
+    {
+        count(STATE_SAMPLER, true);
+        glBindSampler(unit, sampler);
+        return;
+    }
+
+    bool changed = samplers[unit] != sampler;
+    count(STATE_SAMPLER, changed);
+    if (changed)
+    {
+        glBindSampler(unit, sampler);
+        samplers[unit] = sampler;
+    }
+}
+
+bool GLStateCache::setCapability(GLenum capability, bool enabled)
+{
+    int slot = capabilitySlot(capability);
+    if (slot >= 0 && capabilities[slot] == (int)enabled)
+    {
+        count(STATE_CAPABILITY, false);
+        return false;
+    }
+
+    if (slot >= 0)
+        capabilities[slot] = (int)enabled;
+    count(STATE_CAPABILITY, true);
+    return true;
+}
+
+void GLStateCache::enable(GLenum capability)
+{
+    if (setCapability(capability, true))
+        glEnable(capability);
+}
+
+void GLStateCache::disable(GLenum capability)
+{
+    if (setCapability(capability, false))
+        glDisable(capability);
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+    bool changed = blendSource != source || blendDestination != destination;
+    count(STATE_BLEND_FUNC, changed);
+    if (changed)
+    {
+        glBlendFunc(source, destination);
+        blendSource = source;
+        blendDestination = destination;
+    }
+}
+
+void GLStateCache::depthFunc(GLenum function)
+{
+    bool changed = depthFunction != function;
+    count(STATE_DEPTH_FUNC, changed);
+    if (changed)
+    {
+        glDepthFunc(function);
+        depthFunction = function;
+    }
+}
+
+void GLStateCache::depthMask(bool write)
+{
+    bool changed = depthWrite != (int)write;
+    count(STATE_DEPTH_MASK, changed);
+    if (changed)
+    {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        depthWrite = (int)write;
+    }
+}
+
+void GLStateCache::forgetProgram(unsigned int deleted)
+{
+    // deleting the bound program leaves it in use until the next glUseProgram
+    if (program == deleted)
+        program = unknown;
+}
+
+void GLStateCache::forgetVertexArray(unsigned int deleted)
+{
+    // GL reverts to VAO 0 when the bound one is deleted
+    if (vertexArray == deleted)
+    {
+        vertexArray = 0;
+        buffers[ELEMENT_BUFFER_SLOT] = unknown;
+    }
+}
+
+void GLStateCache::forgetBuffer(unsigned int deleted)
+{
+    for (unsigned int &buffer : buffers)
+    {
+        if (buffer == deleted)
+            buffer = 0;
+    }
+}
+
+void GLStateCache::forgetTexture(unsigned int deleted)
+{
+    for (auto &unit : textures)
+        for (unsigned int &texture : unit)
+            if (texture == deleted)
+                texture = 0;
+}
+
+int GLStateCache::bufferSlot(GLenum target)
+{
+    switch (target)
+    {
+        case GL_ARRAY_BUFFER:           return ARRAY_BUFFER_SLOT;
+        case GL_ELEMENT_ARRAY_BUFFER:   return ELEMENT_BUFFER_SLOT;
+        case GL_UNIFORM_BUFFER:         return UNIFORM_BUFFER_SLOT;
+        case GL_PIXEL_UNPACK_BUFFER:    return PIXEL_UNPACK_SLOT;
+        case GL_DRAW_INDIRECT_BUFFER:   return DRAW_INDIRECT_SLOT;
+        case GL_COPY_READ_BUFFER:       return COPY_READ_SLOT;
+        case GL_COPY_WRITE_BUFFER:      return COPY_WRITE_SLOT;
+        case GL_SHADER_STORAGE_BUFFER:  return SHADER_STORAGE_SLOT;
+        default:                        return -1;
+    }
+}
+
+int GLStateCache::capabilitySlot(GLenum capability)
+{
+    switch (capability)
+    {
+        case GL_BLEND:          return BLEND_SLOT;
+        case GL_DEPTH_TEST:     return DEPTH_TEST_SLOT;
+        case GL_CULL_FACE:      return CULL_FACE_SLOT;
+        case GL_SCISSOR_TEST:   return SCISSOR_TEST_SLOT;
+        default:                return -1;
+    }
+}
+
+int GLStateCache::textureTargetSlot(GLenum target)
+{
+    switch (target)
+    {
+        case GL_TEXTURE_2D:         return TEXTURE_2D_SLOT;
+        case GL_TEXTURE_2D_ARRAY:   return TEXTURE_2D_ARRAY_SLOT;
+        case GL_TEXTURE_CUBE_MAP:   return TEXTURE_CUBE_SLOT;
+        case GL_TEXTURE_BUFFER:     return TEXTURE_BUFFER_SLOT;
+        default:                    return -1;
+    }
+}
+
+
+GLStateCache& glState()
+{
+    static GLStateCache cache;
+    return cache;
+}
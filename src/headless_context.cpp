@@ -0,0 +1,92 @@
+#include "headless_context.h"
+#include "gl_state.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstdlib>
+#include <stdexcept>
+
+
+HeadlessContext::HeadlessContext(int width, int height)
+    : framebuffer(0), width(width), height(height), display(nullptr), context(nullptr), colorBuffer(0), depthBuffer(0)
+{
+    // the shaders ask for #version 460 and llvmpipe only advertises 4.5, which is enough for them
+    // only Mesa reads these and an explicit value from the environment wins
+    setenv("MESA_GL_VERSION_OVERRIDE", "4.6", 0);
+    setenv("MESA_GLSL_VERSION_OVERRIDE", "460", 0);
+
+    // 1. display on the surfaceless platform, no window system needed
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    if (getPlatformDisplay)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+        throw std::runtime_error("Failed to initialize EGL display");
+    display = eglDisplay;
+
+    // 2. core profile context without a config or surface (EGL_KHR_no_config_context + surfaceless)
+    if (!eglBindAPI(EGL_OPENGL_API))
+        throw std::runtime_error("EGL has no desktop OpenGL");
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+    if (eglContext == EGL_NO_CONTEXT)
+        throw std::runtime_error("Failed to create EGL context");
+    context = eglContext;
+
+    if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+        throw std::runtime_error("Failed to make EGL context current");
+
+    // load glad of opengl function pointer
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        throw std::runtime_error("Failed to initialize GLAD");
+
+    // fresh context, nothing the state cache remembers is true anymore
+    glState().invalidate();
+
+    // 3. there is no default framebuffer, so draw into our own
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Offscreen framebuffer is incomplete");
+
+    glViewport(0, 0, width, height);
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    if (context)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+    }
+    if (display)
+        eglTerminate((EGLDisplay)display);
+}
+
+std::string HeadlessContext::description() const
+{
+    return std::string((const char*)glGetString(GL_RENDERER)) + " | " + (const char*)glGetString(GL_VERSION);
+}
@@ -0,0 +1,175 @@
+#include "instance_buffer.h"
+#include "gl_state.h"
+#include "thread_pool.h"
+#include "stream_ring.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+
+InstanceBuffer::InstanceBuffer(bool tinted)
+    : transformBuffer(0), tintBuffer(0)
+{
+    glGenBuffers(1, &transformBuffer);
+    if (tinted)
+        glGenBuffers(1, &tintBuffer);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    glDeleteBuffers(1, &transformBuffer);
+    glState().forgetBuffer(transformBuffer);
+    if (tintBuffer)
+    {
+        glDeleteBuffers(1, &tintBuffer);
+        glState().forgetBuffer(tintBuffer);
+    }
+}
+
+void InstanceBuffer::attach(unsigned int vertexArray)
+{
+    glState().bindVertexArray(vertexArray);
+
+    // a mat4 attribute is four vec4 columns on consecutive locations
+    glState().bindBuffer(GL_ARRAY_BUFFER, transformBuffer);
+    for (int column = 0; column < 4; column++)
+    {
+        GLuint location = transformLocation + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void*)(column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    if (tintBuffer)
+    {
+        glState().bindBuffer(GL_ARRAY_BUFFER, tintBuffer);
+        glVertexAttribPointer(colorLocation, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTint),
+                              (void*)offsetof(InstanceTint, color));
+        glEnableVertexAttribArray(colorLocation);
+        glVertexAttribDivisor(colorLocation, 1);
+
+        glVertexAttribPointer(uvOffsetLocation, 2, GL_FLOAT, GL_FALSE, sizeof(InstanceTint),
+                              (void*)offsetof(InstanceTint, uvOffset));
+        glEnableVertexAttribArray(uvOffsetLocation);
+        glVertexAttribDivisor(uvOffsetLocation, 1);
+    }
+}
+
+void InstanceBuffer::upload(const glm::mat4 *transforms, size_t count, const InstanceTint *tints)
+{
+    if (tintBuffer && !tints && count > 0)
+        throw std::invalid_argument("InstanceBuffer: a tinted buffer needs a tint per instance");
+
+    // grow geometrically so a slowly rising count doesn't reallocate every frame
+    if (count > capacity)
+        capacity = std::max(count, capacity * 2);
+    instanceCount = count;
+    transformSource = transformBuffer;
+    tintSource = tintBuffer;
+    transformOffset = tintOffset = 0;
+    if (count == 0)
+        return;
+
+    // orphan then write, a draw still reading last frame's instances keeps the old storage
+    glState().bindBuffer(GL_ARRAY_BUFFER, transformBuffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+
+    if (tintBuffer)
+    {
+        glState().bindBuffer(GL_ARRAY_BUFFER, tintBuffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceTint), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceTint), tints);
+    }
+}
+
+void InstanceBuffer::upload(StreamRing &ring, const glm::mat4 *transforms, size_t count, const InstanceTint *tints)
+{
+    if (tintBuffer && !tints && count > 0)
+        throw std::invalid_argument("InstanceBuffer: a tinted buffer needs a tint per instance");
+
+    instanceCount = count;
+    if (count == 0)
+        return;
+
+    // the mapping is coherent, a plain copy is all it takes for the draw to see it
+    StreamAllocation block = ring.allocate(count * sizeof(glm::mat4));
+    std::memcpy(block.data, transforms, block.size);
+    transformSource = ring.buffer;
+    transformOffset = block.offset;
+
+    if (tintBuffer)
+    {
+        block = ring.allocate(count * sizeof(InstanceTint));
+        std::memcpy(block.data, tints, block.size);
+        tintSource = ring.buffer;
+        tintOffset = block.offset;
+    }
+}
+
+void InstanceBuffer::bindStreams() const
+{
+    // glVertexAttribPointer gave every attribute the binding point of its own location, so
+    // glBindVertexBuffer swaps the buffer and offset and keeps the format and divisor
+    for (int column = 0; column < 4; column++)
+    {
+        glBindVertexBuffer(transformLocation + column, transformSource,
+                           transformOffset + column * sizeof(glm::vec4), sizeof(glm::mat4));
+    }
+    if (tintBuffer)
+    {
+        glBindVertexBuffer(colorLocation, tintSource, tintOffset + offsetof(InstanceTint, color), sizeof(InstanceTint));
+        glBindVertexBuffer(uvOffsetLocation, tintSource, tintOffset + offsetof(InstanceTint, uvOffset),
+                           sizeof(InstanceTint));
+    }
+}
+
+void InstanceBuffer::draw(unsigned int vertexArray, GLsizei indexCount, size_t firstIndex) const
+{
+    if (instanceCount == 0)
+        return;
+    glState().bindVertexArray(vertexArray);
+    bindStreams();
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (const void*)(firstIndex * sizeof(unsigned int)),
+                            (GLsizei)instanceCount);
+}
+
+std::string InstanceBuffer::shaderDefines(bool tinted)
+{
+    return tinted ? "#define INSTANCED\n#define INSTANCE_TINT" : "#define INSTANCED";
+}
+
+void layoutInstanceGrid(std::vector<glm::mat4> &transforms, size_t count, float time)
+{
+    transforms.resize(count);
+    if (count == 0)
+        return;
+
+    int side = (int)std::ceil(std::sqrt((double)count));
+    float cell = 2.0f / side;
+    // a spinning unit quad reaches 0.71 from its center, this keeps neighbours from touching
+    float scale = cell * 0.7f;
+
+    // written column by column instead of translate * rotate * scale, it's the same matrix
+    threadPool().parallelFor((int)count, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            float angle = time + i * 0.37f;
+            float c = std::cos(angle) * scale;
+            float s = std::sin(angle) * scale;
+            float x = -1.0f + cell * (i % side + 0.5f);
+            float y = 1.0f - cell * (i / side + 0.5f);
+
+            glm::mat4 &m = transforms[i];
+            m[0] = glm::vec4(c, s, 0.0f, 0.0f);
+            m[1] = glm::vec4(-s, c, 0.0f, 0.0f);
+            m[2] = glm::vec4(0.0f, 0.0f, scale, 0.0f);
+            m[3] = glm::vec4(x, y, 0.0f, 1.0f);
+        }
+    }, 4096);
+}
@@ -1,4 +1,6 @@
 #include "main.h"
+#include <charconv>
+#include <stdexcept>
 
 
 
@@ -11,8 +13,11 @@
     5. render loop
 */
 
-int main()
+int main(int argc, char** argv)
 {
+    // benchmarks live in bench.cpp and never open the demo window
+    if (argc > 1 && std::string(argv[1]).rfind("--bench", 0) == 0)
+        return runBenchmark(argc, argv);
 
     // 1. Set up window
     GLFWwindow*  window;
@@ -21,10 +26,96 @@ int main()
         window = glfwWindowSetup();    
     }catch(const std::runtime_error& e){
         std::cerr << "Error : " << e.what() <<"\n";
+        return 1;
     }
 
     //-----------------------------------------------------------------------------------------------------------------
-    
+
+    // --profile prints a per-stage timing table every few seconds, --trace <file> also writes a Chrome trace at exit
+    std::string tracePath = flagValue(argc, argv, "--trace");
+    bool profiling = hasFlag(argc, argv, "--profile") || !tracePath.empty();
+    // --parallel-jpeg spreads each JPEG decode over all cores
+    TextureLoader::setParallelJpegDecode(hasFlag(argc, argv, "--parallel-jpeg"));
+    // --mesh <file> draws an .obj or .glb instead of the quad
+    std::string meshPath = flagValue(argc, argv, "--mesh");
+    // --compact-vertices stores it with half float positions/uvs and byte colors
+    bool compactVertices = hasFlag(argc, argv, "--compact-vertices");
+    // --instances <n> draws n copies with one instanced draw call
+    int instanceCount;
+    try
+    {
+        instanceCount = countFlagValue(argc, argv, "--instances");
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cerr << "Error : " << e.what() << "\n";
+        glfwTerminate();
+        return 1;
+    }
+    // --lod simplifies the mesh into a LOD chain at import and draws the level its size on screen needs
+    bool buildLods = hasFlag(argc, argv, "--lod");
+
+    // 2. - 4. happen in the Scene constructor, the headless benchmark builds the same scene
+    {
+        Scene scene(meshPath, compactVertices, instanceCount, buildLods);
+        FrameProfiler profiler;
+        FrameProfiler *activeProfiler = profiling ? &profiler : nullptr;
+        profiler.setTraceCapture(!tracePath.empty());
+        double lastSummary = glfwGetTime();
+
+        //-----------------------------------------------------------------------------------------------------------------
+        // uncomment this call to draw in wireframe polygons.
+        //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+        // 5. render loop
+
+        // render loop
+        while (!glfwWindowShouldClose(window))
+        {
+            if (activeProfiler)
+                activeProfiler->beginFrame();
+
+            {
+                ProfileScope scope(activeProfiler, "input");
+                processInput(window);
+            }
+
+            scene.draw((float)glfwGetTime(), activeProfiler);
+
+            {
+                ProfileScope scope(activeProfiler, "swap");
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+
+            if (activeProfiler)
+            {
+                activeProfiler->endFrame();
+                if (glfwGetTime() - lastSummary > 2.0)
+                {
+                    activeProfiler->printSummary(std::cout);
+                    lastSummary = glfwGetTime();
+                }
+            }
+        }
+
+        if (!tracePath.empty())
+            profiler.writeChromeTrace(tracePath);
+
+        // the scene frees its GL objects here, while the context is still alive
+    }
+
+    // clear all allocated resource
+    glfwTerminate();
+
+    return 0;
+}
+
+
+Scene::Scene(const std::string &meshPath, bool compactVertices, int instanceCount, bool buildLods)
+    : shader("src/shaders/shader.vs","src/shaders/shader.fs",
+             instanceCount > 0 ? InstanceBuffer::shaderDefines(false) : std::string())
+{
     // 2. vertex preparation
 
     //  define vertices 
@@ -43,81 +134,185 @@ int main()
     }; 
 
     // Buffer generation, vertex array generation
-    unsigned int VBO,VAO, EBO;
-    
-    loadBuffer( vertices,sizeof(vertices), indices, sizeof(indices), VBO, VAO, EBO);
+    if (meshPath.empty() && !compactVertices && !buildLods)
+    {
+        loadBuffer( vertices,sizeof(vertices), indices, sizeof(indices), VBO, VAO, EBO);
+        indexCount = 6;
+    }
+    else if (isMeshFile(meshPath))
+    {
+        // converted meshes are uploaded from the mapping in the layout they were written in, only
+        // compressed indices go through a decode. the file brings its own LODs, if it has any
+        MeshFile file(meshPath);
+        std::vector<unsigned int> decoded;
+        const unsigned int *fileIndices = file.indexData();
+        if (!fileIndices)
+        {
+            decoded = file.indices();
+            fileIndices = decoded.data();
+        }
+        loadBuffer(file.vertexData(), file.vertexBytes(), fileIndices, file.indexBytes(), VBO, VAO, EBO, file.layout());
+        indexCount = file.header().indexCount;
+        lods.levels = file.lods();
+    }
+    else
+    {
+        // imported meshes come out in the same interleaved layout as the quad, from there
+        // packVertices writes whatever the vertex layout asks for
+        MeshData mesh;
+        if (meshPath.empty())
+        {
+            mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(float));
+            mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(unsigned int));
+        }
+        else
+        {
+            // source files come in whatever triangle order the exporter wrote
+            mesh = loadMesh(meshPath);
+            optimizeMesh(mesh);
+        }
+
+        // every level indexes the same vertices, they go into one index buffer one after the other
+        if (buildLods)
+            lods = buildLodChain(mesh);
+        const std::vector<unsigned int> &meshIndices = buildLods ? lods.indices : mesh.indices;
+
+        VertexLayout layout = compactVertices ? VertexLayout::compact(!mesh.normals.empty()) : VertexLayout::standard();
+        std::vector<unsigned char> packed = packVertices(mesh, layout);
+        loadBuffer(packed.data(), packed.size(), meshIndices.data(), meshIndices.size() * sizeof(unsigned int),
+                   VBO, VAO, EBO, layout);
+        indexCount = (unsigned int)mesh.indices.size();
+    }
+
+    // the per instance transforms go in a buffer of their own, attached to the same VAO
+    if (instanceCount > 0)
+    {
+        instances.reset(new InstanceBuffer());
+        instances->attach(VAO);
+        if (StreamRing::supported())
+            instanceRing.reset(new StreamRing(instanceCount * sizeof(glm::mat4)));
+        instanceTransforms.resize(instanceCount);
+    }
 
 
     //-----------------------------------------------------------------------------------------------------------------
     
-    // 3. set up shader    
-    Shader theShader("src/shaders/shader.vs","src/shaders/shader.fs");
-    
+    // 3. set up shader (compiled by the member initializer above)
+
+    // resolve uniforms once, samplers never change so they are set here instead of every frame
+    transformLoc = shader.uniform("transform");
+    shader.use();
+    shader.setInt("texture1", 0);
+    shader.setInt("texture2", 1);
 
     //-----------------------------------------------------------------------------------------------------------------
-    // uncomment this call to draw in wireframe polygons.
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     
     // 4. import texture
 
-    //create and bind gl texture
-    unsigned int texture1, texture2;
-    loadTexture(texture1,texture2);
-    
-    //-----------------------------------------------------------------------------------------------------------------
-    
-    // 5. render loop
+    //queue the textures, they show up a few frames later
+    loadTexture(textures, texture1, texture2);
+}
 
-    // render loop
-    while (!glfwWindowShouldClose(window))
+// one frame of the scene, time in seconds drives the rotation
+void Scene::draw(float time, FrameProfiler *profiler)
+{
     {
-        processInput(window);
-
+        ProfileScope scope(profiler, "clear");
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
+    }
 
-        // bind textures on corresponding texture units
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
+    {
+        ProfileScope scope(profiler, "upload");
+        // stream in whatever was decoded (capped by a byte budget) and evict down to the VRAM budget
+        textures.update();
+    }
 
-        
-glm::mat4 trans = glm::mat4(1.0f);
-trans = glm::translate(trans, glm::vec3(0.5f, -0.5f, 0.0f));
-trans = glm::rotate(trans, (float)glfwGetTime(), glm::vec3(0.0f, 0.0f, 1.0f));
+    {
+        ProfileScope scope(profiler, "textures");
+        // bind textures on corresponding texture units (the state cache drops these when nothing changed)
+        glState().bindTexture(0, GL_TEXTURE_2D, texture1.id());
+        glState().bindTexture(1, GL_TEXTURE_2D, texture2.id());
+    }
 
+    if (instances)
+    {
+        ProfileScope scope(profiler, "instances");
+        // every copy spins, so all of them are rebuilt and streamed each frame
+        layoutInstanceGrid(instanceTransforms, instanceTransforms.size(), time);
+        if (instanceRing)
+        {
+            instanceRing->beginFrame();
+            instances->upload(*instanceRing, instanceTransforms.data(), instanceTransforms.size());
+        }
+        else
+        {
+            instances->upload(instanceTransforms.data(), instanceTransforms.size());
+        }
+    }
+
+    {
+        ProfileScope scope(profiler, "uniforms");
+        glm::mat4 trans = glm::mat4(1.0f);
+        // instances carry their own placement, the quad is moved and spun by the uniform
+        if (!instances)
+        {
+            trans = glm::translate(trans, glm::vec3(0.5f, -0.5f, 0.0f));
+            trans = glm::rotate(trans, time, glm::vec3(0.0f, 0.0f, 1.0f));
+        }
 
         //activate shader program
-        theShader.use();
-
-
-        unsigned int transformLoc = glGetUniformLocation(theShader.ID, "transform");
-        glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
-        glUniform1i(glGetUniformLocation(theShader.ID, "texture1"), 0);
-        glUniform1i(glGetUniformLocation(theShader.ID, "texture2"), 1);
-        
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        
-        
-        
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        shader.use();
+
+        shader.setMat4(transformLoc, trans);
+    }
+
+    GLsizei drawCount = indexCount;
+    size_t firstIndex = 0;
+    if (lods.levels.size() > 1)
+    {
+        ProfileScope scope(profiler, "lod");
+        // clip space spans 2 units over the viewport, the mesh is scaled by its transform (all
+        // instances share one scale)
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        float scale = instances && !instanceTransforms.empty() ? glm::length(glm::vec3(instanceTransforms[0][0])) : 1.0f;
+        lod = selectLod(lods, scale * viewport[3] * 0.5f, lod);
+        drawCount = (GLsizei)lods.levels[lod].indexCount;
+        firstIndex = lods.levels[lod].firstIndex;
+    }
+
+    {
+        ProfileScope scope(profiler, "draw");
+        if (instances)
+        {
+            instances->draw(VAO, drawCount, firstIndex);
+            if (instanceRing)
+                instanceRing->endFrame();
+        }
+        else
+        {
+            glState().bindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, drawCount, GL_UNSIGNED_INT, (const void*)(firstIndex * sizeof(unsigned int)));
+        }
     }
+}
 
+Scene::~Scene()
+{
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    glDeleteProgram(shader.ID);
 
-    
-    
-    // clear all allocated resource
-    glfwTerminate();
+    glState().forgetVertexArray(VAO);
+    glState().forgetBuffer(VBO);
+    glState().forgetBuffer(EBO);
+    glState().forgetProgram(shader.ID);
 
-    return 0;
+    // the textures belong to the texture manager, which cleans up after this
 }
 
 
@@ -150,6 +345,9 @@ GLFWwindow*  glfwWindowSetup()
         throw std::runtime_error("Failed to initialize GLAD");
     }
 
+    // fresh context, nothing the state cache remembers is true anymore
+    glState().invalidate();
+
     // this function call use the resize callback fucntion to readjust the viewport to fit the window
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
@@ -157,98 +355,83 @@ GLFWwindow*  glfwWindowSetup()
 }
 
 // 2.
-void loadBuffer( const float vertices[], size_t vertices_size , const unsigned int indices[], size_t indices_size , unsigned int& VBO, unsigned int& VAO, unsigned int& EBO)
+void loadBuffer( const void *vertices, size_t vertices_size , const unsigned int indices[], size_t indices_size , unsigned int& VBO, unsigned int& VAO, unsigned int& EBO, const VertexLayout &layout)
 {
     glGenBuffers(1, &VBO);
     glGenVertexArrays(1,&VAO);
 
     // Bind VAO first
-    glBindVertexArray(VAO);
+    glState().bindVertexArray(VAO);
 
     // buffer binding (bind VBO to GL_ARRAY_BUFFER)
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
 
     // allocate the buffer to VRAM
     glBufferData(GL_ARRAY_BUFFER, vertices_size, vertices, GL_STATIC_DRAW);
 
-    // specified how OpenGL should interpret the vertex data 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);  
-
-    // specify color attribute vertex array pointer
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  
-
+    // specified how OpenGL should interpret the vertex data, one attribute pointer per
+    // entry of the layout (position, color and texture coords for the standard one)
+    layout.apply();
 
     //  create element buffer object for specifying the order of drawing multiple triangle
     glGenBuffers(1, &EBO);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, indices, GL_STATIC_DRAW); 
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-glEnableVertexAttribArray(2);
-
 };
 
 // 3.
-void loadTexture(unsigned int& texture1,unsigned int& texture2)
+void loadTexture(TextureManager& textures, TextureRef& texture1, TextureRef& texture2)
 {
+    // both files are decoded on worker threads and streamed in over the next frames,
+    // until then the refs resolve to a 1x1 placeholder. asking for a file twice shares it
 
     //for barrel
-    glGenTextures(1, &texture1); 
-    glBindTexture(GL_TEXTURE_2D, texture1);
-     // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    //import the image data
-    int containerWidth, containerHeight, nrChannels;
-    unsigned char *data = stbi_load("textures/container.jpg", &containerWidth, &containerHeight, &nrChannels, 0); 
-    if(data)
-    {
-        //generate texture
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, containerWidth, containerHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture\n";
-    }
-    stbi_image_free(data);
-
-    // for smiley
-
-    glGenTextures(1, &texture2); 
-    glBindTexture(GL_TEXTURE_2D, texture2);
-     // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    //import the image data
-    stbi_set_flip_vertically_on_load(true);
-    data = stbi_load("textures/awesomeface.png", &containerWidth, &containerHeight, &nrChannels, 0);
-    if(data)
+    texture1 = textures.acquire("textures/container.jpg");
+
+    // for smiley, png has its origin at the top so flip it
+    TextureLoadOptions flipped;
+    flipped.flipVertically = true;
+    texture2 = textures.acquire("textures/awesomeface.png", flipped);
+}
+
+bool isMeshFile(const std::string &path)
+{
+    return path.size() > 6 && path.compare(path.size() - 6, 6, ".bmesh") == 0;
+}
+
+bool hasFlag(int argc, char** argv, const std::string &flag)
+{
+    for (int i = 1; i < argc; i++)
     {
-        //generate texture
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, containerWidth, containerHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        if (flag == argv[i])
+            return true;
     }
-    else
+    return false;
+}
+
+// the argument following flag, empty if the flag isn't there
+std::string flagValue(int argc, char** argv, const std::string &flag)
+{
+    for (int i = 1; i + 1 < argc; i++)
     {
-        std::cout << "Failed to load texture\n";
+        if (flag == argv[i])
+            return argv[i + 1];
     }
-    
-
+    return "";
+}
 
-    //we're done generating the texture so we'll delete the data (unsign char "container") 
-    stbi_image_free(data);
+int countFlagValue(int argc, char** argv, const std::string &flag)
+{
+    std::string value = flagValue(argc, argv, flag);
+    if (value.empty())
+        return 0;
+    int count = 0;
+    std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), count);
+    if (result.ec != std::errc() || result.ptr != value.data() + value.size() || count < 0)
+        throw std::runtime_error("usage: " + flag + " <n> takes a count of 0 or more, not \"" + value + "\"");
+    return count;
 }
 
 // tell opengl about the render size everythime that user resize the window
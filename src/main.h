@@ -1,20 +1,78 @@
+#ifndef MAIN_H
+#define MAIN_H
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <cmath>
 #include "shader.h"
+#include "bench.h"
+#include "profiler.h"
+#include "texture_manager.h"
+#include "mesh_loader.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "mesh_file.h"
+#include "vertex_layout.h"
+#include "instance_buffer.h"
+#include "stream_ring.h"
+#include <memory>
 #include <thread>
 #include <stb_image.h>
 #include "glm/glm.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// the quad with two textures that the demo draws, shared by the window and --bench
+struct Scene
+{
+    unsigned int VBO, VAO, EBO;
+    unsigned int indexCount;
+    Shader shader;
+    TextureManager textures;
+    TextureRef texture1, texture2;
+    UniformHandle transformLoc;
+    // only there when instanceCount > 0, the mesh is then drawn that many times on a grid
+    std::unique_ptr<InstanceBuffer> instances;
+    // the transforms are streamed through this when the context has glBufferStorage
+    std::unique_ptr<StreamRing> instanceRing;
+    std::vector<glm::mat4> instanceTransforms;
+    // the index buffer holds every level when the mesh was imported with LODs, a single level otherwise
+    MeshLodChain lods;
+    int lod = -1;
+
+    // vertex preparation, shader and texture import. meshPath swaps the quad for an .obj, .glb or .bmesh,
+    // compactVertices packs it with VertexLayout::compact instead of plain floats, buildLods
+    // simplifies it into a LOD chain that is picked from by its size on screen
+    explicit Scene(const std::string &meshPath = std::string(), bool compactVertices = false,
+                   int instanceCount = 0, bool buildLods = false);
+    ~Scene();
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // stages are timed when a profiler is given
+    void draw(float time, FrameProfiler *profiler = nullptr);
+};
+
+// whether path is a .bmesh that Scene uploads without going through MeshData
+bool isMeshFile(const std::string &path);
+
+// command line helpers, shared with bench.cpp
+bool hasFlag(int argc, char** argv, const std::string &flag);
+std::string flagValue(int argc, char** argv, const std::string &flag);
+// flagValue as a count, 0 if the flag isn't there. throws std::runtime_error for anything that
+// isn't a number from 0 to INT_MAX
+int countFlagValue(int argc, char** argv, const std::string &flag);
+
 GLFWwindow* glfwWindowSetup();
-void loadBuffer(const float[], size_t,
+void loadBuffer(const void*, size_t,
                 const unsigned int[], size_t, 
-                unsigned int&, unsigned int&, unsigned int&);
+                unsigned int&, unsigned int&, unsigned int&,
+                const VertexLayout &layout = VertexLayout::standard());
 
-void loadTexture(unsigned int&,unsigned int&);
+void loadTexture(TextureManager&, TextureRef&, TextureRef&);
 
 void framebuffer_size_callback(GLFWwindow *, int , int );
 void processInput(GLFWwindow *window);
+
+#endif
@@ -0,0 +1,109 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path)
+{
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = nullptr;
+        throw std::runtime_error("cannot open " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    length = (size_t)fileSize.QuadPart;
+    if (length == 0)
+        return;   // empty files can't be mapped, data() stays null
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!bytes)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("cannot map " + path);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes)
+        UnmapViewOfFile(bytes);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+}
+
+void MappedFile::adviseSequential() const
+{
+    // FILE_FLAG_SEQUENTIAL_SCAN already asked for read-ahead
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    length = (size_t)info.st_size;
+
+    // empty files can't be mapped, data() stays null
+    if (length > 0)
+    {
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("cannot map " + path);
+        }
+        bytes = (const unsigned char*)mapped;
+    }
+
+    // the mapping keeps the file alive on its own
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes)
+        munmap((void*)bytes, length);
+}
+
+void MappedFile::adviseSequential() const
+{
+    // advice values are not flags, so these are two calls
+    if (bytes)
+    {
+        madvise((void*)bytes, length, MADV_SEQUENTIAL);
+        madvise((void*)bytes, length, MADV_WILLNEED);
+    }
+}
+
+#endif
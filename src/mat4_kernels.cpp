@@ -0,0 +1,163 @@
+#include "mat4_kernels.h"
+#include "cpu_features.h"
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <glm/simd/matrix.h>
+#endif
+
+
+namespace
+{
+    void multiplyScalar(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = a[i] * b[i];
+    }
+
+    void transformScalar(const glm::mat4 &m, const glm::vec4 *in, glm::vec4 *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = m * in[i];
+    }
+
+    void inverseScalar(const glm::mat4 *in, glm::mat4 *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = glm::inverse(in[i]);
+    }
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+    // glm::mat4 is only 4 byte aligned, the glm_vec4 arrays the SIMD functions take are 16
+    void loadColumns(const glm::mat4 &m, glm_vec4 columns[4])
+    {
+        for (int c = 0; c < 4; c++)
+            columns[c] = _mm_loadu_ps(&m[c][0]);
+    }
+
+    void storeColumns(const glm_vec4 columns[4], glm::mat4 &m)
+    {
+        for (int c = 0; c < 4; c++)
+            _mm_storeu_ps(&m[c][0], columns[c]);
+    }
+
+    void multiplySse2(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            glm_vec4 x[4], y[4], result[4];
+            loadColumns(a[i], x);
+            loadColumns(b[i], y);
+            glm_mat4_mul(x, y, result);
+            storeColumns(result, out[i]);
+        }
+    }
+
+    void transformSse2(const glm::mat4 &m, const glm::vec4 *in, glm::vec4 *out, size_t count)
+    {
+        glm_vec4 columns[4];
+        loadColumns(m, columns);
+        for (size_t i = 0; i < count; i++)
+            _mm_storeu_ps(&out[i][0], glm_mat4_mul_vec4(columns, _mm_loadu_ps(&in[i][0])));
+    }
+
+    void inverseSse2(const glm::mat4 *in, glm::mat4 *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            glm_vec4 m[4], result[4];
+            loadColumns(in[i], m);
+            glm_mat4_inverse(m, result);
+            storeColumns(result, out[i]);
+        }
+    }
+
+    CPU_TARGET_AVX
+    void multiplyAvx(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, size_t count)
+    {
+        // only unaligned loads and stores inside, so no copies into glm_vec4 arrays
+        for (size_t i = 0; i < count; i++)
+        {
+            glm_mat4_mul_avx(reinterpret_cast<const glm_vec4*>(&a[i]), reinterpret_cast<const glm_vec4*>(&b[i]),
+                             reinterpret_cast<glm_vec4*>(&out[i]));
+        }
+    }
+
+    CPU_TARGET_AVX2_FMA
+    void multiplyFma(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, size_t count)
+    {
+        // only unaligned loads and stores inside, so no copies into glm_vec4 arrays
+        for (size_t i = 0; i < count; i++)
+        {
+            glm_mat4_mul_fma(reinterpret_cast<const glm_vec4*>(&a[i]), reinterpret_cast<const glm_vec4*>(&b[i]),
+                             reinterpret_cast<glm_vec4*>(&out[i]));
+        }
+    }
+
+    CPU_TARGET_AVX2_FMA
+    void transformFma(const glm::mat4 &m, const glm::vec4 *in, glm::vec4 *out, size_t count)
+    {
+        glm_vec4 columns[4];
+        loadColumns(m, columns);
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2)
+            _mm256_storeu_ps(&out[i][0], glm_mat4_mul_vec4_x2_fma(columns, _mm256_loadu_ps(&in[i][0])));
+        for (; i < count; i++)
+            _mm_storeu_ps(&out[i][0], glm_mat4_mul_vec4_fma(columns, _mm_loadu_ps(&in[i][0])));
+    }
+
+    CPU_TARGET_AVX2_FMA
+    void inverseFma(const glm::mat4 *in, glm::mat4 *out, size_t count)
+    {
+        // the x8 kernel loads all 8 before it stores, so in and out may overlap
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+            glm_mat4_inverse_x8_fma(reinterpret_cast<const glm_vec4*>(&in[i]), reinterpret_cast<glm_vec4*>(&out[i]));
+        inverseSse2(in + i, out + i, count - i);
+    }
+#endif
+
+    const Mat4Kernels levels[Mat4KernelLevelCount] = {
+        {"scalar", multiplyScalar, transformScalar, inverseScalar},
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+        {"sse2", multiplySse2, transformSse2, inverseSse2},
+        {"avx", multiplyAvx, transformSse2, inverseSse2},
+        {"avx_fma", multiplyFma, transformFma, inverseFma},
+#endif
+    };
+
+    bool levelSupported(Mat4KernelLevel level)
+    {
+        switch (level)
+        {
+        case Mat4Scalar:
+            return true;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+        case Mat4Sse2:
+            return true;
+        case Mat4Avx:
+            return cpuHasAvx();
+        case Mat4AvxFma:
+            return cpuHasAvx2() && cpuHasFma();
+#endif
+        default:
+            return false;
+        }
+    }
+}
+
+const Mat4Kernels* mat4Kernels(Mat4KernelLevel level)
+{
+    return levelSupported(level) ? &levels[level] : nullptr;
+}
+
+const Mat4Kernels& mat4Kernels()
+{
+    static const Mat4Kernels *best = []()
+    {
+        int level = Mat4KernelLevelCount - 1;
+        while (!mat4Kernels((Mat4KernelLevel)level))
+            level--;
+        return mat4Kernels((Mat4KernelLevel)level);
+    }();
+    return *best;
+}
@@ -0,0 +1,68 @@
+#include "mesh_file.h"
+#include "mesh_loader.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <filesystem>
+
+
+/*
+    mesh_convert: .obj / .glb (anything loadMesh reads) to .bmesh
+
+        mesh_convert <input> <output.bmesh> [--compress] [--lods <levels>] [--meshlets] [--no-optimize]
+
+    --compress      compact vertices and delta coded indices
+    --lods n        a LOD chain of up to n levels, the mesh included
+    --meshlets      meshlets and their culling bounds for level 0
+    --no-optimize   keeps the source's triangle and vertex order
+*/
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: mesh_convert <input> <output.bmesh> [--compress] [--lods <levels>] [--meshlets] [--no-optimize]\n";
+        return 1;
+    }
+
+    MeshFileOptions options;
+    for (int i = 3; i < argc; i++)
+    {
+        std::string flag = argv[i];
+        if (flag == "--compress")
+            options.compress = true;
+        else if (flag == "--meshlets")
+            options.meshlets = true;
+        else if (flag == "--no-optimize")
+            options.optimize = false;
+        else if (flag == "--lods" && i + 1 < argc)
+            options.lodLevels = std::stoi(argv[++i]);
+        else
+        {
+            std::cerr << "unknown option " << flag << "\n";
+            return 1;
+        }
+    }
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        MeshData mesh = loadMesh(argv[1]);
+        size_t triangles = mesh.triangleCount();
+        writeMeshFile(argv[2], std::move(mesh), options);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        MeshFile file(argv[2]);
+        std::cout << argv[1] << " -> " << argv[2] << ": " << triangles << " triangles, "
+                  << file.header().lodCount << " levels, " << file.header().meshletCount << " meshlets, "
+                  << std::filesystem::file_size(argv[2]) << " bytes in " << seconds << " s\n";
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Error : " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,528 @@
+#include "mesh_file.h"
+#include "mesh_loader.h"
+#include "mesh_optimizer.h"
+#include "cpu_features.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+
+// the header is written and mapped as it is, its layout is the file format
+static_assert(sizeof(MeshFileHeader) == 296, "MeshFileHeader layout changed, bump currentVersion");
+static_assert(sizeof(LodLevel) == 12 && sizeof(Meshlet) == 16 && sizeof(MeshletBounds) == 80,
+              "a .bmesh table entry changed size, bump MeshFileHeader::currentVersion");
+
+namespace
+{
+    const size_t sectionAlignment = 64;
+    const size_t indexBlock = 256;
+
+    uint32_t zigzag(int32_t value)
+    {
+        return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    }
+
+    int32_t unzigzag(uint32_t value)
+    {
+        return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    }
+
+    size_t blockCount(size_t indexCount)
+    {
+        return (indexCount + indexBlock - 1) / indexBlock;
+    }
+
+    // a width byte per block, then the blocks one after the other
+    std::vector<unsigned char> encodeIndices(const std::vector<unsigned int> &indices)
+    {
+        size_t blocks = blockCount(indices.size());
+        std::vector<unsigned char> out(blocks);
+        std::vector<uint32_t> deltas(indexBlock);
+        unsigned int previous = 0;
+        for (size_t block = 0; block < blocks; block++)
+        {
+            size_t first = block * indexBlock, count = std::min(indexBlock, indices.size() - first);
+            uint32_t largest = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                deltas[i] = zigzag((int32_t)(indices[first + i] - previous));
+                previous = indices[first + i];
+                largest = std::max(largest, deltas[i]);
+            }
+
+            unsigned char width = largest < 0x100 ? 1 : largest < 0x10000 ? 2 : 4;
+            out[block] = width;
+            for (size_t i = 0; i < count; i++)
+            {
+                for (int b = 0; b < width; b++)
+                    out.push_back((unsigned char)(deltas[i] >> (8 * b)));
+            }
+        }
+        return out;
+    }
+
+    // bytes the blocks after the width table take, 0 when a width is not 1, 2 or 4
+    size_t encodedBlockBytes(const unsigned char *widths, size_t indexCount)
+    {
+        size_t bytes = 0;
+        for (size_t block = 0; block < blockCount(indexCount); block++)
+        {
+            if (widths[block] != 1 && widths[block] != 2 && widths[block] != 4)
+                return 0;
+            bytes += widths[block] * std::min(indexBlock, indexCount - block * indexBlock);
+        }
+        return bytes;
+    }
+
+    uint32_t readDelta(const unsigned char *p, int width)
+    {
+        if (width == 1)
+            return p[0];
+        if (width == 2)
+            return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+        uint32_t value;
+        std::memcpy(&value, p, 4);
+        return value;
+    }
+
+    // both decoders return the largest index they wrote, 0 for none
+    unsigned int decodeIndicesScalar(const unsigned char *encoded, size_t indexCount, unsigned int *out)
+    {
+        size_t blocks = blockCount(indexCount);
+        const unsigned char *data = encoded + blocks;
+        unsigned int previous = 0, largest = 0;
+        for (size_t block = 0; block < blocks; block++)
+        {
+            int width = encoded[block];
+            size_t first = block * indexBlock, count = std::min(indexBlock, indexCount - first);
+            for (size_t i = 0; i < count; i++, data += width)
+            {
+                previous += (unsigned int)unzigzag(readDelta(data, width));
+                out[first + i] = previous;
+                largest = std::max(largest, previous);
+            }
+        }
+        return largest;
+    }
+
+#ifdef CPU_X86
+    // 8 deltas widened to 32 bits, unzigzagged and summed onto the last index decoded
+    CPU_TARGET_AVX2
+    unsigned int decodeIndicesAvx2(const unsigned char *encoded, size_t indexCount, unsigned int *out)
+    {
+        size_t blocks = blockCount(indexCount);
+        const unsigned char *data = encoded + blocks;
+        const __m256i one = _mm256_set1_epi32(1), lane3 = _mm256_set1_epi32(3), lane7 = _mm256_set1_epi32(7);
+        __m256i carry = _mm256_setzero_si256(), largest8 = _mm256_setzero_si256();
+        unsigned int previous = 0, largest = 0;
+
+        for (size_t block = 0; block < blocks; block++)
+        {
+            int width = encoded[block];
+            size_t first = block * indexBlock, count = std::min(indexBlock, indexCount - first);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8, data += 8 * width)
+            {
+                __m256i z;
+                if (width == 1)
+                    z = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)data));
+                else if (width == 2)
+                    z = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)data));
+                else
+                    z = _mm256_loadu_si256((const __m256i*)data);
+
+                __m256i delta = _mm256_xor_si256(_mm256_srli_epi32(z, 1),
+                                                 _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(z, one)));
+                // prefix sum inside each 128 bit half, then the low half's total onto the high half
+                delta = _mm256_add_epi32(delta, _mm256_slli_si256(delta, 4));
+                delta = _mm256_add_epi32(delta, _mm256_slli_si256(delta, 8));
+                __m256i lowTotal = _mm256_permutevar8x32_epi32(delta, lane3);
+                delta = _mm256_add_epi32(delta, _mm256_blend_epi32(_mm256_setzero_si256(), lowTotal, 0xF0));
+                delta = _mm256_add_epi32(delta, carry);
+                _mm256_storeu_si256((__m256i*)(out + first + i), delta);
+                largest8 = _mm256_max_epu32(largest8, delta);
+                carry = _mm256_permutevar8x32_epi32(delta, lane7);
+            }
+
+            // the tail of the last block
+            previous = (unsigned int)_mm256_cvtsi256_si32(carry);
+            for (; i < count; i++, data += width)
+            {
+                previous += (unsigned int)unzigzag(readDelta(data, width));
+                out[first + i] = previous;
+                largest = std::max(largest, previous);
+            }
+            carry = _mm256_set1_epi32((int)previous);
+        }
+
+        alignas(32) unsigned int lanes[8];
+        _mm256_store_si256((__m256i*)lanes, largest8);
+        for (unsigned int lane : lanes)
+            largest = std::max(largest, lane);
+        return largest;
+    }
+#endif
+
+    void writeSection(std::ofstream &out, MeshFileHeader &header, MeshFileSectionId id, const void *data,
+                      size_t size, size_t decodedSize)
+    {
+        uint64_t offset = (uint64_t)out.tellp();
+        uint64_t aligned = (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+        static const char zeros[sectionAlignment] = {};
+        out.write(zeros, (std::streamsize)(aligned - offset));
+        out.write((const char*)data, (std::streamsize)size);
+        header.sections[id] = {aligned, size, decodedSize};
+    }
+
+    template <typename T>
+    void writeSection(std::ofstream &out, MeshFileHeader &header, MeshFileSectionId id, const std::vector<T> &items)
+    {
+        writeSection(out, header, id, items.data(), items.size() * sizeof(T), items.size() * sizeof(T));
+    }
+
+    template <typename T>
+    std::vector<T> readSection(const unsigned char *data, const MeshFileSection &section)
+    {
+        std::vector<T> items(section.size / sizeof(T));
+        if (!items.empty())
+            std::memcpy(items.data(), data + section.offset, items.size() * sizeof(T));
+        return items;
+    }
+
+    bool indicesBelow(const unsigned int *indices, size_t count, uint32_t vertexCount)
+    {
+        unsigned int largest = 0;
+        for (size_t i = 0; i < count; i++)
+            largest = std::max(largest, indices[i]);
+        return count == 0 || largest < vertexCount;
+    }
+
+    // every meshlet inside the vertex and triangle sections, its triangles inside its own vertices
+    // and those inside the mesh's
+    bool meshletsInRange(const Meshlet *meshlets, size_t meshletCount, const unsigned int *vertices, size_t vertexEntries,
+                         const unsigned char *triangles, size_t triangleBytes, uint32_t vertexCount)
+    {
+        if (!indicesBelow(vertices, vertexEntries, vertexCount))
+            return false;
+        for (size_t m = 0; m < meshletCount; m++)
+        {
+            const Meshlet &meshlet = meshlets[m];
+            if ((uint64_t)meshlet.vertexOffset + meshlet.vertexCount > vertexEntries ||
+                ((uint64_t)meshlet.triangleOffset + meshlet.triangleCount) * 3 > triangleBytes)
+                return false;
+            const unsigned char *local = triangles + (size_t)meshlet.triangleOffset * 3;
+            for (size_t i = 0; i < (size_t)meshlet.triangleCount * 3; i++)
+            {
+                if (local[i] >= meshlet.vertexCount)
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+void writeMeshFile(const std::string &path, MeshData mesh, const MeshFileOptions &options)
+{
+    if (options.optimize)
+        optimizeMesh(mesh);
+
+    bool withNormals = !mesh.normals.empty();
+    VertexLayout layout = VertexLayout::standard();
+    if (options.compress)
+        layout = VertexLayout::compact(withNormals);
+    else if (withNormals)
+        layout.add(VertexSemantic::Normal, VertexFormat::Float32);
+    std::vector<unsigned char> vertices = packVertices(mesh, layout);
+
+    MeshLodChain chain;
+    if (options.lodLevels > 1)
+    {
+        LodChainOptions lodOptions;
+        lodOptions.maxLevels = options.lodLevels;
+        chain = buildLodChain(mesh, lodOptions);
+    }
+    else
+    {
+        chain.indices = mesh.indices;
+        chain.levels.push_back({0, (unsigned int)mesh.indices.size(), 0.0f});
+    }
+    MeshletData meshlets;
+    if (options.meshlets)
+        meshlets = buildMeshlets(mesh);
+
+    MeshFileHeader header = {};
+    header.magic = MeshFileHeader::magicValue;
+    header.version = MeshFileHeader::currentVersion;
+    header.flags = options.compress ? MeshFileHeader::compressedFlag : 0;
+    header.vertexCount = (uint32_t)mesh.vertexCount();
+    header.indexCount = (uint32_t)mesh.indices.size();
+    header.vertexStride = layout.stride();
+    header.attributeCount = (uint32_t)layout.attributes().size();
+    header.lodCount = (uint32_t)chain.levels.size();
+    header.meshletCount = (uint32_t)meshlets.meshlets.size();
+    for (size_t i = 0; i < layout.attributes().size(); i++)
+    {
+        const VertexAttribute &attribute = layout.attributes()[i];
+        header.attributes[i] = {(uint8_t)attribute.semantic, (uint8_t)attribute.format,
+                                (uint16_t)attribute.offset, (uint16_t)attribute.size, 0};
+    }
+
+    glm::vec3 low(0.0f), high(0.0f);
+    for (size_t v = 0; v < mesh.vertexCount(); v++)
+    {
+        glm::vec3 p(mesh.vertices[v * MeshData::floatsPerVertex], mesh.vertices[v * MeshData::floatsPerVertex + 1],
+                    mesh.vertices[v * MeshData::floatsPerVertex + 2]);
+        low = v ? glm::min(low, p) : p;
+        high = v ? glm::max(high, p) : p;
+    }
+    std::memcpy(header.boundsMin, &low.x, sizeof(header.boundsMin));
+    std::memcpy(header.boundsMax, &high.x, sizeof(header.boundsMax));
+    header.radius = glm::length(high - low) * 0.5f;
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("cannot write " + path);
+    // the header goes in last, once the section table is known
+    out.write((const char*)&header, sizeof(header));
+
+    writeSection(out, header, MeshFileVertices, vertices);
+    if (options.compress)
+    {
+        std::vector<unsigned char> encoded = encodeIndices(chain.indices);
+        writeSection(out, header, MeshFileIndices, encoded.data(), encoded.size(), chain.indices.size() * sizeof(unsigned int));
+    }
+    else
+    {
+        writeSection(out, header, MeshFileIndices, chain.indices);
+    }
+    writeSection(out, header, MeshFileLods, chain.levels);
+    writeSection(out, header, MeshFileMeshlets, meshlets.meshlets);
+    writeSection(out, header, MeshFileMeshletBounds, meshlets.bounds);
+    writeSection(out, header, MeshFileMeshletVertices, meshlets.vertices);
+    writeSection(out, header, MeshFileMeshletTriangles, meshlets.triangles);
+
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    if (!out)
+        throw std::runtime_error("cannot write " + path);
+}
+
+MeshFile::MeshFile(const std::string &path)
+    : file(path), head((const MeshFileHeader*)file.data())
+{
+    if (file.size() < sizeof(MeshFileHeader) || head->magic != MeshFileHeader::magicValue)
+        throw std::runtime_error(path + " is not a .bmesh file");
+    if (head->version != MeshFileHeader::currentVersion)
+        throw std::runtime_error(path + " is .bmesh version " + std::to_string(head->version) + ", this build reads " +
+                                 std::to_string(MeshFileHeader::currentVersion));
+    if (head->attributeCount > (uint32_t)MeshFileHeader::maxAttributes)
+        throw std::runtime_error(path + " has a broken vertex layout");
+
+    // layout() rebuilds the attributes from semantic and format alone, the stored stride, offsets
+    // and sizes have to be what that gives or the vertex walk leaves the section
+    VertexLayout rebuilt;
+    try
+    {
+        rebuilt = layout();
+    }
+    catch (const std::invalid_argument&)
+    {
+        throw std::runtime_error(path + " has a broken vertex layout");
+    }
+    bool layoutMatches = rebuilt.stride() == head->vertexStride;
+    for (uint32_t i = 0; i < head->attributeCount && layoutMatches; i++)
+    {
+        const VertexAttribute &attribute = rebuilt.attributes()[i];
+        layoutMatches = attribute.offset == head->attributes[i].offset && attribute.size == head->attributes[i].size;
+    }
+    if (!layoutMatches)
+        throw std::runtime_error(path + " has a broken vertex layout");
+
+    for (const MeshFileSection &section : head->sections)
+    {
+        if (section.offset % sectionAlignment != 0 || section.offset > file.size() || section.size > file.size() - section.offset)
+            throw std::runtime_error(path + " is truncated or has a broken section table");
+    }
+
+    const MeshFileSection &indexSection = head->sections[MeshFileIndices];
+    bool sizesMatch = head->sections[MeshFileVertices].size == (uint64_t)head->vertexCount * head->vertexStride &&
+                      indexSection.decodedSize % sizeof(unsigned int) == 0 &&
+                      head->sections[MeshFileLods].size == (uint64_t)head->lodCount * sizeof(LodLevel) &&
+                      head->sections[MeshFileMeshlets].size == (uint64_t)head->meshletCount * sizeof(Meshlet) &&
+                      head->sections[MeshFileMeshletBounds].size == (uint64_t)head->meshletCount * sizeof(MeshletBounds);
+    if (sizesMatch && compressed())
+    {
+        // the width table has to describe exactly the bytes that follow it
+        size_t indexCount = (size_t)(indexSection.decodedSize / sizeof(unsigned int));
+        size_t blocks = blockCount(indexCount);
+        sizesMatch = indexSection.size >= blocks &&
+                     blocks + encodedBlockBytes(section(MeshFileIndices), indexCount) == indexSection.size &&
+                     (indexCount == 0 || encodedBlockBytes(section(MeshFileIndices), indexCount) != 0);
+    }
+    else if (sizesMatch)
+    {
+        sizesMatch = indexSection.size == indexSection.decodedSize;
+    }
+    if (sizesMatch)
+    {
+        uint64_t indexCount = indexSection.decodedSize / sizeof(unsigned int);
+        sizesMatch = head->indexCount <= indexCount;
+        for (const LodLevel &level : lods())
+            sizesMatch = sizesMatch && (uint64_t)level.firstIndex + level.indexCount <= indexCount;
+    }
+    if (!sizesMatch || head->sections[MeshFileMeshletVertices].size % sizeof(unsigned int) != 0)
+        throw std::runtime_error(path + " has section sizes that don't match its header");
+
+    // the indices go to the GPU as they are, compressed ones are checked by decodeIndices
+    if (!compressed() && !indicesBelow(indexData(), (size_t)(indexSection.size / sizeof(unsigned int)), head->vertexCount))
+        throw std::runtime_error(path + " has indices past its vertices");
+    if (!meshletsInRange((const Meshlet*)section(MeshFileMeshlets), head->meshletCount,
+                         (const unsigned int*)section(MeshFileMeshletVertices),
+                         (size_t)(head->sections[MeshFileMeshletVertices].size / sizeof(unsigned int)),
+                         section(MeshFileMeshletTriangles), (size_t)head->sections[MeshFileMeshletTriangles].size,
+                         head->vertexCount))
+        throw std::runtime_error(path + " has meshlets past its meshlet sections");
+}
+
+VertexLayout MeshFile::layout() const
+{
+    VertexLayout layout;
+    for (uint32_t i = 0; i < head->attributeCount; i++)
+        layout.add((VertexSemantic)head->attributes[i].semantic, (VertexFormat)head->attributes[i].format);
+    return layout;
+}
+
+const unsigned int* MeshFile::indexData() const
+{
+    return compressed() ? nullptr : (const unsigned int*)section(MeshFileIndices);
+}
+
+bool MeshFile::simdAvailable()
+{
+#ifdef CPU_X86
+    return cpuHasAvx2();
+#else
+    return false;
+#endif
+}
+
+void MeshFile::decodeIndices(unsigned int *out, bool allowSimd) const
+{
+    size_t indexCount = indexBytes() / sizeof(unsigned int);
+    if (!compressed())
+    {
+        std::memcpy(out, section(MeshFileIndices), indexBytes());
+        return;
+    }
+    unsigned int largest;
+#ifdef CPU_X86
+    if (allowSimd && simdAvailable())
+        largest = decodeIndicesAvx2(section(MeshFileIndices), indexCount, out);
+    else
+#endif
+        largest = decodeIndicesScalar(section(MeshFileIndices), indexCount, out);
+    if (indexCount > 0 && largest >= head->vertexCount)
+        throw std::runtime_error("a compressed .bmesh decodes to indices past its vertices");
+}
+
+std::vector<unsigned int> MeshFile::indices() const
+{
+    std::vector<unsigned int> out(indexBytes() / sizeof(unsigned int));
+    decodeIndices(out.data());
+    return out;
+}
+
+std::vector<LodLevel> MeshFile::lods() const
+{
+    std::vector<LodLevel> levels = readSection<LodLevel>(file.data(), head->sections[MeshFileLods]);
+    if (levels.empty())
+        levels.push_back({0, head->indexCount, 0.0f});
+    return levels;
+}
+
+MeshletData MeshFile::meshlets() const
+{
+    MeshletData data;
+    data.meshlets = readSection<Meshlet>(file.data(), head->sections[MeshFileMeshlets]);
+    data.bounds = readSection<MeshletBounds>(file.data(), head->sections[MeshFileMeshletBounds]);
+    data.vertices = readSection<unsigned int>(file.data(), head->sections[MeshFileMeshletVertices]);
+    data.triangles = readSection<unsigned char>(file.data(), head->sections[MeshFileMeshletTriangles]);
+    return data;
+}
+
+MeshData loadMeshFile(const std::string &path)
+{
+    MeshFile file(path);
+    const MeshFileHeader &header = file.header();
+    VertexLayout layout = file.layout();
+
+    MeshData mesh;
+    mesh.vertices.assign((size_t)header.vertexCount * MeshData::floatsPerVertex, 1.0f);
+    if (layout.find(VertexSemantic::Normal))
+        mesh.normals.resize((size_t)header.vertexCount * 3);
+
+    const unsigned char *bytes = (const unsigned char*)file.vertexData();
+    for (size_t v = 0; v < header.vertexCount; v++)
+    {
+        const unsigned char *vertex = bytes + v * layout.stride();
+        float *out = &mesh.vertices[v * MeshData::floatsPerVertex];
+        for (const VertexAttribute &attribute : layout.attributes())
+        {
+            // where the attribute goes in MeshData and how many floats it has there
+            float *target = attribute.semantic == VertexSemantic::Position ? out :
+                            attribute.semantic == VertexSemantic::Color ? out + 3 :
+                            attribute.semantic == VertexSemantic::TexCoord ? out + 6 : &mesh.normals[v * 3];
+            int components = attribute.semantic == VertexSemantic::TexCoord ? 2 : 3;
+            const unsigned char *source = vertex + attribute.offset;
+
+            uint32_t words[4] = {};
+            std::memcpy(words, source, attribute.size);
+            float values[4] = {};
+            switch (attribute.format)
+            {
+            case VertexFormat::Float32:
+                std::memcpy(values, source, components * sizeof(float));
+                break;
+            case VertexFormat::Half16:
+            {
+                glm::vec2 xy = glm::unpackHalf2x16(words[0]), zw = glm::unpackHalf2x16(words[1]);
+                values[0] = xy.x; values[1] = xy.y; values[2] = zw.x; values[3] = zw.y;
+                break;
+            }
+            case VertexFormat::Unorm8:
+            {
+                glm::vec4 unpacked = glm::unpackUnorm4x8(words[0]);
+                values[0] = unpacked.x; values[1] = unpacked.y; values[2] = unpacked.z;
+                break;
+            }
+            case VertexFormat::OctSnorm16:
+            {
+                // the unfolding from the vertex_layout.h comment
+                glm::vec2 oct = glm::unpackSnorm2x16(words[0]);
+                glm::vec3 n(oct, 1.0f - std::abs(oct.x) - std::abs(oct.y));
+                if (n.z < 0.0f)
+                    n = glm::vec3(std::copysign(1.0f - std::abs(n.y), n.x), std::copysign(1.0f - std::abs(n.x), n.y), n.z);
+                n = glm::normalize(n);
+                values[0] = n.x; values[1] = n.y; values[2] = n.z;
+                break;
+            }
+            }
+            std::memcpy(target, values, components * sizeof(float));
+        }
+    }
+
+    // level 0 only, like every other importer
+    std::vector<unsigned int> indices = file.indices();
+    mesh.indices.assign(indices.begin(), indices.begin() + header.indexCount);
+    return mesh;
+}
@@ -0,0 +1,1121 @@
+#include "mesh_loader.h"
+#include "mapped_file.h"
+#include "mesh_file.h"
+#include "thread_pool.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace
+{
+    // ---------------------------------------------------------------------------------------------
+    // OBJ
+
+    // OBJ chunks are cut at the first newline after every 1 MB, the cut doesn't depend on the thread
+    // count so the output is the same however many threads parse it
+    const size_t objChunkBytes = 1 << 20;
+    const uint32_t noIndex = 0xffffffffu;
+
+    struct ObjCorner
+    {
+        uint32_t position, texcoord, normal;
+
+        bool operator==(const ObjCorner &other) const
+        {
+            return position == other.position && texcoord == other.texcoord && normal == other.normal;
+        }
+    };
+
+    struct ObjChunk
+    {
+        const char *begin, *end;
+
+        // 1. attribute lines in this chunk and where they start in the shared arrays
+        size_t positionCount = 0, texcoordCount = 0, normalCount = 0;
+        size_t positionBase = 0, texcoordBase = 0, normalBase = 0;
+
+        // 2. faces as resolved corners, faceSizes holds the corner count of every polygon
+        std::vector<ObjCorner> corners;
+        std::vector<uint32_t> faceSizes;
+
+        // 3. welded output, indices are local to the chunk until they are copied out
+        std::vector<float> vertices, normals;
+        std::vector<unsigned int> indices;
+        size_t vertexBase = 0, indexBase = 0;
+
+        std::string error;
+    };
+
+    // the attributes every chunk writes into, sized after the counting pass
+    struct ObjAttributes
+    {
+        std::vector<float> positions, colors, texcoords, normals;
+    };
+
+    inline bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline const char *skipBlanks(const char *p, const char *end)
+    {
+        while (p < end && isBlank(*p))
+            p++;
+        return p;
+    }
+
+    inline const char *findLineEnd(const char *p, const char *end)
+    {
+        const void *newline = std::memchr(p, '\n', end - p);
+        return newline ? (const char*)newline : end;
+    }
+
+    inline bool parseFloat(const char *&p, const char *end, float &value)
+    {
+        p = skipBlanks(p, end);
+        if (p < end && *p == '+')   // from_chars doesn't take a leading plus
+            p++;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc())
+            return false;
+        p = result.ptr;
+        return true;
+    }
+
+    inline bool parseInt(const char *&p, const char *end, long &value)
+    {
+        if (p < end && *p == '+')
+            p++;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc())
+            return false;
+        p = result.ptr;
+        return true;
+    }
+
+    // what kind of attribute line starts at p: 'v', 't', 'n' or 0 for anything else
+    inline char attributeKind(const char *p, const char *end)
+    {
+        if (end - p < 2 || p[0] != 'v')
+            return 0;
+        if (isBlank(p[1]))
+            return 'v';
+        if (end - p >= 3 && (p[1] == 't' || p[1] == 'n') && isBlank(p[2]))
+            return p[1];
+        return 0;
+    }
+
+    void countObjChunk(ObjChunk &chunk)
+    {
+        for (const char *line = chunk.begin; line < chunk.end; )
+        {
+            const char *lineEnd = findLineEnd(line, chunk.end);
+            switch (attributeKind(skipBlanks(line, lineEnd), lineEnd))
+            {
+                case 'v': chunk.positionCount++; break;
+                case 't': chunk.texcoordCount++; break;
+                case 'n': chunk.normalCount++; break;
+            }
+            if (lineEnd == chunk.end)
+                break;
+            line = lineEnd + 1;
+        }
+    }
+
+    // one corner index, 1 based or negative (relative to the attributes read so far), 0 when absent
+    inline uint32_t resolveIndex(long index, size_t readSoFar)
+    {
+        if (index > 0)
+            return (uint32_t)(index - 1);
+        if (index < 0 && (size_t)-index <= readSoFar)
+            return (uint32_t)(readSoFar + index);
+        return noIndex;
+    }
+
+    void parseObjChunk(ObjChunk &chunk, ObjAttributes &attributes)
+    {
+        size_t positions = chunk.positionBase, texcoords = chunk.texcoordBase, normals = chunk.normalBase;
+
+        for (const char *line = chunk.begin; line < chunk.end; )
+        {
+            const char *lineEnd = findLineEnd(line, chunk.end);
+            const char *p = skipBlanks(line, lineEnd);
+
+            char kind = attributeKind(p, lineEnd);
+            if (kind == 'v')
+            {
+                p += 1;
+                float *position = &attributes.positions[positions * 3];
+                if (!parseFloat(p, lineEnd, position[0]) || !parseFloat(p, lineEnd, position[1]) ||
+                    !parseFloat(p, lineEnd, position[2]))
+                {
+                    chunk.error = "bad vertex position";
+                    return;
+                }
+
+                // vertex colors are a common extension: v x y z r g b
+                float color[3];
+                if (parseFloat(p, lineEnd, color[0]) && parseFloat(p, lineEnd, color[1]) &&
+                    parseFloat(p, lineEnd, color[2]))
+                    std::memcpy(&attributes.colors[positions * 3], color, sizeof(color));
+                positions++;
+            }
+            else if (kind == 't')
+            {
+                p += 2;
+                float *texcoord = &attributes.texcoords[texcoords * 2];
+                if (!parseFloat(p, lineEnd, texcoord[0]))
+                {
+                    chunk.error = "bad texture coordinate";
+                    return;
+                }
+                if (!parseFloat(p, lineEnd, texcoord[1]))
+                    texcoord[1] = 0.0f;
+                texcoords++;
+            }
+            else if (kind == 'n')
+            {
+                p += 2;
+                float *normal = &attributes.normals[normals * 3];
+                if (!parseFloat(p, lineEnd, normal[0]) || !parseFloat(p, lineEnd, normal[1]) ||
+                    !parseFloat(p, lineEnd, normal[2]))
+                {
+                    chunk.error = "bad vertex normal";
+                    return;
+                }
+                normals++;
+            }
+            else if (lineEnd - p >= 2 && p[0] == 'f' && isBlank(p[1]))
+            {
+                // f v, f v/vt, f v//vn or f v/vt/vn, any number of corners
+                p += 1;
+                uint32_t cornerCount = 0;
+                while (true)
+                {
+                    p = skipBlanks(p, lineEnd);
+                    if (p >= lineEnd || *p == '#')
+                        break;
+
+                    long position = 0, texcoord = 0, normal = 0;
+                    if (!parseInt(p, lineEnd, position))
+                    {
+                        chunk.error = "bad face";
+                        return;
+                    }
+                    if (p < lineEnd && *p == '/')
+                    {
+                        p++;
+                        if (p < lineEnd && *p != '/' && !parseInt(p, lineEnd, texcoord))
+                        {
+                            chunk.error = "bad face";
+                            return;
+                        }
+                        if (p < lineEnd && *p == '/')
+                        {
+                            p++;
+                            if (!parseInt(p, lineEnd, normal))
+                            {
+                                chunk.error = "bad face";
+                                return;
+                            }
+                        }
+                    }
+
+                    ObjCorner corner = {resolveIndex(position, positions),
+                                        texcoord ? resolveIndex(texcoord, texcoords) : noIndex,
+                                        normal ? resolveIndex(normal, normals) : noIndex};
+                    if (corner.position == noIndex || (texcoord && corner.texcoord == noIndex) ||
+                        (normal && corner.normal == noIndex))
+                    {
+                        chunk.error = "face index out of range";
+                        return;
+                    }
+                    chunk.corners.push_back(corner);
+                    cornerCount++;
+                }
+
+                if (cornerCount < 3)
+                {
+                    chunk.error = "face with less than 3 corners";
+                    return;
+                }
+                chunk.faceSizes.push_back(cornerCount);
+            }
+            // comments, groups, materials, smoothing groups, lines and points are skipped
+
+            if (lineEnd == chunk.end)
+                break;
+            line = lineEnd + 1;
+        }
+    }
+
+    inline uint32_t hashCorner(const ObjCorner &corner)
+    {
+        uint32_t hash = corner.position * 0x9e3779b1u;
+        hash ^= (corner.texcoord + 0x7f4a7c15u) * 0x85ebca6bu;
+        hash ^= (corner.normal + 0x165667b1u) * 0xc2b2ae35u;
+        return hash ^ (hash >> 15);
+    }
+
+    void weldObjChunk(ObjChunk &chunk, const ObjAttributes &attributes, bool withNormals)
+    {
+        size_t positionTotal = attributes.positions.size() / 3;
+        size_t texcoordTotal = attributes.texcoords.size() / 2;
+        size_t normalTotal = attributes.normals.size() / 3;
+
+        // open addressing table of vertex index + 1, at most half full
+        size_t tableSize = 16;
+        while (tableSize < chunk.corners.size() * 2)
+            tableSize *= 2;
+        std::vector<uint32_t> table(tableSize, 0);
+        std::vector<ObjCorner> unique;
+        std::vector<uint32_t> cornerVertex(chunk.corners.size());
+
+        for (size_t i = 0; i < chunk.corners.size(); i++)
+        {
+            const ObjCorner &corner = chunk.corners[i];
+            if (corner.position >= positionTotal ||
+                (corner.texcoord != noIndex && corner.texcoord >= texcoordTotal) ||
+                (corner.normal != noIndex && corner.normal >= normalTotal))
+            {
+                chunk.error = "face index out of range";
+                return;
+            }
+
+            size_t slot = hashCorner(corner) & (tableSize - 1);
+            while (table[slot] && !(unique[table[slot] - 1] == corner))
+                slot = (slot + 1) & (tableSize - 1);
+            if (!table[slot])
+            {
+                unique.push_back(corner);
+                table[slot] = (uint32_t)unique.size();
+            }
+            cornerVertex[i] = table[slot] - 1;
+        }
+
+        chunk.vertices.resize(unique.size() * MeshData::floatsPerVertex);
+        if (withNormals)
+            chunk.normals.resize(unique.size() * 3);
+        for (size_t i = 0; i < unique.size(); i++)
+        {
+            const ObjCorner &corner = unique[i];
+            float *vertex = &chunk.vertices[i * MeshData::floatsPerVertex];
+            std::memcpy(vertex, &attributes.positions[corner.position * 3], 3 * sizeof(float));
+            std::memcpy(vertex + 3, &attributes.colors[corner.position * 3], 3 * sizeof(float));
+            if (corner.texcoord != noIndex)
+                std::memcpy(vertex + 6, &attributes.texcoords[corner.texcoord * 2], 2 * sizeof(float));
+            else
+                vertex[6] = vertex[7] = 0.0f;
+
+            if (withNormals)
+            {
+                float *normal = &chunk.normals[i * 3];
+                if (corner.normal != noIndex)
+                    std::memcpy(normal, &attributes.normals[corner.normal * 3], 3 * sizeof(float));
+                else
+                    normal[0] = normal[1] = normal[2] = 0.0f;
+            }
+        }
+
+        // fan every polygon into triangles
+        size_t triangles = 0;
+        for (uint32_t size : chunk.faceSizes)
+            triangles += size - 2;
+        chunk.indices.reserve(triangles * 3);
+
+        size_t first = 0;
+        for (uint32_t size : chunk.faceSizes)
+        {
+            for (uint32_t corner = 1; corner + 1 < size; corner++)
+            {
+                chunk.indices.push_back(cornerVertex[first]);
+                chunk.indices.push_back(cornerVertex[first + corner]);
+                chunk.indices.push_back(cornerVertex[first + corner + 1]);
+            }
+            first += size;
+        }
+
+        // the corners are not needed anymore, give the memory back before the final copy
+        std::vector<ObjCorner>().swap(chunk.corners);
+        std::vector<uint32_t>().swap(chunk.faceSizes);
+    }
+
+    // runs step on every chunk in parallel and throws the first error any of them reported
+    template <typename Step>
+    void forEachChunk(ThreadPool &pool, std::vector<ObjChunk> &chunks, const std::string &path, Step step)
+    {
+        pool.parallelFor((int)chunks.size(), [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+                step(chunks[i]);
+        });
+
+        for (const ObjChunk &chunk : chunks)
+        {
+            if (!chunk.error.empty())
+                throw std::runtime_error(chunk.error + " in " + path);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // glTF
+
+    // just enough JSON for a glTF header, objects keep their keys in order next to the values
+    struct Json
+    {
+        enum Type { Null, Bool, Number, String, Array, Object };
+
+        Type type = Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string text;
+        std::vector<Json> items;
+        std::vector<std::string> keys;   // object member names, keys[i] belongs to items[i]
+
+        const Json *find(const char *key) const
+        {
+            if (type != Object)
+                return nullptr;
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (keys[i] == key)
+                    return &items[i];
+            }
+            return nullptr;
+        }
+
+        // element i of an array, null when out of range
+        const Json *at(size_t i) const
+        {
+            return type == Array && i < items.size() ? &items[i] : nullptr;
+        }
+
+        double numberOr(const char *key, double fallback) const
+        {
+            const Json *value = find(key);
+            return value && value->type == Number ? value->number : fallback;
+        }
+
+        std::string textOr(const char *key, const std::string &fallback) const
+        {
+            const Json *value = find(key);
+            return value && value->type == String ? value->text : fallback;
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const char *begin, const char *end) : p(begin), end(end) {}
+
+        Json parseDocument()
+        {
+            Json value = parseValue(0);
+            skipWhitespace();
+            if (p != end)
+                fail();
+            return value;
+        }
+
+    private:
+        const char *p, *end;
+
+        [[noreturn]] void fail()
+        {
+            throw std::runtime_error("malformed glTF JSON");
+        }
+
+        void skipWhitespace()
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                p++;
+        }
+
+        bool consume(const char *literal)
+        {
+            size_t length = std::strlen(literal);
+            if ((size_t)(end - p) < length || std::memcmp(p, literal, length) != 0)
+                return false;
+            p += length;
+            return true;
+        }
+
+        Json parseValue(int depth)
+        {
+            if (depth > 64)
+                fail();
+
+            skipWhitespace();
+            if (p >= end)
+                fail();
+
+            Json value;
+            if (*p == '{')
+            {
+                value.type = Json::Object;
+                p++;
+                skipWhitespace();
+                if (p < end && *p == '}')
+                {
+                    p++;
+                    return value;
+                }
+                while (true)
+                {
+                    skipWhitespace();
+                    if (p >= end || *p != '"')
+                        fail();
+                    value.keys.push_back(parseString());
+                    skipWhitespace();
+                    if (p >= end || *p++ != ':')
+                        fail();
+                    value.items.push_back(parseValue(depth + 1));
+                    skipWhitespace();
+                    if (p >= end)
+                        fail();
+                    if (*p == ',')
+                    {
+                        p++;
+                        continue;
+                    }
+                    if (*p++ != '}')
+                        fail();
+                    return value;
+                }
+            }
+            if (*p == '[')
+            {
+                value.type = Json::Array;
+                p++;
+                skipWhitespace();
+                if (p < end && *p == ']')
+                {
+                    p++;
+                    return value;
+                }
+                while (true)
+                {
+                    value.items.push_back(parseValue(depth + 1));
+                    skipWhitespace();
+                    if (p >= end)
+                        fail();
+                    if (*p == ',')
+                    {
+                        p++;
+                        continue;
+                    }
+                    if (*p++ != ']')
+                        fail();
+                    return value;
+                }
+            }
+            if (*p == '"')
+            {
+                value.type = Json::String;
+                value.text = parseString();
+                return value;
+            }
+            if (consume("true"))
+            {
+                value.type = Json::Bool;
+                value.boolean = true;
+                return value;
+            }
+            if (consume("false"))
+            {
+                value.type = Json::Bool;
+                return value;
+            }
+            if (consume("null"))
+                return value;
+
+            value.type = Json::Number;
+            std::from_chars_result result = std::from_chars(p, end, value.number);
+            if (result.ec != std::errc())
+                fail();
+            p = result.ptr;
+            return value;
+        }
+
+        std::string parseString()
+        {
+            p++;   // opening quote
+            std::string text;
+            while (true)
+            {
+                if (p >= end)
+                    fail();
+                char c = *p++;
+                if (c == '"')
+                    return text;
+                if (c != '\\')
+                {
+                    text.push_back(c);
+                    continue;
+                }
+
+                if (p >= end)
+                    fail();
+                char escape = *p++;
+                switch (escape)
+                {
+                    case '"': case '\\': case '/': text.push_back(escape); break;
+                    case 'b': text.push_back('\b'); break;
+                    case 'f': text.push_back('\f'); break;
+                    case 'n': text.push_back('\n'); break;
+                    case 'r': text.push_back('\r'); break;
+                    case 't': text.push_back('\t'); break;
+                    case 'u':
+                    {
+                        // names in glTF are informational, surrogate pairs are kept as two code points
+                        unsigned int code = 0;
+                        if (end - p < 4 || std::from_chars(p, p + 4, code, 16).ptr != p + 4)
+                            fail();
+                        p += 4;
+                        if (code < 0x80)
+                            text.push_back((char)code);
+                        else if (code < 0x800)
+                        {
+                            text.push_back((char)(0xc0 | (code >> 6)));
+                            text.push_back((char)(0x80 | (code & 0x3f)));
+                        }
+                        else
+                        {
+                            text.push_back((char)(0xe0 | (code >> 12)));
+                            text.push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+                            text.push_back((char)(0x80 | (code & 0x3f)));
+                        }
+                        break;
+                    }
+                    default: fail();
+                }
+            }
+        }
+    };
+
+    enum
+    {
+        GLTF_BYTE = 5120,
+        GLTF_UNSIGNED_BYTE = 5121,
+        GLTF_SHORT = 5122,
+        GLTF_UNSIGNED_SHORT = 5123,
+        GLTF_UNSIGNED_INT = 5125,
+        GLTF_FLOAT = 5126,
+        GLTF_TRIANGLES = 4
+    };
+
+    // a typed window into the mapped BIN chunk, nothing is copied until an element is read
+    struct AccessorView
+    {
+        const unsigned char *data = nullptr;
+        size_t stride = 0, count = 0;
+        int componentType = 0, components = 0;
+        bool normalized = false;
+
+        float component(size_t element, int c) const
+        {
+            const unsigned char *at = data + element * stride;
+            switch (componentType)
+            {
+                case GLTF_FLOAT:
+                {
+                    float value;
+                    std::memcpy(&value, at + c * 4, 4);
+                    return value;
+                }
+                case GLTF_UNSIGNED_BYTE:
+                    return normalized ? at[c] / 255.0f : at[c];
+                case GLTF_BYTE:
+                {
+                    float value = (signed char)at[c];
+                    return normalized ? std::max(value / 127.0f, -1.0f) : value;
+                }
+                case GLTF_UNSIGNED_SHORT:
+                {
+                    uint16_t value;
+                    std::memcpy(&value, at + c * 2, 2);
+                    return normalized ? value / 65535.0f : value;
+                }
+                case GLTF_SHORT:
+                {
+                    int16_t value;
+                    std::memcpy(&value, at + c * 2, 2);
+                    return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+                }
+                case GLTF_UNSIGNED_INT:
+                {
+                    uint32_t value;
+                    std::memcpy(&value, at + c * 4, 4);
+                    return (float)value;
+                }
+            }
+            return 0.0f;
+        }
+
+        uint32_t index(size_t element) const
+        {
+            const unsigned char *at = data + element * stride;
+            switch (componentType)
+            {
+                case GLTF_UNSIGNED_BYTE:
+                    return at[0];
+                case GLTF_UNSIGNED_SHORT:
+                {
+                    uint16_t value;
+                    std::memcpy(&value, at, 2);
+                    return value;
+                }
+                case GLTF_UNSIGNED_INT:
+                {
+                    uint32_t value;
+                    std::memcpy(&value, at, 4);
+                    return value;
+                }
+            }
+            return 0;
+        }
+    };
+
+    struct GlbFile
+    {
+        Json json;
+        const unsigned char *bin = nullptr;
+        size_t binSize = 0;
+    };
+
+    int componentSize(int componentType)
+    {
+        switch (componentType)
+        {
+            case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+            case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+            case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+        }
+        throw std::runtime_error("unknown glTF component type " + std::to_string(componentType));
+    }
+
+    int componentCount(const std::string &type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        throw std::runtime_error("unsupported glTF accessor type " + type);
+    }
+
+    AccessorView accessorView(const GlbFile &glb, size_t accessorIndex)
+    {
+        const Json *accessors = glb.json.find("accessors");
+        const Json *accessor = accessors ? accessors->at(accessorIndex) : nullptr;
+        if (!accessor)
+            throw std::runtime_error("glTF accessor " + std::to_string(accessorIndex) + " does not exist");
+        if (accessor->find("sparse"))
+            throw std::runtime_error("sparse glTF accessors are not supported");
+
+        // counts end up as ints in parallelFor, and a count past the buffer would overflow the bounds check
+        double count = accessor->numberOr("count", 0);
+        if (!(count >= 1.0 && count <= INT_MAX))
+            throw std::runtime_error("glTF accessor " + std::to_string(accessorIndex) + " has a bad count");
+
+        AccessorView view;
+        view.count = (size_t)count;
+        view.componentType = (int)accessor->numberOr("componentType", 0);
+        view.components = componentCount(accessor->textOr("type", ""));
+        const Json *normalized = accessor->find("normalized");
+        view.normalized = normalized && normalized->type == Json::Bool && normalized->boolean;
+
+        size_t elementSize = (size_t)componentSize(view.componentType) * view.components;
+        const Json *viewIndex = accessor->find("bufferView");
+        if (!viewIndex)
+            throw std::runtime_error("glTF accessors without a buffer view are not supported");
+
+        const Json *bufferViews = glb.json.find("bufferViews");
+        const Json *bufferView = bufferViews ? bufferViews->at((size_t)viewIndex->number) : nullptr;
+        if (!bufferView)
+            throw std::runtime_error("glTF buffer view does not exist");
+
+        // buffer 0 without a uri is the GLB BIN chunk, that is the only buffer we map
+        const Json *buffers = glb.json.find("buffers");
+        const Json *buffer = buffers ? buffers->at((size_t)bufferView->numberOr("buffer", 0)) : nullptr;
+        if (!buffer || bufferView->numberOr("buffer", 0) != 0 || buffer->find("uri") || !glb.bin)
+            throw std::runtime_error("only the embedded GLB buffer is supported");
+
+        double viewOffset = bufferView->numberOr("byteOffset", 0), viewLength = bufferView->numberOr("byteLength", 0);
+        double accessorOffset = accessor->numberOr("byteOffset", 0), stride = bufferView->numberOr("byteStride", 0);
+        if (!(viewOffset >= 0.0 && viewLength >= 0.0 && accessorOffset >= 0.0 && stride >= 0.0 && stride <= 255.0 &&
+              viewOffset + viewLength <= (double)glb.binSize && accessorOffset <= viewLength))
+            throw std::runtime_error("glTF accessor " + std::to_string(accessorIndex) + " is out of bounds");
+
+        size_t offset = (size_t)viewOffset + (size_t)accessorOffset;
+        size_t viewEnd = (size_t)viewOffset + (size_t)viewLength;
+        view.stride = (size_t)stride;
+        if (view.stride == 0)
+            view.stride = elementSize;
+
+        // the last element has to end inside the view, worked out without multiplying the count
+        if (view.stride < elementSize || viewEnd - offset < elementSize ||
+            view.count > (viewEnd - offset - elementSize) / view.stride + 1)
+            throw std::runtime_error("glTF accessor " + std::to_string(accessorIndex) + " is out of bounds");
+
+        view.data = glb.bin + offset;
+        return view;
+    }
+
+    glm::mat4 nodeTransform(const Json &node)
+    {
+        const Json *matrix = node.find("matrix");
+        if (matrix && matrix->type == Json::Array && matrix->items.size() == 16)
+        {
+            float values[16];
+            for (int i = 0; i < 16; i++)
+                values[i] = (float)matrix->items[i].number;
+            return glm::make_mat4(values);   // column major like glTF
+        }
+
+        glm::vec3 translation(0.0f), scale(1.0f);
+        glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+        const Json *t = node.find("translation");
+        if (t && t->items.size() == 3)
+            translation = glm::vec3(t->items[0].number, t->items[1].number, t->items[2].number);
+        const Json *r = node.find("rotation");
+        if (r && r->items.size() == 4)   // glTF stores x y z w
+            rotation = glm::quat((float)r->items[3].number, (float)r->items[0].number,
+                                 (float)r->items[1].number, (float)r->items[2].number);
+        const Json *s = node.find("scale");
+        if (s && s->items.size() == 3)
+            scale = glm::vec3(s->items[0].number, s->items[1].number, s->items[2].number);
+
+        return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) *
+               glm::scale(glm::mat4(1.0f), scale);
+    }
+
+    void appendPrimitive(const GlbFile &glb, const Json &primitive, const glm::mat4 &transform,
+                         MeshData &mesh, bool withNormals, ThreadPool &pool)
+    {
+        if (primitive.numberOr("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES)
+            return;   // points, lines and strips are not imported
+
+        const Json *attributes = primitive.find("attributes");
+        const Json *positionIndex = attributes ? attributes->find("POSITION") : nullptr;
+        if (!positionIndex)
+            return;
+
+        AccessorView positions = accessorView(glb, (size_t)positionIndex->number);
+        AccessorView normals, texcoords, colors;
+        if (const Json *index = attributes->find("NORMAL"))
+            normals = accessorView(glb, (size_t)index->number);
+        if (const Json *index = attributes->find("TEXCOORD_0"))
+            texcoords = accessorView(glb, (size_t)index->number);
+        if (const Json *index = attributes->find("COLOR_0"))
+            colors = accessorView(glb, (size_t)index->number);
+        if ((normals.data && normals.count != positions.count) || (texcoords.data && texcoords.count != positions.count) ||
+            (colors.data && colors.count != positions.count))
+            throw std::runtime_error("glTF attributes of one primitive differ in count");
+        // component() doesn't check c against the element, the types have to hold what is read below
+        if (positions.components != 3 || (normals.data && normals.components != 3) ||
+            (texcoords.data && texcoords.components != 2) || (colors.data && colors.components < 3))
+            throw std::runtime_error("glTF attribute has the wrong type (POSITION and NORMAL are VEC3, TEXCOORD_0 VEC2)");
+
+        size_t vertexBase = mesh.vertexCount();
+        size_t vertexCount = positions.count;
+        mesh.vertices.resize((vertexBase + vertexCount) * MeshData::floatsPerVertex);
+        if (withNormals)
+            mesh.normals.resize((vertexBase + vertexCount) * 3);
+
+        glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+        pool.parallelFor((int)vertexCount, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                float *vertex = &mesh.vertices[(vertexBase + i) * MeshData::floatsPerVertex];
+                glm::vec4 position = transform * glm::vec4(positions.component(i, 0), positions.component(i, 1),
+                                                           positions.component(i, 2), 1.0f);
+                vertex[0] = position.x;
+                vertex[1] = position.y;
+                vertex[2] = position.z;
+                for (int c = 0; c < 3; c++)
+                    vertex[3 + c] = colors.data ? colors.component(i, c) : 1.0f;
+                vertex[6] = texcoords.data ? texcoords.component(i, 0) : 0.0f;
+                vertex[7] = texcoords.data ? texcoords.component(i, 1) : 0.0f;
+
+                if (withNormals)
+                {
+                    glm::vec3 normal(0.0f);
+                    if (normals.data)
+                    {
+                        normal = normalTransform * glm::vec3(normals.component(i, 0), normals.component(i, 1),
+                                                             normals.component(i, 2));
+                        float length = glm::length(normal);
+                        if (length > 0.0f)
+                            normal /= length;
+                    }
+                    float *out = &mesh.normals[(vertexBase + i) * 3];
+                    out[0] = normal.x;
+                    out[1] = normal.y;
+                    out[2] = normal.z;
+                }
+            }
+        }, 4096);
+
+        // without indices every three vertices are a triangle
+        size_t indexBase = mesh.indices.size();
+        const Json *indicesIndex = primitive.find("indices");
+        if (!indicesIndex)
+        {
+            mesh.indices.resize(indexBase + vertexCount / 3 * 3);
+            for (size_t i = 0; i < vertexCount / 3 * 3; i++)
+                mesh.indices[indexBase + i] = (unsigned int)(vertexBase + i);
+            return;
+        }
+
+        AccessorView indices = accessorView(glb, (size_t)indicesIndex->number);
+        if (indices.components != 1 || indices.componentType == GLTF_FLOAT || indices.componentType == GLTF_BYTE ||
+            indices.componentType == GLTF_SHORT)
+            throw std::runtime_error("glTF indices have to be SCALAR unsigned integers");
+
+        size_t indexCount = indices.count / 3 * 3;
+        mesh.indices.resize(indexBase + indexCount);
+        std::atomic<bool> outOfRange(false);
+        pool.parallelFor((int)indexCount, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                uint32_t index = indices.index(i);
+                if (index >= vertexCount)
+                    outOfRange = true;
+                mesh.indices[indexBase + i] = (unsigned int)(vertexBase + index);
+            }
+        }, 16384);
+        if (outOfRange)
+            throw std::runtime_error("glTF index out of range");
+    }
+
+    void appendNode(const GlbFile &glb, size_t nodeIndex, const glm::mat4 &parent, MeshData &mesh,
+                    bool withNormals, ThreadPool &pool, int depth)
+    {
+        const Json *nodes = glb.json.find("nodes");
+        const Json *node = nodes ? nodes->at(nodeIndex) : nullptr;
+        if (!node || depth > 64)
+            throw std::runtime_error("bad glTF node hierarchy");
+
+        glm::mat4 transform = parent * nodeTransform(*node);
+        if (const Json *meshIndex = node->find("mesh"))
+        {
+            const Json *meshes = glb.json.find("meshes");
+            const Json *gltfMesh = meshes ? meshes->at((size_t)meshIndex->number) : nullptr;
+            const Json *primitives = gltfMesh ? gltfMesh->find("primitives") : nullptr;
+            if (!primitives)
+                throw std::runtime_error("glTF mesh " + std::to_string((size_t)meshIndex->number) + " does not exist");
+            for (const Json &primitive : primitives->items)
+                appendPrimitive(glb, primitive, transform, mesh, withNormals, pool);
+        }
+
+        if (const Json *children = node->find("children"))
+        {
+            for (const Json &child : children->items)
+                appendNode(glb, (size_t)child.number, transform, mesh, withNormals, pool, depth + 1);
+        }
+    }
+
+    // normals are kept for the whole mesh when any primitive has them
+    bool anyPrimitiveHasNormals(const Json &json)
+    {
+        const Json *meshes = json.find("meshes");
+        if (!meshes)
+            return false;
+        for (const Json &gltfMesh : meshes->items)
+        {
+            const Json *primitives = gltfMesh.find("primitives");
+            for (size_t i = 0; primitives && i < primitives->items.size(); i++)
+            {
+                const Json *attributes = primitives->items[i].find("attributes");
+                if (attributes && attributes->find("NORMAL"))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    inline uint32_t readU32(const unsigned char *p)
+    {
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+}
+
+
+MeshData loadObj(const std::string &path, ThreadPool &pool)
+{
+    MappedFile file(path);
+    file.adviseSequential();
+    const char *begin = (const char*)file.data();
+    const char *end = begin + file.size();
+
+    // cut at the first newline after every objChunkBytes
+    std::vector<ObjChunk> chunks;
+    for (const char *chunkBegin = begin; chunkBegin < end; )
+    {
+        const char *chunkEnd = chunkBegin + std::min(objChunkBytes, (size_t)(end - chunkBegin));
+        if (chunkEnd < end)
+            chunkEnd = findLineEnd(chunkEnd, end);
+        ObjChunk chunk;
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunks.push_back(std::move(chunk));
+        if (chunkEnd == end)
+            break;
+        chunkBegin = chunkEnd + 1;
+    }
+
+    // 1. count attribute lines, then every chunk knows where its attributes go
+    forEachChunk(pool, chunks, path, countObjChunk);
+
+    size_t positionTotal = 0, texcoordTotal = 0, normalTotal = 0;
+    for (ObjChunk &chunk : chunks)
+    {
+        chunk.positionBase = positionTotal;
+        chunk.texcoordBase = texcoordTotal;
+        chunk.normalBase = normalTotal;
+        positionTotal += chunk.positionCount;
+        texcoordTotal += chunk.texcoordCount;
+        normalTotal += chunk.normalCount;
+    }
+
+    // 2. parse, positions without a color are white
+    ObjAttributes attributes;
+    attributes.positions.resize(positionTotal * 3);
+    attributes.colors.assign(positionTotal * 3, 1.0f);
+    attributes.texcoords.resize(texcoordTotal * 2);
+    attributes.normals.resize(normalTotal * 3);
+    forEachChunk(pool, chunks, path, [&](ObjChunk &chunk) { parseObjChunk(chunk, attributes); });
+
+    // 3. weld corners into vertices and triangulate
+    bool withNormals = normalTotal > 0;
+    forEachChunk(pool, chunks, path, [&](ObjChunk &chunk) { weldObjChunk(chunk, attributes, withNormals); });
+
+    // 4. concatenate
+    size_t vertexTotal = 0, indexTotal = 0;
+    for (ObjChunk &chunk : chunks)
+    {
+        chunk.vertexBase = vertexTotal;
+        chunk.indexBase = indexTotal;
+        vertexTotal += chunk.vertices.size() / MeshData::floatsPerVertex;
+        indexTotal += chunk.indices.size();
+    }
+
+    MeshData mesh;
+    mesh.vertices.resize(vertexTotal * MeshData::floatsPerVertex);
+    mesh.indices.resize(indexTotal);
+    if (withNormals)
+        mesh.normals.resize(vertexTotal * 3);
+
+    forEachChunk(pool, chunks, path, [&](ObjChunk &chunk)
+    {
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(),
+                  mesh.vertices.begin() + chunk.vertexBase * MeshData::floatsPerVertex);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + chunk.vertexBase * 3);
+        for (size_t i = 0; i < chunk.indices.size(); i++)
+            mesh.indices[chunk.indexBase + i] = chunk.indices[i] + (unsigned int)chunk.vertexBase;
+    });
+
+    return mesh;
+}
+
+MeshData loadGlb(const std::string &path, ThreadPool &pool)
+{
+    MappedFile file(path);
+    const unsigned char *bytes = file.data();
+    size_t size = file.size();
+
+    // 12 byte header: magic "glTF", version 2, total length
+    if (size < 20 || std::memcmp(bytes, "glTF", 4) != 0)
+        throw std::runtime_error(path + " is not a binary glTF file");
+    if (readU32(bytes + 4) != 2)
+        throw std::runtime_error(path + " is not glTF 2.0");
+    size = std::min(size, (size_t)readU32(bytes + 8));
+
+    // chunks: length, type, data padded to 4 bytes. the first one is JSON, BIN is optional
+    GlbFile glb;
+    bool haveJson = false;
+    for (size_t offset = 12; offset + 8 <= size; )
+    {
+        size_t length = readU32(bytes + offset);
+        uint32_t type = readU32(bytes + offset + 4);
+        const unsigned char *data = bytes + offset + 8;
+        if (length > size - offset - 8)
+            throw std::runtime_error(path + " has a truncated chunk");
+
+        if (type == 0x4e4f534a && !haveJson)   // "JSON"
+        {
+            glb.json = JsonParser((const char*)data, (const char*)data + length).parseDocument();
+            haveJson = true;
+        }
+        else if (type == 0x004e4942 && !glb.bin)   // "BIN\0"
+        {
+            glb.bin = data;
+            glb.binSize = length;
+        }
+        offset += 8 + ((length + 3) & ~(size_t)3);
+    }
+    if (!haveJson)
+        throw std::runtime_error(path + " has no JSON chunk");
+
+    MeshData mesh;
+    bool withNormals = anyPrimitiveHasNormals(glb.json);
+
+    // the default scene (or the first), files without scenes get every mesh untransformed
+    const Json *scenes = glb.json.find("scenes");
+    const Json *scene = scenes ? scenes->at((size_t)glb.json.numberOr("scene", 0)) : nullptr;
+    if (scene)
+    {
+        if (const Json *nodes = scene->find("nodes"))
+        {
+            for (const Json &node : nodes->items)
+                appendNode(glb, (size_t)node.number, glm::mat4(1.0f), mesh, withNormals, pool, 0);
+        }
+    }
+    else if (const Json *meshes = glb.json.find("meshes"))
+    {
+        for (const Json &gltfMesh : meshes->items)
+        {
+            if (const Json *primitives = gltfMesh.find("primitives"))
+            {
+                for (const Json &primitive : primitives->items)
+                    appendPrimitive(glb, primitive, glm::mat4(1.0f), mesh, withNormals, pool);
+            }
+        }
+    }
+
+    return mesh;
+}
+
+MeshData loadMesh(const std::string &path, ThreadPool &pool)
+{
+    std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return (char)std::tolower(c); });
+
+    if (extension == ".obj")
+        return loadObj(path, pool);
+    if (extension == ".glb")
+        return loadGlb(path, pool);
+    if (extension == ".bmesh")
+        return loadMeshFile(path);
+    throw std::runtime_error("unsupported mesh format " + path + " (.obj, .glb and .bmesh are supported)");
+}
+
+MeshData loadMesh(const std::string &path)
+{
+    return loadMesh(path, threadPool());
+}
@@ -0,0 +1,504 @@
+#include "mesh_optimizer.h"
+#include "mesh_loader.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace
+{
+    // vertex -> triangles that use it. the first live[v] entries of a vertex's range are the
+    // triangles that still have to be emitted, emitted ones are swapped behind them
+    struct TriangleAdjacency
+    {
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> live;
+        std::vector<unsigned int> triangles;
+
+        TriangleAdjacency(const std::vector<unsigned int> &indices, size_t vertexCount)
+            : offsets(vertexCount + 1, 0), live(vertexCount, 0), triangles(indices.size())
+        {
+            for (unsigned int index : indices)
+            {
+                if (index >= vertexCount)
+                    throw std::runtime_error("mesh index out of range");
+                live[index]++;
+            }
+            for (size_t v = 0; v < vertexCount; v++)
+                offsets[v + 1] = offsets[v] + live[v];
+
+            std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+        }
+
+        void remove(unsigned int vertex, unsigned int triangle)
+        {
+            unsigned int *begin = &triangles[offsets[vertex]];
+            unsigned int *end = begin + live[vertex];
+            unsigned int *found = std::find(begin, end, triangle);
+            if (found != end)
+            {
+                std::swap(*found, end[-1]);
+                live[vertex]--;
+            }
+        }
+    };
+
+    // FIFO cache by insertion time, a vertex is in the cache while fewer than size vertices came after it.
+    // reset() empties it by moving the clock past every entry
+    struct FifoCache
+    {
+        std::vector<uint64_t> inserted;
+        uint64_t time;
+        uint64_t size;
+
+        FifoCache(size_t entries, int cacheSize)
+            : inserted(entries, 0), time((uint64_t)cacheSize + 1), size((uint64_t)cacheSize) {}
+
+        // true on a miss
+        bool touch(size_t entry)
+        {
+            if (time - inserted[entry] < size)
+                return false;
+            inserted[entry] = ++time;
+            return true;
+        }
+
+        void reset()
+        {
+            time += size + 1;
+        }
+    };
+
+    // Forsyth's scoring constants, the simulated cache is LRU with 32 entries
+    const int forsythCacheSize = 32;
+    const float forsythCacheDecayPower = 1.5f;
+    const float forsythLastTriangleScore = 0.75f;
+    const float forsythValenceBoostScale = 2.0f;
+    const float forsythValenceBoostPower = 0.5f;
+
+    struct ForsythScores
+    {
+        float position[forsythCacheSize];
+        float valence[64];
+
+        ForsythScores()
+        {
+            for (int i = 0; i < forsythCacheSize; i++)
+            {
+                // the three vertices of the last triangle get a fixed score so the next triangle
+                // doesn't just continue the strip
+                if (i < 3)
+                    position[i] = forsythLastTriangleScore;
+                else
+                    position[i] = std::pow(1.0f - (float)(i - 3) / (forsythCacheSize - 3), forsythCacheDecayPower);
+            }
+            valence[0] = 0.0f;
+            for (int i = 1; i < 64; i++)
+                valence[i] = forsythValenceBoostScale * std::pow((float)i, -forsythValenceBoostPower);
+        }
+
+        float vertex(int cachePosition, unsigned int liveTriangles) const
+        {
+            if (liveTriangles == 0)
+                return 0.0f;
+            float score = cachePosition >= 0 ? position[cachePosition] : 0.0f;
+            if (liveTriangles < 64)
+                return score + valence[liveTriangles];
+            return score + forsythValenceBoostScale * std::pow((float)liveTriangles, -forsythValenceBoostPower);
+        }
+    };
+}
+
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount, int cacheSize)
+{
+    VertexCacheStats stats;
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    for (unsigned int index : indices)
+    {
+        if (index >= vertexCount)
+            throw std::runtime_error("mesh index out of range");
+        if (cache.touch(index))
+            stats.misses++;
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            stats.vertices++;
+        }
+    }
+
+    stats.triangles = indices.size() / 3;
+    stats.acmr = stats.triangles ? (double)stats.misses / stats.triangles : 0.0;
+    stats.atvr = stats.vertices ? (double)stats.misses / stats.vertices : 0.0;
+    return stats;
+}
+
+VertexFetchStats analyzeVertexFetch(const std::vector<unsigned int> &indices, size_t vertexCount, size_t vertexStride)
+{
+    const size_t lineSize = 64;
+    const int lineCount = 16 * 1024 / lineSize;
+
+    VertexFetchStats stats;
+    FifoCache cache((vertexCount * vertexStride + lineSize - 1) / lineSize, lineCount);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t referencedBytes = 0;
+    for (unsigned int index : indices)
+    {
+        if (index >= vertexCount)
+            throw std::runtime_error("mesh index out of range");
+
+        size_t first = index * vertexStride / lineSize;
+        size_t last = ((size_t)index * vertexStride + vertexStride - 1) / lineSize;
+        for (size_t line = first; line <= last; line++)
+        {
+            if (cache.touch(line))
+                stats.bytesFetched += lineSize;
+        }
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            referencedBytes += vertexStride;
+        }
+    }
+
+    stats.overfetch = referencedBytes ? (double)stats.bytesFetched / referencedBytes : 0.0;
+    return stats;
+}
+
+void optimizeVertexCacheForsyth(std::vector<unsigned int> &indices, size_t vertexCount)
+{
+    static const ForsythScores scores;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    TriangleAdjacency adjacency(indices, vertexCount);
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = scores.vertex(-1, adjacency.live[v]);
+
+    size_t best = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const unsigned int *triangle = &indices[t * 3];
+        triangleScore[t] = vertexScore[triangle[0]] + vertexScore[triangle[1]] + vertexScore[triangle[2]];
+        if (triangleScore[t] > triangleScore[best])
+            best = t;
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    unsigned int cache[forsythCacheSize + 3];
+    int cacheCount = 0;
+    size_t cursor = 0;   // no triangle before this one is left, for when the cache runs dry
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if (best == (size_t)-1)
+        {
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+
+        const unsigned int *triangle = &indices[best * 3];
+        emitted[best] = true;
+        output.insert(output.end(), triangle, triangle + 3);
+        for (int corner = 0; corner < 3; corner++)
+            adjacency.remove(triangle[corner], (unsigned int)best);
+
+        // the triangle's vertices go to the front, everything else moves back
+        unsigned int newCache[forsythCacheSize + 3];
+        int newCount = 0;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            if (std::find(newCache, newCache + newCount, triangle[corner]) == newCache + newCount)
+                newCache[newCount++] = triangle[corner];
+        }
+        int triangleVertices = newCount;
+        for (int i = 0; i < cacheCount; i++)
+        {
+            if (std::find(newCache, newCache + triangleVertices, cache[i]) == newCache + triangleVertices)
+                newCache[newCount++] = cache[i];
+        }
+
+        // rescore everything that moved, including what fell out the back
+        for (int i = 0; i < newCount; i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < forsythCacheSize ? i : -1;
+            vertexScore[v] = scores.vertex(cachePosition[v], adjacency.live[v]);
+        }
+        for (int i = 0; i < newCount; i++)
+        {
+            unsigned int v = newCache[i];
+            for (unsigned int k = 0; k < adjacency.live[v]; k++)
+            {
+                unsigned int t = adjacency.triangles[adjacency.offsets[v] + k];
+                const unsigned int *other = &indices[t * 3];
+                triangleScore[t] = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+            }
+        }
+
+        cacheCount = std::min(newCount, forsythCacheSize);
+        for (int i = 0; i < cacheCount; i++)
+            cache[i] = newCache[i];
+
+        // next triangle: the best one touching the cache
+        best = (size_t)-1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; i++)
+        {
+            unsigned int v = cache[i];
+            for (unsigned int k = 0; k < adjacency.live[v]; k++)
+            {
+                unsigned int t = adjacency.triangles[adjacency.offsets[v] + k];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+void optimizeVertexCacheTipsify(std::vector<unsigned int> &indices, size_t vertexCount, int cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    TriangleAdjacency adjacency(indices, vertexCount);
+    std::vector<uint64_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnds;     // vertices we may come back to
+    std::vector<unsigned int> candidates;   // vertices of the last fan
+    std::vector<unsigned int> fanTriangles;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    uint64_t time = (uint64_t)cacheSize + 1;
+    size_t cursor = 0;   // no vertex before this one has live triangles left
+    long long fan = 0;
+    while (fan >= 0)
+    {
+        // 1. emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        unsigned int fanVertex = (unsigned int)fan;
+        unsigned int begin = adjacency.offsets[fanVertex];
+        unsigned int end = begin + adjacency.live[fanVertex];
+        fanTriangles.assign(adjacency.triangles.begin() + begin, adjacency.triangles.begin() + end);
+        for (unsigned int t : fanTriangles)
+        {
+            if (emitted[t])
+                continue;
+            emitted[t] = true;
+            const unsigned int *triangle = &indices[t * 3];
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = triangle[corner];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                adjacency.remove(v, t);
+                if (time - cacheTime[v] > (uint64_t)cacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        // 2. the candidate that is still in the cache and will still be there after its own fan
+        fan = -1;
+        long long bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (adjacency.live[v] == 0)
+                continue;
+            long long priority = 0;
+            if (time - cacheTime[v] + 2 * adjacency.live[v] <= (uint64_t)cacheSize)
+                priority = (long long)(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fan = v;
+            }
+        }
+
+        // 3. dead end: go back to a recent vertex with work left, or the next one in input order
+        while (fan < 0 && !deadEnds.empty())
+        {
+            unsigned int v = deadEnds.back();
+            deadEnds.pop_back();
+            if (adjacency.live[v] > 0)
+                fan = v;
+        }
+        while (fan < 0 && cursor < vertexCount)
+        {
+            if (adjacency.live[cursor] > 0)
+                fan = (long long)cursor;
+            else
+                cursor++;
+        }
+    }
+
+    indices.swap(output);
+}
+
+size_t optimizeOverdraw(std::vector<unsigned int> &indices, const MeshData &mesh, float threshold, int cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = mesh.vertexCount();
+    if (triangleCount == 0)
+        return 0;
+    for (unsigned int index : indices)
+    {
+        if (index >= vertexCount)
+            throw std::runtime_error("mesh index out of range");
+    }
+
+    // 1. hard boundaries where the cache starts over (a triangle without a single cached vertex)
+    std::vector<size_t> hard;
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int corner = 0; corner < 3; corner++)
+            misses += cache.touch(indices[t * 3 + corner]);
+        if (t == 0 || misses == 3)
+            hard.push_back(t);
+    }
+    hard.push_back(triangleCount);
+
+    // 2. soft boundaries: cut a cluster further wherever the part so far has an ACMR within threshold
+    //    of the whole cluster, drawing that part on its own costs almost nothing in cache hits
+    std::vector<size_t> clusters;
+    for (size_t c = 0; c + 1 < hard.size(); c++)
+    {
+        size_t begin = hard[c], end = hard[c + 1];
+
+        cache.reset();
+        size_t clusterMisses = 0;
+        for (size_t i = begin * 3; i < end * 3; i++)
+            clusterMisses += cache.touch(indices[i]);
+        double limit = threshold * (double)clusterMisses / (end - begin);
+
+        cache.reset();
+        size_t start = begin, misses = 0;
+        clusters.push_back(begin);
+        for (size_t t = begin; t < end; t++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+                misses += cache.touch(indices[t * 3 + corner]);
+            if (t + 1 < end && misses <= limit * (t + 1 - start))
+            {
+                clusters.push_back(t + 1);
+                cache.reset();
+                start = t + 1;
+                misses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // 3. area weighted center and normal of every cluster and of the whole mesh
+    auto position = [&mesh](unsigned int v) { return glm::vec3(mesh.vertices[v * MeshData::floatsPerVertex],
+                                                               mesh.vertices[v * MeshData::floatsPerVertex + 1],
+                                                               mesh.vertices[v * MeshData::floatsPerVertex + 2]); };
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::dvec3> centers(clusterCount), normals(clusterCount);
+    glm::dvec3 meshCenter(0.0);
+    double meshArea = 0.0;
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        glm::dvec3 center(0.0), normal(0.0);
+        double area = 0.0;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            glm::dvec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), c3 = position(indices[t * 3 + 2]);
+            glm::dvec3 cross = glm::cross(b - a, c3 - a);
+            double triangleArea = glm::length(cross);
+            center += (a + b + c3) * (triangleArea / 3.0);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCenter += center;
+        meshArea += area;
+        centers[c] = area > 0.0 ? center / area : center;
+        normals[c] = normal;
+    }
+    if (meshArea > 0.0)
+        meshCenter /= meshArea;
+
+    // 4. clusters that face away from the center the most are drawn first
+    std::vector<double> keys(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        double length = glm::length(normals[c]);
+        keys[c] = length > 0.0 ? glm::dot(centers[c] - meshCenter, normals[c] / length) : 0.0;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (size_t c : order)
+        output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    indices.swap(output);
+    return clusterCount;
+}
+
+size_t optimizeVertexFetch(MeshData &mesh)
+{
+    const unsigned int unused = 0xffffffffu;
+    size_t vertexCount = mesh.vertexCount();
+    std::vector<unsigned int> remap(vertexCount, unused);
+    unsigned int next = 0;
+    for (unsigned int &index : mesh.indices)
+    {
+        if (index >= vertexCount)
+            throw std::runtime_error("mesh index out of range");
+        if (remap[index] == unused)
+            remap[index] = next++;
+        index = remap[index];
+    }
+
+    std::vector<float> vertices(next * MeshData::floatsPerVertex);
+    std::vector<float> normals(mesh.normals.empty() ? 0 : next * 3);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        if (remap[v] == unused)
+            continue;
+        std::copy_n(&mesh.vertices[v * MeshData::floatsPerVertex], MeshData::floatsPerVertex,
+                    &vertices[remap[v] * MeshData::floatsPerVertex]);
+        if (!normals.empty())
+            std::copy_n(&mesh.normals[v * 3], 3, &normals[remap[v] * 3]);
+    }
+    mesh.vertices.swap(vertices);
+    mesh.normals.swap(normals);
+    return next;
+}
+
+void optimizeMesh(MeshData &mesh, VertexCacheMethod method)
+{
+    if (method == VertexCacheMethod::Forsyth)
+        optimizeVertexCacheForsyth(mesh.indices, mesh.vertexCount());
+    else
+        optimizeVertexCacheTipsify(mesh.indices, mesh.vertexCount());
+    optimizeOverdraw(mesh.indices, mesh);
+    optimizeVertexFetch(mesh);
+}
@@ -0,0 +1,520 @@
+#include "mesh_simplifier.h"
+#include "mesh_loader.h"
+#include "mesh_optimizer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+
+
+namespace
+{
+    enum VertexKind : unsigned char
+    {
+        Manifold,
+        Border,
+        Seam,
+        Locked
+    };
+
+    // [from][to]: which kinds a vertex may be moved onto
+    const bool canCollapse[4][4] = {
+        {true,  true,  true,  true},
+        {false, true,  false, true},
+        {false, false, true,  true},
+        {false, false, false, false},
+    };
+
+    const unsigned int none = ~0u;
+
+    // symmetric 4x4 of a sum of weighted squared plane distances
+    struct Quadric
+    {
+        double a00 = 0, a11 = 0, a22 = 0, a10 = 0, a20 = 0, a21 = 0;
+        double b0 = 0, b1 = 0, b2 = 0, c = 0;
+        double weight = 0;
+
+        static Quadric plane(const glm::dvec3 &n, double d, double w)
+        {
+            Quadric q;
+            q.a00 = n.x * n.x * w; q.a11 = n.y * n.y * w; q.a22 = n.z * n.z * w;
+            q.a10 = n.y * n.x * w; q.a20 = n.z * n.x * w; q.a21 = n.z * n.y * w;
+            q.b0 = n.x * d * w; q.b1 = n.y * d * w; q.b2 = n.z * d * w;
+            q.c = d * d * w;
+            q.weight = w;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric &q)
+        {
+            a00 += q.a00; a11 += q.a11; a22 += q.a22; a10 += q.a10; a20 += q.a20; a21 += q.a21;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+            weight += q.weight;
+            return *this;
+        }
+
+        // mean squared distance of p to the planes
+        double error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a10 * x * y + a20 * x * z + a21 * y * z) +
+                       2.0 * (b0 * x + b1 * y + b2 * z) + c;
+            return weight > 0.0 ? std::fabs(r) / weight : 0.0;
+        }
+    };
+
+    struct PositionKey
+    {
+        uint32_t bits[3];
+        bool operator==(const PositionKey &other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+    };
+
+    struct PositionHash
+    {
+        size_t operator()(const PositionKey &key) const
+        {
+            return ((size_t)key.bits[0] * 73856093u) ^ ((size_t)key.bits[1] * 19349663u) ^ ((size_t)key.bits[2] * 83492791u);
+        }
+    };
+
+    // rows of a compressed adjacency, filled by counting first
+    struct Adjacency
+    {
+        std::vector<unsigned int> start, items;
+
+        template <typename Each>
+        void build(size_t rows, size_t entries, Each each)
+        {
+            start.assign(rows + 1, 0);
+            each([&](unsigned int row, unsigned int) { start[row + 1]++; });
+            for (size_t r = 0; r < rows; r++)
+                start[r + 1] += start[r];
+            items.resize(entries);
+            std::vector<unsigned int> fill(start.begin(), start.end() - 1);
+            each([&](unsigned int row, unsigned int item) { items[fill[row]++] = item; });
+        }
+    };
+
+    void meshBounds(const MeshData &mesh, glm::vec3 &origin, float &extent)
+    {
+        glm::vec3 low(0.0f), high(0.0f);
+        for (size_t v = 0; v < mesh.vertexCount(); v++)
+        {
+            glm::vec3 p(mesh.vertices[v * MeshData::floatsPerVertex], mesh.vertices[v * MeshData::floatsPerVertex + 1],
+                        mesh.vertices[v * MeshData::floatsPerVertex + 2]);
+            low = v ? glm::min(low, p) : p;
+            high = v ? glm::max(high, p) : p;
+        }
+        origin = low;
+        extent = std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z));
+    }
+
+    struct Simplifier
+    {
+        size_t vertexCount;
+        std::vector<glm::vec3> positions;    // scaled into the unit cube, for precision
+        std::vector<unsigned int> remap;     // first vertex at the same position
+        std::vector<unsigned int> wedge;     // ring of the vertices at one position
+        std::vector<VertexKind> kind;
+        std::vector<unsigned int> openOut, openIn;   // the other end of a vertex's open edge
+        std::vector<Quadric> quadrics;       // per position (remap)
+
+        Adjacency edges;       // vertex -> vertices it has an edge to, in triangle winding
+        Adjacency triangles;   // position -> triangles
+
+        Simplifier(const MeshData &mesh, const std::vector<unsigned int> &indices)
+            : vertexCount(mesh.vertexCount())
+        {
+            glm::vec3 origin;
+            float extent;
+            meshBounds(mesh, origin, extent);
+            float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+            positions.resize(vertexCount);
+            remap.resize(vertexCount);
+            wedge.resize(vertexCount);
+            // vertices nothing uses stay out of the wedges, they would make their twins look complex
+            std::vector<bool> referenced(vertexCount, false);
+            for (unsigned int index : indices)
+                referenced[index] = true;
+
+            std::unordered_map<PositionKey, unsigned int, PositionHash> seen;
+            seen.reserve(vertexCount);
+            for (unsigned int v = 0; v < vertexCount; v++)
+            {
+                const float *p = &mesh.vertices[(size_t)v * MeshData::floatsPerVertex];
+                positions[v] = (glm::vec3(p[0], p[1], p[2]) - origin) * scale;
+                remap[v] = v;
+                wedge[v] = v;
+                if (!referenced[v])
+                    continue;
+
+                PositionKey key;
+                std::memcpy(key.bits, p, sizeof(key.bits));
+                unsigned int first = seen.emplace(key, v).first->second;
+                remap[v] = first;
+                if (first != v)
+                {
+                    wedge[v] = wedge[first];
+                    wedge[first] = v;
+                }
+            }
+
+            buildEdges(indices);
+            classify();
+            buildQuadrics(indices);
+        }
+
+        void buildEdges(const std::vector<unsigned int> &indices)
+        {
+            edges.build(vertexCount, indices.size(), [&](auto add)
+            {
+                for (size_t i = 0; i < indices.size(); i += 3)
+                {
+                    for (int e = 0; e < 3; e++)
+                        add(indices[i + e], indices[i + (e + 1) % 3]);
+                }
+            });
+        }
+
+        bool hasEdge(unsigned int a, unsigned int b) const
+        {
+            for (unsigned int k = edges.start[a]; k < edges.start[a + 1]; k++)
+            {
+                if (edges.items[k] == b)
+                    return true;
+            }
+            return false;
+        }
+
+        // an edge from any vertex at a's position to any at b's
+        bool hasPositionEdge(unsigned int a, unsigned int b) const
+        {
+            unsigned int v = a;
+            do
+            {
+                for (unsigned int k = edges.start[v]; k < edges.start[v + 1]; k++)
+                {
+                    if (remap[edges.items[k]] == remap[b])
+                        return true;
+                }
+                v = wedge[v];
+            } while (v != a);
+            return false;
+        }
+
+        void classify()
+        {
+            // an open edge has no edge back between the same two vertices. on a border nothing is on
+            // the other side, on a seam the other side uses other vertices at the same positions
+            std::vector<unsigned char> outCount(vertexCount, 0), inCount(vertexCount, 0);
+            openOut.assign(vertexCount, none);
+            openIn.assign(vertexCount, none);
+            for (unsigned int a = 0; a < vertexCount; a++)
+            {
+                for (unsigned int k = edges.start[a]; k < edges.start[a + 1]; k++)
+                {
+                    unsigned int b = edges.items[k];
+                    if (!hasEdge(b, a))
+                    {
+                        openOut[a] = b;
+                        openIn[b] = a;
+                        outCount[a] = (unsigned char)std::min(outCount[a] + 1, 2);
+                        inCount[b] = (unsigned char)std::min(inCount[b] + 1, 2);
+                    }
+                }
+            }
+
+            kind.assign(vertexCount, Locked);
+            for (unsigned int v = 0; v < vertexCount; v++)
+            {
+                bool oneOpenEdge = outCount[v] == 1 && inCount[v] == 1 && openIn[v] != openOut[v];
+                if (wedge[v] == v)
+                {
+                    if (outCount[v] == 0 && inCount[v] == 0)
+                        kind[v] = Manifold;
+                    else if (oneOpenEdge)
+                        kind[v] = Border;
+                }
+                else if (wedge[wedge[v]] == v)
+                {
+                    // two vertices at one position whose open edges run along each other
+                    unsigned int w = wedge[v];
+                    bool twinOpenEdge = outCount[w] == 1 && inCount[w] == 1 && openIn[w] != openOut[w];
+                    if (oneOpenEdge && twinOpenEdge && remap[openIn[v]] == remap[openOut[w]] &&
+                        remap[openOut[v]] == remap[openIn[w]])
+                        kind[v] = Seam;
+                }
+            }
+        }
+
+        void buildQuadrics(const std::vector<unsigned int> &indices)
+        {
+            quadrics.assign(vertexCount, Quadric());
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                const unsigned int *t = &indices[i];
+                glm::dvec3 p0 = positions[t[0]], p1 = positions[t[1]], p2 = positions[t[2]];
+                glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+                double length = glm::length(normal);
+                if (length <= 0.0)
+                    continue;
+                normal /= length;
+
+                Quadric face = Quadric::plane(normal, -glm::dot(normal, p0), length * 0.5);
+                for (int e = 0; e < 3; e++)
+                    quadrics[remap[t[e]]] += face;
+
+                // borders and seams are held in place by a plane through the edge, standing on the triangle
+                for (int e = 0; e < 3; e++)
+                {
+                    unsigned int a = t[e], b = t[(e + 1) % 3];
+                    if ((kind[a] == Manifold && kind[b] == Manifold) || hasEdge(b, a))
+                        continue;
+                    glm::dvec3 pa = positions[a], edge = glm::dvec3(positions[b]) - pa;
+                    double edgeLength = glm::length(edge);
+                    if (edgeLength <= 0.0)
+                        continue;
+                    glm::dvec3 side = glm::normalize(glm::cross(edge, normal));
+                    Quadric outline = Quadric::plane(side, -glm::dot(side, pa), edgeLength * edgeLength * 10.0);
+                    quadrics[remap[a]] += outline;
+                    quadrics[remap[b]] += outline;
+                }
+            }
+        }
+
+        bool validCollapse(unsigned int from, unsigned int to) const
+        {
+            if (!canCollapse[kind[from]][kind[to]])
+                return false;
+            // borders and seams only slide along their own open edge
+            if (kind[from] == Border || kind[from] == Seam)
+                return openOut[from] == to || openIn[from] == to;
+            return true;
+        }
+
+        // the vertex the seam twin of from moves onto, none when the other side doesn't line up
+        unsigned int twinTarget(unsigned int from, unsigned int to) const
+        {
+            unsigned int twin = wedge[from];
+            if (openOut[twin] != none && remap[openOut[twin]] == remap[to])
+                return openOut[twin];
+            if (openIn[twin] != none && remap[openIn[twin]] == remap[to])
+                return openIn[twin];
+            return none;
+        }
+
+        // whether moving position from onto position to turns one of the remaining triangles over
+        bool flips(const std::vector<unsigned int> &indices, unsigned int from, unsigned int to) const
+        {
+            const glm::vec3 &target = positions[to];
+            for (unsigned int k = triangles.start[from]; k < triangles.start[from + 1]; k++)
+            {
+                const unsigned int *t = &indices[(size_t)triangles.items[k] * 3];
+                if (remap[t[0]] == to || remap[t[1]] == to || remap[t[2]] == to)
+                    continue;
+
+                glm::vec3 p[3], q[3];
+                for (int e = 0; e < 3; e++)
+                {
+                    p[e] = positions[t[e]];
+                    q[e] = remap[t[e]] == from ? target : p[e];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+                    return true;
+            }
+            return false;
+        }
+
+        // one pass of collapses, returns false when nothing could go
+        bool pass(std::vector<unsigned int> &indices, size_t targetIndexCount, double errorLimit, double &resultError)
+        {
+            buildEdges(indices);
+            triangles.build(vertexCount, indices.size(), [&](auto add)
+            {
+                for (size_t i = 0; i < indices.size(); i++)
+                    add(remap[indices[i]], (unsigned int)(i / 3));
+            });
+
+            struct Candidate
+            {
+                unsigned int from, to;
+                double error;
+            };
+            std::vector<Candidate> candidates;
+            candidates.reserve(indices.size() / 2);
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                for (int e = 0; e < 3; e++)
+                {
+                    unsigned int a = indices[i + e], b = indices[i + (e + 1) % 3];
+                    if (remap[a] == remap[b])
+                        continue;
+                    // interior and seam edges show up once from each side, keep one of them
+                    if (remap[a] > remap[b] && hasPositionEdge(b, a))
+                        continue;
+
+                    bool forward = validCollapse(a, b), backward = validCollapse(b, a);
+                    double forwardError = forward ? quadrics[remap[a]].error(positions[b]) : 0.0;
+                    double backwardError = backward ? quadrics[remap[b]].error(positions[a]) : 0.0;
+                    if (forward && (!backward || forwardError <= backwardError))
+                        candidates.push_back({a, b, forwardError});
+                    else if (backward)
+                        candidates.push_back({b, a, backwardError});
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const Candidate &x, const Candidate &y)
+            {
+                return x.error < y.error;
+            });
+
+            std::vector<unsigned int> collapse(vertexCount);
+            for (unsigned int v = 0; v < vertexCount; v++)
+                collapse[v] = v;
+            std::vector<bool> touched(vertexCount, false);
+            size_t triangleCount = indices.size() / 3, targetTriangles = targetIndexCount / 3;
+            size_t collapses = 0;
+
+            for (const Candidate &candidate : candidates)
+            {
+                if (candidate.error > errorLimit || triangleCount <= targetTriangles)
+                    break;
+                unsigned int from = remap[candidate.from], to = remap[candidate.to];
+                if (touched[from] || touched[to])
+                    continue;
+
+                unsigned int twinFrom = none, twinTo = none;
+                if (kind[candidate.from] == Seam)
+                {
+                    twinFrom = wedge[candidate.from];
+                    twinTo = twinTarget(candidate.from, candidate.to);
+                    if (twinTo == none)
+                        continue;
+                }
+                if (flips(indices, from, to))
+                    continue;
+
+                collapse[candidate.from] = candidate.to;
+                if (twinFrom != none)
+                    collapse[twinFrom] = twinTo;
+                quadrics[to] += quadrics[from];
+
+                // everything around from changes shape, none of it collapses again in this pass
+                for (unsigned int k = triangles.start[from]; k < triangles.start[from + 1]; k++)
+                {
+                    const unsigned int *t = &indices[(size_t)triangles.items[k] * 3];
+                    bool dies = remap[t[0]] == to || remap[t[1]] == to || remap[t[2]] == to;
+                    triangleCount -= dies;
+                    for (int e = 0; e < 3; e++)
+                        touched[remap[t[e]]] = true;
+                }
+                resultError = std::max(resultError, candidate.error);
+                collapses++;
+            }
+            if (collapses == 0)
+                return false;
+
+            size_t kept = 0;
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                unsigned int a = collapse[indices[i]], b = collapse[indices[i + 1]], c = collapse[indices[i + 2]];
+                if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+                    continue;
+                indices[kept++] = a;
+                indices[kept++] = b;
+                indices[kept++] = c;
+            }
+            indices.resize(kept);
+            return true;
+        }
+    };
+}
+
+std::vector<unsigned int> simplifyMesh(const MeshData &mesh, const std::vector<unsigned int> &indices,
+                                       size_t targetIndexCount, float targetError, float *resultError)
+{
+    std::vector<unsigned int> result(indices);
+    double error = 0.0;
+    if (!indices.empty() && mesh.vertexCount() > 0)
+    {
+        Simplifier simplifier(mesh, indices);
+        // the quadrics hold squared distances
+        double errorLimit = (double)targetError * targetError;
+        while (result.size() > targetIndexCount && simplifier.pass(result, targetIndexCount, errorLimit, error))
+        {
+        }
+    }
+    if (resultError)
+        *resultError = (float)std::sqrt(error);
+    return result;
+}
+
+MeshLodChain buildLodChain(const MeshData &mesh, const LodChainOptions &options)
+{
+    glm::vec3 origin;
+    float extent;
+    meshBounds(mesh, origin, extent);
+
+    MeshLodChain chain;
+    chain.indices = mesh.indices;
+    chain.levels.push_back({0, (unsigned int)mesh.indices.size(), 0.0f});
+
+    std::vector<unsigned int> current = mesh.indices;
+    float error = 0.0f;
+    while ((int)chain.levels.size() < options.maxLevels)
+    {
+        size_t target = (size_t)(current.size() / 3 * options.reduction) * 3;
+        if (target / 3 < options.minTriangles)
+            break;
+
+        float levelError;
+        std::vector<unsigned int> next = simplifyMesh(mesh, current, target, options.maxError, &levelError);
+        // the error limit or locked vertices stopped it short of halfway, nothing worth a level
+        if (next.size() > (current.size() + target) / 2)
+            break;
+
+        optimizeVertexCacheTipsify(next, mesh.vertexCount());
+        error += levelError * extent;
+        chain.levels.push_back({(unsigned int)chain.indices.size(), (unsigned int)next.size(), error});
+        chain.indices.insert(chain.indices.end(), next.begin(), next.end());
+        current.swap(next);
+    }
+    return chain;
+}
+
+float lodPixelsPerUnit(float fovY, int viewportHeight)
+{
+    return viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+}
+
+int selectLod(const MeshLodChain &chain, float pixelsPerUnit, int current, const LodSelectOptions &options)
+{
+    int levels = (int)chain.levels.size();
+    if (levels == 0)
+        return 0;
+
+    // errors grow along the chain, so the last level under the threshold is the coarsest that works
+    int wanted = 0;
+    for (int i = 1; i < levels; i++)
+    {
+        if (chain.levels[i].error * pixelsPerUnit <= options.pixelThreshold)
+            wanted = i;
+    }
+    if (current < 0 || current >= levels || wanted <= current)
+        return wanted;
+
+    // going coarser needs some room below the threshold
+    float coarserThreshold = options.pixelThreshold * (1.0f - options.hysteresis);
+    for (int i = wanted; i > current; i--)
+    {
+        if (chain.levels[i].error * pixelsPerUnit <= coarserThreshold)
+            return i;
+    }
+    return current;
+}
@@ -0,0 +1,454 @@
+#include "meshlet.h"
+#include "mesh_loader.h"
+#include "thread_pool.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+
+namespace
+{
+    const size_t chunkTriangles = 65536;
+
+    glm::vec3 position(const MeshData &mesh, unsigned int vertex)
+    {
+        const float *v = &mesh.vertices[(size_t)vertex * MeshData::floatsPerVertex];
+        return glm::vec3(v[0], v[1], v[2]);
+    }
+
+    // meshlets of the triangles [first, last), their vertices are mesh vertices
+    MeshletData clusterChunk(const MeshData &mesh, size_t first, size_t last, size_t maxVertices, size_t maxTriangles)
+    {
+        MeshletData out;
+        const unsigned int *indices = mesh.indices.data() + first * 3;
+        size_t triangleCount = last - first;
+
+        // chunk local vertex numbers, so every table below is sized by the chunk and not the mesh
+        std::vector<unsigned int> globals(indices, indices + triangleCount * 3);
+        std::sort(globals.begin(), globals.end());
+        globals.erase(std::unique(globals.begin(), globals.end()), globals.end());
+        size_t vertexCount = globals.size();
+
+        std::vector<unsigned int> corners(triangleCount * 3);
+        for (size_t i = 0; i < corners.size(); i++)
+            corners[i] = (unsigned int)(std::lower_bound(globals.begin(), globals.end(), indices[i]) - globals.begin());
+
+        // vertex -> triangles, compressed rows
+        std::vector<unsigned int> rowStart(vertexCount + 1, 0), vertexTriangles(corners.size());
+        for (unsigned int corner : corners)
+            rowStart[corner + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            rowStart[v + 1] += rowStart[v];
+        std::vector<unsigned int> fill(rowStart.begin(), rowStart.end() - 1);
+        for (size_t i = 0; i < corners.size(); i++)
+            vertexTriangles[fill[corners[i]]++] = (unsigned int)(i / 3);
+
+        std::vector<unsigned int> liveTriangles(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            liveTriangles[v] = rowStart[v + 1] - rowStart[v];
+
+        std::vector<glm::vec3> centroids(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            centroids[t] = (position(mesh, indices[t * 3]) + position(mesh, indices[t * 3 + 1]) +
+                            position(mesh, indices[t * 3 + 2])) / 3.0f;
+        }
+
+        // stamps instead of clearing per meshlet: a vertex is in the current meshlet when its stamp
+        // is the meshlet's number, a triangle is already a candidate the same way
+        std::vector<bool> used(triangleCount, false);
+        std::vector<int> vertexStamp(vertexCount, -1), candidateStamp(triangleCount, -1);
+        std::vector<unsigned char> vertexSlot(vertexCount);
+        std::vector<unsigned int> meshletVertices, candidates;
+        std::vector<unsigned char> meshletTriangles;
+
+        size_t scan = 0;
+        int stamp = 0;
+        while (true)
+        {
+            // the next meshlet starts on the border of the last one, at the triangle with the fewest
+            // unused neighbours, so no islands are left behind. index order when there is no border
+            unsigned int seed = 0;
+            unsigned int fewest = ~0u;
+            for (unsigned int t : candidates)
+            {
+                if (used[t])
+                    continue;
+                unsigned int neighbours = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    unsigned int v = corners[t * 3 + c];
+                    for (unsigned int k = rowStart[v]; k < rowStart[v + 1]; k++)
+                        neighbours += !used[vertexTriangles[k]];
+                }
+                if (neighbours < fewest)
+                {
+                    seed = t;
+                    fewest = neighbours;
+                }
+            }
+            if (fewest == ~0u)
+            {
+                while (scan < triangleCount && used[scan])
+                    scan++;
+                if (scan == triangleCount)
+                    break;
+                seed = (unsigned int)scan;
+            }
+
+            meshletVertices.clear();
+            meshletTriangles.clear();
+            candidates.clear();
+            glm::vec3 centroidSum(0.0f);
+
+            auto addTriangle = [&](unsigned int t)
+            {
+                used[t] = true;
+                centroidSum += centroids[t];
+                for (int c = 0; c < 3; c++)
+                {
+                    unsigned int v = corners[t * 3 + c];
+                    liveTriangles[v]--;
+                    if (vertexStamp[v] != stamp)
+                    {
+                        vertexStamp[v] = stamp;
+                        vertexSlot[v] = (unsigned char)meshletVertices.size();
+                        meshletVertices.push_back(v);
+                        for (unsigned int k = rowStart[v]; k < rowStart[v + 1]; k++)
+                        {
+                            unsigned int neighbour = vertexTriangles[k];
+                            if (!used[neighbour] && candidateStamp[neighbour] != stamp)
+                            {
+                                candidateStamp[neighbour] = stamp;
+                                candidates.push_back(neighbour);
+                            }
+                        }
+                    }
+                    meshletTriangles.push_back(vertexSlot[v]);
+                }
+            };
+
+            addTriangle(seed);
+            while (meshletTriangles.size() / 3 < maxTriangles)
+            {
+                glm::vec3 center = centroidSum / (float)(meshletTriangles.size() / 3);
+                int best = -1;
+                int bestNew = 4;
+                float bestDistance = std::numeric_limits<float>::max();
+
+                // used triangles drop out of the list while it is scanned
+                size_t kept = 0;
+                for (size_t i = 0; i < candidates.size(); i++)
+                {
+                    unsigned int t = candidates[i];
+                    if (used[t])
+                        continue;
+                    candidates[kept++] = t;
+
+                    int added = 0;
+                    bool closesVertex = false;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        unsigned int v = corners[t * 3 + c];
+                        added += vertexStamp[v] != stamp;
+                        closesVertex = closesVertex || liveTriangles[v] == 1;
+                    }
+                    if (meshletVertices.size() + added > maxVertices)
+                        continue;
+                    // the last triangle of a vertex goes first, left behind it would end up as a tiny meshlet
+                    if (closesVertex)
+                        added = 0;
+                    if (added > bestNew)
+                        continue;
+
+                    glm::vec3 offset = centroids[t] - center;
+                    float distance = glm::dot(offset, offset);
+                    if (added < bestNew || distance < bestDistance)
+                    {
+                        best = (int)kept - 1;
+                        bestNew = added;
+                        bestDistance = distance;
+                    }
+                }
+                candidates.resize(kept);
+                if (best < 0)
+                    break;
+
+                unsigned int t = candidates[best];
+                candidates[best] = candidates.back();
+                candidates.pop_back();
+                addTriangle(t);
+            }
+
+            Meshlet meshlet;
+            meshlet.vertexOffset = (unsigned int)out.vertices.size();
+            meshlet.triangleOffset = (unsigned int)(out.triangles.size() / 3);
+            meshlet.vertexCount = (unsigned int)meshletVertices.size();
+            meshlet.triangleCount = (unsigned int)(meshletTriangles.size() / 3);
+            out.meshlets.push_back(meshlet);
+            for (unsigned int v : meshletVertices)
+                out.vertices.push_back(globals[v]);
+            out.triangles.insert(out.triangles.end(), meshletTriangles.begin(), meshletTriangles.end());
+            stamp++;
+        }
+        return out;
+    }
+}
+
+std::vector<unsigned int> MeshletData::indexBuffer() const
+{
+    std::vector<unsigned int> indices(triangles.size());
+    for (const Meshlet &meshlet : meshlets)
+    {
+        for (size_t i = 0; i < meshlet.triangleCount * 3; i++)
+        {
+            size_t corner = meshlet.triangleOffset * 3 + i;
+            indices[corner] = vertices[meshlet.vertexOffset + triangles[corner]];
+        }
+    }
+    return indices;
+}
+
+MeshletData buildMeshlets(const MeshData &mesh, size_t maxVertices, size_t maxTriangles)
+{
+    if (maxVertices < 3 || maxVertices > MeshletData::maxVertices || maxTriangles < 1 ||
+        maxTriangles > MeshletData::maxTriangles)
+        throw std::invalid_argument("buildMeshlets: limits have to be 3 - 64 vertices and 1 - 124 triangles");
+
+    size_t triangleCount = mesh.triangleCount();
+    size_t chunkCount = (triangleCount + chunkTriangles - 1) / chunkTriangles;
+    std::vector<MeshletData> chunks(chunkCount);
+    threadPool().parallelFor((int)chunkCount, [&](int begin, int end)
+    {
+        for (int c = begin; c < end; c++)
+        {
+            size_t first = c * chunkTriangles;
+            chunks[c] = clusterChunk(mesh, first, std::min(first + chunkTriangles, triangleCount), maxVertices, maxTriangles);
+        }
+    });
+
+    MeshletData data;
+    for (const MeshletData &chunk : chunks)
+    {
+        unsigned int vertexBase = (unsigned int)data.vertices.size();
+        unsigned int triangleBase = (unsigned int)(data.triangles.size() / 3);
+        for (Meshlet meshlet : chunk.meshlets)
+        {
+            meshlet.vertexOffset += vertexBase;
+            meshlet.triangleOffset += triangleBase;
+            data.meshlets.push_back(meshlet);
+        }
+        data.vertices.insert(data.vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        data.triangles.insert(data.triangles.end(), chunk.triangles.begin(), chunk.triangles.end());
+    }
+
+    data.bounds.resize(data.meshlets.size());
+    threadPool().parallelFor((int)data.meshlets.size(), [&](int begin, int end)
+    {
+        for (int m = begin; m < end; m++)
+            data.bounds[m] = computeMeshletBounds(mesh, data, data.meshlets[m]);
+    }, 256);
+    return data;
+}
+
+MeshletBounds computeMeshletBounds(const MeshData &mesh, const MeshletData &data, const Meshlet &meshlet)
+{
+    MeshletBounds bounds = {};
+
+    glm::vec3 boxMin(std::numeric_limits<float>::max()), boxMax(-std::numeric_limits<float>::max());
+    for (unsigned int i = 0; i < meshlet.vertexCount; i++)
+    {
+        glm::vec3 p = position(mesh, data.vertices[meshlet.vertexOffset + i]);
+        boxMin = glm::min(boxMin, p);
+        boxMax = glm::max(boxMax, p);
+    }
+    bounds.boxMin = boxMin;
+    bounds.boxMax = boxMax;
+    bounds.center = (boxMin + boxMax) * 0.5f;
+    for (unsigned int i = 0; i < meshlet.vertexCount; i++)
+    {
+        glm::vec3 p = position(mesh, data.vertices[meshlet.vertexOffset + i]);
+        bounds.radius = std::max(bounds.radius, glm::length(p - bounds.center));
+    }
+
+    // unit normals of the triangles that have an area, their mean is the cone axis
+    std::vector<glm::vec3> normals, firstCorners;
+    glm::vec3 normalSum(0.0f);
+    for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+    {
+        const unsigned char *local = &data.triangles[(meshlet.triangleOffset + t) * 3];
+        glm::vec3 a = position(mesh, data.vertices[meshlet.vertexOffset + local[0]]);
+        glm::vec3 b = position(mesh, data.vertices[meshlet.vertexOffset + local[1]]);
+        glm::vec3 c = position(mesh, data.vertices[meshlet.vertexOffset + local[2]]);
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        if (length <= 0.0f)
+            continue;
+        normals.push_back(n / length);
+        firstCorners.push_back(a);
+        normalSum += n / length;
+    }
+
+    bounds.coneCutoff = 2.0f;
+    bounds.coneApex = bounds.center;
+    float axisLength = glm::length(normalSum);
+    if (normals.empty() || axisLength < 1e-6f)
+        return bounds;
+
+    glm::vec3 axis = normalSum / axisLength;
+    float minDot = 1.0f;
+    for (const glm::vec3 &n : normals)
+        minDot = std::min(minDot, glm::dot(axis, n));
+    bounds.coneAxis = axis;
+    if (minDot <= 0.0f)
+        return bounds;
+
+    // back along the axis until the apex is behind every triangle's plane
+    float maxT = 0.0f;
+    for (size_t i = 0; i < normals.size(); i++)
+    {
+        float t = glm::dot(bounds.center - firstCorners[i], normals[i]) / glm::dot(axis, normals[i]);
+        maxT = std::max(maxT, t);
+    }
+    bounds.coneApex = bounds.center - axis * maxT;
+    bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    return bounds;
+}
+
+bool MeshletCuller::simdAvailable()
+{
+#ifdef CPU_X86
+    return cpuHasAvx2() && cpuHasFma();
+#else
+    return false;
+#endif
+}
+
+MeshletCuller::MeshletCuller(const std::vector<MeshletBounds> &bounds)
+    : count(bounds.size())
+{
+    // padding lanes have a radius of -infinity, outside every plane
+    size_t padded = (count + 7) & ~(size_t)7;
+    for (std::vector<float> *column : {&centerX, &centerY, &centerZ, &apexX, &apexY, &apexZ, &axisX, &axisY, &axisZ, &cutoff})
+        column->assign(padded, 0.0f);
+    radius.assign(padded, -std::numeric_limits<float>::infinity());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const MeshletBounds &b = bounds[i];
+        centerX[i] = b.center.x; centerY[i] = b.center.y; centerZ[i] = b.center.z;
+        radius[i] = b.radius;
+        apexX[i] = b.coneApex.x; apexY[i] = b.coneApex.y; apexZ[i] = b.coneApex.z;
+        axisX[i] = b.coneAxis.x; axisY[i] = b.coneAxis.y; axisZ[i] = b.coneAxis.z;
+        cutoff[i] = b.coneCutoff;
+    }
+}
+
+#ifdef CPU_X86
+// 8 meshlets a step, bit i of the masks is lane i. same operations in the same order as the scalar loop
+CPU_TARGET_AVX2_FMA
+static void cullAvx2(const float *centerX, const float *centerY, const float *centerZ, const float *radius,
+                     const float *apexX, const float *apexY, const float *apexZ,
+                     const float *axisX, const float *axisY, const float *axisZ, const float *cutoff,
+                     size_t padded, const glm::vec4 planes[6], const glm::vec3 &camera,
+                     unsigned char *frustumOut, unsigned char *backfaceOut)
+{
+    for (size_t i = 0; i < padded; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(centerX + i), cy = _mm256_loadu_ps(centerY + i), cz = _mm256_loadu_ps(centerZ + i);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(planes[p].x), cx,
+                       _mm256_fmadd_ps(_mm256_set1_ps(planes[p].y), cy,
+                       _mm256_fmadd_ps(_mm256_set1_ps(planes[p].z), cz, _mm256_set1_ps(planes[p].w))));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, negativeRadius, _CMP_LT_OQ));
+        }
+
+        __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(apexX + i), _mm256_set1_ps(camera.x));
+        __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(apexY + i), _mm256_set1_ps(camera.y));
+        __m256 vz = _mm256_sub_ps(_mm256_loadu_ps(apexZ + i), _mm256_set1_ps(camera.z));
+        __m256 length = _mm256_sqrt_ps(_mm256_fmadd_ps(vx, vx, _mm256_fmadd_ps(vy, vy, _mm256_mul_ps(vz, vz))));
+        __m256 along = _mm256_fmadd_ps(vx, _mm256_loadu_ps(axisX + i),
+                       _mm256_fmadd_ps(vy, _mm256_loadu_ps(axisY + i), _mm256_mul_ps(vz, _mm256_loadu_ps(axisZ + i))));
+        __m256 backface = _mm256_cmp_ps(along, _mm256_mul_ps(_mm256_loadu_ps(cutoff + i), length), _CMP_GE_OQ);
+
+        frustumOut[i / 8] = (unsigned char)_mm256_movemask_ps(outside);
+        backfaceOut[i / 8] = (unsigned char)_mm256_movemask_ps(backface);
+    }
+}
+#endif
+
+MeshletCullStats MeshletCuller::cull(const glm::mat4 &modelViewProjection, const glm::vec3 &camera,
+                                     std::vector<unsigned int> &visible, bool allowSimd) const
+{
+    glm::vec4 planes[6];
+    extractFrustumPlanes(modelViewProjection, planes);
+
+    // one bit per meshlet for each test, then a single pass compacts the survivors
+    size_t padded = centerX.size();
+    std::vector<unsigned char> frustumMask(padded / 8), backfaceMask(padded / 8);
+
+#ifdef CPU_X86
+    if (allowSimd && simdAvailable())
+    {
+        cullAvx2(centerX.data(), centerY.data(), centerZ.data(), radius.data(), apexX.data(), apexY.data(), apexZ.data(),
+                 axisX.data(), axisY.data(), axisZ.data(), cutoff.data(), padded, planes, camera,
+                 frustumMask.data(), backfaceMask.data());
+    }
+    else
+#endif
+    {
+        for (size_t i = 0; i < padded; i++)
+        {
+            bool outside = false;
+            for (int p = 0; p < 6; p++)
+            {
+                float d = std::fma(planes[p].x, centerX[i], std::fma(planes[p].y, centerY[i],
+                          std::fma(planes[p].z, centerZ[i], planes[p].w)));
+                outside = outside || d < -radius[i];
+            }
+            float vx = apexX[i] - camera.x, vy = apexY[i] - camera.y, vz = apexZ[i] - camera.z;
+            float length = std::sqrt(std::fma(vx, vx, std::fma(vy, vy, vz * vz)));
+            float along = std::fma(vx, axisX[i], std::fma(vy, axisY[i], vz * axisZ[i]));
+            bool backface = along >= cutoff[i] * length;
+
+            frustumMask[i / 8] |= (unsigned char)(outside << (i % 8));
+            backfaceMask[i / 8] |= (unsigned char)(backface << (i % 8));
+        }
+    }
+
+    MeshletCullStats stats;
+    stats.tested = count;
+    visible.clear();
+    for (size_t block = 0; block < padded / 8; block++)
+    {
+        unsigned int outside = frustumMask[block];
+        unsigned int backface = backfaceMask[block] & ~outside;
+        unsigned int keep = ~(outside | backface) & 0xFFu;
+        if (block * 8 + 8 > count)
+        {
+            unsigned int lanes = (1u << (count - block * 8)) - 1;
+            outside &= lanes;
+            backface &= lanes;
+            keep &= lanes;
+        }
+        for (unsigned int lane = 0; lane < 8; lane++)
+        {
+            stats.frustumCulled += (outside >> lane) & 1;
+            stats.backfaceCulled += (backface >> lane) & 1;
+            if (keep & (1u << lane))
+                visible.push_back((unsigned int)(block * 8 + lane));
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,276 @@
+#include "profiler.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+
+FrameProfiler::FrameProfiler(bool gpuTiming, int historyFrames)
+    : gpuTiming(gpuTiming), historyFrames(historyFrames > 0 ? historyFrames : 1)
+{
+    cpuEpoch = std::chrono::steady_clock::now();
+    if (gpuTiming)
+        glGetInteger64v(GL_TIMESTAMP, &gpuEpoch);
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    for (GpuFrame &frame : gpuFrames)
+    {
+        if (!frame.queries.empty())
+            glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+    }
+}
+
+void FrameProfiler::beginFrame()
+{
+    if (gpuTiming)
+    {
+        // pick up whatever finished since last frame without waiting for anything
+        for (GpuFrame &frame : gpuFrames)
+        {
+            if (frame.pending)
+                collectGpuFrame(frame, false);
+        }
+
+        // the slot we are about to reuse has to be free, if the GPU is that far behind we drop it
+        GpuFrame &frame = gpuFrames[frameIndex % gpuFrameLatency];
+        if (frame.pending && !collectGpuFrame(frame, true))
+            droppedGpuFrames++;
+        frame.used = 0;
+        frame.stages.clear();
+    }
+
+    for (Stage &stage : stages)
+        stage.cpuThisFrame = 0.0;
+
+    beginStage("frame");
+}
+
+void FrameProfiler::endFrame()
+{
+    // close anything left open so one missing endStage doesn't break every later frame
+    while (!openStages.empty())
+        endStage();
+
+    for (Stage &stage : stages)
+    {
+        if (stage.cpuThisFrame > 0.0)
+            pushSample(stage.cpuHistory, stage.cpuCount, stage.cpuThisFrame);
+    }
+
+    if (gpuTiming)
+        gpuFrames[frameIndex % gpuFrameLatency].pending = true;
+
+    frameIndex++;
+}
+
+void FrameProfiler::beginStage(const char *name)
+{
+    OpenStage open;
+    open.stage = stageIndex(name);
+    open.beginQuery = 0;
+    if (gpuTiming)
+    {
+        open.beginQuery = nextQuery(gpuFrames[frameIndex % gpuFrameLatency]);
+        glQueryCounter(open.beginQuery, GL_TIMESTAMP);
+    }
+    open.cpuStart = std::chrono::steady_clock::now();
+    openStages.push_back(open);
+}
+
+void FrameProfiler::endStage()
+{
+    if (openStages.empty())
+        return;
+
+    auto cpuEnd = std::chrono::steady_clock::now();
+    OpenStage open = openStages.back();
+    openStages.pop_back();
+
+    double milliseconds = std::chrono::duration<double, std::milli>(cpuEnd - open.cpuStart).count();
+    stages[open.stage].cpuThisFrame += milliseconds;
+
+    if (traceCapture)
+        traceEvents.push_back({open.stage, false, microsecondsSinceStart(open.cpuStart), milliseconds * 1000.0});
+
+    if (gpuTiming)
+    {
+        GpuFrame &frame = gpuFrames[frameIndex % gpuFrameLatency];
+        unsigned int endQuery = nextQuery(frame);
+        glQueryCounter(endQuery, GL_TIMESTAMP);
+        frame.stages.push_back({open.stage, open.beginQuery, endQuery});
+    }
+}
+
+int FrameProfiler::stageIndex(const char *name)
+{
+    // a handful of stages, a linear scan on the pointer (then the text) beats hashing
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        if (stages[i].name == name || std::strcmp(stages[i].name, name) == 0)
+            return (int)i;
+    }
+
+    Stage stage;
+    stage.name = name;
+    stage.cpuHistory.assign(historyFrames, 0.0);
+    stage.gpuHistory.assign(historyFrames, 0.0);
+    stages.push_back(stage);
+    return (int)stages.size() - 1;
+}
+
+unsigned int FrameProfiler::nextQuery(GpuFrame &frame)
+{
+    if (frame.used == frame.queries.size())
+    {
+        unsigned int query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    return frame.queries[frame.used++];
+}
+
+bool FrameProfiler::collectGpuFrame(GpuFrame &frame, bool force)
+{
+    if (frame.stages.empty())
+    {
+        frame.pending = false;
+        return true;
+    }
+
+    // queries complete in order, so the last one being ready means all of them are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.stages.back().endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+        // force only comes from a slot being reused, its results are thrown away
+        if (force)
+        {
+            frame.pending = false;
+            frame.stages.clear();
+        }
+        return false;
+    }
+
+    std::vector<double> frameTotals(stages.size(), 0.0);
+    std::vector<bool> seen(stages.size(), false);
+    for (const GpuStageQuery &query : frame.stages)
+    {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(query.beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(query.endQuery, GL_QUERY_RESULT, &end);
+
+        double milliseconds = (double)(end - begin) / 1.0e6;
+        frameTotals[query.stage] += milliseconds;
+        seen[query.stage] = true;
+
+        if (traceCapture)
+            traceEvents.push_back({query.stage, true, (double)((int64_t)begin - gpuEpoch) / 1000.0, milliseconds * 1000.0});
+    }
+
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        if (seen[i])
+            pushSample(stages[i].gpuHistory, stages[i].gpuCount, frameTotals[i]);
+    }
+
+    frame.pending = false;
+    frame.stages.clear();
+    return true;
+}
+
+void FrameProfiler::pushSample(std::vector<double> &history, int &count, double value)
+{
+    history[count % historyFrames] = value;
+    count++;
+}
+
+double FrameProfiler::microsecondsSinceStart(std::chrono::steady_clock::time_point time) const
+{
+    return std::chrono::duration<double, std::micro>(time - cpuEpoch).count();
+}
+
+std::vector<StageStats> FrameProfiler::stageStats() const
+{
+    auto rolling = [this](const std::vector<double> &history, int count, double &average, double &max)
+    {
+        int samples = std::min(count, historyFrames);
+        double sum = 0.0;
+        max = 0.0;
+        for (int i = 0; i < samples; i++)
+        {
+            sum += history[i];
+            max = std::max(max, history[i]);
+        }
+        average = samples > 0 ? sum / samples : 0.0;
+    };
+
+    std::vector<StageStats> result;
+    for (const Stage &stage : stages)
+    {
+        StageStats stats;
+        stats.name = stage.name;
+        rolling(stage.cpuHistory, stage.cpuCount, stats.cpuAverage, stats.cpuMax);
+        rolling(stage.gpuHistory, stage.gpuCount, stats.gpuAverage, stats.gpuMax);
+        stats.samples = std::min(stage.cpuCount, historyFrames);
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void FrameProfiler::printSummary(std::ostream &out) const
+{
+    out << std::left << std::setw(16) << "stage"
+        << std::right << std::setw(12) << "cpu avg ms" << std::setw(12) << "cpu max ms"
+        << std::setw(12) << "gpu avg ms" << std::setw(12) << "gpu max ms" << "\n";
+
+    out << std::fixed << std::setprecision(3);
+    for (const StageStats &stats : stageStats())
+    {
+        out << std::left << std::setw(16) << stats.name
+            << std::right << std::setw(12) << stats.cpuAverage << std::setw(12) << stats.cpuMax
+            << std::setw(12) << stats.gpuAverage << std::setw(12) << stats.gpuMax << "\n";
+    }
+    out << std::defaultfloat;
+
+    if (droppedGpuFrames > 0)
+        out << droppedGpuFrames << " frames of GPU results dropped\n";
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string &path)
+{
+    // results still in flight are wanted in the trace, at this point waiting is fine
+    if (gpuTiming)
+    {
+        glFinish();
+        for (GpuFrame &frame : gpuFrames)
+        {
+            if (frame.pending)
+                collectGpuFrame(frame, false);
+        }
+    }
+
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+
+    // one process, CPU stages on thread 1 and GPU stages on thread 2
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+    file << std::fixed << std::setprecision(3);
+    for (const TraceEvent &event : traceEvents)
+    {
+        file << ",\n{\"name\":\"" << stages[event.stage].name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu")
+             << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+             << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+    }
+    file << "\n]}\n";
+    return (bool)file;
+}
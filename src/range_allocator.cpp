@@ -0,0 +1,257 @@
+#include "range_allocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+static int countTrailingZeros(uint32_t bits)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctz(bits);
+#endif
+}
+
+static int highestBit(uint32_t bits)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, bits);
+    return (int)index;
+#else
+    return 31 - __builtin_clz(bits);
+#endif
+}
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+    : totalSize(capacity)
+{
+    reset();
+}
+
+void RangeAllocator::reset()
+{
+    nodes.clear();
+    unusedNodes.clear();
+    for (uint32_t &head : binHeads)
+        head = none;
+    for (uint8_t &mask : binMasks)
+        mask = 0;
+    groupMask = 0;
+    allocationCount = 0;
+    usedSize = 0;
+
+    if (totalSize > 0)
+    {
+        uint32_t node = newNode();
+        nodes[node] = {0, totalSize, none, none, none, none, false};
+        insertFree(node);
+    }
+}
+
+// sizes below 8 map to themselves, above that the top bit picks a group of 8 and the next three
+// bits the bin inside it. rounding up gives the first bin whose every range is at least size
+int RangeAllocator::binIndex(uint32_t size, bool roundUp)
+{
+    if (size < 8)
+        return (int)size;
+
+    int exponent = highestBit(size);
+    int shift = exponent - 3;
+    int bin = (exponent - 2) * 8 + (int)((size >> shift) & 7);
+    if (roundUp && (size & ((1u << shift) - 1)) != 0)
+        bin++;
+    return bin;
+}
+
+// first non empty bin at or above bin, -1 if there is none
+int RangeAllocator::firstBinFrom(int bin) const
+{
+    if (bin >= binCount)
+        return -1;
+
+    int group = bin >> 3;
+    uint32_t inGroup = binMasks[group] & (0xFFu << (bin & 7));
+    if (inGroup)
+        return group * 8 + countTrailingZeros(inGroup);
+
+    uint32_t groupsAbove = groupMask & ~((2u << group) - 1);
+    if (!groupsAbove)
+        return -1;
+    group = countTrailingZeros(groupsAbove);
+    return group * 8 + countTrailingZeros(binMasks[group]);
+}
+
+uint32_t RangeAllocator::newNode()
+{
+    if (!unusedNodes.empty())
+    {
+        uint32_t node = unusedNodes.back();
+        unusedNodes.pop_back();
+        return node;
+    }
+    nodes.push_back(Node());
+    return (uint32_t)nodes.size() - 1;
+}
+
+void RangeAllocator::insertFree(uint32_t node)
+{
+    // rounded down, so the bin never promises more than the range has
+    int bin = binIndex(nodes[node].size, false);
+    nodes[node].used = false;
+    nodes[node].binPrev = none;
+    nodes[node].binNext = binHeads[bin];
+    if (binHeads[bin] != none)
+        nodes[binHeads[bin]].binPrev = node;
+    binHeads[bin] = node;
+
+    binMasks[bin >> 3] |= (uint8_t)(1u << (bin & 7));
+    groupMask |= 1u << (bin >> 3);
+}
+
+void RangeAllocator::removeFree(uint32_t node)
+{
+    Node &n = nodes[node];
+    if (n.binPrev != none)
+    {
+        nodes[n.binPrev].binNext = n.binNext;
+    }
+    else
+    {
+        int bin = binIndex(n.size, false);
+        binHeads[bin] = n.binNext;
+        if (n.binNext == none)
+        {
+            binMasks[bin >> 3] &= (uint8_t)~(1u << (bin & 7));
+            if (binMasks[bin >> 3] == 0)
+                groupMask &= ~(1u << (bin >> 3));
+        }
+    }
+    if (n.binNext != none)
+        nodes[n.binNext].binPrev = n.binPrev;
+}
+
+RangeAllocation RangeAllocator::allocate(uint32_t size)
+{
+    if (size == 0)
+        size = 1;
+
+    RangeAllocation allocation;
+
+    // the bin size rounds down into can still hold ranges big enough, a mesh freed and loaded again
+    // would never get its old hole back otherwise. a few looks keep this O(1)
+    uint32_t node = none;
+    int exactBin = binIndex(size, false);
+    if (exactBin != binIndex(size, true))
+    {
+        uint32_t candidate = binHeads[exactBin];
+        for (int looks = 0; looks < 8 && candidate != none; looks++, candidate = nodes[candidate].binNext)
+        {
+            if (nodes[candidate].size >= size)
+            {
+                node = candidate;
+                break;
+            }
+        }
+    }
+    if (node == none)
+    {
+        int bin = firstBinFrom(binIndex(size, true));
+        if (bin < 0)
+            return allocation;
+        node = binHeads[bin];
+    }
+    removeFree(node);
+
+    // the rest of the range stays free right behind the allocation
+    if (nodes[node].size > size)
+    {
+        uint32_t rest = newNode();
+        Node &n = nodes[node];
+        nodes[rest] = {n.offset + size, n.size - size, none, none, node, n.neighbourNext, false};
+        if (n.neighbourNext != none)
+            nodes[n.neighbourNext].neighbourPrev = rest;
+        n.neighbourNext = rest;
+        n.size = size;
+        insertFree(rest);
+    }
+
+    nodes[node].used = true;
+    allocationCount++;
+    usedSize += size;
+
+    allocation.offset = nodes[node].offset;
+    allocation.node = node;
+    return allocation;
+}
+
+void RangeAllocator::free(RangeAllocation allocation)
+{
+    if (!allocation.valid())
+        return;
+
+    uint32_t node = allocation.node;
+    allocationCount--;
+    usedSize -= nodes[node].size;
+    nodes[node].used = false;
+
+    // swallow free neighbours, the merged range keeps the lower node
+    uint32_t prev = nodes[node].neighbourPrev;
+    if (prev != none && !nodes[prev].used)
+    {
+        removeFree(prev);
+        nodes[prev].size += nodes[node].size;
+        nodes[prev].neighbourNext = nodes[node].neighbourNext;
+        if (nodes[node].neighbourNext != none)
+            nodes[nodes[node].neighbourNext].neighbourPrev = prev;
+        unusedNodes.push_back(node);
+        node = prev;
+    }
+
+    uint32_t next = nodes[node].neighbourNext;
+    if (next != none && !nodes[next].used)
+    {
+        removeFree(next);
+        nodes[node].size += nodes[next].size;
+        nodes[node].neighbourNext = nodes[next].neighbourNext;
+        if (nodes[next].neighbourNext != none)
+            nodes[nodes[next].neighbourNext].neighbourPrev = node;
+        unusedNodes.push_back(next);
+    }
+
+    insertFree(node);
+}
+
+uint32_t RangeAllocator::sizeOf(RangeAllocation allocation) const
+{
+    return allocation.valid() ? nodes[allocation.node].size : 0;
+}
+
+RangeAllocatorStats RangeAllocator::stats() const
+{
+    RangeAllocatorStats stats;
+    stats.capacity = totalSize;
+    stats.used = usedSize;
+    stats.free = totalSize - usedSize;
+    stats.allocations = allocationCount;
+
+    for (int bin = 0; bin < binCount; bin++)
+    {
+        for (uint32_t node = binHeads[bin]; node != none; node = nodes[node].binNext)
+        {
+            stats.freeRanges++;
+            if (nodes[node].size > stats.largestFree)
+                stats.largestFree = nodes[node].size;
+        }
+    }
+
+    if (totalSize > 0)
+        stats.utilisation = (double)stats.used / totalSize;
+    if (stats.free > 0)
+        stats.fragmentation = 1.0 - (double)stats.largestFree / stats.free;
+    return stats;
+}
@@ -1,13 +1,39 @@
 #include "shader.h"
 
+#include <filesystem>
+#include <cstring>
+#include <algorithm>
 
 
+// where linked program binaries are kept between launches, empty disables the cache
+std::string Shader::binaryCacheDirectory = "shader_cache";
+
+// the defines go right after the #version line, which has to stay first
+static std::string injectDefines(const std::string &code, const std::string &defines)
+{
+    if(defines.empty())
+        return code;
+
+    size_t lineEnd = 0;
+    size_t version = code.find("#version");
+    if(version != std::string::npos)
+    {
+        lineEnd = code.find('\n', version);
+        lineEnd = lineEnd == std::string::npos ? code.size() : lineEnd + 1;
+    }
+
+    // #line keeps the compiler's error line numbers matching the file on disk
+    int nextLine = 1 + (int)std::count(code.begin(), code.begin() + lineEnd, '\n');
+    return code.substr(0, lineEnd) + defines + "\n#line " + std::to_string(nextLine) + "\n" + code.substr(lineEnd);
+}
+
 //shader constructor
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string &defines)
 { 
     // this do
     // 1. get shader from shader file
-    // 2. create program from shader 
+    // 2. load the program binary from the cache, or create program from shader 
+    // 3. reflect the uniforms
     
     //for the souce shader code imported from files
     std::string vertexCode,fragmentCode;
@@ -43,6 +69,66 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     std::cout << "Error: " << e.what() << std::endl;
     }
 
+    vertexCode = injectDefines(vertexCode, defines);
+    fragmentCode = injectDefines(fragmentCode, defines);
+
+    // 2. the program binary is only valid for this exact source, driver and define set
+    ID = glCreateProgram();
+    std::string cachePath = binaryCachePath(vertexPath, fragmentPath, defines);
+    uint64_t cacheKey = binaryCacheKey(vertexCode, fragmentCode, defines);
+
+    bool success = loadProgramBinary(cachePath, cacheKey);
+    if(!success)
+    {
+        success = compileProgram(vertexCode, fragmentCode);
+        if(success)
+            saveProgramBinary(cachePath, cacheKey);
+    }
+
+    // 3. find every active uniform once so nobody has to call glGetUniformLocation later
+    if(success)
+        reflectUniforms();
+}
+
+Shader Shader::compute(const char* computePath, const std::string &defines)
+{
+    Shader shader;
+
+    std::string computeCode;
+    std::ifstream file(computePath);
+    if(file)
+    {
+        std::stringstream stream;
+        stream << file.rdbuf();
+        computeCode = stream.str();
+    }
+    else
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        std::cout << "Compute shader path: " << computePath << std::endl;
+    }
+    computeCode = injectDefines(computeCode, defines);
+
+    // the same cache as the vertex/fragment programs, with no fragment stage in the name or key
+    shader.ID = glCreateProgram();
+    std::string cachePath = binaryCachePath(computePath, "", defines);
+    uint64_t cacheKey = binaryCacheKey(computeCode, "", defines);
+
+    bool success = shader.loadProgramBinary(cachePath, cacheKey);
+    if(!success)
+    {
+        success = shader.compileComputeProgram(computeCode);
+        if(success)
+            shader.saveProgramBinary(cachePath, cacheKey);
+    }
+    if(success)
+        shader.reflectUniforms();
+    return shader;
+}
+
+// compile both stages from source and link them into ID
+bool Shader::compileProgram(const std::string &vertexCode, const std::string &fragmentCode)
+{
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
 
@@ -87,8 +173,11 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 
 
     // combine shader to program part
-    // ID is in the shader class
-    ID = glCreateProgram();
+    // ID is in the shader class and was created by the constructor
+
+    // ask the driver to keep the linked binary around so it can go into the cache
+    if(GLAD_GL_VERSION_4_1)
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
     // attach shader together
     glAttachShader(ID, vertexShader);
@@ -106,24 +195,328 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader); 
 
+    return success;
+}
+
+bool Shader::compileComputeProgram(const std::string &computeCode)
+{
+    const char* code = computeCode.c_str();
+    int success;
+    char infoLog[512];
+
+    unsigned int computeShader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(computeShader, 1, &code, NULL);
+    glCompileShader(computeShader);
+    glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
+    if(!success)
+    {
+        glGetShaderInfoLog(computeShader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
+    if(GLAD_GL_VERSION_4_1)
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    glAttachShader(ID, computeShader);
+    glLinkProgram(ID);
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    glDeleteShader(computeShader);
+
+    return success;
+}
+
+// FNV-1a 64 bit, used for the cache file name and the key stored inside it
+static uint64_t hashBytes(const std::string &bytes, uint64_t hash = 14695981039346656037ull)
+{
+    for (unsigned char c : bytes)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string hexString(uint64_t value)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; i--, value >>= 4)
+        hex[i] = digits[value & 0xf];
+    return hex;
+}
+
+// one file per vertex/fragment pair and set of defines, so every variant of a shader keeps its own
+// entry. a new source or driver overwrites the stale entry in place
+std::string Shader::binaryCachePath(const char* vertexPath, const char* fragmentPath, const std::string &defines)
+{
+    if(binaryCacheDirectory.empty())
+        return "";
+    std::string programName = std::string(vertexPath) + "|" + fragmentPath + "|" + defines;
+    return binaryCacheDirectory + "/" + hexString(hashBytes(programName)) + ".bin";
+}
+
+uint64_t Shader::binaryCacheKey(const std::string &vertexCode, const std::string &fragmentCode, const std::string &defines)
+{
+    auto glString = [](GLenum name)
+    {
+        const GLubyte *value = glGetString(name);
+        return value ? std::string((const char*)value) : std::string();
+    };
+
+    // separators keep "ab"+"c" and "a"+"bc" from hashing the same
+    uint64_t key = hashBytes(vertexCode);
+    key = hashBytes("\x1f" + fragmentCode, key);
+    key = hashBytes("\x1f" + defines, key);
+    key = hashBytes("\x1f" + glString(GL_VENDOR), key);
+    key = hashBytes("\x1f" + glString(GL_RENDERER), key);
+    key = hashBytes("\x1f" + glString(GL_VERSION), key);
+    return key;
+}
+
+// layout of a cache file, followed by binaryLength bytes of driver binary
+struct ProgramBinaryHeader
+{
+    char magic[4];
+    uint32_t binaryFormat;
+    uint64_t key;
+    uint32_t binaryLength;
+    uint32_t reserved;
+};
+
+static const char programBinaryMagic[4] = {'B', 'G', 'P', '1'};
+
+bool Shader::loadProgramBinary(const std::string &path, uint64_t key)
+{
+    if(path.empty() || !GLAD_GL_VERSION_4_1)
+        return false;
+
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+
+    ProgramBinaryHeader header;
+    if(!file.read((char*)&header, sizeof(header)))
+        return false;
+
+    // different source, defines or driver, the entry is stale and gets replaced after compiling
+    if(std::memcmp(header.magic, programBinaryMagic, 4) != 0 || header.key != key)
+        return false;
+
+    std::vector<char> binary(header.binaryLength);
+    if(!file.read(binary.data(), binary.size()))
+        return false;
+
+    glProgramBinary(ID, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+    int success;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        // the driver rejected it (updated driver, different GPU...), start over with a clean program
+        std::cout << "WARNING::SHADER::PROGRAM::BINARY_REJECTED " << path << std::endl;
+        glDeleteProgram(ID);
+        ID = glCreateProgram();
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+        return false;
+    }
+    return true;
+}
+
+void Shader::saveProgramBinary(const std::string &path, uint64_t key)
+{
+    if(path.empty() || !GLAD_GL_VERSION_4_1)
+        return;
+
+    int length = 0;
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(ID, length, &length, &binaryFormat, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(binaryCacheDirectory, error);
+
+    // write next to the real file and rename, so a crash never leaves a half written entry
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if(!file)
+            return;
+
+        ProgramBinaryHeader header = {};
+        std::memcpy(header.magic, programBinaryMagic, 4);
+        header.binaryFormat = binaryFormat;
+        header.key = key;
+        header.binaryLength = (uint32_t)length;
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), length);
+        if(!file)
+            return;
+    }
+    std::filesystem::rename(tempPath, path, error);
 }
 
 void Shader::use() 
 { 
-    glUseProgram(ID);
+    glState().useProgram(ID);
+}
+
+// FNV-1a, good enough for a handful of short uniform names
+static uint32_t hashUniformName(const std::string &name)
+{
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : name)
+    {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void Shader::reflectUniforms()
+{
+    int count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+
+    int maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+    uniformTable.clear();
+    uniformTable.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+        // uniforms inside uniform blocks have no location, they are fed through buffers
+        std::string name(nameBuffer.data(), length);
+        int location = glGetUniformLocation(ID, name.c_str());
+        if (location < 0)
+            continue;
+
+        uniformTable.push_back({name, location, type, size});
+    }
+
+    // table is kept at most a quarter full so probes stay short
+    size_t capacity = 8;
+    while (capacity < uniformTable.size() * 4)
+        capacity *= 2;
+    uniformSlots.assign(capacity, UniformSlot());
+
+    for (int i = 0; i < (int)uniformTable.size(); i++)
+    {
+        const std::string &name = uniformTable[i].name;
+        insertUniformName(name, i);
+
+        // arrays are reported as "name[0]", make plain "name" resolve as well
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            insertUniformName(name.substr(0, name.size() - 3), i);
+    }
+}
+
+void Shader::insertUniformName(const std::string &name, int index)
+{
+    uint32_t hash = hashUniformName(name);
+    size_t mask = uniformSlots.size() - 1;
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+    {
+        if (uniformSlots[slot].index < 0)
+        {
+            uniformSlots[slot] = {hash, index, name};
+            return;
+        }
+    }
+}
+
+UniformHandle Shader::uniform(const std::string &name) const
+{
+    if (!uniformSlots.empty())
+    {
+        uint32_t hash = hashUniformName(name);
+        size_t mask = uniformSlots.size() - 1;
+        for (size_t slot = hash & mask; uniformSlots[slot].index >= 0; slot = (slot + 1) & mask)
+        {
+            if (uniformSlots[slot].hash == hash && uniformSlots[slot].key == name)
+                return {uniformTable[uniformSlots[slot].index].location};
+        }
+    }
+
+    // the table only has "name[0]" and "name" of an array, other elements like "lights[2]" are
+    // left to the driver
+    if (ID == 0)
+        return {};
+    return {glGetUniformLocation(ID, name.c_str())};
 }
 
 void Shader::setBool(const std::string &name, bool value) const
 {         
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    setBool(uniform(name), value);
 }
 
 void Shader::setInt(const std::string &name, int value) const
 { 
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    setInt(uniform(name), value);
 }
 
 void Shader::setFloat(const std::string &name, float value) const
 { 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
-} 
\ No newline at end of file
+    setFloat(uniform(name), value);
+} 
+
+void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
+{
+    setVec3(uniform(name), value);
+}
+
+void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
+{
+    setVec4(uniform(name), value);
+}
+
+void Shader::setMat4(const std::string &name, const glm::mat4 &value) const
+{
+    setMat4(uniform(name), value);
+}
+
+// a location of -1 is silently ignored by GL, so invalid handles are harmless here
+void Shader::setBool(UniformHandle handle, bool value) const
+{
+    glUniform1i(handle.location, (int)value);
+}
+
+void Shader::setInt(UniformHandle handle, int value) const
+{
+    glUniform1i(handle.location, value);
+}
+
+void Shader::setFloat(UniformHandle handle, float value) const
+{
+    glUniform1f(handle.location, value);
+}
+
+void Shader::setVec3(UniformHandle handle, const glm::vec3 &value) const
+{
+    glUniform3fv(handle.location, 1, &value[0]);
+}
+
+void Shader::setVec4(UniformHandle handle, const glm::vec4 &value) const
+{
+    glUniform4fv(handle.location, 1, &value[0]);
+}
+
+void Shader::setMat4(UniformHandle handle, const glm::mat4 &value) const
+{
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, &value[0][0]);
+}
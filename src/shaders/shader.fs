@@ -3,6 +3,9 @@ out vec4 FragColor;
 
 in vec2 TexCoord;
 in vec3 ourColor;
+#ifdef INSTANCE_TINT
+in vec4 instanceColor;
+#endif
 
 uniform sampler2D texture1;
 uniform sampler2D texture2;
@@ -10,4 +13,7 @@ uniform sampler2D texture2;
 void main()
 {
     FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.2);
+#ifdef INSTANCE_TINT
+    FragColor *= instanceColor;
+#endif
 }
\ No newline at end of file
@@ -3,15 +3,92 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec2 aTexCoord;
 
+#ifdef INSTANCED
+// one per instance (glVertexAttribDivisor), takes locations 4 - 7
+layout (location = 4) in mat4 aInstanceTransform;
+#endif
+#ifdef INSTANCE_TINT
+layout (location = 8) in vec4 aInstanceColor;
+layout (location = 9) in vec2 aInstanceUvOffset;
+out vec4 instanceColor;
+#endif
+#ifdef MULTI_DRAW
+// one per draw of a glMultiDrawElementsIndirect, gl_DrawID picks ours
+layout (std430, binding = 0) readonly buffer DrawTransforms
+{
+    mat4 drawTransform[];
+};
+#endif
+
+#ifdef SKINNED
+// up to 4 joints a vertex, instance i of a draw takes its joints from i * jointsPerInstance on
+layout (location = 10) in uvec4 aJoints;
+layout (location = 11) in vec4 aWeights;
+#ifdef SKIN_MATRICES
+layout (std430, binding = 1) readonly buffer SkinJoints
+{
+    mat4 skinJoint[];
+};
+#else
+// dual quaternions, the real part (x, y, z, w) in the first column, the dual part in the second
+layout (std430, binding = 1) readonly buffer SkinJoints
+{
+    mat2x4 skinJoint[];
+};
+#endif
+uniform int jointsPerInstance;
+#endif
+
 out vec3 ourColor;
 out vec2 TexCoord;
 
 uniform mat4 transform;
 
+#ifdef SKINNED
+vec3 skin(vec3 position)
+{
+   uint base = uint(gl_InstanceID * jointsPerInstance);
+#ifdef SKIN_MATRICES
+   mat4 m = aWeights.x * skinJoint[base + aJoints.x] + aWeights.y * skinJoint[base + aJoints.y]
+          + aWeights.z * skinJoint[base + aJoints.z] + aWeights.w * skinJoint[base + aJoints.w];
+   return (m * vec4(position, 1.0)).xyz;
+#else
+   // blend on the shorter arc of the first joint, then normalize (dual quaternion linear blending)
+   mat2x4 first = skinJoint[base + aJoints.x];
+   mat2x4 dq = aWeights.x * first;
+   for (int i = 1; i < 4; i++)
+   {
+      mat2x4 joint = skinJoint[base + aJoints[i]];
+      dq += (dot(first[0], joint[0]) < 0.0 ? -aWeights[i] : aWeights[i]) * joint;
+   }
+   dq /= length(dq[0]);
+   vec3 real = dq[0].xyz, dual = dq[1].xyz;
+   vec3 translation = 2.0 * (dq[0].w * dual - dq[1].w * real + cross(real, dual));
+   return position + 2.0 * cross(real, cross(real, position) + dq[0].w * position) + translation;
+#endif
+}
+#endif
+
 void main()
 {
-   gl_Position = transform * vec4(aPos, 1.0);
+#ifdef SKINNED
+   vec3 position = skin(aPos);
+#else
+   vec3 position = aPos;
+#endif
+#ifdef INSTANCED
+   // the uniform is shared by every instance, the instance matrix places this copy
+   gl_Position = transform * aInstanceTransform * vec4(position, 1.0);
+#elif defined(MULTI_DRAW)
+   gl_Position = transform * drawTransform[gl_DrawID] * vec4(position, 1.0);
+#else
+   gl_Position = transform * vec4(position, 1.0);
+#endif
    ourColor = aColor;
    TexCoord = aTexCoord;
+#ifdef INSTANCE_TINT
+   TexCoord += aInstanceUvOffset;
+   instanceColor = aInstanceColor;
+#endif
 }
 
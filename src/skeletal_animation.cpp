@@ -0,0 +1,597 @@
+#include "skeletal_animation.h"
+#include "thread_pool.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#include <glm/simd/matrix.h>
+#endif
+
+
+namespace
+{
+    // characters a pool chunk takes at least
+    const int minChunkCharacters = 8;
+    // past this cosine the rotations are so close that slerp falls back to nlerp (sin(angle) is ~0)
+    const float slerpThreshold = 0.9995f;
+
+    // component arrays of a pose or clip frame, and of the model space / skinning dual quaternions
+    enum { RotationX, RotationY, RotationZ, RotationW, PositionX, PositionY, PositionZ, PoseComponents };
+    enum { RealX, RealY, RealZ, RealW, DualX, DualY, DualZ, DualW, DualQuatComponents };
+
+    // weights of two rotations cosine apart (>= 0) for slerp at t
+    void slerpWeights(float cosine, float t, float &weightA, float &weightB)
+    {
+        if (cosine > slerpThreshold)
+        {
+            weightA = 1.0f - t;
+            weightB = t;
+            return;
+        }
+        float angle = std::acos(cosine);
+        float inverseSin = 1.0f / std::sin(angle);
+        weightA = std::sin((1.0f - t) * angle) * inverseSin;
+        weightB = std::sin(t * angle) * inverseSin;
+    }
+
+    // a + t (b - a) for the first count joints of two poses stride apart
+    void interpolateScalar(const float *a, const float *b, float t, float *out, size_t stride, size_t count, bool slerp)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            float ax = a[RotationX * stride + j], ay = a[RotationY * stride + j];
+            float az = a[RotationZ * stride + j], aw = a[RotationW * stride + j];
+            float bx = b[RotationX * stride + j], by = b[RotationY * stride + j];
+            float bz = b[RotationZ * stride + j], bw = b[RotationW * stride + j];
+
+            // q and -q are the same rotation, take the one on the shorter arc from a
+            float cosine = ax * bx + ay * by + az * bz + aw * bw;
+            float sign = cosine < 0.0f ? -1.0f : 1.0f;
+            float weightA = 1.0f - t, weightB = t;
+            if (slerp)
+                slerpWeights(cosine * sign, t, weightA, weightB);
+            weightB *= sign;
+
+            float x = weightA * ax + weightB * bx, y = weightA * ay + weightB * by;
+            float z = weightA * az + weightB * bz, w = weightA * aw + weightB * bw;
+            float inverseLength = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+            out[RotationX * stride + j] = x * inverseLength;
+            out[RotationY * stride + j] = y * inverseLength;
+            out[RotationZ * stride + j] = z * inverseLength;
+            out[RotationW * stride + j] = w * inverseLength;
+
+            for (int c = PositionX; c <= PositionZ; c++)
+                out[c * stride + j] = std::fma(t, b[c * stride + j] - a[c * stride + j], a[c * stride + j]);
+        }
+    }
+
+    // rotation r and position p to the dual quaternion (r, 0.5 (0, p) r) for the first count joints
+    void localsScalar(const float *pose, float *locals, size_t stride, size_t count)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            float rx = pose[RotationX * stride + j], ry = pose[RotationY * stride + j];
+            float rz = pose[RotationZ * stride + j], rw = pose[RotationW * stride + j];
+            float px = pose[PositionX * stride + j], py = pose[PositionY * stride + j], pz = pose[PositionZ * stride + j];
+            locals[RealX * stride + j] = rx;
+            locals[RealY * stride + j] = ry;
+            locals[RealZ * stride + j] = rz;
+            locals[RealW * stride + j] = rw;
+            locals[DualX * stride + j] = 0.5f * (px * rw + py * rz - pz * ry);
+            locals[DualY * stride + j] = 0.5f * (-px * rz + py * rw + pz * rx);
+            locals[DualZ * stride + j] = 0.5f * (px * ry - py * rx + pz * rw);
+            locals[DualW * stride + j] = -0.5f * (px * rx + py * ry + pz * rz);
+        }
+    }
+
+    // model = model of the parent * local, down the joints in order so every parent is done first
+    void chainScalar(const float *locals, const unsigned int *parents, float *models, size_t stride, size_t count)
+    {
+        const unsigned int noParent = Skeleton::noParent;
+        for (size_t j = 0; j < count; j++)
+        {
+            float lx = locals[RealX * stride + j], ly = locals[RealY * stride + j];
+            float lz = locals[RealZ * stride + j], lw = locals[RealW * stride + j];
+            float ldx = locals[DualX * stride + j], ldy = locals[DualY * stride + j];
+            float ldz = locals[DualZ * stride + j], ldw = locals[DualW * stride + j];
+            if (parents[j] == noParent)
+            {
+                for (int c = RealX; c < DualQuatComponents; c++)
+                    models[c * stride + j] = locals[c * stride + j];
+                continue;
+            }
+            size_t p = parents[j];
+            float px = models[RealX * stride + p], py = models[RealY * stride + p];
+            float pz = models[RealZ * stride + p], pw = models[RealW * stride + p];
+            float pdx = models[DualX * stride + p], pdy = models[DualY * stride + p];
+            float pdz = models[DualZ * stride + p], pdw = models[DualW * stride + p];
+
+            // real = p.real l.real, dual = p.real l.dual + p.dual l.real
+            models[RealX * stride + j] = pw * lx + px * lw + py * lz - pz * ly;
+            models[RealY * stride + j] = pw * ly - px * lz + py * lw + pz * lx;
+            models[RealZ * stride + j] = pw * lz + px * ly - py * lx + pz * lw;
+            models[RealW * stride + j] = pw * lw - px * lx - py * ly - pz * lz;
+            models[DualX * stride + j] = (pw * ldx + px * ldw + py * ldz - pz * ldy) + (pdw * lx + pdx * lw + pdy * lz - pdz * ly);
+            models[DualY * stride + j] = (pw * ldy - px * ldz + py * ldw + pz * ldx) + (pdw * ly - pdx * lz + pdy * lw + pdz * lx);
+            models[DualZ * stride + j] = (pw * ldz + px * ldy - py * ldx + pz * ldw) + (pdw * lz + pdx * ly - pdy * lx + pdz * lw);
+            models[DualW * stride + j] = (pw * ldw - px * ldx - py * ldy - pz * ldz) + (pdw * lw - pdx * lx - pdy * ly - pdz * lz);
+        }
+    }
+
+    glm::dualquat componentsAt(const float *components, size_t stride, size_t j)
+    {
+        return glm::dualquat(
+            glm::quat(components[RealW * stride + j], components[RealX * stride + j], components[RealY * stride + j],
+                      components[RealZ * stride + j]),
+            glm::quat(components[DualW * stride + j], components[DualX * stride + j], components[DualY * stride + j],
+                      components[DualZ * stride + j]));
+    }
+
+    void setComponents(float *components, size_t stride, size_t j, const glm::dualquat &q)
+    {
+        components[RealX * stride + j] = q.real.x;
+        components[RealY * stride + j] = q.real.y;
+        components[RealZ * stride + j] = q.real.z;
+        components[RealW * stride + j] = q.real.w;
+        components[DualX * stride + j] = q.dual.x;
+        components[DualY * stride + j] = q.dual.y;
+        components[DualZ * stride + j] = q.dual.z;
+        components[DualW * stride + j] = q.dual.w;
+    }
+
+    // the rigid transform of a unit dual quaternion as a matrix, rotation of the real part and
+    // translation 2 * dual * conjugate(real)
+    glm::mat4 dualQuatMatrix(const glm::dualquat &q)
+    {
+        glm::mat4 m = glm::mat4_cast(q.real);
+        glm::vec3 real(q.real.x, q.real.y, q.real.z), dual(q.dual.x, q.dual.y, q.dual.z);
+        m[3] = glm::vec4(2.0f * (q.real.w * dual - q.dual.w * real + glm::cross(real, dual)), 1.0f);
+        return m;
+    }
+
+#ifdef CPU_X86
+    struct Quat8
+    {
+        __m256 x, y, z, w;
+    };
+
+    CPU_TARGET_AVX2_FMA
+    inline Quat8 multiply(const Quat8 &a, const Quat8 &b)
+    {
+        Quat8 r;
+        r.w = _mm256_fnmadd_ps(a.z, b.z, _mm256_fnmadd_ps(a.y, b.y, _mm256_fnmadd_ps(a.x, b.x, _mm256_mul_ps(a.w, b.w))));
+        r.x = _mm256_fnmadd_ps(a.z, b.y, _mm256_fmadd_ps(a.y, b.z, _mm256_fmadd_ps(a.x, b.w, _mm256_mul_ps(a.w, b.x))));
+        r.y = _mm256_fmadd_ps(a.z, b.x, _mm256_fmadd_ps(a.y, b.w, _mm256_fnmadd_ps(a.x, b.z, _mm256_mul_ps(a.w, b.y))));
+        r.z = _mm256_fmadd_ps(a.z, b.w, _mm256_fnmadd_ps(a.y, b.x, _mm256_fmadd_ps(a.x, b.y, _mm256_mul_ps(a.w, b.z))));
+        return r;
+    }
+
+    CPU_TARGET_AVX2_FMA
+    inline Quat8 loadQuat8(const float *components, size_t stride, size_t first)
+    {
+        return {_mm256_loadu_ps(components + first), _mm256_loadu_ps(components + stride + first),
+                _mm256_loadu_ps(components + 2 * stride + first), _mm256_loadu_ps(components + 3 * stride + first)};
+    }
+
+    // sin x for x in [0, pi/2], Taylor to x^11, the first term left out is below 6e-8 there
+    CPU_TARGET_AVX2_FMA
+    inline __m256 sin8(__m256 x)
+    {
+        __m256 x2 = _mm256_mul_ps(x, x);
+        __m256 p = _mm256_set1_ps(-1.0f / 39916800.0f);
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(1.0f / 362880.0f));
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(-1.0f / 5040.0f));
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(1.0f / 120.0f));
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(-1.0f / 6.0f));
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(1.0f));
+        return _mm256_mul_ps(p, x);
+    }
+
+    // acos x for x in [0, 1], Abramowitz and Stegun 4.4.46, error below 2e-8
+    CPU_TARGET_AVX2_FMA
+    inline __m256 acos8(__m256 x)
+    {
+        __m256 p = _mm256_set1_ps(-0.0012624911f);
+        p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(0.0066700901f));
+        p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(-0.0170881256f));
+        p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(0.0308918810f));
+        p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(-0.0501743046f));
+        p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(0.0889789874f));
+        p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(-0.2145988016f));
+        p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(1.5707963050f));
+        return _mm256_mul_ps(p, _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), x)));
+    }
+
+    // interpolateScalar for every joint up to stride, 8 a step
+    CPU_TARGET_AVX2_FMA
+    void interpolateAvx2(const float *a, const float *b, float t, float *out, size_t stride, bool slerp)
+    {
+        const __m256 signBit = _mm256_set1_ps(-0.0f), one = _mm256_set1_ps(1.0f);
+        const __m256 weightT = _mm256_set1_ps(t), weightOneMinusT = _mm256_set1_ps(1.0f - t);
+        for (size_t j = 0; j < stride; j += 8)
+        {
+            Quat8 qa = loadQuat8(a, stride, j), qb = loadQuat8(b, stride, j);
+            __m256 cosine = _mm256_fmadd_ps(qa.w, qb.w, _mm256_fmadd_ps(qa.z, qb.z,
+                            _mm256_fmadd_ps(qa.y, qb.y, _mm256_mul_ps(qa.x, qb.x))));
+            __m256 sign = _mm256_and_ps(cosine, signBit);
+            cosine = _mm256_xor_ps(cosine, sign);
+
+            __m256 weightA = weightOneMinusT, weightB = weightT;
+            if (slerp)
+            {
+                // the lanes past the threshold divide by a sin of ~0 here, the blend throws those away
+                __m256 angle = acos8(_mm256_min_ps(cosine, one));
+                __m256 inverseSin = _mm256_div_ps(one, sin8(angle));
+                __m256 close = _mm256_cmp_ps(cosine, _mm256_set1_ps(slerpThreshold), _CMP_GT_OQ);
+                weightA = _mm256_blendv_ps(_mm256_mul_ps(sin8(_mm256_mul_ps(weightOneMinusT, angle)), inverseSin),
+                                           weightOneMinusT, close);
+                weightB = _mm256_blendv_ps(_mm256_mul_ps(sin8(_mm256_mul_ps(weightT, angle)), inverseSin),
+                                           weightT, close);
+            }
+            weightB = _mm256_xor_ps(weightB, sign);
+
+            __m256 x = _mm256_fmadd_ps(weightA, qa.x, _mm256_mul_ps(weightB, qb.x));
+            __m256 y = _mm256_fmadd_ps(weightA, qa.y, _mm256_mul_ps(weightB, qb.y));
+            __m256 z = _mm256_fmadd_ps(weightA, qa.z, _mm256_mul_ps(weightB, qb.z));
+            __m256 w = _mm256_fmadd_ps(weightA, qa.w, _mm256_mul_ps(weightB, qb.w));
+            __m256 lengthSquared = _mm256_fmadd_ps(w, w, _mm256_fmadd_ps(z, z, _mm256_fmadd_ps(y, y, _mm256_mul_ps(x, x))));
+            __m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+            _mm256_storeu_ps(out + RotationX * stride + j, _mm256_mul_ps(x, inverseLength));
+            _mm256_storeu_ps(out + RotationY * stride + j, _mm256_mul_ps(y, inverseLength));
+            _mm256_storeu_ps(out + RotationZ * stride + j, _mm256_mul_ps(z, inverseLength));
+            _mm256_storeu_ps(out + RotationW * stride + j, _mm256_mul_ps(w, inverseLength));
+
+            for (int c = PositionX; c <= PositionZ; c++)
+            {
+                __m256 from = _mm256_loadu_ps(a + c * stride + j), to = _mm256_loadu_ps(b + c * stride + j);
+                _mm256_storeu_ps(out + c * stride + j, _mm256_fmadd_ps(weightT, _mm256_sub_ps(to, from), from));
+            }
+        }
+    }
+
+    // localsScalar for every joint up to stride, 8 a step, written as one dual quaternion of 8 floats
+    // a joint (real xyzw, dual xyzw) for the chain
+    CPU_TARGET_AVX2_FMA
+    void localsAvx2(const float *pose, float *locals, size_t stride)
+    {
+        const __m256 half = _mm256_set1_ps(0.5f);
+        for (size_t j = 0; j < stride; j += 8)
+        {
+            Quat8 r = loadQuat8(pose, stride, j);
+            __m256 px = _mm256_mul_ps(half, _mm256_loadu_ps(pose + PositionX * stride + j));
+            __m256 py = _mm256_mul_ps(half, _mm256_loadu_ps(pose + PositionY * stride + j));
+            __m256 pz = _mm256_mul_ps(half, _mm256_loadu_ps(pose + PositionZ * stride + j));
+            Quat8 dual = multiply({px, py, pz, _mm256_setzero_ps()}, r);
+            __m256 rows[8] = {r.x, r.y, r.z, r.w, dual.x, dual.y, dual.z, dual.w};
+            glm_transpose8_avx(rows);
+            for (int lane = 0; lane < 8; lane++)
+                _mm256_storeu_ps(locals + (j + lane) * 8, rows[lane]);
+        }
+    }
+
+    // q * r for two quaternions a register, one per 128 bit lane
+    CPU_TARGET_AVX2_FMA
+    inline __m256 multiplyLanes(__m256 q, __m256 r)
+    {
+        // q * r = qw r + qx (rw, -rz, ry, -rx) + qy (rz, rw, -rx, -ry) + qz (-ry, rx, rw, -rz)
+        const __m256 signsX = _mm256_setr_ps(0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f);
+        const __m256 signsY = _mm256_setr_ps(0.0f, 0.0f, -0.0f, -0.0f, 0.0f, 0.0f, -0.0f, -0.0f);
+        const __m256 signsZ = _mm256_setr_ps(-0.0f, 0.0f, 0.0f, -0.0f, -0.0f, 0.0f, 0.0f, -0.0f);
+        __m256 result = _mm256_mul_ps(_mm256_permute_ps(q, _MM_SHUFFLE(3, 3, 3, 3)), r);
+        result = _mm256_fmadd_ps(_mm256_permute_ps(q, _MM_SHUFFLE(0, 0, 0, 0)),
+                                 _mm256_xor_ps(_mm256_permute_ps(r, _MM_SHUFFLE(0, 1, 2, 3)), signsX), result);
+        result = _mm256_fmadd_ps(_mm256_permute_ps(q, _MM_SHUFFLE(1, 1, 1, 1)),
+                                 _mm256_xor_ps(_mm256_permute_ps(r, _MM_SHUFFLE(1, 0, 3, 2)), signsY), result);
+        return _mm256_fmadd_ps(_mm256_permute_ps(q, _MM_SHUFFLE(2, 2, 2, 2)),
+                               _mm256_xor_ps(_mm256_permute_ps(r, _MM_SHUFFLE(2, 3, 0, 1)), signsZ), result);
+    }
+
+    // chainScalar on dual quaternions of 8 floats a joint. real in the low lane, dual in the high
+    // one: (p.real l.real, p.real l.dual) + (0, p.dual l.real), two lane wise multiplies
+    CPU_TARGET_AVX2_FMA
+    void chainAvx2(const float *locals, const unsigned int *parents, float *models, size_t count)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            __m256 local = _mm256_loadu_ps(locals + j * 8);
+            if (parents[j] != Skeleton::noParent)
+            {
+                __m256 parent = _mm256_loadu_ps(models + (size_t)parents[j] * 8);
+                __m256 realDual = multiplyLanes(_mm256_permute2f128_ps(parent, parent, 0x00), local);
+                __m256 dualReal = multiplyLanes(_mm256_permute2f128_ps(parent, parent, 0x18),
+                                                _mm256_permute2f128_ps(local, local, 0x00));
+                local = _mm256_add_ps(realDual, dualReal);
+            }
+            _mm256_storeu_ps(models + j * 8, local);
+        }
+    }
+
+    // skin = model * inverse bind for 8 joints a step, the models as chainAvx2 leaves them. written as
+    // count dual quaternions or mat4s
+    CPU_TARGET_AVX2_FMA
+    void skinAvx2(const float *models, const float *inverseBinds, size_t stride, size_t count,
+                  glm::dualquat *dualQuaternions, glm::mat4 *matrices)
+    {
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+        for (size_t j = 0; j < count; j += 8)
+        {
+            __m256 m[8];
+            for (int lane = 0; lane < 8; lane++)
+                m[lane] = _mm256_loadu_ps(models + (j + lane) * 8);
+            glm_transpose8_avx(m);
+            Quat8 modelReal = {m[RealX], m[RealY], m[RealZ], m[RealW]}, modelDual = {m[DualX], m[DualY], m[DualZ], m[DualW]};
+            Quat8 bindReal = loadQuat8(inverseBinds, stride, j), bindDual = loadQuat8(inverseBinds + DualX * stride, stride, j);
+            Quat8 real = multiply(modelReal, bindReal);
+            Quat8 dualA = multiply(modelReal, bindDual), dualB = multiply(modelDual, bindReal);
+            Quat8 dual = {_mm256_add_ps(dualA.x, dualB.x), _mm256_add_ps(dualA.y, dualB.y),
+                          _mm256_add_ps(dualA.z, dualB.z), _mm256_add_ps(dualA.w, dualB.w)};
+            size_t lanes = std::min<size_t>(8, count - j);
+
+            if (dualQuaternions)
+            {
+                // element major to one dual quaternion (real xyzw, dual xyzw) a register
+                __m256 r[8] = {real.x, real.y, real.z, real.w, dual.x, dual.y, dual.z, dual.w};
+                glm_transpose8_avx(r);
+                float *out = &dualQuaternions[j].real.x;
+                for (size_t lane = 0; lane < lanes; lane++)
+                    _mm256_storeu_ps(out + lane * 8, r[lane]);
+                continue;
+            }
+
+            // the rotation columns like TransformBatch makes them with scale 1, the translation
+            // 2 (w d - dw r + r x d) as the last column
+            __m256 x2 = _mm256_add_ps(real.x, real.x), y2 = _mm256_add_ps(real.y, real.y), z2 = _mm256_add_ps(real.z, real.z);
+            __m256 xx = _mm256_mul_ps(real.x, x2), yy = _mm256_mul_ps(real.y, y2), zz = _mm256_mul_ps(real.z, z2);
+            __m256 xy = _mm256_mul_ps(real.x, y2), xz = _mm256_mul_ps(real.x, z2), yz = _mm256_mul_ps(real.y, z2);
+            __m256 wx = _mm256_mul_ps(real.w, x2), wy = _mm256_mul_ps(real.w, y2), wz = _mm256_mul_ps(real.w, z2);
+            __m256 tx = _mm256_fmsub_ps(real.y, dual.z, _mm256_mul_ps(real.z, dual.y));
+            __m256 ty = _mm256_fmsub_ps(real.z, dual.x, _mm256_mul_ps(real.x, dual.z));
+            __m256 tz = _mm256_fmsub_ps(real.x, dual.y, _mm256_mul_ps(real.y, dual.x));
+            tx = _mm256_mul_ps(two, _mm256_fnmadd_ps(dual.w, real.x, _mm256_fmadd_ps(real.w, dual.x, tx)));
+            ty = _mm256_mul_ps(two, _mm256_fnmadd_ps(dual.w, real.y, _mm256_fmadd_ps(real.w, dual.y, ty)));
+            tz = _mm256_mul_ps(two, _mm256_fnmadd_ps(dual.w, real.z, _mm256_fmadd_ps(real.w, dual.z, tz)));
+
+            __m256 low[8] = {
+                _mm256_sub_ps(one, _mm256_add_ps(yy, zz)), _mm256_add_ps(xy, wz), _mm256_sub_ps(xz, wy), zero,
+                _mm256_sub_ps(xy, wz), _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), _mm256_add_ps(yz, wx), zero };
+            __m256 high[8] = {
+                _mm256_add_ps(xz, wy), _mm256_sub_ps(yz, wx), _mm256_sub_ps(one, _mm256_add_ps(xx, yy)), zero,
+                tx, ty, tz, one };
+            glm_transpose8_avx(low);
+            glm_transpose8_avx(high);
+            float *out = &matrices[j][0][0];
+            for (size_t lane = 0; lane < lanes; lane++)
+            {
+                _mm256_storeu_ps(out + lane * 16, low[lane]);
+                _mm256_storeu_ps(out + lane * 16 + 8, high[lane]);
+            }
+        }
+    }
+#endif
+
+    // the two frames around time (wrapped into the clip) and how far between them it is
+    void framesAt(const AnimationClip &clip, float time, const float *&a, const float *&b, float &t)
+    {
+        float frames = (float)clip.frameCount();
+        float position = std::fmod(time * clip.framesPerSecond(), frames);
+        if (position < 0.0f)
+            position += frames;
+        size_t first = std::min((size_t)position, clip.frameCount() - 1);
+        t = position - first;
+        a = clip.frame(first);
+        b = clip.frame((first + 1) % clip.frameCount());
+    }
+}
+
+unsigned int Skeleton::addJoint(unsigned int parent, const glm::vec3 &bindPosition, const glm::quat &bindRotation)
+{
+    if (parent != noParent && parent >= parents.size())
+        throw std::invalid_argument("Skeleton::addJoint: there is no joint " + std::to_string(parent));
+
+    glm::dualquat local(glm::normalize(bindRotation), bindPosition);
+    glm::dualquat model = parent == noParent ? local : bindModels[parent] * local;
+    parents.push_back(parent);
+    bindPositions.push_back(bindPosition);
+    bindRotations.push_back(glm::normalize(bindRotation));
+    bindModels.push_back(model);
+    inverseBinds.push_back(glm::inverse(model));
+
+    // the padded layouts move when the count passes a multiple of 8, rebuilt whole, skeletons are small
+    size_t stride = paddedJointCount();
+    bindPose.assign(PoseComponents * stride, 0.0f);
+    inverseBindComponents.assign(DualQuatComponents * stride, 0.0f);
+    std::fill(bindPose.begin() + RotationW * stride, bindPose.begin() + (RotationW + 1) * stride, 1.0f);
+    std::fill(inverseBindComponents.begin() + RealW * stride, inverseBindComponents.begin() + (RealW + 1) * stride, 1.0f);
+    for (size_t j = 0; j < parents.size(); j++)
+    {
+        const glm::quat &rotation = bindRotations[j];
+        const glm::vec3 &position = bindPositions[j];
+        bindPose[RotationX * stride + j] = rotation.x;
+        bindPose[RotationY * stride + j] = rotation.y;
+        bindPose[RotationZ * stride + j] = rotation.z;
+        bindPose[RotationW * stride + j] = rotation.w;
+        bindPose[PositionX * stride + j] = position.x;
+        bindPose[PositionY * stride + j] = position.y;
+        bindPose[PositionZ * stride + j] = position.z;
+        setComponents(inverseBindComponents.data(), stride, j, inverseBinds[j]);
+    }
+    return (unsigned int)(parents.size() - 1);
+}
+
+
+AnimationClip::AnimationClip(size_t jointCount, size_t frameCount, float framesPerSecond)
+    : joints(jointCount), frames(frameCount), stride((jointCount + 7) / 8 * 8), rate(framesPerSecond)
+{
+    if (frameCount == 0 || !(framesPerSecond > 0.0f))
+        throw std::invalid_argument("AnimationClip: needs at least one frame and a positive frame rate");
+
+    keys.assign(frames * PoseComponents * stride, 0.0f);
+    for (size_t f = 0; f < frames; f++)
+        std::fill_n(keys.begin() + (f * PoseComponents + RotationW) * stride, stride, 1.0f);
+}
+
+void AnimationClip::setKey(size_t frame, size_t joint, const glm::vec3 &position, const glm::quat &rotation)
+{
+    float *key = &keys[frame * PoseComponents * stride + joint];
+    key[RotationX * stride] = rotation.x;
+    key[RotationY * stride] = rotation.y;
+    key[RotationZ * stride] = rotation.z;
+    key[RotationW * stride] = rotation.w;
+    key[PositionX * stride] = position.x;
+    key[PositionY * stride] = position.y;
+    key[PositionZ * stride] = position.z;
+}
+
+glm::vec3 AnimationClip::position(size_t frame, size_t joint) const
+{
+    const float *key = this->frame(frame) + joint;
+    return glm::vec3(key[PositionX * stride], key[PositionY * stride], key[PositionZ * stride]);
+}
+
+glm::quat AnimationClip::rotation(size_t frame, size_t joint) const
+{
+    const float *key = this->frame(frame) + joint;
+    return glm::quat(key[RotationW * stride], key[RotationX * stride], key[RotationY * stride], key[RotationZ * stride]);
+}
+
+
+AnimationSystem::AnimationSystem(const Skeleton &skeleton)
+    : skeleton(skeleton)
+{
+}
+
+size_t AnimationSystem::addCharacter()
+{
+    characters.push_back(Character());
+    return characters.size() - 1;
+}
+
+void AnimationSystem::play(size_t character, const AnimationClip &clip, float time)
+{
+    blend(character, clip, time, clip, time, 0.0f);
+    characters[character].clips[1] = nullptr;
+}
+
+void AnimationSystem::blend(size_t character, const AnimationClip &from, float fromTime, const AnimationClip &to,
+                            float toTime, float weight)
+{
+    if (from.jointCount() != jointCount() || to.jointCount() != jointCount())
+    {
+        throw std::invalid_argument("AnimationSystem: a clip for " + std::to_string(from.jointCount()) + " and " +
+                                    std::to_string(to.jointCount()) + " joints on a skeleton of " +
+                                    std::to_string(jointCount()));
+    }
+    Character &state = characters[character];
+    state.clips[0] = &from;
+    state.clips[1] = &to;
+    state.times[0] = fromTime;
+    state.times[1] = toTime;
+    state.weight = weight;
+}
+
+bool AnimationSystem::simdAvailable()
+{
+#ifdef CPU_X86
+    return cpuHasAvx2() && cpuHasFma();
+#else
+    return false;
+#endif
+}
+
+void AnimationSystem::animate(size_t begin, size_t end, const AnimationUpdateOptions &options, bool simd)
+{
+    size_t count = jointCount(), stride = skeleton.paddedJointCount();
+    bool slerp = options.interpolation == AnimationSlerp;
+    bool toMatrices = options.output == SkinMatrices;
+
+    // scratch for the chunk: two sampled poses and their blend, then the local and model space dual
+    // quaternions, component arrays on the scalar path and 8 floats a joint on the AVX2 one. the
+    // padding lanes only ever hold finite values and are never written out
+    std::vector<float> poses(3 * PoseComponents * stride);
+    float *sampled[2] = {&poses[0], &poses[PoseComponents * stride]};
+    float *blended = &poses[2 * PoseComponents * stride];
+    std::vector<float> dualQuats(2 * DualQuatComponents * stride, 0.0f);
+    float *locals = &dualQuats[0], *models = &dualQuats[DualQuatComponents * stride];
+
+    auto interpolate = [&](const float *a, const float *b, float t, float *out)
+    {
+#ifdef CPU_X86
+        if (simd)
+        {
+            interpolateAvx2(a, b, t, out, stride, slerp);
+            return;
+        }
+#endif
+        interpolateScalar(a, b, t, out, stride, count, slerp);
+    };
+
+    for (size_t c = begin; c < end; c++)
+    {
+        const Character &state = characters[c];
+        const float *pose = skeleton.bindPose.data();
+        for (int layer = 0; layer < 2 && state.clips[layer]; layer++)
+        {
+            const float *a, *b;
+            float t;
+            framesAt(*state.clips[layer], state.times[layer], a, b, t);
+            interpolate(a, b, t, sampled[layer]);
+            pose = sampled[layer];
+        }
+        if (state.clips[1])
+        {
+            interpolate(sampled[0], sampled[1], state.weight, blended);
+            pose = blended;
+        }
+
+        glm::dualquat *dualQuaternions = toMatrices ? nullptr : &skinDualQuaternions[c * count];
+        glm::mat4 *matrices = toMatrices ? &skinMatrices[c * count] : nullptr;
+#ifdef CPU_X86
+        if (simd)
+        {
+            localsAvx2(pose, locals, stride);
+            chainAvx2(locals, skeleton.parents.data(), models, count);
+            skinAvx2(models, skeleton.inverseBindComponents.data(), stride, count, dualQuaternions, matrices);
+            continue;
+        }
+#endif
+        localsScalar(pose, locals, stride, count);
+        chainScalar(locals, skeleton.parents.data(), models, stride, count);
+        for (size_t j = 0; j < count; j++)
+        {
+            glm::dualquat skin = componentsAt(models, stride, j) * skeleton.inverseBinds[j];
+            if (toMatrices)
+                matrices[j] = dualQuatMatrix(skin);
+            else
+                dualQuaternions[j] = skin;
+        }
+    }
+}
+
+void AnimationSystem::update(const AnimationUpdateOptions &options)
+{
+    size_t total = characters.size() * jointCount();
+    if (options.output == SkinMatrices)
+        skinMatrices.resize(total);
+    else
+        skinDualQuaternions.resize(total);
+    if (total == 0)
+        return;
+
+    bool simd = options.allowSimd && simdAvailable();
+    if (options.parallel)
+    {
+        threadPool().parallelFor((int)characters.size(), [&](int begin, int end)
+        {
+            animate(begin, end, options, simd);
+        }, minChunkCharacters);
+    }
+    else
+    {
+        animate(0, characters.size(), options, simd);
+    }
+}
@@ -0,0 +1,101 @@
+#include "skin_buffer.h"
+#include "gl_state.h"
+#include "stream_ring.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+
+SkinBuffer::SkinBuffer()
+    : jointBuffer(0)
+{
+    glGenBuffers(1, &jointBuffer);
+    GLint alignment = 256;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    storageAlignment = (size_t)alignment;
+}
+
+SkinBuffer::~SkinBuffer()
+{
+    glDeleteBuffers(1, &jointBuffer);
+    glState().forgetBuffer(jointBuffer);
+}
+
+unsigned int SkinBuffer::attachWeights(unsigned int vertexArray, const SkinVertex *vertices, size_t count)
+{
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glState().bindVertexArray(vertexArray);
+    glState().bindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(SkinVertex), vertices, GL_STATIC_DRAW);
+
+    // the I variant keeps the joints integers, the weights are normalized to 0..1
+    glVertexAttribIPointer(jointsLocation, 4, GL_UNSIGNED_BYTE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, joints));
+    glEnableVertexAttribArray(jointsLocation);
+    glVertexAttribPointer(weightsLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinVertex),
+                          (void*)offsetof(SkinVertex, weights));
+    glEnableVertexAttribArray(weightsLocation);
+    return buffer;
+}
+
+void SkinBuffer::uploadBytesToBuffer(const void *data, size_t size)
+{
+    // grow geometrically so a slowly rising count doesn't reallocate every frame
+    if (size > capacity)
+        capacity = std::max(size, capacity * 2);
+    uploadBytes = size;
+    source = jointBuffer;
+    offset = 0;
+    if (size == 0)
+        return;
+
+    // orphan then write, a draw still skinning with last frame's joints keeps the old storage
+    glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, jointBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+}
+
+void SkinBuffer::uploadBytesToRing(StreamRing &ring, const void *data, size_t size)
+{
+    uploadBytes = size;
+    if (size == 0)
+        return;
+
+    StreamAllocation block = ring.allocate(size, storageAlignment);
+    std::memcpy(block.data, data, size);
+    source = ring.buffer;
+    offset = block.offset;
+}
+
+void SkinBuffer::upload(const glm::dualquat *joints, size_t count)
+{
+    uploadBytesToBuffer(joints, count * sizeof(glm::dualquat));
+}
+
+void SkinBuffer::upload(const glm::mat4 *joints, size_t count)
+{
+    uploadBytesToBuffer(joints, count * sizeof(glm::mat4));
+}
+
+void SkinBuffer::upload(StreamRing &ring, const glm::dualquat *joints, size_t count)
+{
+    uploadBytesToRing(ring, joints, count * sizeof(glm::dualquat));
+}
+
+void SkinBuffer::upload(StreamRing &ring, const glm::mat4 *joints, size_t count)
+{
+    uploadBytesToRing(ring, joints, count * sizeof(glm::mat4));
+}
+
+void SkinBuffer::bind() const
+{
+    if (uploadBytes == 0)
+        return;
+    glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, source, offset, uploadBytes);
+}
+
+std::string SkinBuffer::shaderDefines(bool matrices)
+{
+    return matrices ? "#define SKINNED\n#define SKIN_MATRICES" : "#define SKINNED";
+}
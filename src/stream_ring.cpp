@@ -0,0 +1,114 @@
+#include "stream_ring.h"
+#include "gl_state.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+
+bool StreamRing::supported()
+{
+    return GLAD_GL_VERSION_4_4 != 0;
+}
+
+StreamRing::StreamRing(size_t frameBytes, int frameCount)
+    : buffer(0), mapped(nullptr), regionCount(frameCount), fences()
+{
+    if (!supported())
+        throw std::runtime_error("StreamRing needs GL 4.4 (glBufferStorage)");
+    if (frameCount < 1 || frameCount > (int)(sizeof(fences) / sizeof(fences[0])))
+        throw std::invalid_argument("StreamRing: frameCount has to be 1 - 8");
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformAlignment = (size_t)alignment;
+
+    // every region starts on a boundary any allocation alignment up to 256 is happy with
+    regionSize = (frameBytes + 255) & ~(size_t)255;
+    size_t totalSize = regionSize * regionCount;
+
+    // the copy write binding is free for this, nothing draws from it
+    glGenBuffers(1, &buffer);
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+    mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+    if (!mapped)
+    {
+        glDeleteBuffers(1, &buffer);
+        glState().forgetBuffer(buffer);
+        throw std::runtime_error("StreamRing: couldn't map " + std::to_string(totalSize) + " bytes");
+    }
+}
+
+StreamRing::~StreamRing()
+{
+    for (GLsync fence : fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+    }
+
+    // persistent mappings still have to be unmapped before the buffer goes
+    glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glDeleteBuffers(1, &buffer);
+    glState().forgetBuffer(buffer);
+}
+
+void StreamRing::beginFrame()
+{
+    region = (region + 1) % regionCount;
+    head = 0;
+    ringStats.frames++;
+
+    GLsync &fence = fences[region];
+    if (!fence)
+        return;
+
+    // the first check flushes, so the fence is sure to reach the GPU and the loop can't hang
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        ringStats.stalls++;
+        auto start = std::chrono::steady_clock::now();
+        do
+        {
+            result = glClientWaitSync(fence, 0, 1000000);   // 1 ms
+        } while (result == GL_TIMEOUT_EXPIRED);
+        ringStats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+StreamAllocation StreamRing::allocate(size_t bytes, size_t alignment)
+{
+    if (region < 0)
+        throw std::runtime_error("StreamRing: allocate before the first beginFrame");
+
+    size_t start = (head + alignment - 1) & ~(alignment - 1);
+    if (start + bytes > regionSize)
+        throw std::runtime_error("StreamRing: frame needs more than " + std::to_string(regionSize) + " bytes");
+
+    head = start + bytes;
+    if (head > ringStats.peakFrameBytes)
+        ringStats.peakFrameBytes = head;
+
+    size_t offset = region * regionSize + start;
+    return {mapped + offset, offset, bytes};
+}
+
+StreamAllocation StreamRing::allocateUniform(size_t bytes)
+{
+    return allocate(bytes, uniformAlignment);
+}
+
+void StreamRing::endFrame()
+{
+    if (region < 0)
+        return;
+    if (fences[region])
+        glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
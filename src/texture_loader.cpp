@@ -0,0 +1,399 @@
+#include "texture_loader.h"
+#include "gl_state.h"
+#include "thread_pool.h"
+
+#include <stb_image.h>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+
+static GLenum pixelFormat(int channels)
+{
+    switch (channels)
+    {
+        case 1:  return GL_RED;
+        case 2:  return GL_RG;
+        case 3:  return GL_RGB;
+        default: return GL_RGBA;
+    }
+}
+
+static GLenum internalFormat(int channels)
+{
+    switch (channels)
+    {
+        case 1:  return GL_R8;
+        case 2:  return GL_RG8;
+        case 3:  return GL_RGB8;
+        default: return GL_RGBA8;
+    }
+}
+
+// stb_image calls this with plain function pointers, forward to the shared pool
+static void jpegParallelFor(void *, stbi_parallel_task *task, void *taskContext, int count)
+{
+    // a handful of rows per chunk, single rows are too little work to hand out
+    threadPool().parallelFor(count, [task, taskContext](int begin, int end) {
+        task(taskContext, begin, end);
+    }, 8);
+}
+
+void TextureLoader::setParallelJpegDecode(bool enabled)
+{
+    stbi_set_jpeg_parallel_for(enabled ? jpegParallelFor : nullptr, nullptr);
+}
+
+
+TextureLoader::TextureLoader(int workerThreads, size_t uploadBudget)
+    : uploadBudget(uploadBudget)
+{
+    // the placeholder every loading texture shows, a single white texel
+    const unsigned char white[4] = {255, 255, 255, 255};
+    glGenTextures(1, &placeholder);
+    glState().bindTexture(0, GL_TEXTURE_2D, placeholder);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenBuffers(1, &pixelBuffer);
+
+    if (workerThreads <= 0)
+        workerThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < workerThreads; i++)
+        workers.emplace_back(&TextureLoader::workerLoop, this);
+}
+
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+
+    for (DecodeResult &result : decoded)
+        stbi_image_free(result.pixels);
+
+    for (Texture &texture : textures)
+    {
+        stbi_image_free(texture.pixels);
+        if (texture.id)
+        {
+            glDeleteTextures(1, &texture.id);
+            glState().forgetTexture(texture.id);
+        }
+    }
+    glDeleteTextures(1, &placeholder);
+    glState().forgetTexture(placeholder);
+    glDeleteBuffers(1, &pixelBuffer);
+    glState().forgetBuffer(pixelBuffer);
+}
+
+TextureHandle TextureLoader::load(const std::string &path, const TextureLoadOptions &options)
+{
+    TextureHandle handle = (TextureHandle)textures.size();
+    Texture texture;
+    texture.path = path;
+    texture.options = options;
+    textures.push_back(texture);
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobs.push_back({handle, 0, path, options.flipVertically});
+    }
+    jobReady.notify_one();
+    return handle;
+}
+
+void TextureLoader::unload(TextureHandle handle)
+{
+    if (handle < 0 || handle >= (TextureHandle)textures.size())
+        return;
+
+    Texture &texture = textures[handle];
+    if (texture.id)
+    {
+        glDeleteTextures(1, &texture.id);
+        glState().forgetTexture(texture.id);
+        texture.id = 0;
+    }
+    stbi_image_free(texture.pixels);
+    texture.pixels = nullptr;
+    texture.rowsUploaded = 0;
+    texture.status = UNLOADED;
+    texture.generation++;
+}
+
+void TextureLoader::reload(TextureHandle handle)
+{
+    if (!unloaded(handle))
+        return;
+
+    Texture &texture = textures[handle];
+    texture.status = DECODING;
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobs.push_back({handle, texture.generation, texture.path, texture.options.flipVertically});
+    }
+    jobReady.notify_one();
+}
+
+bool TextureLoader::unloaded(TextureHandle handle) const
+{
+    return handle >= 0 && handle < (TextureHandle)textures.size() && textures[handle].status == UNLOADED;
+}
+
+size_t TextureLoader::gpuBytes(TextureHandle handle) const
+{
+    if (handle < 0 || handle >= (TextureHandle)textures.size() || !textures[handle].id)
+        return 0;
+
+    // drivers pad RGB8 to four bytes a texel, a full mip chain adds a third
+    const Texture &texture = textures[handle];
+    size_t texelBytes = texture.channels == 3 ? 4 : texture.channels;
+    size_t bytes = (size_t)texture.width * texture.height * texelBytes;
+    return texture.options.mipmaps ? bytes * 4 / 3 : bytes;
+}
+
+uint64_t TextureLoader::contentHash(TextureHandle handle) const
+{
+    if (handle < 0 || handle >= (TextureHandle)textures.size())
+        return 0;
+    return textures[handle].contentHash;
+}
+
+unsigned int TextureLoader::texture(TextureHandle handle) const
+{
+    if (handle < 0 || handle >= (TextureHandle)textures.size() || textures[handle].status != READY)
+        return placeholder;
+    return textures[handle].id;
+}
+
+bool TextureLoader::ready(TextureHandle handle) const
+{
+    return handle >= 0 && handle < (TextureHandle)textures.size() && textures[handle].status == READY;
+}
+
+int TextureLoader::pendingCount() const
+{
+    int pending = 0;
+    for (const Texture &texture : textures)
+    {
+        if (texture.status == DECODING || texture.status == UPLOADING)
+            pending++;
+    }
+    return pending;
+}
+
+void TextureLoader::workerLoop()
+{
+    while (true)
+    {
+        DecodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        // read the whole file, then decode from memory so the file is only touched once
+        DecodeResult result = {job.handle, job.generation, nullptr, 0, 0, 0, 0};
+        std::ifstream file(job.path, std::ios::binary | std::ios::ate);
+        if (file)
+        {
+            std::vector<unsigned char> bytes((size_t)file.tellg());
+            file.seekg(0);
+            if (file.read((char*)bytes.data(), bytes.size()))
+            {
+                // FNV-1a over the file, lets the texture manager spot the same image under two paths
+                uint64_t hash = 14695981039346656037ull;
+                for (unsigned char byte : bytes)
+                {
+                    hash ^= byte;
+                    hash *= 1099511628211ull;
+                }
+                result.contentHash = hash;
+
+                // the flip flag is per thread, so workers never race each other on it
+                stbi_set_flip_vertically_on_load_thread(job.flipVertically);
+                result.pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(),
+                                                      &result.width, &result.height, &result.channels, 0);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(decodedMutex);
+            decoded.push_back(result);
+        }
+        decodedReady.notify_all();
+    }
+}
+
+void TextureLoader::collectDecoded()
+{
+    std::vector<DecodeResult> results;
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        results.swap(decoded);
+    }
+
+    for (const DecodeResult &result : results)
+    {
+        Texture &texture = textures[result.handle];
+        if (result.generation != texture.generation)
+        {
+            // unloaded while it was decoding
+            stbi_image_free(result.pixels);
+            continue;
+        }
+
+        texture.contentHash = result.contentHash;
+        if (!result.pixels)
+        {
+            std::cout << "Failed to load texture " << texture.path << "\n";
+            texture.status = FAILED;
+            continue;
+        }
+
+        texture.pixels = result.pixels;
+        texture.width = result.width;
+        texture.height = result.height;
+        texture.channels = result.channels;
+        texture.status = UPLOADING;
+
+        // storage for the full image now, rows are filled in over the next frames
+        glGenTextures(1, &texture.id);
+        glState().bindTexture(0, GL_TEXTURE_2D, texture.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture.options.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture.options.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.options.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texture.options.magFilter);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(texture.channels), texture.width, texture.height, 0,
+                     pixelFormat(texture.channels), GL_UNSIGNED_BYTE, NULL);
+    }
+}
+
+void TextureLoader::update()
+{
+    collectDecoded();
+    lastUploadBytes = 0;
+
+    std::vector<Texture*> uploading;
+    for (Texture &texture : textures)
+    {
+        if (texture.status == UPLOADING)
+            uploading.push_back(&texture);
+    }
+    if (uploading.empty())
+        return;
+
+    // at least one row has to fit, or a very wide image would never finish
+    size_t stagingSize = uploadBudget;
+    for (Texture *texture : uploading)
+        stagingSize = std::max(stagingSize, (size_t)texture->width * texture->channels);
+
+    // orphan the pixel buffer so we never wait on last frame's transfer, then write into it
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, stagingSize, NULL, GL_STREAM_DRAW);
+    unsigned char *staging = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, stagingSize,
+                                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!staging)
+    {
+        glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    // stb rows are tightly packed, an RGB row of odd width isn't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // copy first, the texture calls read from the buffer after it is unmapped
+    struct RowRange { Texture *texture; int firstRow, rows; size_t offset; };
+    std::vector<RowRange> ranges;
+    size_t offset = 0;
+    for (Texture *texture : uploading)
+    {
+        int firstRow = texture->rowsUploaded;
+        size_t copied = uploadRows(*texture, staging + offset, stagingSize - offset);
+        if (copied == 0)
+            break;
+        ranges.push_back({texture, firstRow, texture->rowsUploaded - firstRow, offset});
+        offset += copied;
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    for (const RowRange &range : ranges)
+    {
+        Texture &texture = *range.texture;
+        glState().bindTexture(0, GL_TEXTURE_2D, texture.id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, range.firstRow, texture.width, range.rows,
+                        pixelFormat(texture.channels), GL_UNSIGNED_BYTE, (void*)range.offset);
+
+        if (texture.rowsUploaded == texture.height)
+        {
+            if (texture.options.mipmaps)
+                glGenerateMipmap(GL_TEXTURE_2D);
+            stbi_image_free(texture.pixels);
+            texture.pixels = nullptr;
+            texture.status = READY;
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    lastUploadBytes = offset;
+}
+
+size_t TextureLoader::uploadRows(Texture &texture, unsigned char *staging, size_t budget)
+{
+    size_t rowBytes = (size_t)texture.width * texture.channels;
+    size_t rowsLeft = texture.height - texture.rowsUploaded;
+    size_t rows = std::min(rowsLeft, budget / rowBytes);
+    if (rows == 0)
+        return 0;
+
+    std::memcpy(staging, texture.pixels + texture.rowsUploaded * rowBytes, rows * rowBytes);
+    texture.rowsUploaded += rows;
+    return rows * rowBytes;
+}
+
+void TextureLoader::finish()
+{
+    auto decoding = [this]
+    {
+        for (const Texture &texture : textures)
+        {
+            if (texture.status == DECODING)
+                return true;
+        }
+        return false;
+    };
+
+    // wait for the workers
+    collectDecoded();
+    while (decoding())
+    {
+        {
+            std::unique_lock<std::mutex> lock(decodedMutex);
+            decodedReady.wait(lock, [this] { return !decoded.empty(); });
+        }
+        collectDecoded();
+    }
+
+    // then upload everything in one go, ignoring the budget
+    size_t savedBudget = uploadBudget;
+    for (const Texture &texture : textures)
+    {
+        if (texture.status == UPLOADING)
+            uploadBudget = std::max(uploadBudget, (size_t)texture.width * texture.height * texture.channels);
+    }
+    while (pendingCount() > 0)
+        update();
+    uploadBudget = savedBudget;
+}
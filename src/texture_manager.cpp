@@ -0,0 +1,225 @@
+#include "texture_manager.h"
+
+#include <filesystem>
+#include <limits>
+
+
+TextureRef::TextureRef(TextureManager *manager, int entry)
+    : manager(manager), entry(entry)
+{
+    manager->addRef(entry);
+}
+
+TextureRef::TextureRef(const TextureRef &other)
+    : manager(other.manager), entry(other.entry)
+{
+    if (manager)
+        manager->addRef(entry);
+}
+
+TextureRef& TextureRef::operator=(const TextureRef &other)
+{
+    // take the new reference first, assigning a ref to itself must not drop the texture
+    if (other.manager)
+        other.manager->addRef(other.entry);
+    if (manager)
+        manager->release(entry);
+    manager = other.manager;
+    entry = other.entry;
+    return *this;
+}
+
+TextureRef::~TextureRef()
+{
+    if (manager)
+        manager->release(entry);
+}
+
+unsigned int TextureRef::id() const
+{
+    return manager ? manager->bind(entry) : 0;
+}
+
+bool TextureRef::ready() const
+{
+    return manager && manager->textureLoader.ready(manager->entries[manager->resolve(entry)].handle);
+}
+
+
+TextureManager::TextureManager(size_t vramBudget, int workerThreads, size_t uploadBudget)
+    : textureLoader(workerThreads, uploadBudget), budget(vramBudget)
+{
+}
+
+// the same file loaded with different options is a different texture
+std::string TextureManager::optionsKey(const TextureLoadOptions &options)
+{
+    return "|" + std::to_string(options.flipVertically) + "|" + std::to_string(options.wrap)
+         + "|" + std::to_string(options.minFilter) + "|" + std::to_string(options.magFilter)
+         + "|" + std::to_string(options.mipmaps);
+}
+
+TextureRef TextureManager::acquire(const std::string &path, const TextureLoadOptions &options)
+{
+    // "textures/../textures/a.png" and "./textures/a.png" are the same texture
+    std::error_code error;
+    std::string canonical = std::filesystem::weakly_canonical(path, error).string();
+    if (error)
+        canonical = path;
+    std::string optionKey = optionsKey(options);
+    std::string key = canonical + optionKey;
+
+    auto found = entryByKey.find(key);
+    if (found != entryByKey.end())
+    {
+        hits++;
+        int entry = resolve(found->second);
+        entries[entry].lastUsed = ++useClock;
+
+        // evicted earlier, start bringing it back now rather than on first bind
+        if (textureLoader.unloaded(entries[entry].handle))
+            textureLoader.reload(entries[entry].handle);
+        return TextureRef(this, found->second);
+    }
+
+    misses++;
+    Entry entry;
+    entry.key = key;
+    entry.options = optionKey;
+    entry.handle = textureLoader.load(path, options);
+    entry.lastUsed = ++useClock;
+    entries.push_back(entry);
+    entryByKey[key] = (int)entries.size() - 1;
+    return TextureRef(this, (int)entries.size() - 1);
+}
+
+int TextureManager::resolve(int entry) const
+{
+    while (entries[entry].aliasOf >= 0)
+        entry = entries[entry].aliasOf;
+    return entry;
+}
+
+void TextureManager::addRef(int entry)
+{
+    entries[resolve(entry)].refCount++;
+}
+
+void TextureManager::release(int entry)
+{
+    // nothing is freed here, unreferenced textures stay cached until the budget needs the space
+    entries[resolve(entry)].refCount--;
+}
+
+unsigned int TextureManager::bind(int index)
+{
+    Entry &entry = entries[resolve(index)];
+    entry.lastUsed = ++useClock;
+    if (textureLoader.unloaded(entry.handle))
+        textureLoader.reload(entry.handle);
+    return textureLoader.texture(entry.handle);
+}
+
+void TextureManager::update()
+{
+    textureLoader.update();
+    foldDuplicates();
+    evictToBudget();
+}
+
+void TextureManager::finish()
+{
+    textureLoader.finish();
+    foldDuplicates();
+    evictToBudget();
+}
+
+void TextureManager::foldDuplicates()
+{
+    for (int i = 0; i < (int)entries.size(); i++)
+    {
+        Entry &entry = entries[i];
+        if (entry.hashChecked || entry.aliasOf >= 0)
+            continue;
+
+        uint64_t hash = textureLoader.contentHash(entry.handle);
+        if (hash == 0)
+            continue;
+        entry.hashChecked = true;
+
+        std::string key = std::to_string(hash) + entry.options;
+        auto found = entryByContent.find(key);
+        if (found == entryByContent.end())
+        {
+            entryByContent[key] = i;
+            continue;
+        }
+
+        // same bytes under another path, everyone holding this entry now shares the first one
+        Entry &original = entries[found->second];
+        original.refCount += entry.refCount;
+        original.lastUsed = std::max(original.lastUsed, entry.lastUsed);
+        entry.refCount = 0;
+        entry.aliasOf = found->second;
+        textureLoader.unload(entry.handle);
+        if (textureLoader.unloaded(original.handle))
+            textureLoader.reload(original.handle);
+        contentDuplicates++;
+    }
+}
+
+void TextureManager::evictToBudget()
+{
+    size_t resident = 0;
+    for (const Entry &entry : entries)
+    {
+        if (entry.aliasOf < 0)
+            resident += textureLoader.gpuBytes(entry.handle);
+    }
+
+    while (resident > budget)
+    {
+        // least recently used texture that nobody holds on to
+        int victim = -1;
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (int i = 0; i < (int)entries.size(); i++)
+        {
+            const Entry &entry = entries[i];
+            if (entry.aliasOf >= 0 || entry.refCount > 0 || entry.lastUsed >= oldest)
+                continue;
+            if (textureLoader.gpuBytes(entry.handle) == 0)
+                continue;
+            victim = i;
+            oldest = entry.lastUsed;
+        }
+
+        // everything left is referenced, the budget is simply too small for the scene
+        if (victim < 0)
+            break;
+
+        resident -= textureLoader.gpuBytes(entries[victim].handle);
+        textureLoader.unload(entries[victim].handle);
+        evictions++;
+    }
+}
+
+TextureCacheStats TextureManager::stats() const
+{
+    TextureCacheStats stats = {};
+    stats.textures = (int)entries.size();
+    stats.budgetBytes = budget;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.contentDuplicates = contentDuplicates;
+    stats.evictions = evictions;
+    for (const Entry &entry : entries)
+    {
+        size_t bytes = entry.aliasOf < 0 ? textureLoader.gpuBytes(entry.handle) : 0;
+        if (bytes > 0)
+        {
+            stats.resident++;
+            stats.residentBytes += bytes;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,126 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(int threads)
+{
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < threads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+bool ThreadPool::runChunks(Batch &batch)
+{
+    bool ranAny = false;
+    while (true)
+    {
+        int chunk = batch.nextChunk.fetch_add(1);
+        if (chunk >= batch.chunkCount)
+            return ranAny;
+
+        int begin = chunk * batch.chunkSize;
+        int end = std::min(batch.count, begin + batch.chunkSize);
+        (*batch.body)(begin, end);
+        batch.chunksDone.fetch_add(1);
+        ranAny = true;
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int begin, int end)> &body, int minChunk)
+{
+    if (count <= 0)
+        return;
+
+    // a few chunks per thread keeps everyone busy when chunks take uneven time
+    int threads = threadCount();
+    int chunkSize = std::max(std::max(1, minChunk), (count + threads * 4 - 1) / (threads * 4));
+    int chunkCount = (count + chunkSize - 1) / chunkSize;
+    if (threads == 1 || chunkCount == 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    Batch batch;
+    batch.body = &body;
+    batch.count = count;
+    batch.chunkSize = chunkSize;
+    batch.chunkCount = chunkCount;
+    batch.nextChunk = 0;
+    batch.chunksDone = 0;
+    batch.workersInside = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batches.push_back(&batch);
+    }
+    workReady.notify_all();
+
+    // help with our own batch, then wait for the chunks other threads picked up
+    runChunks(batch);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        batches.erase(std::remove(batches.begin(), batches.end(), &batch), batches.end());
+        batchDone.wait(lock, [&batch] { return batch.chunksDone.load() == batch.chunkCount && batch.workersInside == 0; });
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        Batch *batch = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock, [this] { return stopping || !batches.empty(); });
+            if (stopping)
+                return;
+
+            // batches with nothing left to claim are waiting on their last chunks, skip them
+            for (Batch *candidate : batches)
+            {
+                if (candidate->nextChunk.load() < candidate->chunkCount)
+                {
+                    batch = candidate;
+                    break;
+                }
+            }
+            if (!batch)
+            {
+                workReady.wait(lock);
+                continue;
+            }
+            batch->workersInside++;
+        }
+
+        runChunks(*batch);
+
+        // the owner may be waiting on the chunk we just finished
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batch->workersInside--;
+        }
+        batchDone.notify_all();
+    }
+}
+
+
+ThreadPool& threadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,189 @@
+#include "transform_batch.h"
+#include "thread_pool.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#include <glm/simd/matrix.h>
+#endif
+
+
+namespace
+{
+    // objects per parallelFor chunk, counted in blocks of 8
+    const int minChunkBlocks = 1024;
+
+    // the 16 floats of one column major matrix, operation for operation what the AVX2 kernel does
+    void composeScalar(float px, float py, float pz, float qx, float qy, float qz, float qw,
+                       float sx, float sy, float sz, float *m)
+    {
+        float x2 = qx + qx, y2 = qy + qy, z2 = qz + qz;
+        float xx = qx * x2, yy = qy * y2, zz = qz * z2;
+        float xy = qx * y2, xz = qx * z2, yz = qy * z2;
+        float wx = qw * x2, wy = qw * y2, wz = qw * z2;
+
+        m[0] = std::fma(-(yy + zz), sx, sx);
+        m[1] = (xy + wz) * sx;
+        m[2] = (xz - wy) * sx;
+        m[3] = 0.0f;
+        m[4] = (xy - wz) * sy;
+        m[5] = std::fma(-(xx + zz), sy, sy);
+        m[6] = (yz + wx) * sy;
+        m[7] = 0.0f;
+        m[8] = (xz + wy) * sz;
+        m[9] = (yz - wx) * sz;
+        m[10] = std::fma(-(xx + yy), sz, sz);
+        m[11] = 0.0f;
+        m[12] = px;
+        m[13] = py;
+        m[14] = pz;
+        m[15] = 1.0f;
+    }
+
+#ifdef CPU_X86
+    // 8 objects a step from first, count is a multiple of 8
+    CPU_TARGET_AVX2_FMA
+    void composeAvx2(const float *px, const float *py, const float *pz,
+                     const float *qx, const float *qy, const float *qz, const float *qw,
+                     const float *sx, const float *sy, const float *sz, size_t count, float *out)
+    {
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+        for (size_t i = 0; i < count; i += 8, out += 8 * 16)
+        {
+            __m256 x = _mm256_loadu_ps(qx + i), y = _mm256_loadu_ps(qy + i);
+            __m256 z = _mm256_loadu_ps(qz + i), w = _mm256_loadu_ps(qw + i);
+            __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+            __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+            __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+            __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+            __m256 scaleX = _mm256_loadu_ps(sx + i), scaleY = _mm256_loadu_ps(sy + i), scaleZ = _mm256_loadu_ps(sz + i);
+
+            // columns 0 and 1, then 2 and 3
+            __m256 low[8] = {
+                _mm256_fnmadd_ps(_mm256_add_ps(yy, zz), scaleX, scaleX),
+                _mm256_mul_ps(_mm256_add_ps(xy, wz), scaleX),
+                _mm256_mul_ps(_mm256_sub_ps(xz, wy), scaleX),
+                zero,
+                _mm256_mul_ps(_mm256_sub_ps(xy, wz), scaleY),
+                _mm256_fnmadd_ps(_mm256_add_ps(xx, zz), scaleY, scaleY),
+                _mm256_mul_ps(_mm256_add_ps(yz, wx), scaleY),
+                zero };
+            __m256 high[8] = {
+                _mm256_mul_ps(_mm256_add_ps(xz, wy), scaleZ),
+                _mm256_mul_ps(_mm256_sub_ps(yz, wx), scaleZ),
+                _mm256_fnmadd_ps(_mm256_add_ps(xx, yy), scaleZ, scaleZ),
+                zero,
+                _mm256_loadu_ps(px + i),
+                _mm256_loadu_ps(py + i),
+                _mm256_loadu_ps(pz + i),
+                one };
+
+            glm_transpose8_avx(low);
+            glm_transpose8_avx(high);
+            for (int j = 0; j < 8; j++)
+            {
+                _mm256_storeu_ps(out + j * 16, low[j]);
+                _mm256_storeu_ps(out + j * 16 + 8, high[j]);
+            }
+        }
+    }
+#endif
+}
+
+size_t TransformBatch::add(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    size_t i = size();
+    resize(i + 1);
+    set(i, position, rotation, scale);
+    return i;
+}
+
+void TransformBatch::resize(size_t count)
+{
+    for (std::vector<float> *column : {&positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ})
+        column->resize(count, 0.0f);
+    for (std::vector<float> *column : {&rotationW, &scaleX, &scaleY, &scaleZ})
+        column->resize(count, 1.0f);
+}
+
+void TransformBatch::set(size_t i, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    setPosition(i, position);
+    setRotation(i, rotation);
+    setScale(i, scale);
+}
+
+void TransformBatch::setPosition(size_t i, const glm::vec3 &position)
+{
+    positionX[i] = position.x;
+    positionY[i] = position.y;
+    positionZ[i] = position.z;
+}
+
+void TransformBatch::setRotation(size_t i, const glm::quat &rotation)
+{
+    rotationX[i] = rotation.x;
+    rotationY[i] = rotation.y;
+    rotationZ[i] = rotation.z;
+    rotationW[i] = rotation.w;
+}
+
+void TransformBatch::setScale(size_t i, const glm::vec3 &scale)
+{
+    scaleX[i] = scale.x;
+    scaleY[i] = scale.y;
+    scaleZ[i] = scale.z;
+}
+
+bool TransformBatch::simdAvailable()
+{
+#ifdef CPU_X86
+    return cpuHasAvx2() && cpuHasFma();
+#else
+    return false;
+#endif
+}
+
+void TransformBatch::computeMatrices(glm::mat4 *out, size_t begin, size_t end, bool allowSimd) const
+{
+    // an empty range may start at size(), where indexing the columns is already out of bounds
+    if (begin >= end)
+        return;
+
+    size_t i = begin;
+#ifdef CPU_X86
+    if (allowSimd && simdAvailable())
+    {
+        size_t blocks = (end - begin) / 8 * 8;
+        composeAvx2(&positionX[i], &positionY[i], &positionZ[i], &rotationX[i], &rotationY[i], &rotationZ[i],
+                    &rotationW[i], &scaleX[i], &scaleY[i], &scaleZ[i], blocks, &out[i][0][0]);
+        i += blocks;
+    }
+#endif
+    for (; i < end; i++)
+    {
+        composeScalar(positionX[i], positionY[i], positionZ[i], rotationX[i], rotationY[i], rotationZ[i], rotationW[i],
+                      scaleX[i], scaleY[i], scaleZ[i], &out[i][0][0]);
+    }
+}
+
+void TransformBatch::computeMatrices(glm::mat4 *out, bool allowSimd) const
+{
+    // chunks start on multiples of 8 so only the very last one has a scalar tail
+    size_t count = size();
+    threadPool().parallelFor((int)((count + 7) / 8), [&](int begin, int end)
+    {
+        computeMatrices(out, (size_t)begin * 8, std::min((size_t)end * 8, count), allowSimd);
+    }, minChunkBlocks);
+}
+
+glm::mat4 composeTransform(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    glm::mat4 m;
+    composeScalar(position.x, position.y, position.z, rotation.x, rotation.y, rotation.z, rotation.w,
+                  scale.x, scale.y, scale.z, &m[0][0]);
+    return m;
+}
@@ -0,0 +1,225 @@
+#include "transform_hierarchy.h"
+#include "mat4_kernels.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+    // nodes a pool chunk takes at least, and how many are multiplied as one batch inside it
+    const int minChunkNodes = 2048;
+    const size_t batchNodes = 64;
+}
+
+// used by reference in the ternaries below
+const unsigned int TransformHierarchy::noParent;
+
+unsigned int TransformHierarchy::add(unsigned int parent, const glm::vec3 &position, const glm::quat &rotation,
+                                     const glm::vec3 &scale)
+{
+    if (parent != noParent && parent >= slotOf.size())
+        throw std::invalid_argument("TransformHierarchy::add: there is no node " + std::to_string(parent));
+
+    unsigned int node = (unsigned int)slotOf.size();
+    size_t slot = parents.size();
+    parents.push_back(parent == noParent ? noParent : slotOf[parent]);
+    nodeAt.push_back(node);
+    slotOf.push_back((unsigned int)slot);
+    locals.add(position, rotation, scale);
+    localMatrices.push_back(glm::mat4(1.0f));
+    worlds.push_back(glm::mat4(1.0f));
+    dirty.push_back(0);
+    changed.push_back(0);
+    markDirty(slot);
+    sorted = false;
+    return node;
+}
+
+void TransformHierarchy::markDirty(size_t slot)
+{
+    if (!dirty[slot])
+    {
+        dirty[slot] = 1;
+        dirtySlots.push_back((unsigned int)slot);
+    }
+}
+
+void TransformHierarchy::setLocal(unsigned int node, const glm::vec3 &position, const glm::quat &rotation,
+                                  const glm::vec3 &scale)
+{
+    size_t slot = slotOf[node];
+    locals.set(slot, position, rotation, scale);
+    markDirty(slot);
+}
+
+void TransformHierarchy::setPosition(unsigned int node, const glm::vec3 &position)
+{
+    size_t slot = slotOf[node];
+    locals.setPosition(slot, position);
+    markDirty(slot);
+}
+
+void TransformHierarchy::setRotation(unsigned int node, const glm::quat &rotation)
+{
+    size_t slot = slotOf[node];
+    locals.setRotation(slot, rotation);
+    markDirty(slot);
+}
+
+void TransformHierarchy::setScale(unsigned int node, const glm::vec3 &scale)
+{
+    size_t slot = slotOf[node];
+    locals.setScale(slot, scale);
+    markDirty(slot);
+}
+
+unsigned int TransformHierarchy::parent(unsigned int node) const
+{
+    unsigned int parentSlot = parents[slotOf[node]];
+    return parentSlot == noParent ? noParent : nodeAt[parentSlot];
+}
+
+void TransformHierarchy::sortByDepth()
+{
+    size_t count = size();
+
+    // children of every slot, in slot order
+    std::vector<unsigned int> childStarts(count + 1, 0), children(count);
+    for (size_t slot = 0; slot < count; slot++)
+    {
+        if (parents[slot] != noParent)
+            childStarts[parents[slot] + 1]++;
+    }
+    for (size_t slot = 0; slot < count; slot++)
+        childStarts[slot + 1] += childStarts[slot];
+    std::vector<unsigned int> filled(childStarts.begin(), childStarts.end() - 1);
+    for (size_t slot = 0; slot < count; slot++)
+    {
+        if (parents[slot] != noParent)
+            children[filled[parents[slot]]++] = (unsigned int)slot;
+    }
+
+    // breadth first: the roots, then the children of every node of a level in that level's order
+    std::vector<unsigned int> order;
+    order.reserve(count);
+    for (size_t slot = 0; slot < count; slot++)
+    {
+        if (parents[slot] == noParent)
+            order.push_back((unsigned int)slot);
+    }
+    levelStarts.assign(1, 0);
+    size_t levelBegin = 0;
+    while (levelBegin < order.size())
+    {
+        size_t levelEnd = order.size();
+        for (size_t i = levelBegin; i < levelEnd; i++)
+            order.insert(order.end(), children.begin() + childStarts[order[i]], children.begin() + childStarts[order[i] + 1]);
+        levelStarts.push_back(levelEnd);
+        levelBegin = levelEnd;
+    }
+
+    std::vector<unsigned int> newSlot(count);
+    for (size_t i = 0; i < count; i++)
+        newSlot[order[i]] = (unsigned int)i;
+
+    std::vector<unsigned int> sortedParents(count), sortedNodes(count);
+    TransformBatch sortedLocals;
+    sortedLocals.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned int old = order[i];
+        sortedParents[i] = parents[old] == noParent ? noParent : newSlot[parents[old]];
+        sortedNodes[i] = nodeAt[old];
+        sortedLocals.set(i, locals.position(old), locals.rotation(old), locals.scale(old));
+        slotOf[nodeAt[old]] = (unsigned int)i;
+    }
+    parents.swap(sortedParents);
+    nodeAt.swap(sortedNodes);
+    locals = std::move(sortedLocals);
+
+    dirty.assign(count, 1);
+    dirtySlots.resize(count);
+    for (size_t i = 0; i < count; i++)
+        dirtySlots[i] = (unsigned int)i;
+    sorted = true;
+}
+
+void TransformHierarchy::update(bool parallel)
+{
+    if (!sorted)
+        sortByDepth();
+    size_t count = size();
+    if (count == 0)
+        return;
+
+    // local matrices of the queued nodes, all at once on the SIMD path when most of them are
+    if (dirtySlots.size() * 4 > count)
+    {
+        if (parallel)
+            locals.computeMatrices(localMatrices.data());
+        else
+            locals.computeMatrices(localMatrices.data(), 0, count);
+    }
+    else
+    {
+        for (unsigned int slot : dirtySlots)
+            localMatrices[slot] = composeTransform(locals.position(slot), locals.rotation(slot), locals.scale(slot));
+    }
+
+    const Mat4Kernels &kernels = mat4Kernels();
+    for (size_t level = 0; level + 1 < levelStarts.size(); level++)
+    {
+        size_t levelBegin = levelStarts[level];
+        auto sweep = [&](int first, int last)
+        {
+            for (size_t begin = levelBegin + first; begin < levelBegin + last; begin += batchNodes)
+            {
+                size_t end = std::min(begin + batchNodes, levelBegin + last);
+                size_t changedCount = 0;
+                for (size_t i = begin; i < end; i++)
+                {
+                    changed[i] = dirty[i] | (parents[i] != noParent ? changed[parents[i]] : 0);
+                    changedCount += changed[i];
+                }
+
+                if (level == 0)
+                {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        if (changed[i])
+                            worlds[i] = localMatrices[i];
+                    }
+                }
+                else if (changedCount == end - begin)
+                {
+                    // the whole batch moved: parents gathered next to each other, one kernel call
+                    glm::mat4 parentWorlds[batchNodes];
+                    for (size_t i = begin; i < end; i++)
+                        parentWorlds[i - begin] = worlds[parents[i]];
+                    kernels.multiply(parentWorlds, &localMatrices[begin], &worlds[begin], end - begin);
+                }
+                else if (changedCount > 0)
+                {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        if (changed[i])
+                            kernels.multiply(&worlds[parents[i]], &localMatrices[i], &worlds[i], 1);
+                    }
+                }
+            }
+        };
+
+        int levelSize = (int)(levelStarts[level + 1] - levelBegin);
+        if (parallel && levelSize > minChunkNodes)
+            threadPool().parallelFor(levelSize, sweep, minChunkNodes);
+        else
+            sweep(0, levelSize);
+    }
+
+    for (unsigned int slot : dirtySlots)
+        dirty[slot] = 0;
+    dirtySlots.clear();
+}
@@ -0,0 +1,379 @@
+#include "vertex_layout.h"
+#include "mesh_loader.h"
+#include "thread_pool.h"
+#include "cpu_features.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+
+namespace
+{
+    // bytes one attribute takes, 0 when the semantic can't be stored in that format
+    unsigned int attributeSize(VertexSemantic semantic, VertexFormat format)
+    {
+        int components = semantic == VertexSemantic::TexCoord ? 2 : 3;
+        switch (format)
+        {
+            case VertexFormat::Float32:
+                return components * 4;
+            case VertexFormat::Half16:
+                // positions get a w so the next attribute stays 4 byte aligned
+                if (semantic == VertexSemantic::Position)
+                    return 8;
+                return semantic == VertexSemantic::TexCoord ? 4 : 0;
+            case VertexFormat::Unorm8:
+                return semantic == VertexSemantic::Color ? 4 : 0;
+            case VertexFormat::OctSnorm16:
+                return semantic == VertexSemantic::Normal ? 4 : 0;
+        }
+        return 0;
+    }
+
+    // the same encoding the AVX2 path does, zero length normals come out as (0, 0, 1)
+    glm::vec2 octahedralEncode(const float *normal)
+    {
+        float length = std::max(std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]), 1e-20f);
+        glm::vec2 folded(normal[0] / length, normal[1] / length);
+        if (normal[2] < 0.0f)
+            folded = glm::vec2(std::copysign(1.0f - std::abs(folded.y), folded.x),
+                               std::copysign(1.0f - std::abs(folded.x), folded.y));
+        return folded;
+    }
+
+    const float defaultNormal[3] = {0.0f, 0.0f, 1.0f};
+
+    void packAttribute(const VertexAttribute &attribute, const float *source, const float *normal, unsigned char *out)
+    {
+        // where the attribute sits in the MeshData vertex
+        const float *value = normal;
+        if (attribute.semantic == VertexSemantic::Position)
+            value = source;
+        else if (attribute.semantic == VertexSemantic::Color)
+            value = source + 3;
+        else if (attribute.semantic == VertexSemantic::TexCoord)
+            value = source + 6;
+
+        uint32_t packed[2];
+        switch (attribute.format)
+        {
+            case VertexFormat::Float32:
+                std::memcpy(out, value, attribute.size);
+                return;
+            case VertexFormat::Half16:
+                packed[0] = glm::packHalf2x16(glm::vec2(value[0], value[1]));
+                if (attribute.semantic == VertexSemantic::Position)
+                    packed[1] = glm::packHalf2x16(glm::vec2(value[2], 1.0f));
+                break;
+            case VertexFormat::Unorm8:
+                packed[0] = glm::packUnorm4x8(glm::vec4(value[0], value[1], value[2], 1.0f));
+                break;
+            case VertexFormat::OctSnorm16:
+                packed[0] = glm::packSnorm2x16(octahedralEncode(value));
+                break;
+        }
+        std::memcpy(out, packed, attribute.size);
+    }
+
+    void packScalar(const MeshData &mesh, const VertexLayout &layout, unsigned char *out, size_t begin, size_t end)
+    {
+        bool hasNormals = !mesh.normals.empty();
+        for (size_t v = begin; v < end; v++)
+        {
+            const float *source = &mesh.vertices[v * MeshData::floatsPerVertex];
+            const float *normal = hasNormals ? &mesh.normals[v * 3] : defaultNormal;
+            unsigned char *vertex = out + v * layout.stride();
+            for (const VertexAttribute &attribute : layout.attributes())
+                packAttribute(attribute, source, normal, vertex + attribute.offset);
+        }
+    }
+
+#ifdef CPU_X86
+    // glm::detail::toFloat16 for 8 lanes, bit for bit: round half up, denormals, overflow to infinity
+    CPU_TARGET_AVX2 inline __m256i halfBits(__m256 value)
+    {
+        __m256i bits = _mm256_castps_si256(value);
+        __m256i sign = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x8000));
+        __m256i magnitude = _mm256_and_si256(bits, _mm256_set1_epi32(0x7fffffff));
+        __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(magnitude, 23), _mm256_set1_epi32(127 - 15));
+        __m256i mantissa = _mm256_and_si256(magnitude, _mm256_set1_epi32(0x007fffff));
+        __m256i infinity = _mm256_set1_epi32(0x7c00);
+
+        // normal halves: rebias, round at bit 12 (a carry bumps the exponent), anything too big saturates to infinity
+        __m256i normal = _mm256_add_epi32(_mm256_sub_epi32(magnitude, _mm256_set1_epi32((127 - 15) << 23)),
+                                          _mm256_set1_epi32(0x1000));
+        normal = _mm256_min_epu32(_mm256_srli_epi32(normal, 13), infinity);
+
+        // denormal halves: the significand with its implicit one shifted right by 1 - exponent,
+        // the shift gets big enough to leave 0 for everything below the smallest half
+        __m256i shift = _mm256_sub_epi32(_mm256_set1_epi32(1), exponent);
+        __m256i denormal = _mm256_srlv_epi32(_mm256_or_si256(mantissa, _mm256_set1_epi32(0x00800000)), shift);
+        denormal = _mm256_srli_epi32(_mm256_add_epi32(denormal, _mm256_set1_epi32(0x1000)), 13);
+
+        // infinity and nan, a nan keeps its top mantissa bits and at least one of them set
+        __m256i nanMantissa = _mm256_srli_epi32(mantissa, 13);
+        nanMantissa = _mm256_or_si256(nanMantissa, _mm256_and_si256(_mm256_cmpeq_epi32(nanMantissa, _mm256_setzero_si256()),
+                                                                     _mm256_set1_epi32(1)));
+        __m256i isNan = _mm256_andnot_si256(_mm256_cmpeq_epi32(mantissa, _mm256_setzero_si256()), _mm256_set1_epi32(-1));
+        __m256i special = _mm256_or_si256(infinity, _mm256_and_si256(isNan, nanMantissa));
+
+        __m256i isDenormal = _mm256_cmpgt_epi32(_mm256_set1_epi32(1), exponent);
+        __m256i isSpecial = _mm256_cmpeq_epi32(exponent, _mm256_set1_epi32(0xff - (127 - 15)));
+        __m256i result = _mm256_blendv_epi8(normal, denormal, isDenormal);
+        result = _mm256_blendv_epi8(result, special, isSpecial);
+        return _mm256_or_si256(result, sign);
+    }
+
+    // std::round(x) for x that are already scaled, adding the float just below 0.5 and truncating
+    // never rounds up a value that is a hair under .5
+    CPU_TARGET_AVX2 inline __m256i roundToInt(__m256 value)
+    {
+        __m256 signBit = _mm256_set1_ps(-0.0f);
+        __m256 half = _mm256_or_ps(_mm256_and_ps(value, signBit), _mm256_set1_ps(0.49999997f));
+        return _mm256_cvttps_epi32(_mm256_add_ps(value, half));
+    }
+
+    // glm::packUnorm4x8 of (r, g, b, 1)
+    CPU_TARGET_AVX2 inline __m256i unorm8Color(__m256 r, __m256 g, __m256 b)
+    {
+        __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(255.0f);
+        __m256i red = roundToInt(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(r, zero), one), scale));
+        __m256i green = roundToInt(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(g, zero), one), scale));
+        __m256i blue = roundToInt(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(b, zero), one), scale));
+        __m256i packed = _mm256_or_si256(red, _mm256_slli_epi32(green, 8));
+        packed = _mm256_or_si256(packed, _mm256_slli_epi32(blue, 16));
+        return _mm256_or_si256(packed, _mm256_set1_epi32((int)0xff000000));
+    }
+
+    CPU_TARGET_AVX2 inline __m256i snorm16(__m256 value)
+    {
+        __m256 clamped = _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+        return _mm256_and_si256(roundToInt(_mm256_mul_ps(clamped, _mm256_set1_ps(32767.0f))), _mm256_set1_epi32(0xffff));
+    }
+
+    // octahedralEncode + glm::packSnorm2x16 for 8 normals
+    CPU_TARGET_AVX2 inline __m256i octahedralNormal(__m256 x, __m256 y, __m256 z)
+    {
+        __m256 signBit = _mm256_set1_ps(-0.0f);
+        __m256 length = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(signBit, x), _mm256_andnot_ps(signBit, y)),
+                                      _mm256_andnot_ps(signBit, z));
+        length = _mm256_max_ps(length, _mm256_set1_ps(1e-20f));
+        __m256 foldedX = _mm256_div_ps(x, length);
+        __m256 foldedY = _mm256_div_ps(y, length);
+
+        // lower hemisphere folds over the diagonals
+        __m256 one = _mm256_set1_ps(1.0f);
+        __m256 flippedX = _mm256_or_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signBit, foldedY)), _mm256_and_ps(foldedX, signBit));
+        __m256 flippedY = _mm256_or_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signBit, foldedX)), _mm256_and_ps(foldedY, signBit));
+        __m256 lower = _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ);
+        foldedX = _mm256_blendv_ps(foldedX, flippedX, lower);
+        foldedY = _mm256_blendv_ps(foldedY, flippedY, lower);
+
+        return _mm256_or_si256(snorm16(foldedX), _mm256_slli_epi32(snorm16(foldedY), 16));
+    }
+
+    // 8 vertices a step: the 8x8 block of MeshData floats is transposed so every register holds one
+    // component of 8 vertices, the packed words are then written out attribute by attribute
+    CPU_TARGET_AVX2 void packAvx2(const MeshData &mesh, const VertexLayout &layout, unsigned char *out,
+                                  size_t begin, size_t end)
+    {
+        bool hasNormals = !mesh.normals.empty();
+        unsigned int stride = layout.stride();
+        const __m256i normalIndex = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+
+        size_t v = begin;
+        for (; v + 8 <= end; v += 8)
+        {
+            const float *source = &mesh.vertices[v * MeshData::floatsPerVertex];
+            __m256 r0 = _mm256_loadu_ps(source), r1 = _mm256_loadu_ps(source + 8);
+            __m256 r2 = _mm256_loadu_ps(source + 16), r3 = _mm256_loadu_ps(source + 24);
+            __m256 r4 = _mm256_loadu_ps(source + 32), r5 = _mm256_loadu_ps(source + 40);
+            __m256 r6 = _mm256_loadu_ps(source + 48), r7 = _mm256_loadu_ps(source + 56);
+
+            __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+            __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+            __m256 t4 = _mm256_unpacklo_ps(r4, r5), t5 = _mm256_unpackhi_ps(r4, r5);
+            __m256 t6 = _mm256_unpacklo_ps(r6, r7), t7 = _mm256_unpackhi_ps(r6, r7);
+            __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 x = _mm256_permute2f128_ps(s0, s4, 0x20), y = _mm256_permute2f128_ps(s1, s5, 0x20);
+            __m256 z = _mm256_permute2f128_ps(s2, s6, 0x20), r = _mm256_permute2f128_ps(s3, s7, 0x20);
+            __m256 g = _mm256_permute2f128_ps(s0, s4, 0x31), b = _mm256_permute2f128_ps(s1, s5, 0x31);
+            __m256 u = _mm256_permute2f128_ps(s2, s6, 0x31), tv = _mm256_permute2f128_ps(s3, s7, 0x31);
+
+            unsigned char *vertices = out + v * stride;
+            for (const VertexAttribute &attribute : layout.attributes())
+            {
+                alignas(32) uint32_t low[8], high[8];
+                switch (attribute.format)
+                {
+                    case VertexFormat::Float32:
+                        for (int i = 0; i < 8; i++)
+                        {
+                            const float *normal = hasNormals ? &mesh.normals[(v + i) * 3] : defaultNormal;
+                            packAttribute(attribute, source + i * MeshData::floatsPerVertex, normal,
+                                          vertices + i * stride + attribute.offset);
+                        }
+                        continue;
+                    case VertexFormat::Half16:
+                        if (attribute.semantic == VertexSemantic::Position)
+                        {
+                            _mm256_store_si256((__m256i*)low, _mm256_or_si256(halfBits(x), _mm256_slli_epi32(halfBits(y), 16)));
+                            _mm256_store_si256((__m256i*)high, _mm256_or_si256(halfBits(z), _mm256_set1_epi32(0x3c000000)));
+                        }
+                        else
+                            _mm256_store_si256((__m256i*)low, _mm256_or_si256(halfBits(u), _mm256_slli_epi32(halfBits(tv), 16)));
+                        break;
+                    case VertexFormat::Unorm8:
+                        _mm256_store_si256((__m256i*)low, unorm8Color(r, g, b));
+                        break;
+                    case VertexFormat::OctSnorm16:
+                    {
+                        __m256 nx = _mm256_set1_ps(0.0f), ny = nx, nz = _mm256_set1_ps(1.0f);
+                        if (hasNormals)
+                        {
+                            const float *normals = &mesh.normals[v * 3];
+                            nx = _mm256_i32gather_ps(normals, normalIndex, 4);
+                            ny = _mm256_i32gather_ps(normals + 1, normalIndex, 4);
+                            nz = _mm256_i32gather_ps(normals + 2, normalIndex, 4);
+                        }
+                        _mm256_store_si256((__m256i*)low, octahedralNormal(nx, ny, nz));
+                        break;
+                    }
+                }
+
+                for (int i = 0; i < 8; i++)
+                {
+                    unsigned char *at = vertices + i * stride + attribute.offset;
+                    std::memcpy(at, &low[i], 4);
+                    if (attribute.size == 8)
+                        std::memcpy(at + 4, &high[i], 4);
+                }
+            }
+        }
+
+        packScalar(mesh, layout, out, v, end);
+    }
+#endif
+}
+
+
+VertexLayout& VertexLayout::add(VertexSemantic semantic, VertexFormat format)
+{
+    unsigned int size = attributeSize(semantic, format);
+    if (size == 0)
+        throw std::invalid_argument("vertex attribute can't be stored in that format");
+    if (find(semantic))
+        throw std::invalid_argument("vertex attribute is already in the layout");
+
+    attributeList.push_back({semantic, format, vertexStride, size});
+    vertexStride += size;
+    return *this;
+}
+
+const VertexAttribute* VertexLayout::find(VertexSemantic semantic) const
+{
+    for (const VertexAttribute &attribute : attributeList)
+    {
+        if (attribute.semantic == semantic)
+            return &attribute;
+    }
+    return nullptr;
+}
+
+void VertexLayout::apply(size_t base) const
+{
+    for (const VertexAttribute &attribute : attributeList)
+    {
+        GLuint location = (GLuint)attribute.semantic;
+        const void *offset = (const void*)(base + attribute.offset);
+        switch (attribute.format)
+        {
+            case VertexFormat::Float32:
+                glVertexAttribPointer(location, attribute.size / 4, GL_FLOAT, GL_FALSE, vertexStride, offset);
+                break;
+            case VertexFormat::Half16:
+                glVertexAttribPointer(location, attribute.size / 2, GL_HALF_FLOAT, GL_FALSE, vertexStride, offset);
+                break;
+            case VertexFormat::Unorm8:
+                glVertexAttribPointer(location, 4, GL_UNSIGNED_BYTE, GL_TRUE, vertexStride, offset);
+                break;
+            case VertexFormat::OctSnorm16:
+                glVertexAttribPointer(location, 2, GL_SHORT, GL_TRUE, vertexStride, offset);
+                break;
+        }
+        glEnableVertexAttribArray(location);
+    }
+}
+
+VertexLayout VertexLayout::standard()
+{
+    VertexLayout layout;
+    layout.add(VertexSemantic::Position, VertexFormat::Float32)
+          .add(VertexSemantic::Color, VertexFormat::Float32)
+          .add(VertexSemantic::TexCoord, VertexFormat::Float32);
+    return layout;
+}
+
+VertexLayout VertexLayout::compact(bool withNormals)
+{
+    VertexLayout layout;
+    layout.add(VertexSemantic::Position, VertexFormat::Half16)
+          .add(VertexSemantic::Color, VertexFormat::Unorm8)
+          .add(VertexSemantic::TexCoord, VertexFormat::Half16);
+    if (withNormals)
+        layout.add(VertexSemantic::Normal, VertexFormat::OctSnorm16);
+    return layout;
+}
+
+bool vertexPackingSimdAvailable()
+{
+#ifdef CPU_X86
+    return cpuHasAvx2();
+#else
+    return false;
+#endif
+}
+
+void packVertices(const MeshData &mesh, const VertexLayout &layout, unsigned char *out, bool allowSimd)
+{
+    size_t vertexCount = mesh.vertexCount();
+    bool simd = allowSimd && vertexPackingSimdAvailable();
+
+    // blocks of 4096 vertices, a multiple of the 8 the AVX2 loop takes
+    const size_t blockSize = 4096;
+    int blocks = (int)((vertexCount + blockSize - 1) / blockSize);
+    threadPool().parallelFor(blocks, [&](int first, int last)
+    {
+        size_t begin = first * blockSize;
+        size_t end = std::min(vertexCount, last * blockSize);
+#ifdef CPU_X86
+        if (simd)
+        {
+            packAvx2(mesh, layout, out, begin, end);
+            return;
+        }
+#endif
+        (void)simd;
+        packScalar(mesh, layout, out, begin, end);
+    });
+}
+
+std::vector<unsigned char> packVertices(const MeshData &mesh, const VertexLayout &layout)
+{
+    std::vector<unsigned char> bytes(mesh.vertexCount() * layout.stride());
+    packVertices(mesh, layout, bytes.data());
+    return bytes;
+}